@@ -0,0 +1,39 @@
+#!/bin/bash
+#
+# bench_ask.sh -- time ASK reading 10 million values through -i
+#
+# Usage:  ./bench_ask.sh [count]   (from the Review/ directory)
+#
+# Writes count/2 lines of two numbers each, has a FOCAL program ASK for
+# them in pairs and add them up, and reports the time taken and the rate.
+#
+
+cd "$(dirname "$0")"
+
+COUNT=${1:-10000000}
+TMP=${TMPDIR:-/tmp}
+INPUT="$TMP/bench_ask_input.$$"
+PROGRAM="$TMP/bench_ask.$$.fc"
+
+if [ ! -x "../retrofocal" ]; then
+    echo "retrofocal binary not found (run 'make' in project root first)"
+    exit 1
+fi
+
+trap 'rm -f "$INPUT" "$PROGRAM"' EXIT
+
+awk -v n=$((COUNT / 2)) 'BEGIN { srand(1); for (i = 0; i < n; i++) printf "%d.%02d %d\n", int(rand() * 1000), int(rand() * 100), int(rand() * 100000) }' > "$INPUT"
+
+cat > "$PROGRAM" <<FOCAL
+01.10 SET S=0;SET N=0
+01.20 ASK X,Y;SET S=S+X+Y;SET N=N+2
+01.30 IF (N-$COUNT) 1.2
+01.40 TYPE !,%10.0,N,S,!
+FOCAL
+
+start=$(date +%s.%N)
+result=$(../retrofocal -i "$INPUT" "$PROGRAM" | tail -1)
+end=$(date +%s.%N)
+
+echo "values read and sum: $result"
+awk -v s="$start" -v e="$end" -v n="$COUNT" 'BEGIN { t = e - s; printf "%.2f seconds, %.0f values per second\n", t, n / t }'
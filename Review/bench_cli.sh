@@ -0,0 +1,45 @@
+#!/bin/bash
+#
+# bench_cli.sh -- time the CLI running immediate commands sent over a pipe
+#
+# Usage:  ./bench_cli.sh [count]   (from the Review/ directory)
+#
+# Types in a two-line group, then sends count immediate commands that DO
+# it and work with the results, the way a script driving the CLI would.
+# Runs them once with every command parsed again and once with the
+# parsed commands kept, and reports the time and rate for each. Both
+# print the same totals at the end.
+#
+
+cd "$(dirname "$0")"
+
+COUNT=${1:-200000}
+TMP=${TMPDIR:-/tmp}
+INPUT="$TMP/bench_cli_input.$$"
+
+if [ ! -x "../retrofocal" ]; then
+    echo "retrofocal binary not found (run 'make' in project root first)"
+    exit 1
+fi
+
+trap 'rm -f "$INPUT"' EXIT
+
+{
+    echo "5.10 SET X=X+1"
+    echo "5.20 SET Y=Y+X"
+    awk -v n=$((COUNT / 4)) 'BEGIN { for (i = 0; i < n; i++) print "D 5\nSET Z=Z+FSQT(Y)\nS A(X-FITR(X/8)*8)=Z\nIF (Y) 5.1" }'
+    echo "TYPE %12.0,X,Y,Z,!"
+} > "$INPUT"
+
+run() {
+    start=$(date +%s.%N)
+    result=$(../retrofocal "$@" < "$INPUT" | tr -d '*' | grep '[0-9]' | tail -1)
+    end=$(date +%s.%N)
+    echo "  totals: $(echo $result)"
+    awk -v s="$start" -v e="$end" -v n="$COUNT" 'BEGIN { t = e - s; printf "  %.2f seconds, %.0f commands per second\n", t, n / t }'
+}
+
+echo "parsing every command:"
+run --cli-cache-size 0
+echo "keeping parsed commands:"
+run
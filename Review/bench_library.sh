@@ -0,0 +1,55 @@
+#!/bin/bash
+#
+# bench_library.sh -- time programs switching overlays with LIBRARY RUN
+#
+# Usage:  ./bench_library.sh [count]   (from the Review/ directory)
+#
+# Writes a ring of overlays of about 450 lines each, every one of which
+# counts a switch and does LIBRARY RUN on the next, until count switches
+# have been made. Runs a ring of two, which the loader keeps parsed in
+# memory, and a ring of twelve, more than it keeps, so every switch has to
+# map and parse the file again, and reports the time and rate for each.
+#
+
+cd "$(dirname "$0")"
+
+COUNT=${1:-5000}
+TMP=${TMPDIR:-/tmp}
+WORK="$TMP/bench_library.$$"
+
+if [ ! -x "../retrofocal" ]; then
+    echo "retrofocal binary not found (run 'make' in project root first)"
+    exit 1
+fi
+
+trap 'rm -rf "$WORK"' EXIT
+mkdir -p "$WORK"
+
+# overlay n of a ring of size, the rest of the lines are only there to parse
+overlays() {
+    for ((n = 0; n < $1; n++)); do
+        awk -v count=$COUNT -v next_overlay="$WORK/ring$1_$(( (n + 1) % $1 )).fc" 'BEGIN {
+            print "1.10 S X=X+1"
+            print "1.20 I (X-" count ") 1.3,1.4,1.4"
+            print "1.30 LIBRARY RUN \"" next_overlay "\""
+            print "1.40 T %8,X,!; Q"
+            for (g = 2; g < 40; g++)
+                for (l = 1; l < 13; l++)
+                    printf "%d.%02d S Y=Y+%d*X-FSQT(%d)+FSIN(X)/3\n", g, l, g, l
+        }' > "$WORK/ring$1_$n.fc"
+    done
+}
+
+run() {
+    overlays $1
+    start=$(date +%s.%N)
+    result=$(../retrofocal "$WORK/ring$1_0.fc")
+    end=$(date +%s.%N)
+    echo "  switches: $(echo $result)"
+    awk -v s="$start" -v e="$end" -v n="$COUNT" 'BEGIN { t = e - s; printf "  %.2f seconds, %.0f switches per second\n", t, n / t }'
+}
+
+echo "two overlays, kept parsed:"
+run 2
+echo "twelve overlays, parsed every time:"
+run 12
@@ -0,0 +1,85 @@
+#!/bin/bash
+#
+# bench_plugin.sh -- time the sample plugin's kernels against FOCAL
+#
+# Usage:  ./bench_plugin.sh [repeats]   (from the Review/ directory)
+#
+# Builds plugins/sample.c, then runs a 1024-point FFT and a 32 by 32
+# solve the given number of times, once written in FOCAL and once through
+# FNEW, and reports the time taken by each and the speedup. Both print
+# checksums of their results, which should agree.
+#
+
+cd "$(dirname "$0")"
+
+REPEATS=${1:-20}
+TMP=${TMPDIR:-/tmp}
+WORK="$TMP/bench_plugin.$$"
+
+if [ ! -x "../retrofocal" ]; then
+    echo "retrofocal binary not found (run 'make' in project root first)"
+    exit 1
+fi
+
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+${CC:-cc} -O2 -shared -fPIC -I../plugins ../plugins/sample.c -o "$WORK/sample.so" -lm || exit 1
+
+# both versions set the signal and the matrix up again before every
+# repeat, and print the sum of the magnitudes of the FFT and of the
+# solution. The matrix is diagonally dominant, so the plugin never swaps
+# rows and the FOCAL solver can leave pivoting out. The loops are made
+# with IF rather than DO, so the timing is of the arithmetic
+SETUP="01.10 SET N=1024; SET B=10; SET K=32; SET PI=4*FATN(1); SET T=0
+01.20 FOR I=0,N-1; SET R(I)=FSIN(I/7)+FCOS(I/3); SET Y(I)=0
+01.30 FOR I=0,K*K-1; SET W(I)=FSIN(I)
+01.40 FOR I=0,K-1; SET W(I*K+I)=W(I*K+I)+K; SET V(I)=I
+01.50 FOR I=0,K*K-1; SET H(I)=W(I)
+01.60 FOR I=0,K-1; SET Z(I)=V(I)"
+FINISH="03.90 SET T=T+1; IF (T-$REPEATS) 1.2
+04.10 SET CR=0; FOR I=0,N-1; SET CR=CR+FSQT(R(I)^2+Y(I)^2)
+04.20 SET CZ=0; FOR I=0,K-1; SET CZ=CZ+FABS(Z(I))
+04.30 TYPE %12.04, CR, CZ, !; QUIT"
+
+cat > "$WORK/focal.fc" <<FOCAL
+$SETUP
+02.05 COMMENT AN IN-PLACE RADIX-2 FFT, BIT REVERSAL FIRST
+02.10 SET I=0
+02.20 SET J=0; SET X=I; FOR O=1,B; SET J=J*2+X-FITR(X/2)*2; SET X=FITR(X/2)
+02.30 SET P(J)=R(I); SET Q(J)=Y(I); SET I=I+1; IF (I-N) 2.2
+02.40 FOR I=0,N-1; SET R(I)=P(I); SET Y(I)=Q(I)
+02.50 SET L=2
+02.60 SET A=-2*PI/L; SET O=0
+02.70 SET WR=FCOS(A*O); SET WI=FSIN(A*O); SET S=O
+02.80 SET M=S+L/2; SET TR=R(M)*WR-Y(M)*WI; SET TI=R(M)*WI+Y(M)*WR
+02.85 SET R(M)=R(S)-TR; SET Y(M)=Y(S)-TI; SET R(S)=R(S)+TR; SET Y(S)=Y(S)+TI
+02.90 SET S=S+L; IF (S-N) 2.8
+02.92 SET O=O+1; IF (O-L/2) 2.7
+02.94 SET L=L*2; IF (L-N) 2.6, 2.6
+03.05 COMMENT GAUSSIAN ELIMINATION, THEN BACK SUBSTITUTION
+03.10 SET O=0
+03.20 SET I=O+1
+03.30 SET X=H(I*K+O)/H(O*K+O); FOR J=O,K-1; SET H(I*K+J)=H(I*K+J)-X*H(O*K+J)
+03.40 SET Z(I)=Z(I)-X*Z(O); SET I=I+1; IF (I-K) 3.3
+03.50 SET O=O+1; IF (O-K+1) 3.2
+03.60 SET O=K-1
+03.70 SET X=Z(O); FOR J=O+1,K-1; SET X=X-H(O*K+J)*Z(J)
+03.80 SET Z(O)=X/H(O*K+O); SET O=O-1; IF (O) 3.9; GOTO 3.7
+$FINISH
+FOCAL
+
+cat > "$WORK/plugin.fc" <<FOCAL
+$SETUP
+02.10 SET X=FNEW(1,R(0),Y(0),N)
+03.10 SET X=FNEW(3,H(0),Z(0),K)
+$FINISH
+FOCAL
+
+for version in focal plugin; do
+    start=$(date +%s.%N)
+    result=$(../retrofocal --plugin "$WORK/sample.so" "$WORK/$version.fc")
+    end=$(date +%s.%N)
+    eval ${version}_time=$(awk -v s="$start" -v e="$end" 'BEGIN { printf "%.3f", e - s }')
+    echo "$version: checksums $(echo $result)"
+done
+awk -v f=$focal_time -v p=$plugin_time 'BEGIN { printf "FOCAL %.3f seconds, plugin %.3f seconds, %.1f times faster\n", f, p, f / p }'
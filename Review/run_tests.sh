@@ -61,13 +61,10 @@ else
     elif [ $rc -ne 0 ]; then
         echo "  FAIL: exited with error code $rc"
         FAIL=$((FAIL + 1))
-    elif echo "$output" | grep -q "TEST COMPLETE"; then
-        # The program ran without crashing.  Negative subscript indexing is
-        # undefined behavior; it may appear to work on some platforms while
-        # corrupting memory silently.  The bug still exists in the code.
-        echo "  WARN: ran without crashing (undefined behavior did not manifest)"
-        echo "        Bug still exists: negative index used on a 0-based C array"
-        echo "        Run under AddressSanitizer to confirm: make asan"
+    elif echo "$output" | grep -q "A(-1)  =   42" && echo "$output" | grep -q "A(-2048)=   99"; then
+        # Arrays are stored by subscript rather than as a 0-based C array,
+        # so negative subscripts hold their own values.
+        echo "  PASS: negative subscripts stored and read back correctly"
         PASS=$((PASS + 1))
     else
         echo "  FAIL: unexpected output"
@@ -101,6 +98,296 @@ else
 fi
 separator
 
+# Optimizer: loop invariants and compiled lines are checked by running every
+# expression both ways, and fused statements and machine code by comparing
+# the output with --no-optimize, as are array loops run as batches
+for t in test_loop_invariants test_fused_statements test_native_loops test_vector_loops; do
+    TOTAL=$((TOTAL + 1))
+    echo "Optimizer: $t matches the unoptimized interpreter"
+    if [ ! -x "../retrofocal" ]; then
+        echo "  SKIP: retrofocal binary not found"
+        SKIP=$((SKIP + 1))
+    else
+        output=$(../retrofocal --verify-optimizer --tier-threshold 1 $t.fc 2>&1)
+        fused=$(../retrofocal $t.fc 2>&1)
+        expected=$(../retrofocal --no-optimize $t.fc 2>&1)
+        if echo "$output" | grep -q "differs from source"; then
+            echo "  FAIL: optimized and source results differ"
+            echo "$output" | grep "differs" | head -5 | sed 's/^/        /'
+            FAIL=$((FAIL + 1))
+        elif [ "$output" != "$expected" ] || [ "$fused" != "$expected" ]; then
+            echo "  FAIL: output differs from --no-optimize"
+            diff <(echo "$expected") <(echo "$fused") | head -10 | sed 's/^/        /'
+            FAIL=$((FAIL + 1))
+        else
+            echo "  PASS: results bit-identical with and without the optimizer"
+            PASS=$((PASS + 1))
+        fi
+    fi
+    separator
+done
+
+# Empty statements: a doubled or trailing semicolon leaves a statement with
+# nothing in it, which every pass over the program has to step over
+TOTAL=$((TOTAL + 1))
+echo "Empty statements: programs with doubled and trailing semicolons"
+if [ ! -x "../retrofocal" ]; then
+    echo "  SKIP: retrofocal binary not found"
+    SKIP=$((SKIP + 1))
+else
+    expected=$(../retrofocal --no-optimize test_empty_statements.fc 2>&1; echo "rc=$?")
+    output=$(../retrofocal --verify-optimizer --tier-threshold 1 test_empty_statements.fc 2>&1; echo "rc=$?")
+    fused=$(../retrofocal test_empty_statements.fc 2>&1; echo "rc=$?")
+    if [ "${expected##*rc=}" -gt 128 ] || [ "${output##*rc=}" -gt 128 ] || [ "${fused##*rc=}" -gt 128 ]; then
+        echo "  FAIL: crashed"
+        FAIL=$((FAIL + 1))
+    elif [ "$output" != "$expected" ] || [ "$fused" != "$expected" ]; then
+        echo "  FAIL: output differs from --no-optimize"
+        diff <(echo "$expected") <(echo "$fused") | head -10 | sed 's/^/        /'
+        FAIL=$((FAIL + 1))
+    else
+        echo "  PASS: empty statements were skipped the same way everywhere"
+        PASS=$((PASS + 1))
+    fi
+fi
+separator
+
+# Translator: each example is translated with --emit-c, built against the
+# runtime and run with the same input and seed as the interpreter, and the
+# output has to match byte for byte, parse messages and exit status included
+examples="bottles: dampsine: fact:5 primes:200 numtest:1,40 diceg:3 iplot: schrod:
+          lunar:0,10,20,200,200,200,100,50,50,30,30,20,10,0,0,0,0,0,0,0,0
+          sumer:100,0,2000,500,YES,10,0,2000,500,NO"
+for example in $examples; do
+    name=${example%%:*}
+    input=$(echo "${example#*:}" | tr ',' '\n')
+    TOTAL=$((TOTAL + 1))
+    echo "Translator: $name.fc matches the interpreter when translated to C"
+    if [ ! -x "../retrofocal" ] || ! command -v cc > /dev/null; then
+        echo "  SKIP: retrofocal binary or C compiler not found"
+        SKIP=$((SKIP + 1))
+        separator
+        continue
+    fi
+    work=$(mktemp -d)
+    expected=$(echo "$input" | ../retrofocal -r 7 ../examples/$name.fc 2>&1; echo "rc=$?")
+    if ! ../retrofocal --emit-c ../examples/$name.fc > $work/$name.c 2> $work/emit.txt; then
+        # a program the parser rejects is rejected the same way by both
+        output=$(cat $work/emit.txt; echo "rc=1")
+    elif ! cc -O2 -I../runtime -I../src $work/$name.c ../runtime/focalrt.c ../src/number.c ../src/rng.c -o $work/$name -lm 2> $work/cc.txt; then
+        output="does not compile: $(head -3 $work/cc.txt)"
+    else
+        output=$(cat $work/emit.txt; echo "$input" | $work/$name -r 7 2>&1; echo "rc=$?")
+    fi
+    if [ "$output" == "$expected" ]; then
+        echo "  PASS: translated output is identical"
+        PASS=$((PASS + 1))
+    else
+        echo "  FAIL: translated output differs"
+        diff <(echo "$expected") <(echo "$output") | head -10 | sed 's/^/        /'
+        FAIL=$((FAIL + 1))
+    fi
+    rm -rf $work
+    separator
+done
+
+# Common: a second run sees what the first left in the --common file, and a
+# file that isn't a common area, or is the wrong size, is refused
+TOTAL=$((TOTAL + 1))
+echo "Common: FCOM values stored by one run are read by the next"
+if [ ! -x "../retrofocal" ]; then
+    echo "  SKIP: retrofocal binary not found"
+    SKIP=$((SKIP + 1))
+else
+    work=$(mktemp -d)
+    first=$(../retrofocal --common $work/area test_common_area.fc 2>&1)
+    second=$(../retrofocal --common $work/area test_common_area.fc 2>&1)
+    ../retrofocal --common $work/area --common-size 10 test_common_area.fc > /dev/null 2>&1
+    resized=$?
+    echo "not a common area" > $work/other
+    ../retrofocal --common $work/other test_common_area.fc > /dev/null 2>&1
+    other=$?
+    if [ "$(echo $first)" != "4950" ] || [ "$(echo $second)" != "9900" ]; then
+        echo "  FAIL: runs printed $(echo $first) and $(echo $second), expected 4950 and 9900"
+        FAIL=$((FAIL + 1))
+    elif [ $resized -eq 0 ] || [ $other -eq 0 ]; then
+        echo "  FAIL: a wrong-sized or foreign file was accepted"
+        FAIL=$((FAIL + 1))
+    else
+        echo "  PASS: the common area carried over and bad files were refused"
+        PASS=$((PASS + 1))
+    fi
+    rm -rf $work
+fi
+separator
+
+# Replay: a checkpoint taken while replaying a --record log is the same as
+# the recorded run's, and --resume can't be used with a log
+TOTAL=$((TOTAL + 1))
+echo "Replay: checkpoints while replaying a log"
+if [ ! -x "../retrofocal" ]; then
+    echo "  SKIP: retrofocal binary not found"
+    SKIP=$((SKIP + 1))
+else
+    work=$(mktemp -d)
+    recorded=$(../retrofocal -r 7 --record $work/log --checkpoint-every 50 --checkpoint-file $work/recorded.fcs test_replay_checkpoint.fc 2>&1)
+    replayed=$(../retrofocal -r 7 --replay $work/log --checkpoint-every 50 --checkpoint-file $work/replayed.fcs test_replay_checkpoint.fc 2>&1)
+    if [ "$replayed" != "$recorded" ]; then
+        echo "  FAIL: the replay printed $(echo $replayed), the recording $(echo $recorded)"
+        FAIL=$((FAIL + 1))
+    elif ! cmp -s $work/recorded.fcs $work/replayed.fcs; then
+        echo "  FAIL: the replay's checkpoint differs from the recording's"
+        FAIL=$((FAIL + 1))
+    elif ../retrofocal --resume $work/recorded.fcs --replay $work/log > /dev/null 2>&1; then
+        echo "  FAIL: --resume was allowed with --replay"
+        FAIL=$((FAIL + 1))
+    else
+        echo "  PASS: the checkpoints match and --resume was refused"
+        PASS=$((PASS + 1))
+    fi
+    rm -rf $work
+fi
+separator
+
+# Plugin: the sample plugin's FFT, dot product and solver, called through
+# FNEW, give the answers FOCAL does, and FNEW is still zero without it. SET
+# into an array FNEW writes back into still lands after the write back
+TOTAL=$((TOTAL + 1))
+echo "Plugin: FNEW calls the functions in plugins/sample.c"
+work=$(mktemp -d)
+if [ ! -x "../retrofocal" ]; then
+    echo "  SKIP: retrofocal binary not found"
+    SKIP=$((SKIP + 1))
+elif ! ${CC:-cc} -O2 -shared -fPIC -I../plugins ../plugins/sample.c -o $work/sample.so -lm 2>/dev/null; then
+    echo "  SKIP: could not build the sample plugin"
+    SKIP=$((SKIP + 1))
+else
+    with=$(../retrofocal --plugin $work/sample.so test_plugin_calls.fc 2>&1)
+    without=$(../retrofocal test_plugin_calls.fc 2>&1)
+    expected="0.0000 8.0000 0.0000 5.0000 0.8000 1.4000"
+    back=""
+    for mode in "" --no-optimize --no-jit; do
+        back="$back$(../retrofocal $mode --plugin $work/sample.so test_plugin_writeback.fc 2>&1) "
+    done
+    if [ "$(echo $with)" != "$expected" ]; then
+        echo "  FAIL: printed $(echo $with), expected $expected"
+        FAIL=$((FAIL + 1))
+    elif [ "$(echo $without)" != "-0.3050 0.0000 7.0000 0.0000 3.0000 5.0000" ]; then
+        echo "  FAIL: without the plugin printed $(echo $without)"
+        FAIL=$((FAIL + 1))
+    elif [ "$(echo $back)" != "64.0000 0.0000 1.0000 64.0000 0.0000 1.0000 64.0000 0.0000 1.0000" ]; then
+        echo "  FAIL: storing into the array FNEW writes back printed $(echo $back)"
+        FAIL=$((FAIL + 1))
+    else
+        echo "  PASS: the plugin's results match FOCAL's"
+        PASS=$((PASS + 1))
+    fi
+fi
+rm -rf $work
+separator
+
+# Channels: TYPE writes two files at once through OPEN OUTPUT, ASK reads them
+# back through OPEN INPUT, and goes back to the terminal when one runs out
+TOTAL=$((TOTAL + 1))
+echo "Channels: OPEN INPUT and OUTPUT read and write files"
+if [ ! -x "../retrofocal" ]; then
+    echo "  SKIP: retrofocal binary not found"
+    SKIP=$((SKIP + 1))
+else
+    here=$(pwd)
+    work=$(mktemp -d)
+    output=$(cd $work && echo 7 | $here/../retrofocal $here/test_file_channels.fc 2>&1)
+    lines=$(cat $work/SQUARES 2>/dev/null | wc -l)
+    if [ "$(echo $output)" != ": 338350 25502500 7" ]; then
+        echo "  FAIL: printed $(echo $output), expected : 338350 25502500 7"
+        FAIL=$((FAIL + 1))
+    elif [ $lines -ne 100 ]; then
+        echo "  FAIL: the file has $lines lines, expected 100"
+        FAIL=$((FAIL + 1))
+    else
+        echo "  PASS: the files were written and read back"
+        PASS=$((PASS + 1))
+    fi
+    rm -rf $work
+fi
+separator
+
+# Display: FDIS and FDXS draw the same square and row of points in a PPM
+# image and an SVG drawing, and FADC reads the sample file channel by channel.
+# No checkpoint is taken, as it couldn't put either back
+TOTAL=$((TOTAL + 1))
+echo "Display: --plot-file and --adc-file"
+if [ ! -x "../retrofocal" ]; then
+    echo "  SKIP: retrofocal binary not found"
+    SKIP=$((SKIP + 1))
+else
+    work=$(mktemp -d)
+    printf '1 10\n2 20\n' > $work/samples
+    output=$(../retrofocal --plot-file $work/screen.ppm --adc-file $work/samples test_plot_display.fc 2>&1)
+    ../retrofocal --plot-file $work/screen.svg --adc-file $work/samples --checkpoint-every 10 --checkpoint-file $work/run.fcs test_plot_display.fc > /dev/null 2>&1
+    # the square is 3200 points around and the row 100 more, each with one 255
+    lit=$(tail -c +18 $work/screen.ppm | tr -cd '\377' | wc -c)
+    points=$(grep -o 'h0' $work/screen.svg | wc -l)
+    lines=$(grep -o 'L' $work/screen.svg | wc -l)
+    if [ "$(echo $output)" != "1 10 2 20 1 10" ]; then
+        echo "  FAIL: printed $(echo $output), expected 1 10 2 20 1 10"
+        FAIL=$((FAIL + 1))
+    elif [ $lit -ne 3300 ]; then
+        echo "  FAIL: the image has $lit points lit, expected 3300"
+        FAIL=$((FAIL + 1))
+    elif [ $points -ne 101 ] || [ $lines -ne 4 ]; then
+        echo "  FAIL: the drawing has $points points and $lines lines, expected 101 and 4"
+        FAIL=$((FAIL + 1))
+    elif [ -e $work/run.fcs ]; then
+        echo "  FAIL: a checkpoint was taken, which can't put the plot or samples back"
+        FAIL=$((FAIL + 1))
+    else
+        echo "  PASS: both files hold the plot and the samples were read in turn"
+        PASS=$((PASS + 1))
+    fi
+    rm -rf $work
+fi
+separator
+
+# CLI: lines typed, replaced and deleted between immediate commands are
+# linked into the program as they come, a second immediate line used to hang,
+# and a trailing semicolon leaves an empty statement that has to be skipped
+TOTAL=$((TOTAL + 1))
+echo "CLI: editing a program between immediate commands"
+if [ ! -x "../retrofocal" ]; then
+    echo "  SKIP: retrofocal binary not found"
+    SKIP=$((SKIP + 1))
+else
+    output=$(timeout 10 ../retrofocal < test_cli_edits.fc 2>&1 | tr -d '*')
+    if [ "$(echo $output)" != "9.0000 8.0000 5.0000 1.0000 22.0000 21.0000 5.0000 21.0000" ]; then
+        echo "  FAIL: printed $(echo $output), expected 9.0000 8.0000 5.0000 1.0000 22.0000 21.0000 5.0000 21.0000"
+        FAIL=$((FAIL + 1))
+    else
+        echo "  PASS: the edits ran in line order"
+        PASS=$((PASS + 1))
+    fi
+fi
+separator
+
+# Library: a program and an overlay LIBRARY RUN each other 49 times, the
+# second time on each comes from the loader's cache, then LIBRARY CALL stops it
+TOTAL=$((TOTAL + 1))
+echo "Library: chaining overlays with LIBRARY RUN"
+if [ ! -x "../retrofocal" ]; then
+    echo "  SKIP: retrofocal binary not found"
+    SKIP=$((SKIP + 1))
+else
+    output=$(timeout 10 ../retrofocal test_library_run.fc 2>&1)
+    if [ "$(echo $output)" != "50 98" ]; then
+        echo "  FAIL: printed $(echo $output), expected 50 98"
+        FAIL=$((FAIL + 1))
+    else
+        echo "  PASS: the overlays ran in turn"
+        PASS=$((PASS + 1))
+    fi
+fi
+separator
+
 echo ""
 echo "--- C unit tests (automated pass/fail) ---"
 echo ""
@@ -113,7 +400,8 @@ for t in test_C2_str_new_null \
          test_C7_fin_fallthrough \
          test_C8_wrong_union_member \
          test_C9_lst_key_null \
-         test_C10_lst_copy_broken; do
+         test_C10_lst_copy_broken \
+         test_ask_number_parser; do
     run_c_test "$t"
     separator
 done
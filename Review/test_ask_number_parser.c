@@ -0,0 +1,236 @@
+/*
+ * test_ask_number_parser.c
+ * Equivalence test for the single-pass ASK number parser in number.c.
+ *
+ * string_to_number() used to live in retrofocal.c, where it scanned the
+ * input twice and called pow() twice per value. The reference below is
+ * that code, with the error calls replaced by a flag and two sign bugs
+ * corrected:
+ *
+ *   mantissa_sign = !mantissa_sign;   // should be -mantissa_sign
+ *   exponent_sign = !exponent_sign;   // should be -exponent_sign
+ *
+ * !1 is 0, so every negative input read as zero, and the sign was also
+ * only applied to the integer part, so -5.5 would have read as -4.5.
+ *
+ * The new parser must give a bit-identical result, and fail on the same
+ * inputs, for every string of up to four characters over an alphabet of
+ * digits, letters, periods, Es and signs, for the inputs the example
+ * programs are run with, and for a million random decimal numbers.
+ * Numbers with more digits than a long long holds have to come out
+ * close to what strtod gives, rather than overflowing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "number.h"
+
+static int reference_failed;
+
+static double reference_string_to_number(const char *string)
+{
+	int len = (int)strlen(string);
+
+	// empty/useless string?
+	if (len == 0)
+		return 0.0;
+
+	int e_location = -1;
+	int p_location = -1;
+	int integer = 0;
+	int fraction = 0;
+	int exponent = 0;
+	int mantissa_sign = 1;
+	int exponent_sign = 1;
+
+	// look for Es and .s in the string
+	for (int i = 0; i < (int)len; i++) {
+		char c = string[i];
+		if (c == 'E' || c == 'e') {
+			if (e_location != -1) {
+				reference_failed = 1;
+				return 0;
+			}
+			e_location = i;
+		}
+		else if (c == '.') {
+			if (p_location != -1) {
+				reference_failed = 1;
+				return 0;
+			}
+			p_location = i;
+		}
+	}
+	// if there wasn't an E or period, move it to the end
+	if (e_location == -1)
+		e_location = len;
+	if (p_location == -1)
+		p_location = e_location;
+
+	// process the integer part, everything to the left of the period and/or E
+	for (int i = 0; i < p_location; i++) {
+		char c = string[i];
+		int val = 0;
+		if (c == '-')
+			mantissa_sign = -mantissa_sign;   /* FIX: was !mantissa_sign */
+		else if (c == '+')
+			mantissa_sign = 1;
+		else if (isalpha(c))
+			val = char_code_for_character(c);
+		else if (isdigit(c))
+			val = (c - '0');
+		else {
+			reference_failed = 1;
+			return 0;
+		}
+		integer = integer * 10 + val;
+	}
+
+	// and the fraction, if there is one
+	for (int i = p_location + 1; i < e_location; i++) {
+		char c = string[i];
+		int val = 0;
+		if (isalpha(c))
+			val = char_code_for_character(c);
+		else if (isdigit(c))
+			val = (c - '0');
+		else {
+			reference_failed = 1;
+			return 0;
+		}
+		fraction = fraction * 10 + val;
+	}
+
+	// and then for the exponent, if there is any
+	for (int i = e_location + 1; i < len; i++) {
+		char c = string[i];
+		int val = 0;
+		if (isalpha(c))
+			val = char_code_for_character(c);
+		else if (isdigit(c))
+			val = (c - '0');
+		else if (c == '-')
+			exponent_sign = -exponent_sign;   /* FIX: was !exponent_sign */
+		else if (c == '+')
+			exponent_sign = 1;
+		else {
+			reference_failed = 1;
+			return 0;
+		}
+		exponent = exponent * 10 + val;
+	}
+
+	// and construct the final number
+	/* FIX: the sign applies to the fraction as well */
+	double val = ((integer * mantissa_sign) + ((fraction * mantissa_sign) / pow(10, e_location - p_location - 1))) * pow(10, (exponent * exponent_sign));
+	return val;
+}
+
+static long compared = 0;
+static int failures = 0;
+
+static void compare(const char *text)
+{
+	const char *error = NULL;
+	reference_failed = 0;
+	double expected = reference_string_to_number(text);
+	double actual = string_to_number(text, strlen(text), &error);
+	compared++;
+
+	// compare the bits, so signed zeros and the last place all count
+	if (memcmp(&expected, &actual, sizeof(double)) != 0 || reference_failed != (error != NULL)) {
+		if (failures < 20)
+			printf("  FAIL: \"%s\" gave %.17g%s, expected %.17g%s\n", text,
+				   actual, error ? " (error)" : "", expected, reference_failed ? " (error)" : "");
+		failures++;
+	}
+}
+
+/* the reference overflows past nine digits, so longer numbers are only
+   checked against the C library, to within the last place or two */
+static void compare_long(const char *text)
+{
+	const char *error = NULL;
+	double expected = strtod(text, NULL);
+	double actual = string_to_number(text, strlen(text), &error);
+	compared++;
+
+	if (error != NULL || fabs(actual - expected) > fabs(expected) * 1e-15) {
+		if (failures < 20)
+			printf("  FAIL: \"%s\" gave %.17g%s, expected %.17g\n", text,
+				   actual, error ? " (error)" : "", expected);
+		failures++;
+	}
+}
+
+int main(void)
+{
+	static const char alphabet[] = "0123456789.E+-AYZ";
+	const int letters = (int)strlen(alphabet);
+	char text[32];
+
+	printf("ASK number parser equivalence\n");
+
+	// every string of up to four characters
+	for (int length = 0; length <= 4; length++) {
+		int total = 1;
+		for (int i = 0; i < length; i++)
+			total *= letters;
+		for (int n = 0; n < total; n++) {
+			int k = n;
+			for (int i = 0; i < length; i++) {
+				text[i] = alphabet[k % letters];
+				k /= letters;
+			}
+			text[length] = '\0';
+			compare(text);
+		}
+	}
+
+	// the inputs the examples are run with
+	static const char *examples[] = {
+		"5", "200", "1", "40", "0", "10", "20", "100", "50", "30", "2000", "500",
+		"YES", "NO", "3", "Y", "N", "-1", "3.14159", "1E3", "2.5E-3", "-0", "-", NULL
+	};
+	for (int i = 0; examples[i] != NULL; i++)
+		compare(examples[i]);
+
+	// and random numbers, with exponents past the end of the power table
+	srand(1);
+	for (int i = 0; i < 1000000; i++) {
+		int digits = rand() % 9 + 1;
+		int places = rand() % 10;
+		char *p = text;
+		if (rand() % 4 == 0)
+			*p++ = '-';
+		for (int j = 0; j < digits; j++)
+			*p++ = '0' + rand() % 10;
+		if (places > 0) {
+			*p++ = '.';
+			for (int j = 1; j < places; j++)
+				*p++ = '0' + rand() % 10;
+		}
+		if (rand() % 2 == 0)
+			p += sprintf(p, "E%d", rand() % 61 - 30);
+		*p = '\0';
+		compare(text);
+	}
+
+	// and numbers with more digits than a long long holds
+	static const char *long_numbers[] = {
+		"3.14159265358979323846", "12345678901234567890123", "-98765432109876543210.5",
+		"0.000000000000000000001234567890123456789", "99999999999999999999999999E-10",
+		"1.00000000000000000000000000001", NULL
+	};
+	for (int i = 0; long_numbers[i] != NULL; i++)
+		compare_long(long_numbers[i]);
+
+	if (failures == 0)
+		printf("  PASS: %ld inputs parsed identically\n", compared);
+	else
+		printf("  FAIL: %d of %ld inputs differ\n", failures, compared);
+	return failures > 0;
+}
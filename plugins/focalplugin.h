@@ -0,0 +1,95 @@
+/* plugin interface for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __FOCALPLUGIN_H__
+#define __FOCALPLUGIN_H__
+
+/**
+ * @file focalplugin.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief The interface between RetroFOCAL and the functions FNEW calls.
+ *
+ * On the PDP-8, FNEW called a machine-code routine patched into the
+ * interpreter. Here it calls a C function in a shared library loaded with
+ * --plugin. FNEW(S,X,Y...) calls the function registered as selector S
+ * with the values of X, Y and so on, and returns whatever it returns.
+ *
+ * A plugin exports focal_plugin_init, which is called once when it is
+ * loaded and registers its functions with host->define. Nothing else in
+ * the interpreter is visible to it, everything goes through the host.
+ *
+ * Arguments are doubles. An argument written as an element, like A(I),
+ * also carries the name of the array and the subscript, and the function
+ * can ask the host for a run of elements starting there as a plain block
+ * of doubles, which it can read and write. Anything it changes is stored
+ * back into the array when the function returns. FOCAL arrays are kept in
+ * pages and only the elements that are used are allocated, so the block is
+ * a copy, not the array itself, and is only good until the function
+ * returns.
+ *
+ * Only this file is needed to build a plugin, for instance
+ * "cc -O2 -shared -fPIC -Iplugins myplugin.c -o myplugin.so". See
+ * plugins/sample.c for an example.
+ */
+
+/* changes whenever anything below changes in a way old plugins can't use */
+#define FOCAL_PLUGIN_VERSION 1
+
+/* the name of the function every plugin exports */
+#define FOCAL_PLUGIN_INIT "focal_plugin_init"
+
+/* one argument to FNEW, after the selector */
+typedef struct {
+  double value;         // its value
+  const char *array;    // the array for an element like A(I), otherwise NULL
+  int subscript;        // the subscript, I in A(I)
+} focal_arg_t;
+
+typedef struct focal_host_s focal_host_t;
+
+/* a function FNEW can call, argv[0] is the first argument after the selector */
+typedef double (*focal_function_t)(const focal_host_t *host, int argc, const focal_arg_t *argv);
+
+struct focal_host_s {
+  /* FOCAL_PLUGIN_VERSION for the interpreter that loaded the plugin */
+  int version;
+
+  /* registers function as FNEW(selector,...), name is used in messages,
+     returns 0 if the selector was already taken */
+  int (*define)(int selector, const char *name, focal_function_t function);
+
+  /* returns count elements of the array arg is an element of, starting
+     with that element, or NULL if arg isn't an element or the run goes
+     past the end of the array */
+  double *(*elements)(const focal_arg_t *arg, int count);
+
+  /* reports an error against the line that called FNEW, the program
+     carries on */
+  void (*error)(const char *message);
+};
+
+/**
+ * Called when the plugin is loaded. Return 0 if it can't be used, for
+ * instance because host->version is older than the one it was built for.
+ */
+typedef int (*focal_plugin_init_t)(const focal_host_t *host);
+
+#endif /* __FOCALPLUGIN_H__ */
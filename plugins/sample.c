@@ -0,0 +1,190 @@
+/* sample FNEW plugin for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+/**
+ * @file sample.c
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief A plugin with a few numeric kernels, and an example of writing one.
+ *
+ * Build it with "make plugins/sample.so" and run a program with
+ * "retrofocal --plugin plugins/sample.so prog.fc". It provides:
+ *
+ *   FNEW(1,R(0),I(0),N)  the discrete Fourier transform of the N complex
+ *                        values in R and I, in place, N a power of two,
+ *                        returns N
+ *   FNEW(2,A(0),B(0),N)  the dot product of the first N elements of A
+ *                        and B, added up in order as a FOR loop would
+ *   FNEW(3,M(0),V(0),N)  solves M X = V for the N by N matrix held a row
+ *                        at a time in M, leaving X in V and M reduced,
+ *                        returns the determinant, zero if there's no
+ *                        solution
+ *
+ * The arrays can start at any element, R(16) is as good as R(0).
+ */
+
+#include <stddef.h>
+#include <math.h>
+
+#include "focalplugin.h"
+
+/* the element count from an argument, or 0 after reporting the error */
+static int size_of(const focal_host_t *host, const focal_arg_t *arg)
+{
+  if (arg->value < 1 || arg->value != floor(arg->value)) {
+    host->error("FNEW size must be a whole number above zero");
+    return 0;
+  }
+  return (int)arg->value;
+} /* size_of */
+
+/* the elements, or NULL after reporting the error */
+static double *elements(const focal_host_t *host, const focal_arg_t *arg, int count)
+{
+  double *values = host->elements(arg, count);
+  if (values == NULL)
+    host->error("FNEW needs an array element with room after it");
+  return values;
+} /* elements */
+
+static double fft(const focal_host_t *host, int argc, const focal_arg_t *argv)
+{
+  if (argc != 3) {
+    host->error("FNEW 1 takes two arrays and a size");
+    return 0;
+  }
+  int n = size_of(host, &argv[2]);
+  if (n == 0)
+    return 0;
+  if ((n & (n - 1)) != 0) {
+    host->error("FNEW 1 size must be a power of two");
+    return 0;
+  }
+  double *re = elements(host, &argv[0], n);
+  double *im = elements(host, &argv[1], n);
+  if (re == NULL || im == NULL)
+    return 0;
+
+  // put the values in bit-reversed order
+  for (int i = 1, j = 0; i < n; i++) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      double t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+
+  // then combine them in pairs, fours, and so on
+  for (int length = 2; length <= n; length <<= 1) {
+    double angle = -2 * M_PI / length;
+    for (int k = 0; k < length / 2; k++) {
+      double wr = cos(angle * k), wi = sin(angle * k);
+      for (int i = k; i < n; i += length) {
+        int j = i + length / 2;
+        double tr = re[j] * wr - im[j] * wi;
+        double ti = re[j] * wi + im[j] * wr;
+        re[j] = re[i] - tr;
+        im[j] = im[i] - ti;
+        re[i] += tr;
+        im[i] += ti;
+      }
+    }
+  }
+  return n;
+} /* fft */
+
+static double dot(const focal_host_t *host, int argc, const focal_arg_t *argv)
+{
+  if (argc != 3) {
+    host->error("FNEW 2 takes two arrays and a size");
+    return 0;
+  }
+  int n = size_of(host, &argv[2]);
+  if (n == 0)
+    return 0;
+  double *a = elements(host, &argv[0], n);
+  double *b = elements(host, &argv[1], n);
+  if (a == NULL || b == NULL)
+    return 0;
+
+  double sum = 0;
+  for (int i = 0; i < n; i++)
+    sum = sum + a[i] * b[i];
+  return sum;
+} /* dot */
+
+static double solve(const focal_host_t *host, int argc, const focal_arg_t *argv)
+{
+  if (argc != 3) {
+    host->error("FNEW 3 takes a matrix, a vector and a size");
+    return 0;
+  }
+  int n = size_of(host, &argv[2]);
+  if (n == 0)
+    return 0;
+  double *m = elements(host, &argv[0], n * n);
+  double *v = elements(host, &argv[1], n);
+  if (m == NULL || v == NULL)
+    return 0;
+
+  // Gaussian elimination, swapping up the largest value in each column
+  double determinant = 1;
+  for (int column = 0; column < n; column++) {
+    int pivot = column;
+    for (int row = column + 1; row < n; row++)
+      if (fabs(m[row * n + column]) > fabs(m[pivot * n + column]))
+        pivot = row;
+    if (m[pivot * n + column] == 0)
+      return 0;
+    if (pivot != column) {
+      for (int i = 0; i < n; i++) {
+        double t = m[column * n + i]; m[column * n + i] = m[pivot * n + i]; m[pivot * n + i] = t;
+      }
+      double t = v[column]; v[column] = v[pivot]; v[pivot] = t;
+      determinant = -determinant;
+    }
+    determinant *= m[column * n + column];
+    for (int row = column + 1; row < n; row++) {
+      double factor = m[row * n + column] / m[column * n + column];
+      for (int i = column; i < n; i++)
+        m[row * n + i] -= factor * m[column * n + i];
+      v[row] -= factor * v[column];
+    }
+  }
+
+  // and then back up from the bottom
+  for (int row = n - 1; row >= 0; row--) {
+    double sum = v[row];
+    for (int i = row + 1; i < n; i++)
+      sum -= m[row * n + i] * v[i];
+    v[row] = sum / m[row * n + row];
+  }
+  return determinant;
+} /* solve */
+
+int focal_plugin_init(const focal_host_t *host)
+{
+  if (host->version < FOCAL_PLUGIN_VERSION)
+    return 0;
+  return host->define(1, "FFT", fft) && host->define(2, "DOT", dot) && host->define(3, "SOLVE", solve);
+} /* focal_plugin_init */
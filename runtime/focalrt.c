@@ -0,0 +1,334 @@
+/* translated program runtime (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+
+#include "focalrt.h"
+#include "number.h"
+#include "rng.h"
+
+/* the same limit as the interpreter's lines array, used by WRITE */
+#define RT_MAXLINE 9999
+
+/* the entries on the stack */
+typedef enum { RT_DO, RT_FOR } rt_entry_type_t;
+
+typedef struct {
+  rt_entry_type_t type;
+  // a FOR
+  double *index;          // the index variable, or NULL to call slot
+  double *(*slot)(void);
+  double end, step;
+  int body, tail;
+  // a DO
+  int target_group, target_step;
+  int returnpoint;
+} rt_entry_t;
+
+double rt_line = 0;
+int rt_column = 0;
+const char *rt_format = "";
+
+static rt_entry_t *stack = NULL;
+static int stack_depth = 0;
+static int stack_size = 0;
+
+/************************************************************************/
+
+void rt_start(int argc, char *argv[])
+{
+  char *test;
+  int seed = -1;
+
+  // only -r means anything, in either "-r 7" or "-r7" form
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "-r", 2) != 0)
+      continue;
+    const char *number = argv[i][2] != '\0' ? argv[i] + 2 : (i + 1 < argc ? argv[i + 1] : "");
+    seed = (int)strtol(number, &test, 10);
+    if (test == number)
+      seed = -1;
+  }
+
+  // seed the same generator the interpreter uses
+  rng_seed(seed > -1 ? (uint32_t)seed : (uint32_t)time(NULL));
+} /* rt_start */
+
+void rt_error(const char *message)
+{
+  fprintf(stderr, "%s at line %2.2f\n", message, rt_line);
+} /* rt_error */
+
+double rt_divide(double a, double b)
+{
+  if (b == 0)
+    rt_error("Division by zero");
+  return a / b;
+} /* rt_divide */
+
+double rt_power(double a, double b)
+{
+  return b == 2 ? a * a : pow(a, b);
+} /* rt_power */
+
+double rt_abs(double a) { return fabs(a); }
+double rt_atn(double a) { return atan(a); }
+double rt_cos(double a) { return cos(a); }
+double rt_exp(double a) { return exp(a); }
+double rt_itr(double a) { return floor(a); }
+double rt_log(double a) { return log(a); }
+double rt_sin(double a) { return sin(a); }
+double rt_sqt(double a) { return sqrt(a); }
+
+double rt_sgn(double a)
+{
+  // the FOCAL-71 version, where 0 returns 0
+  if (a < 0)
+    return -1;
+  else if (a == 0)
+    return 0;
+  else
+    return 1;
+} /* rt_sgn */
+
+double rt_random(void)
+{
+  return rng_next();
+} /* rt_random */
+
+double rt_in(void)
+{
+  char c = getchar();
+  return (int)c + 128;
+} /* rt_in */
+
+double rt_out(double a)
+{
+  putchar((int)a - 128);
+  return a;
+} /* rt_out */
+
+double *rt_element(double *array, double subscript)
+{
+  if (subscript < -RT_ORIGIN || subscript > RT_ELEMENTS - RT_ORIGIN - 1) {
+    rt_error("Array subscript out of bounds");
+    subscript = 0;
+  }
+  return array + (int)subscript;
+} /* rt_element */
+
+double rt_number(const char *text, size_t length)
+{
+  const char *error = NULL;
+  double value = string_to_number(text, length, &error);
+  if (error != NULL)
+    rt_error(error);
+  return value;
+} /* rt_number */
+
+void rt_print_number(double value)
+{
+  rt_column += printf(rt_format, value);
+} /* rt_print_number */
+
+void rt_print_string(const char *string)
+{
+  rt_column += printf("%-s", string);
+} /* rt_print_string */
+
+void rt_new_line(void)
+{
+  printf("\n");
+  rt_column = 0;
+} /* rt_new_line */
+
+void rt_carriage_return(void)
+{
+  printf("\r");
+  rt_column = 0;
+} /* rt_carriage_return */
+
+void rt_tab(int columns)
+{
+  while (rt_column % columns != 0) {
+    printf(" ");
+    rt_column++;
+  }
+} /* rt_tab */
+
+void rt_ask_start(rt_ask_t *ask)
+{
+  ask->next = NULL;
+} /* rt_ask_start */
+
+size_t rt_ask_field(rt_ask_t *ask, const char **text)
+{
+  // skip to the next value on the line, if there is one
+  while (ask->next != NULL && is_input_separator(*ask->next))
+    ask->next++;
+
+  if (ask->next == NULL || *ask->next == '\0') {
+    printf(":");
+    fflush(stdout);
+    if (fgets(ask->line, sizeof(ask->line), stdin) != ask->line)
+      exit(EXIT_FAILURE);
+
+    size_t length = strlen(ask->line);
+    if (length > 0 && ask->line[length - 1] == '\n')
+      ask->line[length - 1] = '\0';
+    for (char *c = ask->line; *c; c++)
+      *c = toupper((unsigned char)*c);
+
+    ask->next = ask->line;
+    while (is_input_separator(*ask->next))
+      ask->next++;
+  }
+
+  // the value runs up to the next separator, an empty line is zero
+  char *end = ask->next;
+  while (*end != '\0' && !is_input_separator(*end))
+    end++;
+
+  *text = ask->next;
+  ask->next = end;
+  return end - *text;
+} /* rt_ask_field */
+
+void rt_write(const rt_listing_t *listing, int lines, bool selected, double value)
+{
+  int start_line = 1;
+  int end_line = RT_MAXLINE;
+
+  // a whole number is a group, anything else a single line
+  if (selected) {
+    int line_index = (int)round(value * 100);
+    if (fabs(value - round(value)) < 0.00001) {
+      start_line = (int)round(value) * 100;
+      end_line = start_line + 100;
+      if (start_line >= RT_MAXLINE) {
+        fprintf(stderr, "Invalid group number.\n");
+        return;
+      }
+    } else {
+      if (line_index < 0 || line_index >= RT_MAXLINE) {
+        fprintf(stderr, "Invalid line number.\n");
+        return;
+      }
+      start_line = line_index;
+      end_line = line_index + 1;
+    }
+  }
+
+  for (int i = 0; i < lines; i++)
+    if (listing[i].line >= start_line && listing[i].line < end_line)
+      printf("%s", listing[i].text);
+} /* rt_write */
+
+/** Returns a new entry on the top of the stack. */
+static rt_entry_t *push_entry(rt_entry_type_t type)
+{
+  if (stack_depth == stack_size) {
+    stack_size = stack_size == 0 ? 16 : stack_size * 2;
+    stack = realloc(stack, stack_size * sizeof(*stack));
+    if (stack == NULL) {
+      fprintf(stderr, "Out of memory for the stack\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  rt_entry_t *entry = &stack[stack_depth++];
+  memset(entry, 0, sizeof(*entry));
+  entry->type = type;
+  return entry;
+} /* push_entry */
+
+void rt_do(int target_group, int target_step, int returnpoint)
+{
+  rt_entry_t *entry = push_entry(RT_DO);
+  entry->target_group = target_group;
+  entry->target_step = target_step;
+  entry->returnpoint = returnpoint;
+} /* rt_do */
+
+void rt_for(double *index, double *(*slot)(void), double end, double step, int body, int tail)
+{
+  rt_entry_t *entry = push_entry(RT_FOR);
+  entry->index = index;
+  entry->slot = slot;
+  entry->end = end;
+  entry->step = step;
+  entry->body = body;
+  entry->tail = tail;
+} /* rt_for */
+
+int rt_return(int next)
+{
+  if (stack_depth == 0 || stack[stack_depth - 1].type != RT_DO) {
+    rt_error("RETURN without DO");
+    return next;
+  }
+  return stack[--stack_depth].returnpoint;
+} /* rt_return */
+
+/** Steps the FOR on the top of the stack, see next_iteration in the
+ * interpreter.
+ */
+static int next_iteration(rt_entry_t *entry, int next)
+{
+  double *index = entry->index != NULL ? entry->index : entry->slot();
+
+  bool again;
+  if (entry->step == 1)
+    again = ++*index <= entry->end;
+  else {
+    *index += entry->step;
+    again = (entry->step < 0 && *index >= entry->end) || (entry->step > 0 && *index <= entry->end);
+  }
+
+  if (again)
+    return entry->body;
+  stack_depth--;
+  return next;
+} /* next_iteration */
+
+int rt_line_end(int statement, int next, bool line_ends, int this_group, int this_step, int next_group)
+{
+  if (stack_depth == 0)
+    return next;
+  rt_entry_t *entry = &stack[stack_depth - 1];
+
+  // the end of the FOR's own line is always the end of the loop body
+  if (entry->type == RT_FOR && entry->tail == statement)
+    return next_iteration(entry, next);
+  if (!line_ends)
+    return next;
+
+  if (entry->type == RT_FOR)
+    return next_iteration(entry, next);
+
+  // a DO of a group returns at the end of the group, and of a line at the end of the line
+  if ((entry->target_step == 0 && this_group == entry->target_group && this_group != next_group) ||
+      (entry->target_step != 0 && this_group == entry->target_group && this_step == entry->target_step)) {
+    stack_depth--;
+    return entry->returnpoint;
+  }
+  return next;
+} /* rt_line_end */
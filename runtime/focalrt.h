@@ -0,0 +1,205 @@
+/* translated program runtime (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __FOCALRT_H__
+#define __FOCALRT_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+/**
+ * @file focalrt.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief The runtime for programs translated to C with --emit-c.
+ *
+ * The translated program does its own arithmetic and control flow, and
+ * calls in here for everything the interpreter would have done the same
+ * way for every program: printing numbers and keeping track of the
+ * cursor, reading ASK input and converting it with the interpreter's own
+ * string_to_number, FRAN and the other functions, array bounds, error
+ * messages, and the stack of DO and FOR entries along with the rules for
+ * what happens at the end of a line.
+ *
+ * The functions are kept out of the translated file on purpose, so that
+ * the compiler can't fold a call like FSIN(1) into a constant that might
+ * round differently from the C library the interpreter uses.
+ *
+ * Build libfocalrt.a with "make libfocalrt.a" and compile the translated
+ * program with "cc prog.c -Iruntime libfocalrt.a -lm".
+ */
+
+/* every variable can be subscripted from -2048 to 2047, and element 0 is
+   the variable itself */
+#define RT_ELEMENTS 4096
+#define RT_ORIGIN 2048
+
+/* the line being run, for error messages, in FOCAL xx.yy format */
+extern double rt_line;
+
+/* the column of the output cursor, used for tabs */
+extern int rt_column;
+
+/* the C format numbers are printed with, set by % in a TYPE */
+extern const char *rt_format;
+
+/* one line of the program listing, for WRITE */
+typedef struct {
+  int line;             // in xx.yy * 100 format
+  const char *text;     // the line as WRITE prints it, including the newline
+} rt_listing_t;
+
+/* the state of one ASK statement, the rest of the last line typed */
+typedef struct {
+  char line[256];
+  char *next;
+} rt_ask_t;
+
+/**
+ * Seeds FRAN from "-r seed" on the command line, or the clock if there
+ * is none, the same way the interpreter does.
+ */
+void rt_start(int argc, char *argv[]);
+
+/**
+ * Prints an error message along with the current line. Like the
+ * interpreter, the program carries on afterwards.
+ */
+void rt_error(const char *message);
+
+/* arithmetic that can report an error or would otherwise be folded */
+double rt_divide(double a, double b);
+double rt_power(double a, double b);
+
+/* the functions */
+double rt_abs(double a);
+double rt_atn(double a);
+double rt_cos(double a);
+double rt_exp(double a);
+double rt_itr(double a);
+double rt_log(double a);
+double rt_sgn(double a);
+double rt_sin(double a);
+double rt_sqt(double a);
+
+/* the approximations used in place of some of them for --math=fast, see src/fmath.h */
+double fast_atn(double a);
+double fast_cos(double a);
+double fast_exp(double a);
+double fast_log(double a);
+double fast_sin(double a);
+
+double rt_random(void);
+double rt_in(void);
+double rt_out(double a);
+
+/**
+ * Returns the slot for one element of an array, after checking the
+ * subscript is in range. Out of range subscripts report an error and
+ * use element 0.
+ *
+ * @param array Element 0 of the array.
+ * @param subscript The subscript, which is truncated.
+ */
+double *rt_element(double *array, double subscript);
+
+/**
+ * Converts text typed at ASK into a number, reporting any error.
+ */
+double rt_number(const char *text, size_t length);
+
+/* TYPE output, each of which keeps rt_column up to date */
+void rt_print_number(double value);
+void rt_print_string(const char *string);
+void rt_new_line(void);
+void rt_carriage_return(void);
+void rt_tab(int columns);
+
+/**
+ * Starts an ASK statement.
+ */
+void rt_ask_start(rt_ask_t *ask);
+
+/**
+ * Returns the next value typed at an ASK, printing the colon prompt and
+ * reading a new line if the last one has been used up. The program exits
+ * if the input runs out.
+ *
+ * @param ask The state of the statement.
+ * @paramout text Set to the start of the value.
+ * @return The length of the value.
+ */
+size_t rt_ask_field(rt_ask_t *ask, const char **text);
+
+/**
+ * Prints the lines of the program selected by a WRITE.
+ *
+ * @param listing The program, in line order.
+ * @param lines The number of entries in @p listing.
+ * @param selected True if the WRITE had a line or group after it.
+ * @param value ... and its value if it did.
+ */
+void rt_write(const rt_listing_t *listing, int lines, bool selected, double value);
+
+/**
+ * Pushes the entry for a DO.
+ *
+ * @param target_group The group of the line or group called.
+ * @param target_step ... and the step, 0 for a whole group.
+ * @param returnpoint The statement to come back to, -1 for the end.
+ */
+void rt_do(int target_group, int target_step, int returnpoint);
+
+/**
+ * Pushes the entry for a FOR, after the index has been given its first
+ * value.
+ *
+ * @param index The index variable, or NULL if it is subscripted.
+ * @param slot ... in which case this finds it each time around.
+ * @param end The last value.
+ * @param step The amount added each time around.
+ * @param body The statement after the FOR, -1 if there is none.
+ * @param tail The last statement on the FOR's line.
+ */
+void rt_for(double *index, double *(*slot)(void), double end, double step, int body, int tail);
+
+/**
+ * Performs a RETURN, returning the statement to go to next.
+ */
+int rt_return(int next);
+
+/**
+ * Called after the last statement on a line has been run, to perform
+ * the NEXT of the FOR or the RETURN of the DO that is on top of the
+ * stack, if it is time to.
+ *
+ * @param statement The statement that was run.
+ * @param next The statement that would run next.
+ * @param line_ends True if the interpreter sees a change of line here.
+ * @param this_group The group of the line.
+ * @param this_step ... and its step.
+ * @param next_group The group of the following line.
+ * @return The statement to go to next, -1 for the end of the program.
+ */
+int rt_line_end(int statement, int next, bool line_ends, int this_group, int this_step, int next_group);
+
+#endif /* __FOCALRT_H__ */
@@ -0,0 +1,200 @@
+/* array storage (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include <stdint.h>
+
+#include "array.h"
+#include "memstat.h"
+
+/* the size of the hash map when the first element is stored */
+#define MAP_START 8
+
+/* marks an unused map slot, it's outside the range of subscripts */
+#define EMPTY_KEY INT16_MAX
+
+struct array_s {
+  bool paged;                       // the map has been converted to pages
+  int count;                        // elements in the map
+  int capacity;                     // slots in the map, always a power of two
+  int16_t *keys;                    // subscript in each slot, or EMPTY_KEY
+  either_t *values;                 // and its value
+  either_t *pages[ARRAY_PAGES];     // once paged, NULL until something is stored
+};
+
+/* what's returned for elements that were never stored */
+static const either_t zero_element;
+
+/** Returns the slot holding @p index, or the empty slot where it would go.
+ * The map is never full, so this always finds one or the other.
+ */
+static int map_find(const array_t *array, int index)
+{
+  // multiplying by the golden ratio spreads out runs and strides alike
+  unsigned mask = array->capacity - 1;
+  unsigned slot = (((uint32_t)(index - ARRAY_FIRST) * 2654435769u) >> 16) & mask;
+  while (array->keys[slot] != index && array->keys[slot] != EMPTY_KEY)
+    slot = (slot + 1) & mask;
+  return slot;
+} /* map_find */
+
+static void map_resize(array_t *array, int capacity)
+{
+  int16_t *keys = array->keys;
+  either_t *values = array->values;
+  int old_capacity = array->capacity;
+
+  array->capacity = capacity;
+  array->keys = malloc(capacity * sizeof(*keys));
+  array->values = calloc(capacity, sizeof(*values));
+  memory_charge(MEMORY_ARRAYS, capacity * (sizeof(*keys) + sizeof(*values)));
+  for (int i = 0; i < capacity; i++)
+    array->keys[i] = EMPTY_KEY;
+
+  for (int i = 0; i < old_capacity; i++) {
+    if (keys[i] != EMPTY_KEY) {
+      int slot = map_find(array, keys[i]);
+      array->keys[slot] = keys[i];
+      array->values[slot] = values[i];
+    }
+  }
+  memory_release(MEMORY_ARRAYS, old_capacity * (sizeof(*keys) + sizeof(*values)));
+  free(keys);
+  free(values);
+} /* map_resize */
+
+static either_t *page_element(array_t *array, int index)
+{
+  int offset = index - ARRAY_FIRST;
+  either_t **page = &array->pages[offset / ARRAY_PAGE_SIZE];
+  if (*page == NULL)
+    *page = memory_calloc(MEMORY_ARRAYS, ARRAY_PAGE_SIZE * sizeof(either_t));
+  return &(*page)[offset % ARRAY_PAGE_SIZE];
+} /* page_element */
+
+/** Moves everything in the map into pages and frees the map. */
+static void promote(array_t *array)
+{
+  for (int i = 0; i < array->capacity; i++)
+    if (array->keys[i] != EMPTY_KEY)
+      *page_element(array, array->keys[i]) = array->values[i];
+
+  memory_release(MEMORY_ARRAYS, array->capacity * (sizeof(*array->keys) + sizeof(*array->values)));
+  free(array->keys);
+  free(array->values);
+  array->keys = NULL;
+  array->values = NULL;
+  array->capacity = array->count = 0;
+  array->paged = true;
+} /* promote */
+
+array_t *array_new(void)
+{
+  return memory_calloc(MEMORY_ARRAYS, sizeof(array_t));
+} /* array_new */
+
+void array_free(array_t *array)
+{
+  if (array == NULL)
+    return;
+  for (int i = 0; i < ARRAY_PAGES; i++) {
+    if (array->pages[i] != NULL) {
+      memory_release(MEMORY_ARRAYS, ARRAY_PAGE_SIZE * sizeof(either_t));
+      free(array->pages[i]);
+    }
+  }
+  memory_release(MEMORY_ARRAYS, array->capacity * (sizeof(*array->keys) + sizeof(*array->values)) + sizeof(*array));
+  free(array->keys);
+  free(array->values);
+  free(array);
+} /* array_free */
+
+const either_t *array_read(const array_t *array, int index)
+{
+  if (array->paged) {
+    int offset = index - ARRAY_FIRST;
+    const either_t *page = array->pages[offset / ARRAY_PAGE_SIZE];
+    return page != NULL ? &page[offset % ARRAY_PAGE_SIZE] : &zero_element;
+  }
+  if (array->count == 0)
+    return &zero_element;
+  int slot = map_find(array, index);
+  return array->keys[slot] == index ? &array->values[slot] : &zero_element;
+} /* array_read */
+
+either_t *array_write(array_t *array, int index)
+{
+  if (!array->paged) {
+    if (array->capacity == 0)
+      map_resize(array, MAP_START);
+    int slot = map_find(array, index);
+    if (array->keys[slot] == index)
+      return &array->values[slot];
+
+    // a new element, which either goes into the map or tips it over into pages
+    if (array->count < ARRAY_SPARSE_LIMIT) {
+      // keep the map no more than three-quarters full
+      if ((array->count + 1) * 4 > array->capacity * 3) {
+        map_resize(array, array->capacity * 2);
+        slot = map_find(array, index);
+      }
+      array->keys[slot] = index;
+      array->count++;
+      return &array->values[slot];
+    }
+    promote(array);
+  }
+  return page_element(array, index);
+} /* array_write */
+
+void array_read_run(const array_t *array, int index, int count, double *values)
+{
+  while (count > 0) {
+    if (!array->paged) {
+      *values++ = array_read(array, index++)->number;
+      count--;
+      continue;
+    }
+    // the rest of this page is contiguous, or all zero if it was never stored into
+    int offset = index - ARRAY_FIRST;
+    int run = ARRAY_PAGE_SIZE - offset % ARRAY_PAGE_SIZE;
+    if (run > count)
+      run = count;
+    const either_t *page = array->pages[offset / ARRAY_PAGE_SIZE];
+    for (int i = 0; i < run; i++)
+      values[i] = page != NULL ? page[offset % ARRAY_PAGE_SIZE + i].number : 0;
+    values += run;
+    index += run;
+    count -= run;
+  }
+} /* array_read_run */
+
+void array_foreach(array_t *array, void (*function)(int index, either_t *element, void *user_data), void *user_data)
+{
+  if (array->paged) {
+    for (int i = 0; i < ARRAY_PAGES; i++)
+      if (array->pages[i] != NULL)
+        for (int j = 0; j < ARRAY_PAGE_SIZE; j++)
+          function(ARRAY_FIRST + i * ARRAY_PAGE_SIZE + j, &array->pages[i][j], user_data);
+  } else {
+    for (int i = 0; i < array->capacity; i++)
+      if (array->keys[i] != EMPTY_KEY)
+        function(array->keys[i], &array->values[i], user_data);
+  }
+} /* array_foreach */
@@ -0,0 +1,86 @@
+/* array storage (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __ARRAY_H__
+#define __ARRAY_H__
+
+#include "stdhdr.h"
+#include "retrofocal.h"
+
+/**
+ * @file array.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief Storage for the elements of subscripted variables.
+ *
+ * FOCAL has no DIM, any variable can be subscripted from -2048 to 2047,
+ * and most programs only ever touch a handful of those elements. So an
+ * array starts out as a small open-addressed hash map holding only the
+ * elements that have been assigned. Once it holds ARRAY_SPARSE_LIMIT of
+ * them it is converted into pages of ARRAY_PAGE_SIZE elements, and from
+ * then on a page is only allocated when something is stored in it.
+ *
+ * Elements that have never been assigned read as zero. Subscripts must be
+ * checked against ARRAY_FIRST and ARRAY_LAST before calling in.
+ */
+
+#define ARRAY_FIRST -2048
+#define ARRAY_LAST 2047
+#define ARRAY_PAGE_SIZE 256
+#define ARRAY_PAGES ((ARRAY_LAST - ARRAY_FIRST + 1) / ARRAY_PAGE_SIZE)
+
+/* the number of elements kept in the hash map before it is paged */
+#define ARRAY_SPARSE_LIMIT 64
+
+/**
+ * Makes a new, empty array.
+ */
+array_t *array_new(void);
+
+/**
+ * Frees an array and all of its elements.
+ */
+void array_free(array_t *array);
+
+/**
+ * Returns the element at @p index for reading. Nothing is allocated, an
+ * element that has never been stored returns a shared zero.
+ */
+const either_t *array_read(const array_t *array, int index);
+
+/**
+ * Returns the element at @p index for writing, making room for it if
+ * needed. The pointer is only good until the next call to array_write.
+ */
+either_t *array_write(array_t *array, int index);
+
+/**
+ * Copies the values of @p count elements starting at @p index into
+ * @p values, which is array_read for each of them but a page at a time.
+ */
+void array_read_run(const array_t *array, int index, int count, double *values);
+
+/**
+ * Calls @p function with each element that has been stored, in no
+ * particular order.
+ */
+void array_foreach(array_t *array, void (*function)(int index, either_t *element, void *user_data), void *user_data);
+
+#endif /* __ARRAY_H__ */
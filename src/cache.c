@@ -0,0 +1,331 @@
+/* parse cache (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
+#if !defined(WIN32) && !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#include "cache.h"
+#include "image.h"
+#include "retrofocal.h"
+#include "memstat.h"
+
+extern int yyparse(void);
+extern void *yy_scan_bytes(const char *bytes, int length);
+extern void yy_delete_buffer(void *buffer);
+
+/* command line settings */
+bool use_cache = false;
+char *cache_dir = NULL;
+long cache_size_limit = CACHE_DEFAULT_SIZE;
+
+/* statistics */
+int cache_hits = 0;
+int cache_misses = 0;
+int cache_stores = 0;
+int cache_evictions = 0;
+
+/* entries are named by the hash plus this */
+#define CACHE_SUFFIX ".fcb"
+
+/* one file in the cache directory, used while enforcing the size limit */
+typedef struct {
+  char *path;
+  off_t size;
+  time_t used;
+} cache_entry_t;
+
+/** FNV-1a over the source text, seeded with the image version so a
+ * format change never finds the old entries.
+ */
+static uint64_t source_hash(const char *text, size_t length)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  hash ^= IMAGE_VERSION;
+  hash *= 1099511628211ULL;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)text[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+} /* source_hash */
+
+static int make_directory(const char *path)
+{
+#if defined(WIN32) || defined(_WIN32)
+  return mkdir(path);
+#else
+  return mkdir(path, 0755);
+#endif
+}
+
+/** Returns the cache directory, creating it if needed. The default is
+ * $XDG_CACHE_HOME/retrofocal, falling back to ~/.cache/retrofocal.
+ * Returns NULL if there is nowhere to put it.
+ */
+static const char *cache_directory(void)
+{
+  static char *directory = NULL;
+  if (directory != NULL)
+    return directory;
+
+  if (cache_dir != NULL && cache_dir[0] != '\0') {
+    directory = str_new(cache_dir);
+  } else {
+    const char *base = getenv("XDG_CACHE_HOME");
+    const char *suffix = "/retrofocal";
+    if (base == NULL || base[0] == '\0') {
+      base = getenv("HOME");
+      suffix = "/.cache/retrofocal";
+    }
+    if (base == NULL || base[0] == '\0')
+      return NULL;
+    directory = malloc(strlen(base) + strlen(suffix) + 1);
+    strcpy(directory, base);
+    strcat(directory, suffix);
+  }
+
+  // create each missing component in turn, like mkdir -p
+  for (char *slash = strchr(directory + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    make_directory(directory);
+    *slash = '/';
+  }
+  if (make_directory(directory) != 0 && errno != EEXIST) {
+    fprintf(stderr, "Cannot create cache directory: %s\n", directory);
+    free(directory);
+    directory = NULL;
+  }
+  return directory;
+} /* cache_directory */
+
+/** Returns the malloced path of the entry for the given text. */
+static char *entry_path(const char *directory, const char *text, size_t length)
+{
+  char *path = malloc(strlen(directory) + 1 + 16 + strlen(CACHE_SUFFIX) + 1);
+  sprintf(path, "%s/%016llx%s", directory, (unsigned long long)source_hash(text, length), CACHE_SUFFIX);
+  return path;
+} /* entry_path */
+
+static bool is_entry_name(const char *name)
+{
+  size_t length = strlen(name);
+  size_t suffix = strlen(CACHE_SUFFIX);
+  return length == 16 + suffix && strcmp(name + 16, CACHE_SUFFIX) == 0;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+  const cache_entry_t *first = a, *second = b;
+  if (first->used < second->used)
+    return -1;
+  return first->used > second->used;
+}
+
+/** Deletes the least-recently-used entries until the directory fits in
+ * cache_size_limit. Hits touch the file, so the modification time is the
+ * last time an entry was used.
+ */
+static void enforce_size_limit(const char *directory)
+{
+  DIR *dir = opendir(directory);
+  if (dir == NULL)
+    return;
+
+  cache_entry_t *entries = NULL;
+  int count = 0, capacity = 0;
+  long long total = 0;
+  struct dirent *item;
+  while ((item = readdir(dir)) != NULL) {
+    if (!is_entry_name(item->d_name))
+      continue;
+    char *path = malloc(strlen(directory) + strlen(item->d_name) + 2);
+    sprintf(path, "%s/%s", directory, item->d_name);
+    struct stat info;
+    if (stat(path, &info) != 0) {
+      free(path);
+      continue;
+    }
+    if (count == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      entries = realloc(entries, capacity * sizeof(*entries));
+    }
+    entries[count].path = path;
+    entries[count].size = info.st_size;
+    entries[count].used = info.st_mtime;
+    count++;
+    total += info.st_size;
+  }
+  closedir(dir);
+
+  if (total > cache_size_limit) {
+    qsort(entries, count, sizeof(*entries), compare_entries);
+    for (int i = 0; i < count && total > cache_size_limit; i++) {
+      if (remove(entries[i].path) == 0) {
+        total -= entries[i].size;
+        cache_evictions++;
+      }
+    }
+  }
+
+  for (int i = 0; i < count; i++)
+    free(entries[i].path);
+  free(entries);
+} /* enforce_size_limit */
+
+/** Writes the current program to the cache. The image goes to a temporary
+ * name first and is renamed into place, so a reader never sees half a file
+ * and two interpreters storing the same program don't collide.
+ */
+static void store_entry(const char *directory, const char *path)
+{
+  size_t length;
+  unsigned char *data = encode_image(&length);
+  if (data == NULL)
+    return;
+
+  char *temporary = malloc(strlen(path) + 32);
+  sprintf(temporary, "%s.%ld.tmp", path, (long)getpid());
+  FILE *fp = fopen(temporary, "wb");
+  bool ok = fp != NULL;
+  if (ok) {
+    ok = fwrite(data, 1, length, fp) == length;
+    ok = (fclose(fp) == 0) && ok;
+  }
+#if defined(WIN32) || defined(_WIN32)
+  // rename won't replace an existing file on Windows
+  if (ok)
+    remove(path);
+#endif
+  if (ok && rename(temporary, path) == 0)
+    cache_stores++;
+  else
+    remove(temporary);
+  free(temporary);
+  free(data);
+
+  enforce_size_limit(directory);
+} /* store_entry */
+
+/** Attempts to load the program from the given entry. */
+static bool load_entry(const char *path)
+{
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+    return false;
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (size <= 0) {
+    fclose(fp);
+    return false;
+  }
+  unsigned char *data = malloc(size);
+  memory_charge(MEMORY_IO, size);
+  bool ok = fread(data, 1, size, fp) == (size_t)size;
+  fclose(fp);
+  ok = ok && decode_image(data, size);
+  memory_release(MEMORY_IO, size);
+  free(data);
+
+  // a damaged entry is thrown away so it gets rebuilt
+  if (!ok) {
+    remove(path);
+    return false;
+  }
+
+  // mark it as recently used for the eviction order
+  utime(path, NULL);
+  return true;
+} /* load_entry */
+
+static void parse_text(const char *text, size_t length)
+{
+  for (int i = 0; i < MAXLINE; i++)
+    interpreter_state.lines[i] = NULL;
+  void *buffer = yy_scan_bytes(text, (int)length);
+  yyparse();
+  yy_delete_buffer(buffer);
+}
+
+bool cache_parse(const char *text, size_t length)
+{
+  const char *directory = use_cache ? cache_directory() : NULL;
+  if (directory == NULL) {
+    parse_text(text, length);
+    return false;
+  }
+
+  char *path = entry_path(directory, text, length);
+  if (load_entry(path)) {
+    cache_hits++;
+    free(path);
+    return true;
+  }
+  cache_misses++;
+
+  // parse into an empty variable table and analyzer counts so the entry
+  // holds only what this text defines, even when it's a LIBRARY CALL on
+  // top of an earlier program, then merge them back in afterwards
+  int counts[PARSE_COUNTERS];
+  get_parse_counters(counts);
+  clear_parse_counters();
+  list_t *variables = interpreter_state.variable_values;
+  interpreter_state.variable_values = NULL;
+
+  parse_text(text, length);
+  store_entry(directory, path);
+
+  list_t *parsed = interpreter_state.variable_values;
+  interpreter_state.variable_values = variables;
+  merge_variables(parsed);
+  add_parse_counters(counts);
+
+  free(path);
+  return false;
+} /* cache_parse */
+
+int cache_purge(void)
+{
+  const char *directory = cache_directory();
+  if (directory == NULL)
+    return 0;
+  DIR *dir = opendir(directory);
+  if (dir == NULL)
+    return 0;
+
+  int removed = 0;
+  struct dirent *item;
+  while ((item = readdir(dir)) != NULL) {
+    if (!is_entry_name(item->d_name))
+      continue;
+    char *path = malloc(strlen(directory) + strlen(item->d_name) + 2);
+    sprintf(path, "%s/%s", directory, item->d_name);
+    if (remove(path) == 0)
+      removed++;
+    free(path);
+  }
+  closedir(dir);
+  return removed;
+} /* cache_purge */
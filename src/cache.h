@@ -0,0 +1,74 @@
+/* parse cache (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include "stdhdr.h"
+
+/**
+ * @file cache.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief Transparent on-disk cache of parsed programs.
+ *
+ * When enabled, every program source that goes through the parser is
+ * hashed, and the resulting tree is stored as a program image (see
+ * image.h) named after that hash. The next time the same text is loaded,
+ * from the command line or with LIBRARY, the image is decoded instead
+ * and the lexer and parser are skipped. Any edit to the source changes
+ * the hash, so stale entries are simply never found again, and the size
+ * limit eventually evicts them, least-recently-used first.
+ */
+
+/* the default limit on the total size of the cache directory */
+#define CACHE_DEFAULT_SIZE (64L * 1024 * 1024)
+
+extern bool use_cache;          // --cache, consult and fill the cache
+extern char *cache_dir;         // --cache-dir, overrides the default location
+extern long cache_size_limit;   // --cache-size, total bytes kept on disk
+
+/* counts reported by -p and -w */
+extern int cache_hits;
+extern int cache_misses;
+extern int cache_stores;
+extern int cache_evictions;
+
+/**
+ * Parses program text, replacing the current program. If the cache is enabled
+ * and holds this text, the stored image is decoded instead, otherwise the
+ * text is parsed and the result added to the cache.
+ *
+ * As with yyparse, the lines are left un-chained for interpreter_post_parse.
+ *
+ * @param text The program source.
+ * @param length Length of @p text in bytes.
+ * @return true if the program came from the cache.
+ */
+bool cache_parse(const char *text, size_t length);
+
+/**
+ * Deletes every entry in the cache directory.
+ *
+ * @return The number of entries removed.
+ */
+int cache_purge(void);
+
+#endif /* __CACHE_H__ */
@@ -0,0 +1,264 @@
+/* file channels (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include "channel.h"
+#include "retrofocal.h"
+
+#if !defined(WIN32) && !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+FILE *channel_output = NULL;
+
+/* one file, open for reading or writing */
+typedef struct {
+  bool open;
+  bool output;
+  FILE *file;           // an output channel's file, or an input one's on Windows ...
+  char *buffer;         // ... and the buffer stdio uses for output
+  int fd;               // an input channel's file elsewhere ...
+  char *data;           // ... all of it if mapped, otherwise what's been read
+  size_t size;          // bytes in data
+  size_t capacity;      // bytes allocated for data, 0 if mapped
+  size_t position;      // the start of the next line in data
+  bool at_end;          // nothing more to read into data
+  char *line;           // the last line read, with a terminator
+  size_t line_size;
+  int column;           // the cursor column while another channel is selected
+} channel_t;
+
+static channel_t channels[CHANNELS];
+static int input_channel = 0;
+static int output_channel = 0;
+static bool closed_at_exit = false;
+
+/* the channel number from a value, or -1 after reporting the error */
+static int channel_number(double channel, bool terminal)
+{
+  if (channel != floor(channel) || channel < (terminal ? 0 : 1) || channel >= CHANNELS) {
+    focal_error("Bad channel number");
+    return -1;
+  }
+  return (int)channel;
+} /* channel_number */
+
+/* switches TYPE to a channel, keeping the column of the one it leaves */
+static void select_output(int number)
+{
+  channels[output_channel].column = interpreter_state.cursor_column;
+  output_channel = number;
+  interpreter_state.cursor_column = channels[number].column;
+  channel_output = number == 0 ? NULL : channels[number].file;
+} /* select_output */
+
+static void close_channel(int number)
+{
+  channel_t *channel = &channels[number];
+  if (!channel->open)
+    return;
+  if (number == input_channel)
+    input_channel = 0;
+  if (number == output_channel)
+    select_output(0);
+
+  if (channel->output) {
+    fclose(channel->file);
+    free(channel->buffer);
+  } else {
+#if !defined(WIN32) && !defined(_WIN32)
+    if (channel->capacity == 0 && channel->data != NULL)
+      munmap(channel->data, channel->size);
+    else
+      free(channel->data);
+    close(channel->fd);
+#else
+    free(channel->data);
+    fclose(channel->file);
+#endif
+    free(channel->line);
+  }
+  memset(channel, 0, sizeof(*channel));
+} /* close_channel */
+
+/* output still in the buffers is written when the program exits */
+static void close_all(void)
+{
+  for (int i = 1; i < CHANNELS; i++)
+    close_channel(i);
+} /* close_all */
+
+/* opens a file for reading, mapping it if it's an ordinary file */
+static bool open_input(channel_t *channel, const char *file)
+{
+#if !defined(WIN32) && !defined(_WIN32)
+  channel->fd = open(file, O_RDONLY);
+  if (channel->fd < 0)
+    return false;
+  struct stat info;
+  if (fstat(channel->fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, channel->fd, 0);
+    if (data != MAP_FAILED) {
+      channel->data = data;
+      channel->size = (size_t)info.st_size;
+      channel->at_end = true;
+      madvise(data, channel->size, MADV_SEQUENTIAL);
+      return true;
+    }
+  }
+#else
+  channel->file = fopen(file, "rb");
+  if (channel->file == NULL)
+    return false;
+#endif
+  channel->capacity = CHANNEL_BUFFER;
+  channel->data = malloc(channel->capacity);
+  return true;
+} /* open_input */
+
+/* reads more of an unmapped file, keeping the part line not yet used */
+static void fill_input(channel_t *channel)
+{
+  size_t left = channel->size - channel->position;
+  memmove(channel->data, channel->data + channel->position, left);
+  channel->position = 0;
+  channel->size = left;
+  // a line longer than the buffer needs a bigger one
+  if (left == channel->capacity) {
+    channel->capacity *= 2;
+    channel->data = realloc(channel->data, channel->capacity);
+  }
+#if !defined(WIN32) && !defined(_WIN32)
+  ssize_t count = read(channel->fd, channel->data + left, channel->capacity - left);
+#else
+  long count = (long)fread(channel->data + left, 1, channel->capacity - left, channel->file);
+#endif
+  if (count <= 0)
+    channel->at_end = true;
+  else
+    channel->size += (size_t)count;
+} /* fill_input */
+
+/************************************************************************/
+
+void channel_open(double channel, const char *file, bool output)
+{
+  int number = channel_number(channel, false);
+  if (number < 0)
+    return;
+  close_channel(number);
+
+  channel_t *opening = &channels[number];
+  bool opened;
+  if (output) {
+    opening->file = fopen(file, "w");
+    opened = opening->file != NULL;
+    if (opened) {
+      opening->buffer = malloc(CHANNEL_BUFFER);
+      setvbuf(opening->file, opening->buffer, _IOFBF, CHANNEL_BUFFER);
+    }
+  } else
+    opened = open_input(opening, file);
+  if (!opened) {
+    char message[MAXSTRING];
+    snprintf(message, sizeof(message), "Cannot open %s", file);
+    focal_error(message);
+    memset(opening, 0, sizeof(*opening));
+    return;
+  }
+  opening->open = true;
+  opening->output = output;
+
+  if (!closed_at_exit) {
+    atexit(close_all);
+    closed_at_exit = true;
+  }
+  channel_select(number, output);
+} /* channel_open */
+
+void channel_select(double channel, bool output)
+{
+  int number = channel_number(channel, true);
+  if (number < 0)
+    return;
+  if (number > 0 && (!channels[number].open || channels[number].output != output)) {
+    focal_error(output ? "Channel is not open for output" : "Channel is not open for input");
+    return;
+  }
+  if (output)
+    select_output(number);
+  else
+    input_channel = number;
+} /* channel_select */
+
+void channel_close(double channel)
+{
+  if (channel < 0) {
+    close_all();
+    return;
+  }
+  int number = channel_number(channel, false);
+  if (number > 0)
+    close_channel(number);
+} /* channel_close */
+
+char *channel_read_line(void)
+{
+  while (input_channel != 0) {
+    channel_t *channel = &channels[input_channel];
+    char *start = channel->data + channel->position;
+    size_t left = channel->size - channel->position;
+    char *end = left > 0 ? memchr(start, '\n', left) : NULL;
+
+    if (end == NULL && !channel->at_end) {
+      fill_input(channel);
+      continue;
+    }
+    // out of lines, back to the terminal
+    if (end == NULL && left == 0) {
+      close_channel(input_channel);
+      return NULL;
+    }
+
+    // the last line may not have a newline
+    size_t length = end != NULL ? (size_t)(end - start) : left;
+    channel->position += end != NULL ? length + 1 : length;
+    if (length > 0 && start[length - 1] == '\r')
+      length--;
+    if (length + 1 > channel->line_size) {
+      channel->line_size = length + 1;
+      channel->line = realloc(channel->line, channel->line_size);
+    }
+    memcpy(channel->line, start, length);
+    channel->line[length] = '\0';
+    return channel->line;
+  }
+  return NULL;
+} /* channel_read_line */
+
+bool channel_any_open(void)
+{
+  for (int i = 1; i < CHANNELS; i++)
+    if (channels[i].open)
+      return true;
+  return false;
+} /* channel_any_open */
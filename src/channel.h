@@ -0,0 +1,107 @@
+/* file channels (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __CHANNEL_H__
+#define __CHANNEL_H__
+
+#include "stdhdr.h"
+
+/**
+ * @file channel.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief OPEN, reading and writing files through numbered channels.
+ *
+ * FOCAL-71 used OPEN to point ASK at the paper tape reader and TYPE at the
+ * punch instead of the teletype. Here the devices are files on numbered
+ * channels. Channel 0 is the terminal and can't be closed, channels 1 up
+ * to CHANNELS-1 each hold a file open for reading or for writing.
+ *
+ *   O INPUT "file"       opens file for reading on channel 1 and ASKs from it
+ *   O INPUT N,"file"     the same on channel N
+ *   O INPUT N            ASKs from channel N, which is already open
+ *   O RESTORE INPUT      ASKs from the terminal again
+ *   O CLOSE N            closes channel N, O CLOSE closes them all
+ *
+ * and OUTPUT in place of INPUT for TYPE. Everything that prints for the
+ * program goes to the output channel, TYPE and ASK's prompts, FOUT, WRITE
+ * and MODIFY. Errors and the CLI's own messages stay on the terminal.
+ *
+ * Output channels are buffered CHANNEL_BUFFER bytes at a time. Input
+ * channels map a regular file into memory and read lines straight out of
+ * it, anything else, like a pipe, is read CHANNEL_BUFFER bytes at a time.
+ * Lines can be any length, so a program can write thousands of numbers on
+ * one line with TYPE and ASK them back in one statement. ASK prints no
+ * colon when reading a channel, and when a channel runs out it is closed
+ * and ASK carries on from the terminal, as FOCAL-71 did at the end of a
+ * tape.
+ *
+ * Each channel keeps its own column for TYPE's tabs. Lines read from
+ * channels are not passed through --record, a replay reads the files again.
+ */
+
+/* channels, including the terminal on 0 */
+#define CHANNELS 16
+
+/* bytes buffered for each file */
+#define CHANNEL_BUFFER (1024 * 1024)
+
+/* where the program's output goes, NULL for the terminal */
+extern FILE *channel_output;
+
+/* use this rather than stdout for anything the program prints */
+#define CHANNEL_OUTPUT (channel_output != NULL ? channel_output : stdout)
+
+/**
+ * Opens a file on a channel, closing whatever was there, and selects it.
+ * Errors are reported with focal_error.
+ *
+ * @param channel The channel, 1 to CHANNELS-1.
+ * @param file The file name.
+ * @param output True to write the file, false to read it.
+ */
+void channel_open(double channel, const char *file, bool output);
+
+/**
+ * Makes ASK or TYPE use a channel that's already open, 0 for the terminal.
+ */
+void channel_select(double channel, bool output);
+
+/**
+ * Closes a channel, or all of them if channel is negative. A selected
+ * channel that is closed goes back to the terminal.
+ */
+void channel_close(double channel);
+
+/**
+ * Reads the next line from the input channel.
+ *
+ * @return The line without its newline, good until the next call, or NULL
+ *         if ASK should read the terminal.
+ */
+char *channel_read_line(void);
+
+/**
+ * True if any channel other than the terminal is open, which also means
+ * ASK and TYPE are both using the terminal.
+ */
+bool channel_any_open(void);
+
+#endif /* __CHANNEL_H__ */
@@ -22,6 +22,9 @@ Boston, MA 02111-1307, USA.  */
 #include "parse.h"
 #include "io.h"
 #include "strng.h"
+#include "loader.h"
+#include "program.h"
+#include "cli.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,6 +48,21 @@ extern void delete_variables(void);
 jmp_buf parse_error_jmp_buf;
 bool parse_in_cli_mode = false;
 
+/* command line settings */
+int cli_cache_size = CLI_CACHE_SIZE;
+
+/* an immediate command that has been parsed before */
+typedef struct {
+  char *text;             // the command, without the spaces around it
+  list_t *statements;     // what it parsed to, ready to go in line 0
+  unsigned long used;     // when it last ran, to find the least recently used
+} cli_command_t;
+
+static cli_command_t *commands = NULL;
+static int command_count = 0;
+static unsigned long command_clock = 0;
+static long command_generation = 0;  // program_generation when they were parsed
+
 /* Helper to parse a line number from the start of input */
 static int parse_line_number(const char *line, char **rest)
 {
@@ -66,6 +84,70 @@ static int parse_line_number(const char *line, char **rest)
   return -1;  /* No line number found */
 }
 
+/* copies the command without the spaces around it, which don't change
+   what it means */
+static char *command_text(const char *input_line)
+{
+  while (*input_line && isspace((unsigned char)*input_line))
+    input_line++;
+  size_t length = strlen(input_line);
+  while (length > 0 && isspace((unsigned char)input_line[length - 1]))
+    length--;
+  char *text = malloc(length + 1);
+  memcpy(text, input_line, length);
+  text[length] = '\0';
+  return text;
+} /* command_text */
+
+/* forgets every command, their statements may refer to lines that have
+   changed since */
+static void flush_commands(void)
+{
+  for (int i = 0; i < command_count; i++) {
+    free(commands[i].text);
+    lst_free(commands[i].statements);
+  }
+  command_count = 0;
+  command_generation = program_generation;
+} /* flush_commands */
+
+/* the statements a command parsed to last time, or NULL */
+static list_t *find_command(const char *text)
+{
+  if (command_generation != program_generation)
+    flush_commands();
+  for (int i = 0; i < command_count; i++)
+    if (strcmp(commands[i].text, text) == 0) {
+      commands[i].used = ++command_clock;
+      return commands[i].statements;
+    }
+  return NULL;
+} /* find_command */
+
+/* keeps a newly parsed command, pushing out the one least recently used
+   if the cache is full. returns false if it can't be kept */
+static bool keep_command(char *text, list_t *statements)
+{
+  if (cli_cache_size <= 0)
+    return false;
+  if (commands == NULL)
+    commands = calloc(cli_cache_size, sizeof(*commands));
+  int slot = command_count;
+  if (command_count == cli_cache_size) {
+    slot = 0;
+    for (int i = 1; i < command_count; i++)
+      if (commands[i].used < commands[slot].used)
+        slot = i;
+    free(commands[slot].text);
+    lst_free(commands[slot].statements);
+  } else
+    command_count++;
+  commands[slot].text = text;
+  commands[slot].statements = statements;
+  commands[slot].used = ++command_clock;
+  return true;
+} /* keep_command */
+
 static bool handle_erase_cli_command(const char *input_line)
 {
   const char *p = input_line;
@@ -114,17 +196,17 @@ static bool handle_erase_cli_command(const char *input_line)
       return true;
     }
     for (int i = start; i < MAXLINE && i < start + 100; i++)
-      interpreter_state.lines[i] = NULL;
+      if (interpreter_state.lines[i] != NULL)
+        program_store_line(i, NULL);
   } else {
     int index = (int)round(num * 100);
     if (index < 0 || index >= MAXLINE) {
       fprintf(stderr, "Invalid ERASE target.\n");
       return true;
     }
-    interpreter_state.lines[index] = NULL;
+    if (interpreter_state.lines[index] != NULL)
+      program_store_line(index, NULL);
   }
-
-  interpreter_post_parse();
   return true;
 }
 
@@ -141,11 +223,12 @@ static void process_cli_line(const char *input_line)
     rest++;
   if (line_num >= 0) {
     /* This is a line edit: either delete or store */
-    if (!rest || *rest == '\0') {
+    if (line_num >= MAXLINE) {
+      fprintf(stderr, "Invalid line number.\n");
+    } else if (!rest || *rest == '\0') {
       /* Just a line number - delete the line */
-      if (line_num >= 0 && line_num < MAXLINE) {
-        interpreter_state.lines[line_num] = NULL;
-      }
+      if (interpreter_state.lines[line_num] != NULL)
+        program_store_line(line_num, NULL);
     } else {
       /* Line number followed by code - parse and store the line */
       char statement_with_line[512];
@@ -162,19 +245,33 @@ static void process_cli_line(const char *input_line)
       parse_in_cli_mode = false;
     }
   } else {
-    /* No line number - this is immediate-mode execution */
-    char statement_with_line[512];
-    snprintf(statement_with_line, sizeof(statement_with_line), "0.00 %s\n", input_line);
-    
-    /* Set up error recovery and mark that we're in CLI mode */
-    parse_in_cli_mode = true;
-    if (setjmp(parse_error_jmp_buf) == 0) {
-      /* Parse this line into the current program storage using string-based scanning */
-      void *buffer = yy_scan_string(statement_with_line);
-      yyparse();
-      yy_delete_buffer(buffer);
+    /* No line number - this is immediate-mode execution, a command that
+       has been seen before reuses what it parsed to */
+    char *text = command_text(input_line);
+    list_t *immediate = find_command(text);
+    bool kept = immediate != NULL;
+    if (kept) {
+      free(text);
+      program_store_line(0, immediate);
+    } else {
+      char statement_with_line[512];
+      snprintf(statement_with_line, sizeof(statement_with_line), "0.00 %s\n", input_line);
+      
+      /* Set up error recovery and mark that we're in CLI mode */
+      parse_in_cli_mode = true;
+      if (setjmp(parse_error_jmp_buf) == 0) {
+        /* Parse this line into the current program storage using string-based scanning */
+        void *buffer = yy_scan_string(statement_with_line);
+        yyparse();
+        yy_delete_buffer(buffer);
+      }
+      parse_in_cli_mode = false;
+      
+      immediate = interpreter_state.lines[0];
+      kept = immediate != NULL && keep_command(text, immediate);
+      if (!kept)
+        free(text);
     }
-    parse_in_cli_mode = false;
     
     /* Check for command-only statements that should not be executed through interpreter_run */
     bool should_exit_cli = false;
@@ -188,103 +285,17 @@ static void process_cli_line(const char *input_line)
       if (stmt->type == LIBRARY) {
         /* Extract and perform the LIBRARY operation directly, don't execute through interpreter_run */
         if (stmt->parms.library.action == 1) {
-          /* LIBRARY CALL: load and parse a file */
-          FILE *lib_file = fopen(stmt->parms.library.filename, "r");
-          if (lib_file == NULL) {
-            fprintf(stderr, "Cannot open library file: %s\n", stmt->parms.library.filename);
-          } else {
-            /* Read the entire file into memory and parse it with string-based scanning */
-            fseek(lib_file, 0, SEEK_END);
-            long file_size = ftell(lib_file);
-            fseek(lib_file, 0, SEEK_SET);
-            
-            char *file_content = malloc(file_size + 1);
-            if (file_content == NULL) {
-              fprintf(stderr, "Memory allocation error reading library file\n");
-            } else {
-              size_t read_size = fread(file_content, 1, file_size, lib_file);
-              file_content[read_size] = '\0';
-              fclose(lib_file);
-              
-              /* Clear the current program */
-              for (int i = 0; i < MAXLINE; i++) {
-                interpreter_state.lines[i] = NULL;
-              }
-              
-              /* Parse the file content using string-based scanning */
-              extern int yyparse(void);
-              void *buffer = yy_scan_string(file_content);
-              yyparse();
-              yy_delete_buffer(buffer);
-              
-              free(file_content);
-              
-              /* Find first non-null line and set up state (without calling interpreter_post_parse to avoid hanging) */
-              int first_line = 0;
-              while ((first_line < MAXLINE - 1) && (interpreter_state.lines[first_line] == NULL))
-                first_line++;
-              interpreter_state.first_line_index = first_line;
-              interpreter_state.current_statement = interpreter_state.lines[first_line];
-            }
-          }
+          /* LIBRARY CALL: load and parse a file, replacing the current program */
+          library_load(stmt->parms.library.filename);
         } else if (stmt->parms.library.action == 0) {
           /* LIBRARY SAVE: write the current program to a file */
-          extern char *write_program(int start_line, int end_line);
-          char *output = write_program(1, MAXLINE);
-          if (output) {
-            FILE *save_file = fopen(stmt->parms.library.filename, "w");
-            if (save_file == NULL) {
-              fprintf(stderr, "Cannot open file for writing: %s\n", stmt->parms.library.filename);
-            } else {
-              fprintf(save_file, "%s", output);
-              fclose(save_file);
-            }
-            free(output);
-          }
+          library_save(stmt->parms.library.filename);
         } else {
           /* LIBRARY RUN: load a program file and immediately execute it */
-          FILE *lib_file = fopen(stmt->parms.library.filename, "r");
-          if (lib_file == NULL) {
-            fprintf(stderr, "Cannot open library file: %s\n", stmt->parms.library.filename);
-          } else {
-            /* Read the entire file into memory and parse it with string-based scanning */
-            fseek(lib_file, 0, SEEK_END);
-            long file_size = ftell(lib_file);
-            fseek(lib_file, 0, SEEK_SET);
-            
-            char *file_content = malloc(file_size + 1);
-            if (file_content == NULL) {
-              fprintf(stderr, "Memory allocation error reading library file\n");
-            } else {
-              size_t read_size = fread(file_content, 1, file_size, lib_file);
-              file_content[read_size] = '\0';
-              fclose(lib_file);
-              
-              /* Clear the current program */
-              for (int i = 0; i < MAXLINE; i++) {
-                interpreter_state.lines[i] = NULL;
-              }
-              
-              /* Parse the file content using string-based scanning */
-              extern int yyparse(void);
-              void *buffer = yy_scan_string(file_content);
-              yyparse();
-              yy_delete_buffer(buffer);
-              
-              free(file_content);
-              
-              /* Find first non-null line and set up state (without calling interpreter_post_parse to avoid hanging) */
-              int first_line = 0;
-              while ((first_line < MAXLINE - 1) && (interpreter_state.lines[first_line] == NULL))
-                first_line++;
-              interpreter_state.first_line_index = first_line;
-              
-              /* Start execution at the first line of the loaded program */
-              interpreter_state.current_statement = interpreter_state.lines[first_line];
-              interpreter_state.running_state = 1;
-              interpreter_run();
-              interpreter_state.running_state = 0;
-            }
+          if (library_load(stmt->parms.library.filename)) {
+            interpreter_state.running_state = 1;
+            interpreter_run();
+            interpreter_state.running_state = 0;
           }
         }
         should_skip_execution = true;
@@ -307,12 +318,15 @@ static void process_cli_line(const char *input_line)
       interpreter_state.first_line_index = saved_first_line_index;
     }
 
-    /* Remove the temporary line and restore line links */
-    if (interpreter_state.lines[0] != NULL) {
-      lst_free(interpreter_state.lines[0]);
-      interpreter_state.lines[0] = NULL;
-    }
-    interpreter_post_parse();
+    /* A DO or FOR the command didn't finish, like a FOR on the immediate
+       line, would point into statements that are about to go */
+    clear_stack();
+
+    /* Remove the temporary line, unless it's being kept for next time */
+    if (interpreter_state.lines[0] != NULL)
+      program_store_line(0, NULL);
+    if (immediate != NULL && !kept)
+      lst_free(immediate);
     if (should_exit_cli) {
       terminate_retrofocal(EXIT_SUCCESS);
     }
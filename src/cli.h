@@ -21,6 +21,13 @@ Boston, MA 02111-1307, USA.  */
 #ifndef CLI_H
 #define CLI_H
 
+/* immediate commands kept parsed, so the same one typed again, or sent
+   again by a script, goes straight to the interpreter */
+#define CLI_CACHE_SIZE 32
+
+/* command line settings */
+extern int cli_cache_size;   // --cli-cache-size, 0 to parse every command
+
 /* Main interactive CLI loop
  * Reads commands from the user, handles line editing and execution
  * Only called when RetroFOCAL is started without a source file
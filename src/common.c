@@ -0,0 +1,200 @@
+/* shared common area (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include <stdint.h>
+
+#include "common.h"
+#include "retrofocal.h"
+#include "record.h"
+
+#if !defined(WIN32) && !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* command line settings */
+char *common_file = NULL;
+long common_size = 0;
+bool common_lock = false;
+
+#define COMMON_VERSION 1
+static const char common_magic[8] = { 'F', 'O', 'C', 'A', 'L', 'C', 'O', 'M' };
+
+/* the start of the file, padded so the elements are well aligned */
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;     // bytes before the first element
+  uint64_t elements;
+  char unused[40];
+} common_header_t;
+
+static double *elements = NULL;
+static long element_count = 0;
+
+#if !defined(WIN32) && !defined(_WIN32)
+static void *mapping = NULL;
+static size_t mapping_size = 0;
+static int common_fd = -1;
+
+static void close_common(void)
+{
+  if (mapping != NULL)
+    munmap(mapping, mapping_size);
+  if (common_fd >= 0)
+    close(common_fd);
+  mapping = NULL;
+  elements = NULL;
+  common_fd = -1;
+}
+
+/* writes the header and zeros for a new area */
+static bool create_area(int fd, long count)
+{
+  common_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, common_magic, sizeof(header.magic));
+  header.version = COMMON_VERSION;
+  header.header_size = sizeof(header);
+  header.elements = (uint64_t)count;
+  if (ftruncate(fd, (off_t)(sizeof(header) + count * sizeof(double))) != 0)
+    return false;
+  return pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+}
+
+bool common_start(void)
+{
+  if (common_file == NULL)
+    return true;
+
+  common_fd = open(common_file, O_RDWR | O_CREAT, 0666);
+  if (common_fd < 0) {
+    fprintf(stderr, "Cannot open common area: %s\n", common_file);
+    return false;
+  }
+
+  // the first program to get here sets the file up, the rest wait for it
+  if (flock(common_fd, LOCK_EX) != 0) {
+    fprintf(stderr, "Cannot lock common area: %s\n", common_file);
+    close_common();
+    return false;
+  }
+
+  struct stat info;
+  common_header_t header;
+  if (fstat(common_fd, &info) == 0 && info.st_size == 0) {
+    if (!create_area(common_fd, common_size > 0 ? common_size : COMMON_DEFAULT_SIZE)) {
+      fprintf(stderr, "Cannot write common area: %s\n", common_file);
+      close_common();
+      return false;
+    }
+  }
+  if (fstat(common_fd, &info) != 0) {
+    fprintf(stderr, "Cannot open common area: %s\n", common_file);
+    close_common();
+    return false;
+  }
+  if (pread(common_fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || memcmp(header.magic, common_magic, sizeof(header.magic)) != 0) {
+    fprintf(stderr, "Not a RetroFOCAL common area: %s\n", common_file);
+    close_common();
+    return false;
+  }
+  if (header.version != COMMON_VERSION) {
+    fprintf(stderr, "Common area %s is version %u, this version of RetroFOCAL reads %i.\n", common_file, header.version, COMMON_VERSION);
+    close_common();
+    return false;
+  }
+
+  // the file has to be as long as the header says, and the size asked for
+  if (header.header_size < sizeof(header) || header.header_size % sizeof(double) != 0 || header.elements > LONG_MAX / sizeof(double) ||
+      (uint64_t)info.st_size < header.header_size + header.elements * sizeof(double)) {
+    fprintf(stderr, "Common area %s is shorter than its header says.\n", common_file);
+    close_common();
+    return false;
+  }
+  if (common_size > 0 && header.elements != (uint64_t)common_size) {
+    fprintf(stderr, "Common area %s holds %llu elements, not %li.\n", common_file, (unsigned long long)header.elements, common_size);
+    close_common();
+    return false;
+  }
+
+  mapping_size = header.header_size + header.elements * sizeof(double);
+  mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, common_fd, 0);
+  if (mapping == MAP_FAILED) {
+    mapping = NULL;
+    fprintf(stderr, "Cannot map common area: %s\n", common_file);
+    close_common();
+    return false;
+  }
+  elements = (double *)((char *)mapping + header.header_size);
+  element_count = (long)header.elements;
+
+  // without --common-lock other programs can have it as soon as it's set up
+  if (!common_lock)
+    flock(common_fd, LOCK_UN);
+
+  // terminate_retrofocal always goes through exit, which also drops the lock
+  atexit(close_common);
+  return true;
+} /* common_start */
+#else
+bool common_start(void)
+{
+  if (common_file == NULL)
+    return true;
+  fprintf(stderr, "--common is not supported on this platform.\n");
+  return false;
+} /* common_start */
+#endif
+
+/* the element for a subscript, or NULL after reporting the error */
+static double *common_element(double index)
+{
+  if (!(index >= 0 && index < element_count)) {
+    focal_error("Common index out of bounds");
+    return NULL;
+  }
+  return &elements[(long)index];
+} /* common_element */
+
+double common_read(double index)
+{
+  double value = 0;
+  if (elements != NULL) {
+    double *element = common_element(index);
+    if (element != NULL)
+      value = *element;
+  }
+  // another program may have put it there, so it's an input like any other
+  return record_common(value);
+} /* common_read */
+
+double common_write(double index, double value)
+{
+  if (elements != NULL) {
+    double *element = common_element(index);
+    if (element != NULL)
+      *element = value;
+  }
+  return value;
+} /* common_write */
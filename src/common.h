@@ -0,0 +1,81 @@
+/* shared common area (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __COMMON_H__
+#define __COMMON_H__
+
+#include "stdhdr.h"
+
+/**
+ * @file common.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief FCOM, a block of numbers shared between programs.
+ *
+ * UW-FOCAL used FCOM to set aside common memory that one program could
+ * leave for the next. Here FCOM(I) reads element I of a common area and
+ * FCOM(I,X) stores X there and returns it. With --common FILE the area
+ * is that file mapped into memory, so programs run one after the other,
+ * or at the same time, see each other's numbers directly without having
+ * to TYPE them out and ASK them back in.
+ *
+ * The file starts with a header holding a magic number, a version and
+ * the number of elements, followed by the elements as doubles in the
+ * machine's own byte order. A missing or empty file is set up with
+ * --common-size elements, COMMON_DEFAULT_SIZE if not given, and an
+ * existing one is checked to be a common area of the size its header
+ * claims. --common-lock holds an exclusive lock on the file from start
+ * to finish, so programs sharing it take turns instead of interleaving.
+ * Without it, each element is read and written whole, but nothing stops
+ * two programs from updating the same one at once.
+ *
+ * Without --common, FCOM reads zero and ignores stores, as before. Values
+ * read are passed through the --record log, so a replayed run sees the
+ * same numbers the recorded one did.
+ */
+
+/* the elements in a new area if --common-size isn't given */
+#define COMMON_DEFAULT_SIZE 4096
+
+/* command line settings */
+extern char *common_file;       // --common, the file to map
+extern long common_size;        // --common-size, elements in a new area, 0 for the default
+extern bool common_lock;        // --common-lock, hold the file for the whole run
+
+/**
+ * Maps the common area, if --common was given. Call once after the
+ * options are parsed.
+ *
+ * @return false if it could not be opened, or isn't a common area of the
+ *         right size, with a message printed.
+ */
+bool common_start(void);
+
+/**
+ * Returns element @p index of the area, for FCOM(I).
+ */
+double common_read(double index);
+
+/**
+ * Stores @p value in element @p index of the area and returns it, for FCOM(I,X).
+ */
+double common_write(double index, double value);
+
+#endif /* __COMMON_H__ */
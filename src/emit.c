@@ -0,0 +1,871 @@
+/* C translator (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include <stdarg.h>
+
+#include "emit.h"
+#include "retrofocal.h"
+#include "optimize.h"
+#include "number.h"
+#include "write.h"
+#include "parse.h"
+#include "fmath.h"
+
+/* command line settings */
+bool emit_c = false;
+
+/* the state of one translation */
+typedef struct {
+  FILE *out;
+  list_t **nodes;         // the statements, in program order
+  int *lines;             // ... the line each is on, in xx.yy * 100 format
+  int count;
+  int *line_start;        // the first statement on each line, -1 for none
+  list_t *variables;      // name -> bool, true if it is ever subscripted
+  const char *indent;     // put in front of each line of code
+  int temporaries;        // numbered within each function
+  double line;            // the line being translated, for messages
+  bool failed;
+} emitter_t;
+
+/************************************************************************/
+
+/** Returns a malloced string made with printf formatting. */
+static char *text(const char *format, ...)
+{
+  va_list ap;
+  va_start(ap, format);
+  int length = vsnprintf(NULL, 0, format, ap);
+  va_end(ap);
+
+  char *result = malloc(length + 1);
+  va_start(ap, format);
+  vsnprintf(result, length + 1, format, ap);
+  va_end(ap);
+  return result;
+} /* text */
+
+/** Writes one line of code at the current indent. */
+static void line_of_code(emitter_t *e, const char *format, ...)
+{
+  va_list ap;
+  fputs(e->indent, e->out);
+  va_start(ap, format);
+  vfprintf(e->out, format, ap);
+  va_end(ap);
+  fputc('\n', e->out);
+} /* line_of_code */
+
+/** Reports something that can't be translated. */
+static void unsupported(emitter_t *e, const char *what)
+{
+  fprintf(stderr, "%s cannot be translated to C at line %2.2f\n", what, e->line);
+  e->failed = true;
+} /* unsupported */
+
+/** Returns a C string literal holding @p string. */
+static char *c_string(const char *string)
+{
+  char *result = malloc(strlen(string) * 4 + 3);
+  char *p = result;
+  *p++ = '"';
+  for (const unsigned char *c = (const unsigned char *)string; *c; c++) {
+    if (*c == '"' || *c == '\\' || *c == '?') {
+      *p++ = '\\';
+      *p++ = *c;
+    } else if (*c == '\n') {
+      *p++ = '\\';
+      *p++ = 'n';
+    } else if (isprint(*c))
+      *p++ = *c;
+    else
+      p += sprintf(p, "\\%03o", *c);
+  }
+  *p++ = '"';
+  *p = '\0';
+  return result;
+} /* c_string */
+
+/** Returns a C literal for a number, as short as it can be while still
+ * reading back as exactly the same double.
+ */
+static char *c_number(double number)
+{
+  char buffer[40];
+  if (isnan(number))
+    return str_new("(0.0 / 0.0)");
+  if (isinf(number))
+    return str_new(number < 0 ? "(-1.0 / 0.0)" : "(1.0 / 0.0)");
+
+  // whole numbers are written out in full, rather than as 5e+03
+  if (number == trunc(number) && fabs(number) < 1e15)
+    snprintf(buffer, sizeof(buffer), "%.0f", number);
+  else {
+    for (int precision = 1; precision <= 17; precision++) {
+      snprintf(buffer, sizeof(buffer), "%.*g", precision, number);
+      if (strtod(buffer, NULL) == number)
+        break;
+    }
+  }
+  if (strpbrk(buffer, ".e") == NULL)
+    strcat(buffer, ".0");
+  return signbit(number) ? text("(%s)", buffer) : str_new(buffer);
+} /* c_number */
+
+/** Returns the C name for a variable, which FOCAL allows to be any
+ * letters and digits.
+ */
+static char *c_name(const char *prefix, const char *name)
+{
+  char *result = malloc(strlen(prefix) + strlen(name) * 3 + 1);
+  char *p = result + sprintf(result, "%s", prefix);
+  for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+    if (isalnum(*c))
+      *p++ = *c;
+    else
+      p += sprintf(p, "_%02x", *c);
+  }
+  *p = '\0';
+  return result;
+} /* c_name */
+
+/** Returns the C format that print_item would make from a FOCAL one. */
+static char *c_format(char *format)
+{
+  int width = atoi(format);
+  int precision = format_decimals(format);
+  char *printf_format = text(type_equals ? "= %%%d.%df" : "  %%%d.%df", width, precision);
+  char *result = c_string(printf_format);
+  free(printf_format);
+  return result;
+} /* c_format */
+
+/** Writes a temporary holding @p value, which is consumed, and returns
+ * its name. Everything that might print or report an error goes through
+ * here so that it happens in order.
+ */
+static char *temporary(emitter_t *e, const char *type, char *value)
+{
+  char *name = text("t%d", ++e->temporaries);
+  line_of_code(e, "%s%s%s = %s;", type, type[strlen(type) - 1] == '*' ? "" : " ", name, value);
+  free(value);
+  return name;
+} /* temporary */
+
+/************************************************************************/
+
+/* finding the variables */
+
+static void note_expression(expression_t *expression, void *user_data);
+
+/** Adds a variable to the table, marking it if it is subscripted here. */
+static void note_variable(emitter_t *e, variable_t *variable)
+{
+  bool *subscripted = lst_data_with_key(e->variables, variable->name);
+  if (subscripted == NULL) {
+    subscripted = calloc(1, sizeof(*subscripted));
+    e->variables = lst_insert_with_key_sorted(e->variables, subscripted, str_new(variable->name));
+  }
+  if (variable->subscripts != NULL)
+    *subscripted = true;
+  for (list_t *subscript = variable->subscripts; subscript != NULL; subscript = lst_next(subscript))
+    note_expression(subscript->data, e);
+} /* note_variable */
+
+static void note_expression(expression_t *expression, void *user_data)
+{
+  if (expression == NULL)
+    return;
+  if (expression->type == variable)
+    note_variable(user_data, expression->parms.variable);
+  else if (expression->type == op)
+    for (int i = 0; i < expression->parms.op.arity; i++)
+      note_expression(expression->parms.op.p[i], user_data);
+} /* note_expression */
+
+/** Returns true if the variable is stored in an array. */
+static bool is_array(emitter_t *e, variable_t *variable)
+{
+  bool *subscripted = lst_data_with_key(e->variables, variable->name);
+  return subscripted != NULL && *subscripted;
+} /* is_array */
+
+/** Returns the C for a variable without subscripts, which for an array
+ * is element 0.
+ */
+static char *reference(emitter_t *e, variable_t *variable)
+{
+  if (!is_array(e, variable))
+    return c_name("v_", variable->name);
+  char *name = c_name("a_", variable->name);
+  char *result = text("%s[RT_ORIGIN]", name);
+  free(name);
+  return result;
+} /* reference */
+
+/************************************************************************/
+
+/* expressions */
+
+static char *emit_value(emitter_t *e, expression_t *expression);
+
+/** Writes the code to find a variable's slot and returns a pointer to it.
+ * Subscripts are evaluated and checked here, as variable_slot does.
+ */
+static char *emit_slot(emitter_t *e, variable_t *variable)
+{
+  char *plain = reference(e, variable);
+  if (variable->subscripts == NULL) {
+    char *result = text("&%s", plain);
+    free(plain);
+    return result;
+  }
+
+  // there is only one dimension in FOCAL, more is an error and uses element 0
+  if (lst_next(variable->subscripts) != NULL) {
+    line_of_code(e, "rt_error(\"Array access has more than one subscript\");");
+    char *result = text("&%s", plain);
+    free(plain);
+    return result;
+  }
+  free(plain);
+
+  char *subscript = emit_value(e, variable->subscripts->data);
+  char *array = c_name("a_", variable->name);
+  char *slot = text("rt_element(%s + RT_ORIGIN, %s)", array, subscript);
+  free(array);
+  free(subscript);
+  return temporary(e, "double *", slot);
+} /* emit_slot */
+
+/** Writes an assignment to a slot from emit_slot, consuming both. */
+static void emit_store(emitter_t *e, char *slot, char *value)
+{
+  if (slot[0] == '&')
+    line_of_code(e, "%s = %s;", slot + 1, value);
+  else
+    line_of_code(e, "*%s = %s;", slot, value);
+  free(slot);
+  free(value);
+} /* emit_store */
+
+/** Returns the C name of a function that depends only on its parameter,
+ * in the --math mode the program was translated with. */
+static const char *pure_function_name(int function)
+{
+  if (math_mode == MATH_FAST)
+    switch (function) {
+      case FATN: return "fast_atn";
+      case FCOS: return "fast_cos";
+      case FEXP: return "fast_exp";
+      case FLOG: return "fast_log";
+      case FSIN: return "fast_sin";
+    }
+  switch (function) {
+    case FABS: return "rt_abs";
+    case FATN: return "rt_atn";
+    case FCOS: return "rt_cos";
+    case FEXP: return "rt_exp";
+    case FITR: return "rt_itr";
+    case FLOG: return "rt_log";
+    case FSGN: return "rt_sgn";
+    case FSIN: return "rt_sin";
+    case FSQT: return "rt_sqt";
+    default: return NULL;
+  }
+} /* pure_function_name */
+
+/** Writes the code for an operator and returns its value. The operands
+ * have already been worked out, so the only question is whether the
+ * operator itself does something that has to stay in order.
+ */
+static char *emit_operator(emitter_t *e, expression_t *expression)
+{
+  char *a = NULL, *b = NULL, *result = NULL;
+  int opcode = expression->parms.op.opcode;
+
+  if (expression->parms.op.arity == 0) {
+    if (opcode == FRAN)
+      return temporary(e, "double", str_new("rt_random()"));
+    if (opcode == FIN)
+      return temporary(e, "double", str_new("rt_in()"));
+    unsupported(e, "The function");
+    return str_new("0.0");
+  }
+
+  a = emit_value(e, expression->parms.op.p[0]);
+  if (expression->parms.op.arity == 1) {
+    if (opcode == '-')
+      result = text("-(%s)", a);
+    else if (pure_function_name(opcode) != NULL)
+      result = text("%s(%s)", pure_function_name(opcode), a);
+    else if (opcode == FOUT)
+      result = temporary(e, "double", text("rt_out(%s)", a));
+    else if (opcode == FADC || opcode == FDIS || opcode == FDXS || opcode == FNEW || opcode == FCOM)
+      result = str_new("0.0");
+    else {
+      unsupported(e, "The function");
+      result = str_new("0.0");
+    }
+    free(a);
+    return result;
+  }
+
+  b = emit_value(e, expression->parms.op.p[1]);
+  switch (opcode) {
+    case '+':
+    case '-':
+    case '*':
+      result = text("(%s %c %s)", a, opcode, b);
+      break;
+    case '/':
+      result = temporary(e, "double", text("rt_divide(%s, %s)", a, b));
+      break;
+    case '^':
+      result = text("rt_power(%s, %s)", a, b);
+      break;
+    case '=':
+      result = text("(double)-(%s == %s)", a, b);
+      break;
+    case ',':
+      // FNEW's arguments, which are worked out in order and then dropped
+      result = str_new(b);
+      break;
+    case FCOM:
+      // there's no common area outside the interpreter, so stores are
+      // dropped and reads give zero, as they do there without --common
+      result = str_new(b);
+      break;
+    case FDIS:
+    case FDXS:
+      // nor a display, so points go nowhere as they do without --plot-file
+      result = str_new("0.0");
+      break;
+    default:
+      unsupported(e, "The operator");
+      result = str_new("0.0");
+  }
+  free(a);
+  free(b);
+  return result;
+} /* emit_operator */
+
+/** Writes any code needed to evaluate an expression and returns the C
+ * for its value.
+ */
+static char *emit_value(emitter_t *e, expression_t *expression)
+{
+  switch (expression->type) {
+    case number:
+      return c_number(expression->parms.number);
+
+    case numstr:
+    {
+      // the text never changes, so neither does the value or the error
+      const char *error = NULL;
+      double value = string_to_number(expression->parms.string, strlen(expression->parms.string), &error);
+      if (error != NULL) {
+        char *message = c_string(error);
+        line_of_code(e, "rt_error(%s);", message);
+        free(message);
+      }
+      return c_number(value);
+    }
+
+    case variable:
+      if (expression->parms.variable->subscripts == NULL)
+        return reference(e, expression->parms.variable);
+      else {
+        char *slot = emit_slot(e, expression->parms.variable);
+        char *value = text("*%s", slot);
+        free(slot);
+        return temporary(e, "double", value);
+      }
+
+    case op:
+      return emit_operator(e, expression);
+
+    default:
+      unsupported(e, "A string used as a number");
+      return str_new("0.0");
+  }
+} /* emit_value */
+
+/************************************************************************/
+
+/* statements */
+
+/** Writes the code for one item in a TYPE or the prompt of an ASK. */
+static void emit_print_item(emitter_t *e, printitem_t *item)
+{
+  expression_t *expression = item->expression;
+
+  if (expression == NULL) {
+    if (item->separator > 0) {
+      switch (item->separator) {
+        case '!':
+          line_of_code(e, "rt_new_line();");
+          break;
+        case '#':
+          line_of_code(e, "rt_carriage_return();");
+          break;
+        case ':':
+          line_of_code(e, "rt_tab(%d);", tab_columns);
+          break;
+      }
+    }
+    else if (item->format != 0) {
+      if (atoi(item->format) > 31 || format_decimals(item->format) > 31)
+        line_of_code(e, "rt_error(\"Format has length greater than 31\");");
+      char *format = c_format(item->format);
+      line_of_code(e, "rt_format = %s;", format);
+      free(format);
+    }
+    else
+      line_of_code(e, "rt_error(\"Print item has no expression, format or separator\");");
+  }
+  else if (expression->type == string) {
+    char *literal = c_string(expression->parms.string);
+    line_of_code(e, "rt_print_string(%s);", literal);
+    free(literal);
+  }
+  else {
+    char *value = emit_value(e, expression);
+    line_of_code(e, "rt_print_number(%s);", value);
+    free(value);
+  }
+} /* emit_print_item */
+
+/** Writes the code to go to a line or group, which is found now rather
+ * than when it runs. The errors are the ones find_line would report.
+ */
+static void emit_jump(emitter_t *e, double linenumber)
+{
+  char message[128];
+  int group = trunc(linenumber);
+  int step = round((linenumber - group) * 100);
+  int target = -1;
+
+  if (linenumber == 0.0)
+    snprintf(message, sizeof(message), "Line 0 is reserved for internal use and cannot be referenced");
+  else if (linenumber < 0) {
+    if (linenumber != floor(linenumber))
+      snprintf(message, sizeof(message), "Negative target line %i.%i in branch", group, step);
+    else
+      snprintf(message, sizeof(message), "Negative target group %i.%i in branch", group, step);
+  }
+  else if (step != 0) {
+    target = group * 100 + step < MAXLINE ? e->line_start[group * 100 + step] : -1;
+    snprintf(message, sizeof(message), "Undefined target line %i.%i in branch", group, step);
+  }
+  else {
+    for (int i = group * 100; i < MAXLINE - 1; i++)
+      if (e->line_start[i] >= 0 && linenumber == trunc(i / 100)) {
+        target = e->line_start[i];
+        break;
+      }
+    snprintf(message, sizeof(message), "Undefined target line %i in branch", group);
+  }
+
+  if (target >= 0)
+    line_of_code(e, "pc = %d;", target);
+  else {
+    char *literal = c_string(message);
+    line_of_code(e, "rt_error(%s);", literal);
+    line_of_code(e, "pc = -1;");
+    free(literal);
+  }
+} /* emit_jump */
+
+/** Returns the statement after @p index, or -1 at the end. */
+static int next_statement(emitter_t *e, int index)
+{
+  return index + 1 < e->count ? index + 1 : -1;
+} /* next_statement */
+
+/** Returns true if @p index is the last statement on its line. */
+static bool ends_line(emitter_t *e, int index)
+{
+  return index + 1 == e->count || e->lines[index + 1] != e->lines[index];
+} /* ends_line */
+
+/** Writes the body of a statement.
+ *
+ * @return true if it may go somewhere other than the next statement.
+ */
+static bool emit_body(emitter_t *e, int index, statement_t *statement)
+{
+  switch (statement->type) {
+    case COMMENT:
+      return false;
+
+    case ASK:
+    {
+      bool reads = false;
+      for (list_t *I = statement->parms.input; I != NULL; I = lst_next(I)) {
+        printitem_t *item = I->data;
+        if (item->expression != NULL && item->expression->type == variable)
+          reads = true;
+      }
+      if (reads) {
+        line_of_code(e, "rt_ask_t ask;");
+        line_of_code(e, "const char *text;");
+        line_of_code(e, "size_t length;");
+        line_of_code(e, "rt_ask_start(&ask);");
+      }
+
+      // the prompts are printed, the variables read in turn
+      for (list_t *I = statement->parms.input; I != NULL; I = lst_next(I)) {
+        printitem_t *item = I->data;
+        if (item->expression == NULL || item->expression->type != variable)
+          emit_print_item(e, item);
+        else {
+          line_of_code(e, "length = rt_ask_field(&ask, &text);");
+          emit_store(e, emit_slot(e, item->expression->parms.variable), str_new("rt_number(text, length)"));
+        }
+      }
+      return false;
+    }
+
+    case DO:
+    {
+      double target = statement->parms._do;
+      int target_group = trunc(target);
+      int target_step = (target - target_group) * 100;
+      line_of_code(e, "rt_do(%d, %d, %d);", target_group, target_step, next_statement(e, index));
+      emit_jump(e, target);
+      return true;
+    }
+
+    case ERASE:
+      if (statement->parms.erase.mode == 0)
+        line_of_code(e, "erase_variables();");
+      else
+        line_of_code(e, "rt_error(\"ERASE with a line, group, or ALL argument is not allowed during program execution\");");
+      return false;
+
+    case FOR:
+    {
+      variable_t *variable = statement->parms._for.variable;
+      char *begin = temporary(e, "double", emit_value(e, statement->parms._for.begin));
+      char *end = temporary(e, "double", emit_value(e, statement->parms._for.end));
+      char *step = statement->parms._for.step != NULL ? temporary(e, "double", emit_value(e, statement->parms._for.step)) : str_new("1");
+
+      // the loop runs to the end of the FOR's line
+      int tail = index;
+      while (!ends_line(e, tail))
+        tail++;
+
+      char *slot = emit_slot(e, variable);
+      if (variable->subscripts == NULL)
+        line_of_code(e, "rt_for(%s, NULL, %s, %s, %d, %d);", slot, end, step, next_statement(e, index), tail);
+      else
+        line_of_code(e, "rt_for(NULL, for_index_%d, %s, %s, %d, %d);", index, end, step, next_statement(e, index), tail);
+      emit_store(e, slot, begin);
+      free(end);
+      free(step);
+      return false;
+    }
+
+    case GOTO:
+      if (statement->parms.go == 0) {
+        // the first line of the program
+        int first = -1;
+        for (int i = 1; i < MAXLINE - 1 && first < 0; i++)
+          first = e->line_start[i];
+        line_of_code(e, "pc = %d;", first);
+      } else
+        emit_jump(e, statement->parms.go);
+      return true;
+
+    case IF:
+    {
+      char *condition = temporary(e, "double", emit_value(e, statement->parms._if.condition));
+      const char *otherwise = "";
+      double targets[3] = { statement->parms._if.less_line, statement->parms._if.zero_line, statement->parms._if.more_line };
+      const char *tests[3] = { "<", "==", ">" };
+
+      // a missing branch carries on with the rest of the line
+      for (int i = 0; i < 3; i++) {
+        if (targets[i] > 0) {
+          line_of_code(e, "%sif (%s %s 0) {", otherwise, condition, tests[i]);
+          const char *indent = e->indent;
+          e->indent = "          ";
+          emit_jump(e, targets[i]);
+          e->indent = indent;
+          line_of_code(e, "}");
+          otherwise = "else ";
+        }
+      }
+      if (otherwise[0] == '\0')
+        line_of_code(e, "(void)%s;", condition);
+      free(condition);
+      return true;
+    }
+
+    case QUIT:
+      line_of_code(e, "pc = -1;");
+      return true;
+
+    case RETURN:
+      line_of_code(e, "pc = rt_return(pc);");
+      return true;
+
+    case SET:
+    {
+      char *slot = emit_slot(e, statement->parms.set.variable);
+      if (statement->parms.set.expression->type == string) {
+        line_of_code(e, "rt_error(\"Type mismatch in assignment\");");
+        free(slot);
+      } else
+        emit_store(e, slot, emit_value(e, statement->parms.set.expression));
+      return false;
+    }
+
+    case TYPE:
+      for (list_t *item = statement->parms.print; item != NULL; item = lst_next(item))
+        emit_print_item(e, item->data);
+      return false;
+
+    case WRITE:
+      if (statement->parms.write_spec != NULL) {
+        char *value = emit_value(e, statement->parms.write_spec);
+        line_of_code(e, "rt_write(listing, LISTING_LINES, true, %s);", value);
+        free(value);
+      } else
+        line_of_code(e, "rt_write(listing, LISTING_LINES, false, 0);");
+      return false;
+
+    default:
+      unsupported(e, "The statement");
+      return false;
+  }
+} /* emit_body */
+
+/** Writes the case for one statement. */
+static void emit_statement(emitter_t *e, int index)
+{
+  statement_t *statement = e->nodes[index]->data;
+  int line = e->lines[index];
+  int next = next_statement(e, index);
+
+  e->line = (double)line / 100.0;
+  e->temporaries = 0;
+
+  // a new line gets a comment with its source
+  if (index == 0 || e->lines[index - 1] != line) {
+    char *listing = write_program(line, line + 1);
+    char *end = strchr(listing, '\n');
+    if (end != NULL)
+      *end = '\0';
+    for (char *close = strstr(listing, "*/"); close != NULL; close = strstr(close, "*/"))
+      close[1] = '\\';
+    fprintf(e->out, "\n      /* %s */\n", listing);
+    free(listing);
+  }
+
+  fprintf(e->out, "      case %d: {\n", index);
+  line_of_code(e, "rt_line = %d / 100.0;", line);
+  line_of_code(e, "pc = %d;", next);
+
+  // an empty statement is skipped without even checking for the end of the line
+  if (statement == NULL) {
+    fprintf(e->out, "      }\n");
+    fprintf(e->out, "        continue;\n");
+    return;
+  }
+
+  bool jumps = emit_body(e, index, statement);
+
+  // work out the line numbers the way perform_statement does, truncation and all
+  if (ends_line(e, index)) {
+    double this_line = (double)line / 100.0;
+    double next_line = next >= 0 ? (double)e->lines[next] / 100.0 : -1.0;
+    int this_group = trunc(this_line);
+    int this_step = (this_line - this_group) * 100;
+    int next_group = trunc(next_line);
+    int next_step = (next_line - next_group) * 100;
+    bool line_ends = this_group != next_group || this_step != next_step;
+    line_of_code(e, "pc = rt_line_end(%d, pc, %s, %d, %d, %d);", index, line_ends ? "true" : "false", this_group, this_step, next_group);
+  }
+
+  fprintf(e->out, "      }\n");
+  if (jumps || ends_line(e, index))
+    fprintf(e->out, "        continue;\n");
+  else
+    fprintf(e->out, "        /* fall through */\n");
+} /* emit_statement */
+
+/** Writes a function that finds the slot of a FOR's subscripted index,
+ * which the runtime calls each time around the loop.
+ */
+static void emit_index_function(emitter_t *e, int index, statement_t *statement)
+{
+  e->line = (double)e->lines[index] / 100.0;
+  e->temporaries = 0;
+  e->indent = "  ";
+  fprintf(e->out, "\nstatic double *for_index_%d(void)\n{\n", index);
+  char *slot = emit_slot(e, statement->parms._for.variable);
+  line_of_code(e, "return %s;", slot);
+  fprintf(e->out, "}\n");
+  free(slot);
+} /* emit_index_function */
+
+bool emit_program(FILE *file, const char *source_name)
+{
+  emitter_t e = { 0 };
+  list_t *program = interpreter_state.lines[interpreter_state.first_line_index];
+  bool erases = false, writes = false;
+
+  // the result goes to a temporary file, so nothing is written if it fails
+  e.out = tmpfile();
+  if (e.out == NULL) {
+    fprintf(stderr, "Cannot create a temporary file for the translation.\n");
+    return false;
+  }
+
+  // number the statements and note which line each is on
+  e.count = lst_length(program);
+  e.nodes = calloc(e.count + 1, sizeof(*e.nodes));
+  e.lines = calloc(e.count + 1, sizeof(*e.lines));
+  e.line_start = malloc(MAXLINE * sizeof(*e.line_start));
+  for (int i = 0; i < MAXLINE; i++)
+    e.line_start[i] = -1;
+
+  int index = 0, line = interpreter_state.first_line_index;
+  for (list_t *node = program; node != NULL; node = lst_next(node), index++) {
+    if (node != program) {
+      int following = line + 1;
+      while (following < MAXLINE && interpreter_state.lines[following] == NULL)
+        following++;
+      if (following < MAXLINE && node == interpreter_state.lines[following])
+        line = following;
+    }
+    if (e.line_start[line] < 0)
+      e.line_start[line] = index;
+    e.nodes[index] = node;
+    e.lines[index] = line;
+  }
+
+  // find the variables, and whether anything needs the listing or ERASE
+  for (index = 0; index < e.count; index++) {
+    statement_t *statement = e.nodes[index]->data;
+    if (statement == NULL)
+      continue;
+    foreach_root(statement, note_expression, &e);
+    if (statement->type == SET)
+      note_variable(&e, statement->parms.set.variable);
+    else if (statement->type == FOR)
+      note_variable(&e, statement->parms._for.variable);
+    else if (statement->type == WRITE) {
+      note_expression(statement->parms.write_spec, &e);
+      writes = true;
+    }
+    else if (statement->type == ERASE && statement->parms.erase.mode == 0)
+      erases = true;
+  }
+
+  fprintf(e.out, "/* %s, translated to C by RetroFOCAL %s\n", source_name, VERSION_STRING);
+  fprintf(e.out, "   build with: cc prog.c -Iruntime libfocalrt.a -lm */\n\n");
+  fprintf(e.out, "#include \"focalrt.h\"\n\n");
+
+  // the variables
+  for (list_t *node = lst_first_node(e.variables); node != NULL; node = lst_next(node)) {
+    char *name = c_name(*(bool *)node->data ? "a_" : "v_", node->key);
+    if (*(bool *)node->data)
+      fprintf(e.out, "static double %s[RT_ELEMENTS];\n", name);
+    else
+      fprintf(e.out, "static double %s;\n", name);
+    free(name);
+  }
+
+  if (erases) {
+    fprintf(e.out, "\nstatic void erase_variables(void)\n{\n");
+    for (list_t *node = lst_first_node(e.variables); node != NULL; node = lst_next(node)) {
+      char *name = c_name(*(bool *)node->data ? "a_" : "v_", node->key);
+      if (*(bool *)node->data)
+        fprintf(e.out, "  memset(%s, 0, sizeof(%s));\n", name, name);
+      else
+        fprintf(e.out, "  %s = 0;\n", name);
+      free(name);
+    }
+    fprintf(e.out, "}\n");
+  }
+
+  // WRITE prints the program as it was when it was translated
+  if (writes) {
+    int lines = 0;
+    fprintf(e.out, "\nstatic const rt_listing_t listing[] = {\n");
+    for (int i = 1; i < MAXLINE; i++) {
+      if (interpreter_state.lines[i] == NULL)
+        continue;
+      char *listing = write_program(i, i + 1);
+      char *literal = c_string(listing);
+      fprintf(e.out, "  { %d, %s },\n", i, literal);
+      free(literal);
+      free(listing);
+      lines++;
+    }
+    fprintf(e.out, "};\n#define LISTING_LINES %d\n", lines);
+  }
+
+  // the FORs with subscripted indexes find them each time around
+  for (index = 0; index < e.count; index++) {
+    statement_t *statement = e.nodes[index]->data;
+    if (statement != NULL && statement->type == FOR && statement->parms._for.variable->subscripts != NULL)
+      emit_index_function(&e, index, statement);
+  }
+
+  // and the program itself
+  char default_format[] = "5.4";
+  char *format = c_format(default_format);
+  fprintf(e.out, "\nint main(int argc, char *argv[])\n{\n");
+  fprintf(e.out, "  int pc = %d;\n\n", e.count > 0 ? 0 : -1);
+  fprintf(e.out, "  rt_start(argc, argv);\n");
+  fprintf(e.out, "  rt_format = %s;\n", format);
+  fprintf(e.out, "  while (pc >= 0) {\n");
+  fprintf(e.out, "    switch (pc) {\n");
+  free(format);
+
+  e.indent = "        ";
+  for (index = 0; index < e.count; index++)
+    emit_statement(&e, index);
+
+  fprintf(e.out, "    }\n");
+  fprintf(e.out, "  }\n");
+  fprintf(e.out, "  return EXIT_SUCCESS;\n");
+  fprintf(e.out, "}\n");
+
+  // copy it out if it all worked
+  if (!e.failed) {
+    char buffer[4096];
+    size_t length;
+    rewind(e.out);
+    while ((length = fread(buffer, 1, sizeof(buffer), e.out)) > 0)
+      fwrite(buffer, 1, length, file);
+  }
+
+  fclose(e.out);
+  lst_free_everything(e.variables);
+  free(e.nodes);
+  free(e.lines);
+  free(e.line_start);
+  return !e.failed;
+} /* emit_program */
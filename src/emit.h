@@ -0,0 +1,65 @@
+/* C translator (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __EMIT_H__
+#define __EMIT_H__
+
+#include "stdhdr.h"
+
+/**
+ * @file emit.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief Translates a program into C ahead of time.
+ *
+ * --emit-c writes the parsed program out as a C file that, linked with
+ * the runtime in runtime/, prints exactly what the interpreter would have
+ * for the same input and -r seed.
+ *
+ * Each statement becomes a case in a single switch, headed by a comment
+ * holding its line as WRITE would list it. Variables become static
+ * doubles, or arrays of 4096 for the ones that are ever subscripted, with
+ * A and A(0) sharing element 0. Expressions are written as C, with
+ * anything that might print or report an error given its own temporary
+ * so everything happens in the order the interpreter would do it.
+ *
+ * The targets of GOTO, IF and DO are looked up as the file is written.
+ * DO and FOR keep an explicit stack in the runtime, which also decides
+ * what happens at the end of each line using the same rules, including
+ * their quirks, as perform_statement.
+ *
+ * MODIFY, LIBRARY and the other statements that only make sense inside
+ * the interpreter can't be translated, and neither can a string used as
+ * a number. These are reported and nothing is written.
+ */
+
+extern bool emit_c;           // set by --emit-c
+
+/**
+ * Writes the current program as C. The program must have been through
+ * interpreter_post_parse.
+ *
+ * @param file The file to write to.
+ * @param source_name The name of the program, for the comment at the top.
+ * @return true if every statement could be translated.
+ */
+bool emit_program(FILE *file, const char *source_name);
+
+#endif /* __EMIT_H__ */
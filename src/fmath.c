@@ -0,0 +1,202 @@
+/* math library (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include <stdint.h>
+#include <float.h>
+
+#include "fmath.h"
+
+/* command line settings */
+math_mode_t math_mode = MATH_EXACT;
+
+/* pi/2 and ln 2 split in two, the first part with enough trailing zeros
+   that multiplying it by a whole number up to about 2^20 is exact */
+static const double two_over_pi = 6.36619772367581382433e-01;
+static const double pio2_hi = 1.57079632673412561417e+00;
+static const double pio2_lo = 6.07710050650619224932e-11;
+static const double inv_ln2 = 1.44269504088896338700e+00;
+static const double ln2_hi = 6.93147180369123816490e-01;
+static const double ln2_lo = 1.90821492927058770002e-10;
+
+static const double pi_2 = 1.57079632679489655800e+00;
+static const double pi_6 = 5.23598775598298815658e-01;
+static const double sqrt2 = 1.41421356237309514547e+00;
+static const double sqrt3 = 1.73205080756887719318e+00;
+static const double tan_pi_12 = 2.67949192431122706473e-01;
+
+/* adding this rounds anything under 2^51 to a whole number, which then
+   sits in the low bits, without the call floor can need */
+static const double round_magic = 6755399441055744.0;
+
+/* the ranges the approximations cover, outside them the library is used */
+#define SINCOS_LIMIT 1e5
+#define EXP_LOW -708.0
+#define EXP_HIGH 709.0
+
+/* sin and cos of the quadrant that x falls in, on -pi/4..pi/4, where the
+   Taylor series to x^9 and x^10 are good to a few parts in 1e10 */
+static inline double sin_poly(double r)
+{
+  double s = r * r;
+  return r + r * s * (-1.0 / 6 + s * (1.0 / 120 + s * (-1.0 / 5040 + s * (1.0 / 362880))));
+} /* sin_poly */
+
+static inline double cos_poly(double r)
+{
+  double s = r * r;
+  return 1.0 + s * (-0.5 + s * (1.0 / 24 + s * (-1.0 / 720 + s * (1.0 / 40320 + s * (-1.0 / 3628800)))));
+} /* cos_poly */
+
+/* sin(a + quadrant * pi/2), without any branches for the compiler to trip on */
+static inline double sin_core(double a, int quadrant)
+{
+  double shifted = a * two_over_pi + round_magic;
+  double k = shifted - round_magic;
+  double r = (a - k * pio2_hi) - k * pio2_lo;
+  double s = sin_poly(r), c = cos_poly(r);
+  // odd quadrants take the cos, the second half of the circle flips the sign
+  uint64_t q, s_bits, c_bits;
+  memcpy(&q, &shifted, sizeof(q));
+  memcpy(&s_bits, &s, sizeof(s_bits));
+  memcpy(&c_bits, &c, sizeof(c_bits));
+  q += quadrant;
+  uint64_t odd = -(q & 1);
+  uint64_t v_bits = ((c_bits & odd) | (s_bits & ~odd)) ^ ((q & 2) << 62);
+  double v;
+  memcpy(&v, &v_bits, sizeof(v));
+  return v;
+} /* sin_core */
+
+/* e^a as 2^k * e^r with r within ln 2 / 2 of zero */
+static inline double exp_core(double a)
+{
+  double shifted = a * inv_ln2 + round_magic;
+  double k = shifted - round_magic;
+  double r = (a - k * ln2_hi) - k * ln2_lo;
+  double p = 1.0 + r * (1.0 + r * (1.0 / 2 + r * (1.0 / 6 + r * (1.0 / 24 + r * (1.0 / 120 + r * (1.0 / 720 + r * (1.0 / 5040)))))));
+  uint64_t bits;
+  memcpy(&bits, &shifted, sizeof(bits));
+  bits = (uint64_t)((int32_t)bits + 1023) << 52;
+  double scale;
+  memcpy(&scale, &bits, sizeof(scale));
+  return p * scale;
+} /* exp_core */
+
+/* log a as e ln 2 + log m, with m within sqrt 2 of 1, from the series for
+   log((1+f)/(1-f)), which converges quickly when f is small */
+static inline double log_core(double a)
+{
+  uint64_t bits;
+  memcpy(&bits, &a, sizeof(bits));
+  int e = (int)(bits >> 52) - 1023;
+  bits = (bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL;
+  double m;
+  memcpy(&m, &bits, sizeof(m));
+  int big = m > sqrt2;
+  m *= 1.0 - 0.5 * big;
+  e += big;
+  double f = (m - 1.0) / (m + 1.0);
+  double s = f * f;
+  double p = 2.0 * f * (1.0 + s * (1.0 / 3 + s * (1.0 / 5 + s * (1.0 / 7 + s * (1.0 / 9)))));
+  return e * ln2_hi + (p + e * ln2_lo);
+} /* log_core */
+
+/* atan, folding everything onto 0..tan(pi/12) with atan(1/x) = pi/2 - atan(x)
+   and atan(x) = pi/6 + atan((x sqrt 3 - 1) / (sqrt 3 + x)) */
+static inline double atn_core(double a)
+{
+  double x = fabs(a);
+  int invert = x > 1.0;
+  x = invert ? 1.0 / x : x;
+  int shift = x > tan_pi_12;
+  x = shift ? (x * sqrt3 - 1.0) / (sqrt3 + x) : x;
+  double s = x * x;
+  double p = x + x * s * (-1.0 / 3 + s * (1.0 / 5 + s * (-1.0 / 7 + s * (1.0 / 9 + s * (-1.0 / 11)))));
+  p = shift ? p + pi_6 : p;
+  p = invert ? pi_2 - p : p;
+  return copysign(p, a);
+} /* atn_core */
+
+static inline bool sincos_range(double a) { return fabs(a) < SINCOS_LIMIT; }
+static inline bool exp_range(double a) { return (a >= EXP_LOW) & (a <= EXP_HIGH); }
+static inline bool log_range(double a) { return (a >= DBL_MIN) & (a <= DBL_MAX); }
+
+double fast_atn(double a)
+{
+  return atn_core(a);
+} /* fast_atn */
+
+double fast_cos(double a)
+{
+  return sincos_range(a) ? sin_core(a, 1) : cos(a);
+} /* fast_cos */
+
+double fast_exp(double a)
+{
+  return exp_range(a) ? exp_core(a) : exp(a);
+} /* fast_exp */
+
+double fast_log(double a)
+{
+  return log_range(a) ? log_core(a) : log(a);
+} /* fast_log */
+
+double fast_sin(double a)
+{
+  return sincos_range(a) ? sin_core(a, 0) : sin(a);
+} /* fast_sin */
+
+/* with more than one version of the batches, the best one for the
+   processor is picked when the program starts */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#define BATCH_TARGETS __attribute__((target_clones("avx2", "default")))
+#else
+#define BATCH_TARGETS
+#endif
+
+/* the batches first check that every value is in range, and if so run the
+   core with nothing else in the loop */
+#define BATCH(name, library, in_range, core)                    \
+BATCH_TARGETS                                                   \
+void batch_##name(double *values, int count)                    \
+{                                                               \
+  if (math_mode == MATH_EXACT) {                                \
+    for (int i = 0; i < count; i++)                             \
+      values[i] = library(values[i]);                           \
+    return;                                                     \
+  }                                                             \
+  int all = 1;                                                  \
+  for (int i = 0; i < count; i++)                               \
+    all &= in_range(values[i]);                                 \
+  if (all)                                                      \
+    for (int i = 0; i < count; i++)                             \
+      values[i] = core;                                         \
+  else                                                          \
+    for (int i = 0; i < count; i++)                             \
+      values[i] = fast_##name(values[i]);                       \
+} /* batch_##name */
+
+static inline bool any_range(double a) { (void)a; return true; }
+
+BATCH(atn, atan, any_range, atn_core(values[i]))
+BATCH(cos, cos, sincos_range, sin_core(values[i], 1))
+BATCH(exp, exp, exp_range, exp_core(values[i]))
+BATCH(log, log, log_range, log_core(values[i]))
+BATCH(sin, sin, sincos_range, sin_core(values[i], 0))
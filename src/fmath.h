@@ -0,0 +1,75 @@
+/* math library (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __FMATH_H__
+#define __FMATH_H__
+
+#include "stdhdr.h"
+
+/**
+ * @file fmath.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief The transcendental functions, exact or fast.
+ *
+ * FSIN, FCOS, FEXP, FLOG and FATN normally call the C library, so the
+ * results are the IEEE ones every other program gets. The original FOCAL
+ * only printed about six digits, though, and --math=fast swaps in the
+ * short polynomials here, which are good to about 1e-8 over the ranges
+ * programs actually use and several times quicker. Arguments outside
+ * those ranges, like FSIN(1E9) or FLOG(0), go to the C library anyway.
+ *
+ * The mode is picked before the program runs and every path uses the same
+ * functions, so the tree walker, compiled lines, machine code, batches and
+ * constant folding all agree with each other in either mode. FSQT, FABS,
+ * FITR and FSGN are exact in both modes, the processor does them as fast
+ * as any approximation could.
+ *
+ * The batch forms work on a block of values in place, for array loops
+ * run as batches, see vector.h. The fast ones have no branches in the
+ * common case, so the compiler can use vector instructions for them.
+ *
+ * Nothing here depends on the interpreter, so translated programs, see
+ * emit.h, can link it too.
+ */
+
+typedef enum {
+  MATH_EXACT,       // the C library
+  MATH_FAST         // the approximations below
+} math_mode_t;
+
+/* command line settings */
+extern math_mode_t math_mode;   // set by --math
+
+/* the approximations, for any argument */
+double fast_atn(double a);
+double fast_cos(double a);
+double fast_exp(double a);
+double fast_log(double a);
+double fast_sin(double a);
+
+/* the functions over count values in place, in the current mode */
+void batch_atn(double *values, int count);
+void batch_cos(double *values, int count);
+void batch_exp(double *values, int count);
+void batch_log(double *values, int count);
+void batch_sin(double *values, int count);
+
+#endif /* __FMATH_H__ */
@@ -0,0 +1,952 @@
+/* image (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include <stdint.h>
+
+#include "image.h"
+#include "retrofocal.h"
+#include "statistics.h"
+#include "memstat.h"
+#include "array.h"
+#include "parse.h"
+#include "channel.h"
+#include "plot.h"
+#include "rng.h"
+
+/* the header is the magic, version, a reserved word, payload length and checksum */
+#define IMAGE_HEADER_SIZE 16
+static const unsigned char image_magic[4] = { 'F', 'C', 'B', 0x1A };
+static const unsigned char snapshot_magic[4] = { 'F', 'C', 'S', 0x1A };
+
+/* marks a NULL statement pointer in a snapshot */
+#define NO_STATEMENT 0xFFFFFFFF
+
+/* marks a NULL string, as opposed to an empty one */
+#define NULL_STRING 0xFFFFFFFF
+
+/* the static analyzer counts, saved so -p works the same on an image */
+static int *parse_counters[PARSE_COUNTERS] = {
+  &numeric_constants_total, &numeric_constants_float, &numeric_constants_zero,
+  &numeric_constants_one, &string_constants_total, &string_constants_max,
+  &linenum_constants_total, &linenum_forwards, &linenum_backwards,
+  &linenum_same_line, &linenum_do_totals, &linenum_then_go_totals,
+  &linenum_go_totals, &for_loops_total, &for_loops_step_1, &increments,
+  &decrements, &assign_zero, &assign_one, &assign_other
+};
+
+/************************************************************************/
+
+/* growable output buffer */
+typedef struct {
+  unsigned char *data;
+  size_t length;
+  size_t capacity;
+} image_buffer_t;
+
+/* bounds-checked input cursor, failed is set on any overrun */
+typedef struct {
+  const unsigned char *data;
+  size_t length;
+  size_t offset;
+  bool failed;
+} image_reader_t;
+
+/** FNV-1a, used for the payload checksum. */
+static uint32_t checksum(const unsigned char *data, size_t length)
+{
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+} /* checksum */
+
+static void put_bytes(image_buffer_t *buffer, const void *bytes, size_t count)
+{
+  if (buffer->length + count > buffer->capacity) {
+    size_t new_capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+    while (new_capacity < buffer->length + count)
+      new_capacity *= 2;
+    buffer->data = realloc(buffer->data, new_capacity);
+    if (buffer->data == NULL) {
+      fprintf(stderr, "Realloc failed while writing program image\n");
+      exit(EXIT_FAILURE);
+    }
+    buffer->capacity = new_capacity;
+  }
+  memcpy(buffer->data + buffer->length, bytes, count);
+  buffer->length += count;
+}
+
+static void put_u8(image_buffer_t *buffer, unsigned value)
+{
+  unsigned char byte = (unsigned char)value;
+  put_bytes(buffer, &byte, 1);
+}
+
+static void put_u16(image_buffer_t *buffer, unsigned value)
+{
+  unsigned char bytes[2] = { value & 0xFF, (value >> 8) & 0xFF };
+  put_bytes(buffer, bytes, 2);
+}
+
+static void put_u32(image_buffer_t *buffer, uint32_t value)
+{
+  unsigned char bytes[4];
+  for (int i = 0; i < 4; i++)
+    bytes[i] = (value >> (i * 8)) & 0xFF;
+  put_bytes(buffer, bytes, 4);
+}
+
+static void put_double(image_buffer_t *buffer, double value)
+{
+  uint64_t bits;
+  unsigned char bytes[8];
+  memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0; i < 8; i++)
+    bytes[i] = (bits >> (i * 8)) & 0xFF;
+  put_bytes(buffer, bytes, 8);
+}
+
+static void put_string(image_buffer_t *buffer, const char *string)
+{
+  if (string == NULL) {
+    put_u32(buffer, NULL_STRING);
+    return;
+  }
+  uint32_t length = (uint32_t)strlen(string);
+  put_u32(buffer, length);
+  put_bytes(buffer, string, length);
+}
+
+static const unsigned char *get_bytes(image_reader_t *reader, size_t count)
+{
+  if (reader->failed || reader->length - reader->offset < count) {
+    reader->failed = true;
+    return NULL;
+  }
+  const unsigned char *bytes = reader->data + reader->offset;
+  reader->offset += count;
+  return bytes;
+}
+
+static unsigned get_u8(image_reader_t *reader)
+{
+  const unsigned char *bytes = get_bytes(reader, 1);
+  return bytes ? bytes[0] : 0;
+}
+
+static unsigned get_u16(image_reader_t *reader)
+{
+  const unsigned char *bytes = get_bytes(reader, 2);
+  return bytes ? (unsigned)(bytes[0] | (bytes[1] << 8)) : 0;
+}
+
+static uint32_t get_u32(image_reader_t *reader)
+{
+  const unsigned char *bytes = get_bytes(reader, 4);
+  if (bytes == NULL)
+    return 0;
+  return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static double get_double(image_reader_t *reader)
+{
+  const unsigned char *bytes = get_bytes(reader, 8);
+  uint64_t bits = 0;
+  double value;
+  if (bytes == NULL)
+    return 0.0;
+  for (int i = 0; i < 8; i++)
+    bits |= (uint64_t)bytes[i] << (i * 8);
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static char *get_string(image_reader_t *reader)
+{
+  uint32_t length = get_u32(reader);
+  if (length == NULL_STRING)
+    return NULL;
+  const unsigned char *bytes = get_bytes(reader, length);
+  if (bytes == NULL)
+    return NULL;
+  char *string = malloc(length + 1);
+  memcpy(string, bytes, length);
+  string[length] = '\0';
+  return string;
+}
+
+/************************************************************************/
+
+/* the tree writers, these mirror the structures in retrofocal.h */
+
+static void put_expression(image_buffer_t *buffer, const expression_t *expression);
+
+static void put_variable(image_buffer_t *buffer, const variable_t *variable)
+{
+  if (variable == NULL) {
+    put_u8(buffer, 0);
+    return;
+  }
+  put_u8(buffer, 1);
+  put_string(buffer, variable->name);
+  if (variable->subscripts == NULL) {
+    put_u8(buffer, 0);
+    return;
+  }
+  put_u8(buffer, 1);
+  put_u16(buffer, lst_length(variable->subscripts));
+  for (list_t *node = lst_first_node(variable->subscripts); node != NULL; node = node->next)
+    put_expression(buffer, node->data);
+}
+
+static void put_expression(image_buffer_t *buffer, const expression_t *expression)
+{
+  // zero is a missing expression, otherwise the type is offset by one
+  if (expression == NULL) {
+    put_u8(buffer, 0);
+    return;
+  }
+  put_u8(buffer, expression->type + 1);
+
+  switch (expression->type) {
+    case number:
+      put_double(buffer, expression->parms.number);
+      break;
+    case string:
+    case numstr:
+      put_string(buffer, expression->parms.string);
+      break;
+    case variable:
+      put_variable(buffer, expression->parms.variable);
+      break;
+    case op:
+      put_u8(buffer, expression->parms.op.arity);
+      put_u32(buffer, (uint32_t)expression->parms.op.opcode);
+      // arity-0 functions may carry an ignored parameter, like FRAN(X)
+      if (expression->parms.op.arity == 0)
+        put_expression(buffer, expression->parms.op.p[0]);
+      for (int i = 0; i < expression->parms.op.arity; i++)
+        put_expression(buffer, expression->parms.op.p[i]);
+      break;
+    case invariant:
+      // only found in optimized trees, and those are never stored
+      break;
+  }
+}
+
+static void put_printlist(image_buffer_t *buffer, list_t *list)
+{
+  put_u16(buffer, lst_length(list));
+  for (list_t *node = lst_first_node(list); node != NULL; node = node->next) {
+    printitem_t *item = node->data;
+    put_expression(buffer, item->expression);
+    put_u32(buffer, (uint32_t)item->separator);
+    put_string(buffer, item->format);
+  }
+}
+
+static void put_statement(image_buffer_t *buffer, const statement_t *statement)
+{
+  // empty statements are kept, they are part of the list
+  if (statement == NULL) {
+    put_u8(buffer, 0);
+    return;
+  }
+  put_u8(buffer, 1);
+  put_u16(buffer, statement->type);
+  put_u8(buffer, statement->abbreviated);
+
+  switch (statement->type) {
+    case COMMENT:
+      put_string(buffer, statement->parms.rem);
+      break;
+    case ASK:
+      put_printlist(buffer, statement->parms.input);
+      break;
+    case TYPE:
+      put_printlist(buffer, statement->parms.print);
+      break;
+    case DO:
+      put_double(buffer, statement->parms._do);
+      break;
+    case GOTO:
+      put_double(buffer, statement->parms.go);
+      break;
+    case IF:
+      put_expression(buffer, statement->parms._if.condition);
+      put_double(buffer, statement->parms._if.less_line);
+      put_double(buffer, statement->parms._if.zero_line);
+      put_double(buffer, statement->parms._if.more_line);
+      break;
+    case FOR:
+      put_variable(buffer, statement->parms._for.variable);
+      put_expression(buffer, statement->parms._for.begin);
+      put_expression(buffer, statement->parms._for.end);
+      put_expression(buffer, statement->parms._for.step);
+      break;
+    case SET:
+      put_variable(buffer, statement->parms.set.variable);
+      put_expression(buffer, statement->parms.set.expression);
+      break;
+    case ERASE:
+      put_u32(buffer, (uint32_t)statement->parms.erase.mode);
+      put_double(buffer, statement->parms.erase.target);
+      break;
+    case MODIFY:
+      put_double(buffer, statement->parms.modify_line);
+      break;
+    case WRITE:
+      put_expression(buffer, statement->parms.write_spec);
+      break;
+    case LIBRARY:
+      put_string(buffer, statement->parms.library.filename);
+      put_u32(buffer, (uint32_t)statement->parms.library.action);
+      break;
+    case OPEN:
+      put_u32(buffer, (uint32_t)statement->parms.open.action);
+      put_expression(buffer, statement->parms.open.channel);
+      put_expression(buffer, statement->parms.open.filename);
+      break;
+    default:
+      // QUIT, RETURN and VARLIST have no parameters
+      break;
+  }
+}
+
+static void put_variable_name(void *key, void *data, void *user_data)
+{
+  variable_storage_t *storage = data;
+  put_string(user_data, key);
+  put_u8(user_data, storage->array != NULL);
+}
+
+/************************************************************************/
+
+/* and the readers */
+
+static expression_t *get_expression(image_reader_t *reader);
+
+static variable_t *get_variable(image_reader_t *reader)
+{
+  if (get_u8(reader) == 0)
+    return NULL;
+
+  variable_t *variable = memory_calloc(MEMORY_AST, sizeof(*variable));
+  variable->name = get_string(reader);
+  if (get_u8(reader) != 0) {
+    int count = get_u16(reader);
+    for (int i = 0; i < count && !reader->failed; i++)
+      variable->subscripts = lst_append(variable->subscripts, get_expression(reader));
+  }
+  if (variable->name == NULL)
+    reader->failed = true;
+  return variable;
+}
+
+static expression_t *get_expression(image_reader_t *reader)
+{
+  unsigned tag = get_u8(reader);
+  if (tag == 0 || reader->failed)
+    return NULL;
+  if (tag > op + 1) {
+    reader->failed = true;
+    return NULL;
+  }
+
+  expression_t *expression = memory_calloc(MEMORY_AST, sizeof(*expression));
+  expression->type = tag - 1;
+
+  switch (expression->type) {
+    case number:
+      expression->parms.number = get_double(reader);
+      break;
+    case string:
+    case numstr:
+      expression->parms.string = get_string(reader);
+      break;
+    case variable:
+      expression->parms.variable = get_variable(reader);
+      break;
+    case op:
+      expression->parms.op.arity = get_u8(reader);
+      expression->parms.op.opcode = (int)get_u32(reader);
+      if (expression->parms.op.arity > 3) {
+        reader->failed = true;
+        break;
+      }
+      if (expression->parms.op.arity == 0)
+        expression->parms.op.p[0] = get_expression(reader);
+      for (int i = 0; i < expression->parms.op.arity; i++)
+        expression->parms.op.p[i] = get_expression(reader);
+      break;
+    default:
+      reader->failed = true;
+      break;
+  }
+  return expression;
+}
+
+static list_t *get_printlist(image_reader_t *reader)
+{
+  list_t *list = NULL;
+  int count = get_u16(reader);
+  for (int i = 0; i < count && !reader->failed; i++) {
+    printitem_t *item = memory_calloc(MEMORY_AST, sizeof(*item));
+    item->expression = get_expression(reader);
+    item->separator = (int)get_u32(reader);
+    item->format = get_string(reader);
+    list = lst_append(list, item);
+  }
+  return list;
+}
+
+static statement_t *get_statement(image_reader_t *reader)
+{
+  if (get_u8(reader) == 0)
+    return NULL;
+
+  statement_t *statement = memory_calloc(MEMORY_AST, sizeof(*statement));
+  statement->type = get_u16(reader);
+  statement->abbreviated = get_u8(reader);
+
+  switch (statement->type) {
+    case COMMENT:
+      statement->parms.rem = get_string(reader);
+      break;
+    case ASK:
+      statement->parms.input = get_printlist(reader);
+      break;
+    case TYPE:
+      statement->parms.print = get_printlist(reader);
+      break;
+    case DO:
+      statement->parms._do = get_double(reader);
+      break;
+    case GOTO:
+      statement->parms.go = get_double(reader);
+      break;
+    case IF:
+      statement->parms._if.condition = get_expression(reader);
+      statement->parms._if.less_line = get_double(reader);
+      statement->parms._if.zero_line = get_double(reader);
+      statement->parms._if.more_line = get_double(reader);
+      break;
+    case FOR:
+      statement->parms._for.variable = get_variable(reader);
+      statement->parms._for.begin = get_expression(reader);
+      statement->parms._for.end = get_expression(reader);
+      statement->parms._for.step = get_expression(reader);
+      break;
+    case SET:
+      statement->parms.set.variable = get_variable(reader);
+      statement->parms.set.expression = get_expression(reader);
+      break;
+    case ERASE:
+      statement->parms.erase.mode = (int)get_u32(reader);
+      statement->parms.erase.target = get_double(reader);
+      break;
+    case MODIFY:
+      statement->parms.modify_line = get_double(reader);
+      break;
+    case WRITE:
+      statement->parms.write_spec = get_expression(reader);
+      break;
+    case LIBRARY:
+      statement->parms.library.filename = get_string(reader);
+      statement->parms.library.action = (int)get_u32(reader);
+      break;
+    case OPEN:
+      statement->parms.open.action = (int)get_u32(reader);
+      statement->parms.open.channel = get_expression(reader);
+      statement->parms.open.filename = get_expression(reader);
+      break;
+    default:
+      break;
+  }
+  return statement;
+}
+
+/************************************************************************/
+
+/* the header is written last, once the payload is known */
+static void begin_image(image_buffer_t *buffer)
+{
+  unsigned char header[IMAGE_HEADER_SIZE] = { 0 };
+  put_bytes(buffer, header, sizeof(header));
+}
+
+static void finish_image(image_buffer_t *buffer, const unsigned char *magic)
+{
+  uint32_t payload = (uint32_t)(buffer->length - IMAGE_HEADER_SIZE);
+  uint32_t sum = checksum(buffer->data + IMAGE_HEADER_SIZE, payload);
+  memcpy(buffer->data, magic, 4);
+  buffer->data[4] = IMAGE_VERSION & 0xFF;
+  buffer->data[5] = (IMAGE_VERSION >> 8) & 0xFF;
+  for (int i = 0; i < 4; i++) {
+    buffer->data[8 + i] = (payload >> (i * 8)) & 0xFF;
+    buffer->data[12 + i] = (sum >> (i * 8)) & 0xFF;
+  }
+}
+
+/* checks the header, leaving the reader at the start of the payload */
+static bool check_image(image_reader_t *reader, const unsigned char *magic, const char *kind)
+{
+  if (reader->length < IMAGE_HEADER_SIZE || memcmp(reader->data, magic, 4) != 0) {
+    fprintf(stderr, "Not a RetroFOCAL %s.\n", kind);
+    return false;
+  }
+  reader->offset = 4;
+  unsigned version = get_u16(reader);
+  (void)get_u16(reader);
+  uint32_t payload = get_u32(reader);
+  uint32_t sum = get_u32(reader);
+  if (version != IMAGE_VERSION) {
+    fprintf(stderr, "The %s is version %u, this version of RetroFOCAL reads %u.\n", kind, version, IMAGE_VERSION);
+    return false;
+  }
+  if (payload != reader->length - IMAGE_HEADER_SIZE || checksum(reader->data + IMAGE_HEADER_SIZE, payload) != sum) {
+    fprintf(stderr, "The %s is corrupt (bad length or checksum).\n", kind);
+    return false;
+  }
+  return true;
+}
+
+static void put_program(image_buffer_t *buffer)
+{
+  // the analyzer counts
+  put_u16(buffer, PARSE_COUNTERS);
+  for (int i = 0; i < PARSE_COUNTERS; i++)
+    put_u32(buffer, (uint32_t)*parse_counters[i]);
+
+  // the variable table
+  put_u32(buffer, (uint32_t)lst_length(interpreter_state.variable_values));
+  lst_foreach(interpreter_state.variable_values, put_variable_name, buffer);
+
+  // and the lines, each one stopping where the next begins
+  int line_count = 0;
+  for (int i = 0; i < MAXLINE; i++)
+    if (interpreter_state.lines[i] != NULL)
+      line_count++;
+  put_u32(buffer, (uint32_t)line_count);
+
+  for (int i = 0; i < MAXLINE; i++) {
+    if (interpreter_state.lines[i] == NULL)
+      continue;
+    list_t *stop = next_line_head(i);
+    int statements = 0;
+    for (list_t *node = interpreter_state.lines[i]; node != NULL && node != stop; node = node->next)
+      statements++;
+
+    put_u16(buffer, i);
+    put_u16(buffer, statements);
+    for (list_t *node = interpreter_state.lines[i]; node != NULL && node != stop; node = node->next)
+      put_statement(buffer, node->data);
+  }
+}
+
+static void get_program(image_reader_t *reader)
+{
+  // the analyzer counts are added, the same as parsing another file would
+  int counters = get_u16(reader);
+  int values[PARSE_COUNTERS] = { 0 };
+  for (int i = 0; i < counters; i++) {
+    int value = (int)get_u32(reader);
+    if (i < PARSE_COUNTERS)
+      values[i] = value;
+  }
+  add_parse_counters(values);
+
+  // the variable table, inserted the same way the parser does it
+  uint32_t variables = get_u32(reader);
+  expression_t zero = { .type = number, .parms.number = 0 };
+  for (uint32_t i = 0; i < variables && !reader->failed; i++) {
+    variable_t reference = { 0 };
+    reference.name = get_string(reader);
+    list_t *subscripts = get_u8(reader) ? lst_append(NULL, &zero) : NULL;
+    reference.subscripts = subscripts;
+    if (reference.name != NULL)
+      insert_variable(&reference);
+    lst_free(subscripts);
+  }
+
+  // and finally the program itself
+  for (int i = 0; i < MAXLINE; i++)
+    interpreter_state.lines[i] = NULL;
+
+  uint32_t lines = get_u32(reader);
+  for (uint32_t i = 0; i < lines && !reader->failed; i++) {
+    unsigned index = get_u16(reader);
+    unsigned statements = get_u16(reader);
+    list_t *line = NULL;
+    for (unsigned j = 0; j < statements && !reader->failed; j++)
+      line = lst_append(line, get_statement(reader));
+    if (index >= MAXLINE) {
+      reader->failed = true;
+      break;
+    }
+    interpreter_state.lines[index] = line;
+  }
+}
+
+/* writes to a temporary name and renames it into place, so a crash part
+   way through never leaves a damaged file where a good one used to be */
+static bool write_file(const char *filename, const unsigned char *data, size_t length)
+{
+  char *temporary = malloc(strlen(filename) + 5);
+  strcpy(temporary, filename);
+  strcat(temporary, ".tmp");
+
+  FILE *fp = fopen(temporary, "wb");
+  if (fp == NULL) {
+    fprintf(stderr, "Cannot open file for writing: %s\n", temporary);
+    free(temporary);
+    return false;
+  }
+  bool ok = fwrite(data, 1, length, fp) == length;
+  ok = (fclose(fp) == 0) && ok;
+#if defined(WIN32) || defined(_WIN32)
+  // rename won't replace an existing file on Windows
+  if (ok)
+    remove(filename);
+#endif
+  ok = ok && rename(temporary, filename) == 0;
+  if (!ok) {
+    fprintf(stderr, "Error writing file: %s\n", filename);
+    remove(temporary);
+  }
+  free(temporary);
+  return ok;
+}
+
+/* reads a whole file with a single fread */
+static unsigned char *read_file(const char *filename, size_t *length)
+{
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL)
+    return NULL;
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (size < 0) {
+    fclose(fp);
+    return NULL;
+  }
+  unsigned char *data = malloc(size > 0 ? size : 1);
+  *length = fread(data, 1, size, fp);
+  fclose(fp);
+  memory_charge(MEMORY_IO, *length);
+  return data;
+}
+
+/* and gives it back when the decoder is done with it */
+static void free_file(unsigned char *data, size_t length)
+{
+  memory_release(MEMORY_IO, length);
+  free(data);
+}
+
+/************************************************************************/
+
+unsigned char *encode_image(size_t *length)
+{
+  image_buffer_t buffer = { NULL, 0, 0 };
+  begin_image(&buffer);
+  put_program(&buffer);
+  finish_image(&buffer, image_magic);
+
+  *length = buffer.length;
+  return buffer.data;
+} /* encode_image */
+
+bool decode_image(const unsigned char *data, size_t length)
+{
+  image_reader_t reader = { data, length, 0, false };
+
+  // check the header before we touch the current program
+  if (!check_image(&reader, image_magic, "program image"))
+    return false;
+
+  get_program(&reader);
+  if (reader.failed) {
+    fprintf(stderr, "Program image is truncated or malformed.\n");
+    return false;
+  }
+  return true;
+} /* decode_image */
+
+bool save_image(const char *filename)
+{
+  size_t length;
+  unsigned char *data = encode_image(&length);
+  bool ok = write_file(filename, data, length);
+  free(data);
+  return ok;
+} /* save_image */
+
+bool load_image(const char *filename)
+{
+  size_t length;
+  unsigned char *data = read_file(filename, &length);
+  if (data == NULL) {
+    fprintf(stderr, "Cannot open program image: %s\n", filename);
+    return false;
+  }
+  bool ok = decode_image(data, length);
+  free_file(data, length);
+  return ok;
+} /* load_image */
+
+/************************************************************************/
+
+/* snapshots add the run state to the program, statement pointers are
+   written as their position in the chained program list */
+
+static uint32_t statement_index(list_t *start, list_t *statement)
+{
+  // compare the nodes, not their data, empty statements have NULL data
+  uint32_t index = 0;
+  for (list_t *node = start; node != NULL; node = node->next, index++)
+    if (node == statement)
+      return index;
+  return NO_STATEMENT;
+}
+
+static list_t *statement_at(list_t *start, uint32_t index, image_reader_t *reader)
+{
+  if (index == NO_STATEMENT)
+    return NULL;
+  list_t *statement = lst_node_at(start, (int)index);
+  if (statement == NULL)
+    reader->failed = true;
+  return statement;
+}
+
+/* only the non-zero elements are written, most of an array is usually empty */
+static void count_element(int index, either_t *element, void *user_data)
+{
+  (void)index;
+  if (element->number != 0)
+    (*(uint32_t *)user_data)++;
+}
+
+static void put_element(int index, either_t *element, void *user_data)
+{
+  // subscripts are stored as signed 16-bit values
+  if (element->number != 0) {
+    put_u16(user_data, (uint16_t)index);
+    put_double(user_data, element->number);
+  }
+}
+
+static void put_variable_values(void *key, void *data, void *user_data)
+{
+  variable_storage_t *storage = data;
+  uint32_t used = storage->value[0].number != 0;
+  if (storage->array != NULL)
+    array_foreach(storage->array, count_element, &used);
+
+  put_string(user_data, key);
+  put_u32(user_data, used);
+  put_element(0, storage->value, user_data);
+  if (storage->array != NULL)
+    array_foreach(storage->array, put_element, user_data);
+}
+
+static void get_variable_values(image_reader_t *reader)
+{
+  uint32_t variables = get_u32(reader);
+  for (uint32_t i = 0; i < variables && !reader->failed; i++) {
+    char *name = get_string(reader);
+    uint32_t used = get_u32(reader);
+    variable_storage_t *storage = name ? lst_data_with_key(interpreter_state.variable_values, name) : NULL;
+    if (storage == NULL) {
+      reader->failed = true;
+      free(name);
+      return;
+    }
+    for (uint32_t j = 0; j < used && !reader->failed; j++) {
+      int index = (int16_t)get_u16(reader);
+      double value = get_double(reader);
+      if (index == 0)
+        storage->value[0].number = value;
+      else if (storage->array == NULL || index < ARRAY_FIRST || index > ARRAY_LAST)
+        reader->failed = true;
+      else
+        array_write(storage->array, index)->number = value;
+    }
+    free(name);
+  }
+}
+
+bool save_snapshot(const char *filename)
+{
+  static bool warned = false;
+  if (channel_any_open()) {
+    if (!warned)
+      fprintf(stderr, "Not checkpointing while a file channel is open.\n");
+    warned = true;
+    return false;
+  }
+  // the screen so far and where each A/D channel is reading aren't saved
+  if (plot_file != NULL || adc_file != NULL) {
+    if (!warned)
+      fprintf(stderr, "Not checkpointing while plotting or reading A/D samples.\n");
+    warned = true;
+    return false;
+  }
+
+  image_buffer_t buffer = { NULL, 0, 0 };
+  list_t *start = interpreter_state.lines[interpreter_state.first_line_index];
+
+  begin_image(&buffer);
+  put_program(&buffer);
+
+  put_u32(&buffer, (uint32_t)lst_length(interpreter_state.variable_values));
+  lst_foreach(interpreter_state.variable_values, put_variable_values, &buffer);
+
+  // the RNG state is a single word, see rng.h
+  put_u32(&buffer, (uint32_t)(rng_state & 0xFFFFFFFF));
+  put_u32(&buffer, (uint32_t)(rng_state >> 32));
+
+  put_u32(&buffer, statement_index(start, interpreter_state.current_statement));
+  put_string(&buffer, interpreter_state.format);
+  put_u32(&buffer, (uint32_t)interpreter_state.cursor_column);
+
+  // the stack, bottom first, the FOR index is found again from the head
+  put_u32(&buffer, (uint32_t)lst_length(interpreter_state.stack));
+  for (list_t *node = lst_first_node(interpreter_state.stack); node != NULL; node = node->next) {
+    stackentry_t *entry = node->data;
+    put_u16(&buffer, entry->type);
+    put_double(&buffer, entry->original_line);
+    put_double(&buffer, entry->target_line);
+    put_u32(&buffer, statement_index(start, entry->head));
+    put_u32(&buffer, statement_index(start, entry->returnpoint));
+    put_double(&buffer, entry->begin);
+    put_double(&buffer, entry->end);
+    put_double(&buffer, entry->step);
+  }
+
+  finish_image(&buffer, snapshot_magic);
+  bool ok = write_file(filename, buffer.data, buffer.length);
+  free(buffer.data);
+  return ok;
+} /* save_snapshot */
+
+bool load_snapshot(const char *filename)
+{
+  size_t length;
+  unsigned char *data = read_file(filename, &length);
+  if (data == NULL) {
+    fprintf(stderr, "Cannot open checkpoint: %s\n", filename);
+    return false;
+  }
+  image_reader_t reader = { data, length, 0, false };
+  if (!check_image(&reader, snapshot_magic, "checkpoint")) {
+    free_file(data, length);
+    return false;
+  }
+
+  // the program comes back exactly as a program image does, then the
+  // lines are chained so the statement indices can be resolved
+  get_program(&reader);
+  if (!reader.failed)
+    interpreter_post_parse();
+  list_t *start = interpreter_state.lines[interpreter_state.first_line_index];
+
+  get_variable_values(&reader);
+
+  uint64_t random_state = get_u32(&reader);
+  random_state |= (uint64_t)get_u32(&reader) << 32;
+
+  interpreter_state.current_statement = statement_at(start, get_u32(&reader), &reader);
+  char *format = get_string(&reader);
+  interpreter_state.format = format ? format : "5.4";
+  interpreter_state.cursor_column = (int)get_u32(&reader);
+
+  interpreter_state.stack = NULL;
+  uint32_t entries = get_u32(&reader);
+  for (uint32_t i = 0; i < entries && !reader.failed; i++) {
+    stackentry_t *entry = memory_calloc(MEMORY_STACK, sizeof(*entry));
+    entry->type = get_u16(&reader);
+    entry->original_line = get_double(&reader);
+    entry->target_line = get_double(&reader);
+    entry->head = statement_at(start, get_u32(&reader), &reader);
+    entry->returnpoint = statement_at(start, get_u32(&reader), &reader);
+    entry->begin = get_double(&reader);
+    entry->end = get_double(&reader);
+    entry->step = get_double(&reader);
+    if (entry->type == FOR) {
+      if (entry->head == NULL || ((statement_t *)entry->head->data)->type != FOR)
+        reader.failed = true;
+      else
+        entry->index_variable = ((statement_t *)entry->head->data)->parms._for.variable;
+    }
+    interpreter_state.stack = lst_append(interpreter_state.stack, entry);
+  }
+  free_file(data, length);
+
+  // xorshift never leaves zero, so that can't have come from a run
+  if (reader.failed || interpreter_state.current_statement == NULL || random_state == 0) {
+    fprintf(stderr, "Checkpoint is truncated or malformed.\n");
+    return false;
+  }
+
+  rng_state = random_state;
+  resumed_run = true;
+  return true;
+} /* load_snapshot */
+
+void get_parse_counters(int *values)
+{
+  for (int i = 0; i < PARSE_COUNTERS; i++)
+    values[i] = *parse_counters[i];
+} /* get_parse_counters */
+
+void clear_parse_counters(void)
+{
+  for (int i = 0; i < PARSE_COUNTERS; i++)
+    *parse_counters[i] = 0;
+} /* clear_parse_counters */
+
+void add_parse_counters(const int *values)
+{
+  for (int i = 0; i < PARSE_COUNTERS; i++) {
+    // the longest string is a maximum, not a count
+    if (parse_counters[i] == &string_constants_max) {
+      if (values[i] > string_constants_max)
+        string_constants_max = values[i];
+    } else
+      *parse_counters[i] += values[i];
+  }
+} /* add_parse_counters */
+
+bool is_image_file(const char *filename)
+{
+  unsigned char magic[4];
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL)
+    return false;
+  size_t read_size = fread(magic, 1, sizeof(magic), fp);
+  fclose(fp);
+  return read_size == sizeof(magic) && memcmp(magic, image_magic, sizeof(magic)) == 0;
+} /* is_image_file */
@@ -0,0 +1,133 @@
+/* image (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __IMAGE_H__
+#define __IMAGE_H__
+
+#include "stdhdr.h"
+
+/**
+ * @file image.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief Precompiled program images (.fcb files).
+ *
+ * An image is a compact binary serialization of a parsed program: the
+ * lines and their statements, the expression trees and constants within
+ * them, the variable table and the static analyzer counts. Loading an
+ * image skips the lexer and parser entirely, which is the bulk of the
+ * startup cost for short programs.
+ *
+ * The file starts with a fixed header holding a magic number, a format
+ * version and an FNV-1a checksum of the payload that follows. All values
+ * are stored little-endian so images can be moved between machines.
+ */
+
+/* version 2 added the OPEN statement, 3 the generator state in checkpoints */
+#define IMAGE_VERSION 3
+
+/* the number of static analyzer counts stored in an image */
+#define PARSE_COUNTERS 20
+
+/**
+ * Serializes the current program into a malloced buffer, header included.
+ *
+ * @param length Set to the length of the returned buffer.
+ * @return The image, or NULL if there is no program. Caller must free it.
+ */
+unsigned char *encode_image(size_t *length);
+
+/**
+ * Replaces the current program with the one held in an in-memory image.
+ * The lines are left un-chained, so call interpreter_post_parse after.
+ *
+ * @param data The image, header included.
+ * @param length Length of @p data in bytes.
+ * @return true if the image was valid and loaded.
+ */
+bool decode_image(const unsigned char *data, size_t length);
+
+/**
+ * Writes the current program to the named image file.
+ *
+ * @param filename The file to create or overwrite.
+ * @return true on success.
+ */
+bool save_image(const char *filename);
+
+/**
+ * Loads the named image file with a single read and decodes it.
+ *
+ * @param filename The image file to read.
+ * @return true on success.
+ */
+bool load_image(const char *filename);
+
+/**
+ * Writes a checkpoint of the running program: the program itself, every
+ * variable value, the runtime stack, the current statement, the print
+ * format, the cursor column and the RNG state. The file is written under
+ * a temporary name and renamed into place, so a crash part way through
+ * leaves the previous checkpoint intact.
+ *
+ * Nothing is saved while a file channel is open, as the files themselves
+ * can't be put back the way they were, nor with --plot-file or --adc-file,
+ * for the same reason. A warning is printed the first time.
+ *
+ * @param filename The checkpoint file to replace.
+ * @return true on success.
+ */
+bool save_snapshot(const char *filename);
+
+/**
+ * Restores a checkpoint written by save_snapshot. The program is loaded and
+ * chained, and interpreter_run will continue from the saved statement.
+ *
+ * @param filename The checkpoint file to read.
+ * @return true on success.
+ */
+bool load_snapshot(const char *filename);
+
+/**
+ * Copies the static analyzer counts into @p values, which must hold
+ * PARSE_COUNTERS entries.
+ */
+void get_parse_counters(int *values);
+
+/**
+ * Zeros the static analyzer counts.
+ */
+void clear_parse_counters(void);
+
+/**
+ * Merges @p values into the static analyzer counts, the same way that
+ * parsing another file would.
+ */
+void add_parse_counters(const int *values);
+
+/**
+ * Checks whether a file starts with the image magic number.
+ *
+ * @param filename The file to examine.
+ * @return true if it looks like an image.
+ */
+bool is_image_file(const char *filename);
+
+#endif /* __IMAGE_H__ */
@@ -23,6 +23,7 @@
 #if !defined(WIN32) && !defined(_WIN32)
 static struct termios original_terminal_attrs;
 static bool terminal_raw_mode = false;
+static int stdin_is_terminal = -1;   // checked on the first read, -i may have replaced stdin
 #endif
 
 /*
@@ -93,7 +94,9 @@ int raw_mode_input_line(char *buffer, size_t size)
   return 0;
 #else
   /* If stdin is not a TTY, use fgets instead of raw mode */
-  if (!isatty(STDIN_FILENO)) {
+  if (stdin_is_terminal == -1)
+    stdin_is_terminal = isatty(STDIN_FILENO);
+  if (!stdin_is_terminal) {
     char *result = fgets(buffer, size, stdin);
     if (result == buffer) {
       /* Strip newline if present */
@@ -0,0 +1,1155 @@
+/* native code generation (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include <stdint.h>
+#include <math.h>
+
+#include "jit.h"
+#include "tier.h"
+#include "memstat.h"
+#include "parse.h"
+#include "fmath.h"
+
+/* Apple's AArch64 machines only run code made in memory mapped with
+   MAP_JIT, so they are left to the stack machine */
+#if !defined(WIN32) && !defined(_WIN32)
+#if defined(__x86_64__)
+#define JIT_X86_64
+#elif defined(__aarch64__) && !defined(__APPLE__)
+#define JIT_AARCH64
+#endif
+#endif
+
+#if defined(JIT_X86_64) || defined(JIT_AARCH64)
+#define JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+/* command line settings */
+bool use_jit = true;
+
+/* statistics */
+int expressions_native = 0;
+int loops_native = 0;
+long long native_iterations = 0;
+long jit_code_size = 0;
+
+#ifdef JIT_SUPPORTED
+
+/* the stack machine's stack is kept in this many registers */
+#define SLOTS 14
+
+/* the frame: the slots are saved at the bottom around calls, then the
+   subscript being stored into, and the end and step of a loop */
+#define FRAME 144
+#define FRAME_SUBSCRIPT 112
+#define FRAME_END 120
+#define FRAME_STEP 128
+
+/* executable memory is handed out from blocks of this size */
+#define ARENA_SIZE 65536
+
+static unsigned char *arena = NULL;
+static size_t arena_used = 0, arena_size = 0;
+
+static const char division_message[] = "Division by zero";
+
+/* machine code as it is being put together */
+typedef struct {
+  unsigned char *bytes;
+  size_t length, capacity;
+  bool failed;                // something could not be compiled
+} assembler_t;
+
+static void put_byte(assembler_t *a, int byte)
+{
+  if (a->length == a->capacity) {
+    a->capacity = a->capacity ? a->capacity * 2 : 256;
+    a->bytes = realloc(a->bytes, a->capacity);
+  }
+  a->bytes[a->length++] = (unsigned char)byte;
+}
+
+static void put_int32(assembler_t *a, int32_t value)
+{
+  for (int i = 0; i < 4; i++)
+    put_byte(a, ((uint32_t)value >> (8 * i)) & 0xFF);
+}
+
+/* the C library entry point for a function, or its approximation with
+   --math=fast, or NULL if it is done inline or through pure_function */
+static void *library_function(int function)
+{
+  switch (function) {
+    case FATN: return math_mode == MATH_FAST ? (void *)fast_atn : (void *)atan;
+    case FCOS: return math_mode == MATH_FAST ? (void *)fast_cos : (void *)cos;
+    case FEXP: return math_mode == MATH_FAST ? (void *)fast_exp : (void *)exp;
+    case FITR: return (void *)floor;
+    case FLOG: return math_mode == MATH_FAST ? (void *)fast_log : (void *)log;
+    case FSIN: return math_mode == MATH_FAST ? (void *)fast_sin : (void *)sin;
+    default: return NULL;
+  }
+} /* library_function */
+
+/* each processor's code below provides prologue, epilogue,
+   compile_instruction, return_first_slot, compile_set and compile_loop,
+   which use these to do the parts that are the same on both */
+static bool compile_root(assembler_t *a, expression_t *root);
+static int compile_body(assembler_t *a, list_t *head, list_t *tail);
+
+#ifdef JIT_X86_64
+
+/* the registers, by their number in the instruction encoding */
+#define RAX 0
+#define RBX 3
+#define RSP 4
+#define RDI 7
+#define R12 12
+#define R13 13
+
+/* values on the stack machine's stack live in xmm2 and up, xmm0 and xmm1
+   are left for passing parameters and scratch */
+#define XMM(slot) ((slot) + 2)
+
+/* condition codes for jumps */
+#define JAE 0x3
+#define JNE 0x5
+#define JA 0x7
+#define JP 0xA
+#define JLE 0xE
+#define JMP -1
+
+/* SSE2 instructions, with the prefix and second opcode byte */
+#define MOVSD_LOAD 0xF2, 0x10
+#define MOVSD_STORE 0xF2, 0x11
+#define MOVAPD 0x66, 0x28
+#define CVTSI2SD 0xF2, 0x2A
+#define UCOMISD 0x66, 0x2E
+#define SQRTSD 0xF2, 0x51
+#define XORPD 0x66, 0x57
+#define ADDSD 0xF2, 0x58
+#define MULSD 0xF2, 0x59
+#define SUBSD 0xF2, 0x5C
+#define DIVSD 0xF2, 0x5E
+#define MOVQ_TO_XMM 0x66, 0x6E
+#define MOVQ_FROM_XMM 0x66, 0x7E
+
+static void put_int64(assembler_t *a, uint64_t value)
+{
+  for (int i = 0; i < 8; i++)
+    put_byte(a, (value >> (8 * i)) & 0xFF);
+}
+
+/* the REX prefix, if one is needed, for a register in the reg field and
+   another in the r/m field */
+static void rex(assembler_t *a, bool wide, int reg, int rm)
+{
+  int prefix = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+  if (prefix != 0x40)
+    put_byte(a, prefix);
+}
+
+static void modrm_register(assembler_t *a, int reg, int rm)
+{
+  put_byte(a, 0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+/* reg and [base + offset], which always uses a 32-bit offset */
+static void modrm_memory(assembler_t *a, int reg, int base, int32_t offset)
+{
+  put_byte(a, 0x80 | (reg & 7) << 3 | (base & 7));
+  if ((base & 7) == RSP)
+    put_byte(a, 0x24);
+  put_int32(a, offset);
+}
+
+/* an SSE instruction between two registers, wide for the movq forms */
+static void sse_register(assembler_t *a, int prefix, int opcode, int reg, int rm, bool wide)
+{
+  put_byte(a, prefix);
+  rex(a, wide, reg, rm);
+  put_byte(a, 0x0F);
+  put_byte(a, opcode);
+  modrm_register(a, reg, rm);
+}
+
+/* an SSE instruction between a register and [base + offset] */
+static void sse_memory(assembler_t *a, int prefix, int opcode, int reg, int base, int32_t offset)
+{
+  put_byte(a, prefix);
+  rex(a, false, reg, base);
+  put_byte(a, 0x0F);
+  put_byte(a, opcode);
+  modrm_memory(a, reg, base, offset);
+}
+
+/* mov reg, value */
+static void load_immediate(assembler_t *a, int reg, uint64_t value)
+{
+  rex(a, true, 0, reg);
+  put_byte(a, 0xB8 + (reg & 7));
+  put_int64(a, value);
+}
+
+static void load_pointer(assembler_t *a, int reg, const void *pointer)
+{
+  load_immediate(a, reg, (uint64_t)(uintptr_t)pointer);
+}
+
+/* puts a constant in an xmm register, by way of rax */
+static void load_constant(assembler_t *a, int xmm, double value)
+{
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  load_immediate(a, RAX, bits);
+  sse_register(a, MOVQ_TO_XMM, xmm, RAX, true);
+}
+
+/* calls a C function through rax */
+static void call(assembler_t *a, void *function)
+{
+  load_pointer(a, RAX, function);
+  put_byte(a, 0xFF);
+  put_byte(a, 0xD0);
+}
+
+/* emits a jump, or a conditional one, and returns where its offset goes
+   so it can be pointed at its target later with land */
+static size_t jump(assembler_t *a, int condition)
+{
+  if (condition == JMP)
+    put_byte(a, 0xE9);
+  else {
+    put_byte(a, 0x0F);
+    put_byte(a, 0x80 | condition);
+  }
+  put_int32(a, 0);
+  return a->length - 4;
+}
+
+/* points the jump at the next instruction */
+static void land(assembler_t *a, size_t offset)
+{
+  int32_t distance = (int32_t)(a->length - (offset + 4));
+  memcpy(&a->bytes[offset], &distance, sizeof(distance));
+}
+
+/* emits a jump back to an instruction that has already been emitted */
+static void jump_back(assembler_t *a, int condition, size_t target)
+{
+  size_t offset = jump(a, condition);
+  int32_t distance = (int32_t)target - (int32_t)(offset + 4);
+  memcpy(&a->bytes[offset], &distance, sizeof(distance));
+}
+
+/* every xmm register belongs to the caller, so the slots in use have to be
+   saved in the frame around a call into C */
+static void spill(assembler_t *a, int slots)
+{
+  for (int i = 0; i < slots; i++)
+    sse_memory(a, MOVSD_STORE, XMM(i), RSP, 8 * i);
+}
+
+static void reload(assembler_t *a, int slots)
+{
+  for (int i = 0; i < slots; i++)
+    sse_memory(a, MOVSD_LOAD, XMM(i), RSP, 8 * i);
+}
+
+/* saves the registers a function has to keep and makes the frame, which
+   leaves the stack aligned for calls */
+static void prologue(assembler_t *a)
+{
+  put_byte(a, 0x53);                      // push rbx
+  put_byte(a, 0x41); put_byte(a, 0x54);   // push r12
+  put_byte(a, 0x41); put_byte(a, 0x55);   // push r13
+  put_byte(a, 0x48); put_byte(a, 0x81); put_byte(a, 0xEC);
+  put_int32(a, FRAME);                    // sub rsp, FRAME
+}
+
+static void epilogue(assembler_t *a)
+{
+  put_byte(a, 0x48); put_byte(a, 0x81); put_byte(a, 0xC4);
+  put_int32(a, FRAME);                    // add rsp, FRAME
+  put_byte(a, 0x41); put_byte(a, 0x5D);   // pop r13
+  put_byte(a, 0x41); put_byte(a, 0x5C);   // pop r12
+  put_byte(a, 0x5B);                      // pop rbx
+  put_byte(a, 0xC3);                      // ret
+}
+
+/* emits the code for one instruction of the stack machine, see run_code,
+   with the stack that far in *depth */
+static void compile_instruction(assembler_t *a, const instruction_t *instruction, int *depth)
+{
+  int top = *depth - 1;
+
+  switch (instruction->op) {
+    case CODE_NUMBER:
+      if (*depth == SLOTS)
+        break;
+      load_constant(a, XMM(*depth), instruction->operand.number);
+      (*depth)++;
+      return;
+
+    case CODE_VARIABLE:
+    {
+      if (*depth == SLOTS)
+        break;
+      // the value is read straight from where it lives
+      variable_storage_t *storage = variable_storage(instruction->operand.variable);
+      load_pointer(a, RAX, &storage->value->number);
+      sse_memory(a, MOVSD_LOAD, XMM(*depth), RAX, 0);
+      (*depth)++;
+      return;
+    }
+
+    case CODE_ELEMENT:
+    {
+      // element_slot checks the bounds and reports the error
+      variable_storage_t *storage = variable_storage(instruction->operand.variable);
+      spill(a, top);
+      sse_register(a, MOVAPD, 0, XMM(top), false);
+      load_pointer(a, RDI, storage);
+      put_byte(a, 0x31); put_byte(a, 0xF6);   // xor esi, esi
+      call(a, (void *)element_slot);
+      reload(a, top);
+      sse_memory(a, MOVSD_LOAD, XMM(top), RAX, 0);
+      return;
+    }
+
+    case CODE_NEGATE:
+      // flip the sign bit, which is what the C compiler does for -x
+      sse_register(a, MOVQ_FROM_XMM, XMM(top), RAX, true);
+      put_byte(a, 0x48); put_byte(a, 0x0F); put_byte(a, 0xBA); put_byte(a, 0xF8); put_byte(a, 63);  // btc rax, 63
+      sse_register(a, MOVQ_TO_XMM, XMM(top), RAX, true);
+      return;
+
+    case CODE_ADD:
+      sse_register(a, ADDSD, XMM(top - 1), XMM(top), false);
+      (*depth)--;
+      return;
+    case CODE_SUBTRACT:
+      sse_register(a, SUBSD, XMM(top - 1), XMM(top), false);
+      (*depth)--;
+      return;
+    case CODE_MULTIPLY:
+      sse_register(a, MULSD, XMM(top - 1), XMM(top), false);
+      (*depth)--;
+      return;
+
+    case CODE_DIVIDE:
+    {
+      // report a zero divisor and then divide anyway, as the interpreter does
+      sse_register(a, XORPD, 0, 0, false);
+      sse_register(a, UCOMISD, XMM(top), 0, false);
+      size_t nonzero = jump(a, JNE);
+      size_t unordered = jump(a, JP);
+      spill(a, *depth);
+      load_pointer(a, RDI, division_message);
+      call(a, (void *)focal_error);
+      reload(a, *depth);
+      land(a, nonzero);
+      land(a, unordered);
+      sse_register(a, DIVSD, XMM(top - 1), XMM(top), false);
+      (*depth)--;
+      return;
+    }
+
+    case CODE_POWER:
+    {
+      // squares are multiplied, everything else goes to pow
+      load_constant(a, 0, 2.0);
+      sse_register(a, UCOMISD, XMM(top), 0, false);
+      size_t not_two = jump(a, JNE);
+      size_t unordered = jump(a, JP);
+      sse_register(a, MULSD, XMM(top - 1), XMM(top - 1), false);
+      size_t done = jump(a, JMP);
+      land(a, not_two);
+      land(a, unordered);
+      spill(a, top - 1);
+      sse_register(a, MOVAPD, 0, XMM(top - 1), false);
+      sse_register(a, MOVAPD, 1, XMM(top), false);
+      call(a, (void *)pow);
+      sse_register(a, MOVAPD, XMM(top - 1), 0, false);
+      reload(a, top - 1);
+      land(a, done);
+      (*depth)--;
+      return;
+    }
+
+    case CODE_EQUAL:
+      // -1 if they are equal, which a NaN never is, otherwise 0
+      sse_register(a, UCOMISD, XMM(top - 1), XMM(top), false);
+      put_byte(a, 0x0F); put_byte(a, 0x9B); put_byte(a, 0xC0);   // setnp al
+      put_byte(a, 0x0F); put_byte(a, 0x94); put_byte(a, 0xC1);   // sete cl
+      put_byte(a, 0x20); put_byte(a, 0xC8);                      // and al, cl
+      put_byte(a, 0x0F); put_byte(a, 0xB6); put_byte(a, 0xC0);   // movzx eax, al
+      put_byte(a, 0xF7); put_byte(a, 0xD8);                      // neg eax
+      sse_register(a, CVTSI2SD, XMM(top - 1), RAX, false);
+      (*depth)--;
+      return;
+
+    case CODE_FUNCTION:
+    {
+      int function = instruction->operand.function;
+      if (function == FABS) {
+        sse_register(a, MOVQ_FROM_XMM, XMM(top), RAX, true);
+        put_byte(a, 0x48); put_byte(a, 0x0F); put_byte(a, 0xBA); put_byte(a, 0xF0); put_byte(a, 63);  // btr rax, 63
+        sse_register(a, MOVQ_TO_XMM, XMM(top), RAX, true);
+        return;
+      }
+      // the instruction is correctly rounded, just like the library
+      if (function == FSQT) {
+        sse_register(a, SQRTSD, XMM(top), XMM(top), false);
+        return;
+      }
+      spill(a, top);
+      sse_register(a, MOVAPD, 0, XMM(top), false);
+      if (library_function(function) != NULL)
+        call(a, library_function(function));
+      else {
+        put_byte(a, 0xBF);
+        put_int32(a, function);               // mov edi, function
+        call(a, (void *)pure_function);
+      }
+      sse_register(a, MOVAPD, XMM(top), 0, false);
+      reload(a, top);
+      return;
+    }
+
+    case CODE_TREE:
+      if (*depth == SLOTS)
+        break;
+      spill(a, *depth);
+      load_pointer(a, RDI, instruction->operand.expression);
+      call(a, (void *)expression_value);
+      sse_register(a, MOVAPD, XMM(*depth), 0, false);
+      reload(a, *depth);
+      (*depth)++;
+      return;
+  }
+
+  // the stack is deeper than there are registers for
+  a->failed = true;
+} /* compile_instruction */
+
+/* moves the value of an expression to where a double is returned */
+static void return_first_slot(assembler_t *a)
+{
+  sse_register(a, MOVAPD, 0, XMM(0), false);
+} /* return_first_slot */
+
+/* emits one SET, in the order the interpreter does it: the subscript and
+   its bounds check, the value, and only then the element slot */
+static void compile_set(assembler_t *a, statement_t *statement, int *expressions)
+{
+  variable_t *target = statement->parms.set.variable;
+  variable_storage_t *storage = variable_storage(target);
+
+  if (target->subscripts != NULL) {
+    *expressions += compile_root(a, target->subscripts->data);
+    sse_register(a, MOVAPD, 0, XMM(0), false);
+    call(a, (void *)checked_subscript);
+    sse_memory(a, MOVSD_STORE, 0, RSP, FRAME_SUBSCRIPT);
+  }
+
+  *expressions += compile_root(a, statement->parms.set.expression);
+
+  if (target->subscripts != NULL) {
+    spill(a, 1);
+    sse_memory(a, MOVSD_LOAD, 0, RSP, FRAME_SUBSCRIPT);
+    load_pointer(a, RDI, storage);
+    put_byte(a, 0xBE);
+    put_int32(a, 1);                                  // mov esi, 1
+    call(a, (void *)element_slot);
+    reload(a, 1);
+  } else
+    load_pointer(a, RAX, &storage->value->number);
+  sse_memory(a, MOVSD_STORE, XMM(0), RAX, 0);
+} /* compile_set */
+
+/* emits a native_loop_t for the statements after a FOR, and returns the
+   number of compiled expressions among them */
+static int compile_loop(assembler_t *a, list_t *head, list_t *tail, int statements)
+{
+  prologue(a);
+  put_byte(a, 0x48); put_byte(a, 0x89); put_byte(a, 0xFB);   // mov rbx, rdi
+  put_byte(a, 0x49); put_byte(a, 0x89); put_byte(a, 0xF4);   // mov r12, rsi
+  put_byte(a, 0x45); put_byte(a, 0x31); put_byte(a, 0xED);   // xor r13d, r13d
+  sse_memory(a, MOVSD_STORE, 0, RSP, FRAME_END);
+  sse_memory(a, MOVSD_STORE, 1, RSP, FRAME_STEP);
+
+  // each time round uses up the statements from the countdown first, and
+  // stops while there is still one left for the run loop to take
+  size_t top = a->length;
+  rex(a, true, RAX, R12);
+  put_byte(a, 0x8B);
+  modrm_memory(a, RAX, R12, 0);                     // mov rax, [r12]
+  put_byte(a, 0x48); put_byte(a, 0x3D);
+  put_int32(a, statements);                         // cmp rax, statements
+  size_t out_of_countdown = jump(a, JLE);
+  rex(a, true, 5, R12);
+  put_byte(a, 0x81);
+  modrm_memory(a, 5, R12, 0);
+  put_int32(a, statements);                         // sub qword [r12], statements
+
+  int expressions = compile_body(a, head, tail);
+  put_byte(a, 0x49); put_byte(a, 0xFF); put_byte(a, 0xC5);   // inc r13
+
+  // the NEXT, as next_iteration does it, reading the index back in case
+  // the body changed it
+  sse_memory(a, MOVSD_LOAD, 0, RBX, 0);
+  sse_memory(a, ADDSD, 0, RSP, FRAME_STEP);
+  sse_memory(a, MOVSD_STORE, 0, RBX, 0);
+  sse_memory(a, MOVSD_LOAD, 1, RSP, FRAME_STEP);
+  sse_memory(a, MOVSD_LOAD, 4, RSP, FRAME_END);
+  sse_register(a, XORPD, 3, 3, false);
+  sse_register(a, UCOMISD, 1, 3, false);
+  size_t upward = jump(a, JA);
+  sse_register(a, UCOMISD, 3, 1, false);
+  size_t downward = jump(a, JA);
+  size_t finished = jump(a, JMP);
+  land(a, upward);
+  sse_register(a, UCOMISD, 4, 0, false);
+  jump_back(a, JAE, top);
+  size_t finished_upward = jump(a, JMP);
+  land(a, downward);
+  sse_register(a, UCOMISD, 0, 4, false);
+  jump_back(a, JAE, top);
+
+  land(a, finished);
+  land(a, finished_upward);
+  put_byte(a, 0x4C); put_byte(a, 0x89); put_byte(a, 0xE8);   // mov rax, r13
+  put_byte(a, 0x48); put_byte(a, 0xF7); put_byte(a, 0xD8);   // neg rax
+  size_t done = jump(a, JMP);
+  land(a, out_of_countdown);
+  put_byte(a, 0x4C); put_byte(a, 0x89); put_byte(a, 0xE8);   // mov rax, r13
+  land(a, done);
+  epilogue(a);
+  return expressions;
+} /* compile_loop */
+
+#else /* JIT_AARCH64 */
+
+/* the registers, by their number in the instruction encoding. 31 is the
+   stack pointer in loads, stores and adds, and the zero register in the
+   rest */
+#define X0 0
+#define X1 1
+#define X9 9
+#define X10 10
+#define X16 16
+#define X19 19
+#define X20 20
+#define X21 21
+#define SP 31
+#define XZR 31
+
+/* values on the stack machine's stack live in d16 and up, d0 to d7 are
+   left for passing parameters and scratch, and d8 to d15 would have to be
+   saved for the caller, so they aren't used */
+#define D(slot) ((slot) + 16)
+
+/* condition codes for branches, after fcmp MI is less than and the rest
+   are false when either side is a NaN */
+#define EQ 0x0
+#define NE 0x1
+#define MI 0x4
+#define GE 0xA
+#define GT 0xC
+#define LE 0xD
+#define ALWAYS -1
+
+/* floating point instructions on doubles, d = n op m */
+#define FMUL_D 0x1E600800
+#define FDIV_D 0x1E601800
+#define FADD_D 0x1E602800
+#define FSUB_D 0x1E603800
+
+/* ... and d = op n */
+#define FMOV_D 0x1E604000
+#define FABS_D 0x1E60C000
+#define FNEG_D 0x1E614000
+#define FSQRT_D 0x1E61C000
+
+/* loads and stores at [base + offset], for a multiple of 8 up to 32760 */
+#define LDR_D 0xFD400000
+#define STR_D 0xFD000000
+#define LDR_X 0xF9400000
+#define STR_X 0xF9000000
+
+/* every instruction is a single word */
+static void emit(assembler_t *a, uint32_t instruction)
+{
+  put_int32(a, (int32_t)instruction);
+}
+
+static void fp_binary(assembler_t *a, uint32_t opcode, int d, int n, int m)
+{
+  emit(a, opcode | (uint32_t)m << 16 | (uint32_t)n << 5 | (uint32_t)d);
+}
+
+static void fp_unary(assembler_t *a, uint32_t opcode, int d, int n)
+{
+  emit(a, opcode | (uint32_t)n << 5 | (uint32_t)d);
+}
+
+/* fcmp n, m */
+static void fp_compare(assembler_t *a, int n, int m)
+{
+  emit(a, 0x1E602000 | (uint32_t)m << 16 | (uint32_t)n << 5);
+}
+
+/* fcmp n, #0.0 */
+static void fp_compare_zero(assembler_t *a, int n)
+{
+  emit(a, 0x1E602008 | (uint32_t)n << 5);
+}
+
+static void load_store(assembler_t *a, uint32_t opcode, int reg, int base, int offset)
+{
+  emit(a, opcode | (uint32_t)(offset / 8) << 10 | (uint32_t)base << 5 | (uint32_t)reg);
+}
+
+/* mov reg, value, with a movz and a movk for each other halfword that
+   isn't zero */
+static void load_immediate(assembler_t *a, int reg, uint64_t value)
+{
+  emit(a, 0xD2800000 | (uint32_t)(value & 0xFFFF) << 5 | (uint32_t)reg);
+  for (int shift = 16; shift < 64; shift += 16)
+    if ((value >> shift) & 0xFFFF)
+      emit(a, 0xF2800000 | (uint32_t)(shift / 16) << 21 | (uint32_t)((value >> shift) & 0xFFFF) << 5 | (uint32_t)reg);
+}
+
+static void load_pointer(assembler_t *a, int reg, const void *pointer)
+{
+  load_immediate(a, reg, (uint64_t)(uintptr_t)pointer);
+}
+
+/* puts a constant in a d register, by way of x9 */
+static void load_constant(assembler_t *a, int d, double value)
+{
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  load_immediate(a, X9, bits);
+  emit(a, 0x9E670000 | X9 << 5 | (uint32_t)d);      // fmov d, x9
+}
+
+/* calls a C function through x16, which is the register the linker uses
+   for the same thing */
+static void call(assembler_t *a, void *function)
+{
+  load_pointer(a, X16, function);
+  emit(a, 0xD63F0000 | X16 << 5);                   // blr x16
+}
+
+/* emits a branch, or a conditional one, and returns where it is so it can
+   be pointed at its target later with land */
+static size_t jump(assembler_t *a, int condition)
+{
+  emit(a, condition == ALWAYS ? 0x14000000 : 0x54000000 | (uint32_t)condition);
+  return a->length - 4;
+}
+
+/* fills in the distance from the branch at offset to target, in words */
+static void aim(assembler_t *a, size_t offset, size_t target)
+{
+  uint32_t instruction;
+  memcpy(&instruction, &a->bytes[offset], sizeof(instruction));
+  int32_t distance = ((int32_t)target - (int32_t)offset) / 4;
+  if (instruction == 0x14000000)
+    instruction |= (uint32_t)distance & 0x3FFFFFF;
+  else
+    instruction |= ((uint32_t)distance & 0x7FFFF) << 5;
+  memcpy(&a->bytes[offset], &instruction, sizeof(instruction));
+}
+
+/* points the branch at the next instruction */
+static void land(assembler_t *a, size_t offset)
+{
+  aim(a, offset, a->length);
+}
+
+/* emits a branch back to an instruction that has already been emitted */
+static void jump_back(assembler_t *a, int condition, size_t target)
+{
+  aim(a, jump(a, condition), target);
+}
+
+/* d16 and up belong to the caller, so the slots in use have to be saved
+   in the frame around a call into C */
+static void spill(assembler_t *a, int slots)
+{
+  for (int i = 0; i < slots; i++)
+    load_store(a, STR_D, D(i), SP, 8 * i);
+}
+
+static void reload(assembler_t *a, int slots)
+{
+  for (int i = 0; i < slots; i++)
+    load_store(a, LDR_D, D(i), SP, 8 * i);
+}
+
+/* saves the frame pointer, the return address and the registers a loop
+   keeps across calls, and makes the frame, which leaves sp aligned */
+static void prologue(assembler_t *a)
+{
+  emit(a, 0xA9BF7BFD);                    // stp x29, x30, [sp, #-16]!
+  emit(a, 0x910003FD);                    // mov x29, sp
+  emit(a, 0xA9BF53F3);                    // stp x19, x20, [sp, #-16]!
+  emit(a, 0xA9BF5BF5);                    // stp x21, x22, [sp, #-16]!
+  emit(a, 0xD10003FF | FRAME << 10);      // sub sp, sp, FRAME
+}
+
+static void epilogue(assembler_t *a)
+{
+  emit(a, 0x910003FF | FRAME << 10);      // add sp, sp, FRAME
+  emit(a, 0xA8C15BF5);                    // ldp x21, x22, [sp], #16
+  emit(a, 0xA8C153F3);                    // ldp x19, x20, [sp], #16
+  emit(a, 0xA8C17BFD);                    // ldp x29, x30, [sp], #16
+  emit(a, 0xD65F03C0);                    // ret
+}
+
+/* emits the code for one instruction of the stack machine, see run_code,
+   with the stack that far in *depth */
+static void compile_instruction(assembler_t *a, const instruction_t *instruction, int *depth)
+{
+  int top = *depth - 1;
+
+  switch (instruction->op) {
+    case CODE_NUMBER:
+      if (*depth == SLOTS)
+        break;
+      load_constant(a, D(*depth), instruction->operand.number);
+      (*depth)++;
+      return;
+
+    case CODE_VARIABLE:
+    {
+      if (*depth == SLOTS)
+        break;
+      // the value is read straight from where it lives
+      variable_storage_t *storage = variable_storage(instruction->operand.variable);
+      load_pointer(a, X9, &storage->value->number);
+      load_store(a, LDR_D, D(*depth), X9, 0);
+      (*depth)++;
+      return;
+    }
+
+    case CODE_ELEMENT:
+    {
+      // element_slot checks the bounds and reports the error
+      variable_storage_t *storage = variable_storage(instruction->operand.variable);
+      spill(a, top);
+      fp_unary(a, FMOV_D, 0, D(top));
+      load_pointer(a, X0, storage);
+      emit(a, 0x52800000 | X1);                     // mov w1, 0
+      call(a, (void *)element_slot);
+      reload(a, top);
+      load_store(a, LDR_D, D(top), X0, 0);
+      return;
+    }
+
+    case CODE_NEGATE:
+      // fneg only flips the sign bit, which is what the C compiler does for -x
+      fp_unary(a, FNEG_D, D(top), D(top));
+      return;
+
+    case CODE_ADD:
+      fp_binary(a, FADD_D, D(top - 1), D(top - 1), D(top));
+      (*depth)--;
+      return;
+    case CODE_SUBTRACT:
+      fp_binary(a, FSUB_D, D(top - 1), D(top - 1), D(top));
+      (*depth)--;
+      return;
+    case CODE_MULTIPLY:
+      fp_binary(a, FMUL_D, D(top - 1), D(top - 1), D(top));
+      (*depth)--;
+      return;
+
+    case CODE_DIVIDE:
+    {
+      // report a zero divisor and then divide anyway, as the interpreter does
+      fp_compare_zero(a, D(top));
+      size_t nonzero = jump(a, NE);
+      spill(a, *depth);
+      load_pointer(a, X0, division_message);
+      call(a, (void *)focal_error);
+      reload(a, *depth);
+      land(a, nonzero);
+      fp_binary(a, FDIV_D, D(top - 1), D(top - 1), D(top));
+      (*depth)--;
+      return;
+    }
+
+    case CODE_POWER:
+    {
+      // squares are multiplied, everything else goes to pow
+      load_constant(a, 0, 2.0);
+      fp_compare(a, D(top), 0);
+      size_t not_two = jump(a, NE);
+      fp_binary(a, FMUL_D, D(top - 1), D(top - 1), D(top - 1));
+      size_t done = jump(a, ALWAYS);
+      land(a, not_two);
+      spill(a, top - 1);
+      fp_unary(a, FMOV_D, 0, D(top - 1));
+      fp_unary(a, FMOV_D, 1, D(top));
+      call(a, (void *)pow);
+      fp_unary(a, FMOV_D, D(top - 1), 0);
+      reload(a, top - 1);
+      land(a, done);
+      (*depth)--;
+      return;
+    }
+
+    case CODE_EQUAL:
+      // -1 if they are equal, which a NaN never is, otherwise 0
+      fp_compare(a, D(top - 1), D(top));
+      emit(a, 0x5A9F03E0 | NE << 12 | X9);          // csetm w9, eq
+      emit(a, 0x1E620000 | X9 << 5 | D(top - 1));   // scvtf d, w9
+      (*depth)--;
+      return;
+
+    case CODE_FUNCTION:
+    {
+      int function = instruction->operand.function;
+      if (function == FABS) {
+        fp_unary(a, FABS_D, D(top), D(top));
+        return;
+      }
+      // the instruction is correctly rounded, just like the library
+      if (function == FSQT) {
+        fp_unary(a, FSQRT_D, D(top), D(top));
+        return;
+      }
+      spill(a, top);
+      fp_unary(a, FMOV_D, 0, D(top));
+      if (library_function(function) != NULL)
+        call(a, library_function(function));
+      else {
+        load_immediate(a, X0, (uint64_t)function);
+        call(a, (void *)pure_function);
+      }
+      fp_unary(a, FMOV_D, D(top), 0);
+      reload(a, top);
+      return;
+    }
+
+    case CODE_TREE:
+      if (*depth == SLOTS)
+        break;
+      spill(a, *depth);
+      load_pointer(a, X0, instruction->operand.expression);
+      call(a, (void *)expression_value);
+      fp_unary(a, FMOV_D, D(*depth), 0);
+      reload(a, *depth);
+      (*depth)++;
+      return;
+  }
+
+  // the stack is deeper than there are registers for
+  a->failed = true;
+} /* compile_instruction */
+
+/* moves the value of an expression to where a double is returned */
+static void return_first_slot(assembler_t *a)
+{
+  fp_unary(a, FMOV_D, 0, D(0));
+} /* return_first_slot */
+
+/* emits one SET, in the order the interpreter does it: the subscript and
+   its bounds check, the value, and only then the element slot */
+static void compile_set(assembler_t *a, statement_t *statement, int *expressions)
+{
+  variable_t *target = statement->parms.set.variable;
+  variable_storage_t *storage = variable_storage(target);
+
+  if (target->subscripts != NULL) {
+    *expressions += compile_root(a, target->subscripts->data);
+    fp_unary(a, FMOV_D, 0, D(0));
+    call(a, (void *)checked_subscript);
+    load_store(a, STR_D, 0, SP, FRAME_SUBSCRIPT);
+  }
+
+  *expressions += compile_root(a, statement->parms.set.expression);
+
+  if (target->subscripts != NULL) {
+    spill(a, 1);
+    load_store(a, LDR_D, 0, SP, FRAME_SUBSCRIPT);
+    load_pointer(a, X0, storage);
+    emit(a, 0x52800000 | 1 << 5 | X1);              // mov w1, 1
+    call(a, (void *)element_slot);
+    reload(a, 1);
+  } else
+    load_pointer(a, X0, &storage->value->number);
+  load_store(a, STR_D, D(0), X0, 0);
+} /* compile_set */
+
+/* emits a native_loop_t for the statements after a FOR, and returns the
+   number of compiled expressions among them */
+static int compile_loop(assembler_t *a, list_t *head, list_t *tail, int statements)
+{
+  prologue(a);
+  emit(a, 0xAA0003E0 | X0 << 16 | X19);             // mov x19, x0
+  emit(a, 0xAA0003E0 | X1 << 16 | X20);             // mov x20, x1
+  emit(a, 0xAA0003E0 | XZR << 16 | X21);            // mov x21, xzr
+  load_store(a, STR_D, 0, SP, FRAME_END);
+  load_store(a, STR_D, 1, SP, FRAME_STEP);
+
+  // each time round uses up the statements from the countdown first, and
+  // stops while there is still one left for the run loop to take
+  size_t top = a->length;
+  load_store(a, LDR_X, X9, X20, 0);                 // ldr x9, [x20]
+  load_immediate(a, X10, (uint64_t)statements);
+  emit(a, 0xEB00001F | X10 << 16 | X9 << 5);        // cmp x9, x10
+  size_t out_of_countdown = jump(a, LE);
+  emit(a, 0xCB000000 | X10 << 16 | X9 << 5 | X9);   // sub x9, x9, x10
+  load_store(a, STR_X, X9, X20, 0);                 // str x9, [x20]
+
+  int expressions = compile_body(a, head, tail);
+  emit(a, 0x91000400 | X21 << 5 | X21);             // add x21, x21, 1
+
+  // the NEXT, as next_iteration does it, reading the index back in case
+  // the body changed it
+  load_store(a, LDR_D, 0, X19, 0);
+  load_store(a, LDR_D, 1, SP, FRAME_STEP);
+  fp_binary(a, FADD_D, 0, 0, 1);
+  load_store(a, STR_D, 0, X19, 0);
+  load_store(a, LDR_D, 4, SP, FRAME_END);
+  fp_compare_zero(a, 1);
+  size_t upward = jump(a, GT);
+  size_t downward = jump(a, MI);
+  size_t finished = jump(a, ALWAYS);
+  land(a, upward);
+  fp_compare(a, 4, 0);
+  jump_back(a, GE, top);
+  size_t finished_upward = jump(a, ALWAYS);
+  land(a, downward);
+  fp_compare(a, 0, 4);
+  jump_back(a, GE, top);
+
+  land(a, finished);
+  land(a, finished_upward);
+  emit(a, 0xCB0003E0 | X21 << 16 | X0);             // neg x0, x21
+  size_t done = jump(a, ALWAYS);
+  land(a, out_of_countdown);
+  emit(a, 0xAA0003E0 | X21 << 16 | X0);             // mov x0, x21
+  land(a, done);
+  epilogue(a);
+  return expressions;
+} /* compile_loop */
+
+#endif /* JIT_X86_64 */
+
+/* emits the code for an expression, leaving its value in the first slot */
+static void compile_code(assembler_t *a, const code_t *code)
+{
+  int depth = 0;
+  for (int i = 0; i < code->length && !a->failed; i++)
+    compile_instruction(a, &code->instructions[i], &depth);
+  if (depth != 1)
+    a->failed = true;
+} /* compile_code */
+
+/* true if the value of an expression can be worked out in machine code */
+static bool is_native(expression_t *root)
+{
+  expression_t *tree = root->optimized != NULL ? root->optimized : root;
+  return root->compiled != NULL || tree->type == number;
+} /* is_native */
+
+/* emits the code for a root expression that is_native accepts, returns
+   true if it was compiled rather than a constant */
+static bool compile_root(assembler_t *a, expression_t *root)
+{
+  if (root->compiled != NULL) {
+    compile_code(a, root->compiled);
+    return true;
+  }
+  // a constant is put in the first slot just as a compiled one would be
+  expression_t *tree = root->optimized != NULL ? root->optimized : root;
+  instruction_t constant = { CODE_NUMBER, { .number = tree->parms.number } };
+  int depth = 0;
+  compile_instruction(a, &constant, &depth);
+  return false;
+} /* compile_root */
+
+/* emits the SETs after a FOR up to the end of its line, and returns the
+   number of compiled expressions among them */
+static int compile_body(assembler_t *a, list_t *head, list_t *tail)
+{
+  int expressions = 0;
+  for (list_t *node = lst_next(head); !a->failed; node = lst_next(node)) {
+    if (node->data != NULL && ((statement_t *)node->data)->type == SET)
+      compile_set(a, node->data, &expressions);
+    if (node == tail)
+      break;
+  }
+  return expressions;
+} /* compile_body */
+
+/* copies finished code into executable memory and returns where it went */
+static void *place_code(const assembler_t *a)
+{
+  if (arena == NULL || arena_used + a->length > arena_size) {
+    size_t size = a->length > ARENA_SIZE ? (a->length + ARENA_SIZE - 1) / ARENA_SIZE * ARENA_SIZE : ARENA_SIZE;
+    void *block = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED)
+      return NULL;
+    arena = block;
+    arena_size = size;
+    arena_used = 0;
+  }
+  // never writable and executable at the same time
+  else if (mprotect(arena, arena_size, PROT_READ | PROT_WRITE) != 0)
+    return NULL;
+
+  void *entry = arena + arena_used;
+  memcpy(entry, a->bytes, a->length);
+  // AArch64 doesn't fetch instructions through the data cache, so it has to
+  // be told they changed, on x86-64 this does nothing
+  __builtin___clear_cache((char *)entry, (char *)entry + a->length);
+  arena_used += (a->length + 15) & ~(size_t)15;
+  jit_code_size += (long)a->length;
+  if (mprotect(arena, arena_size, PROT_READ | PROT_EXEC) != 0) {
+    // leave it alone rather than risk running half-made code
+    arena = NULL;
+    return NULL;
+  }
+  return entry;
+} /* place_code */
+
+/* returns the native_t for something that is about to be built, or NULL if
+   it has been built too many times */
+static native_t *start_build(native_t **native, long generation)
+{
+  if (*native == NULL)
+    *native = memory_calloc(MEMORY_AST, sizeof(**native));
+  (*native)->entry = NULL;
+  (*native)->generation = generation;
+  if ((*native)->builds >= JIT_MAX_BUILDS)
+    return NULL;
+  (*native)->builds++;
+  return *native;
+} /* start_build */
+
+native_expression_t jit_expression(code_t *code, long generation)
+{
+  if (code->native != NULL && code->native->generation == generation)
+    return (native_expression_t)code->native->entry;
+  if (!use_jit)
+    return NULL;
+
+  native_t *native = start_build(&code->native, generation);
+  if (native == NULL)
+    return NULL;
+
+  assembler_t a = { NULL, 0, 0, false };
+  prologue(&a);
+  compile_code(&a, code);
+  return_first_slot(&a);
+  epilogue(&a);
+
+  if (!a.failed)
+    native->entry = place_code(&a);
+  if (native->entry != NULL && native->builds == 1)
+    expressions_native++;
+  free(a.bytes);
+  return (native_expression_t)native->entry;
+} /* jit_expression */
+
+/* true if the statements after the FOR up to the end of its line can all
+   be done in machine code, and counts them */
+static bool loop_is_native(list_t *head, list_t *tail, int *statements)
+{
+  *statements = 0;
+  for (list_t *node = lst_next(head); node != NULL; node = lst_next(node)) {
+    statement_t *statement = node->data;
+    // an empty statement doesn't finish the line the way the others do, so
+    // a loop that has one is left to the interpreter
+    if (statement == NULL)
+      return false;
+    if (statement->type == SET) {
+      variable_t *target = statement->parms.set.variable;
+      if (!is_native(statement->parms.set.expression))
+        return false;
+      if (target->subscripts != NULL && (lst_next(target->subscripts) != NULL || !is_native(target->subscripts->data)))
+        return false;
+    }
+    else if (statement->type != COMMENT)
+      return false;
+    (*statements)++;
+    if (node == tail)
+      return true;
+  }
+  return false;
+} /* loop_is_native */
+
+native_loop_t jit_loop(statement_t *statement, list_t *head, list_t *tail, long generation)
+{
+  native_t *loop = statement->parms._for.native;
+  if (loop != NULL && loop->generation == generation)
+    return (native_loop_t)loop->entry;
+
+  if (!use_jit)
+    return NULL;
+
+  int statements;
+  loop = start_build(&statement->parms._for.native, generation);
+  if (loop == NULL || !loop_is_native(head, tail, &statements))
+    return NULL;
+
+  assembler_t a = { NULL, 0, 0, false };
+  int expressions = compile_loop(&a, head, tail, statements);
+
+  if (!a.failed)
+    loop->entry = place_code(&a);
+  if (loop->entry != NULL) {
+    loop->statements = statements;
+    loop->expressions = expressions;
+    if (loop->builds == 1)
+      loops_native++;
+  }
+  free(a.bytes);
+  return (native_loop_t)loop->entry;
+} /* jit_loop */
+
+#else
+
+/* there's no code generator for this processor, so everything stays on
+   the stack machine */
+native_expression_t jit_expression(code_t *code, long generation)
+{
+  (void)code;
+  (void)generation;
+  return NULL;
+} /* jit_expression */
+
+native_loop_t jit_loop(statement_t *statement, list_t *head, list_t *tail, long generation)
+{
+  (void)statement;
+  (void)head;
+  (void)tail;
+  (void)generation;
+  return NULL;
+} /* jit_loop */
+
+#endif
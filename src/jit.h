@@ -0,0 +1,112 @@
+/* native code generation (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __JIT_H__
+#define __JIT_H__
+
+#include "stdhdr.h"
+#include "retrofocal.h"
+
+/**
+ * @file jit.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief Turns compiled expressions and loops into machine code.
+ *
+ * This is the last tier. The first time an expression that tier.c has
+ * compiled is run, its instructions are translated into x86-64 or AArch64
+ * machine code in memory that is mapped executable, and from then on that is
+ * called in place of the stack machine. Variables are read and written
+ * at the addresses of their storage, which are looked up when the code
+ * is made, and the functions call straight into the C library, so the
+ * results are the same as the interpreter's down to the last bit.
+ *
+ * A FOR whose line holds nothing after it but SETs and comments is also
+ * turned into a loop of machine code, which does the stores and the
+ * NEXT itself and only comes back to the interpreter when the loop is
+ * done or the checkpoint and limit countdown runs out. Anything else
+ * on the line, like TYPE, ASK or DO, leaves it to the interpreter.
+ *
+ * The addresses are only good until a variable is freed, so the code
+ * remembers the variable generation it was made for and is made again
+ * when that changes, up to JIT_MAX_BUILDS times.
+ *
+ * The code for the two processors is laid out the same way: the stack
+ * machine's stack is kept in registers the C functions it calls are free
+ * to change, so the ones in use are saved in the frame around each call.
+ *
+ * On other processors, on Apple's AArch64 machines, which only run code
+ * made in memory mapped for it, or where memory can't be made executable,
+ * every request for code returns NULL and the stack machine carries on
+ * as before. --no-jit does the same thing on purpose.
+ */
+
+/* the number of times the code for one expression or loop is rebuilt
+   after variables are freed before it is left to the stack machine */
+#define JIT_MAX_BUILDS 8
+
+/* the machine code made for an expression or a loop */
+struct native_s {
+  void *entry;          // where to call it, NULL if it could not be made
+  long generation;      // the variable generation its addresses belong to
+  int builds;           // times it has been made
+  int statements;       // in a loop, the statements performed each time round
+  int expressions;      // ... and the compiled expressions among them
+};
+
+/* returns the value of an expression */
+typedef double (*native_expression_t)(void);
+
+/* runs a loop with the index at index until the NEXT fails or countdown is
+   about to run out, and returns the times round, negated if the loop ended */
+typedef long (*native_loop_t)(double *index, double end, double step, long *countdown);
+
+/* command line settings */
+extern bool use_jit;              // cleared by --no-jit
+
+/* statistics */
+extern int expressions_native;
+extern int loops_native;
+extern long long native_iterations;
+extern long jit_code_size;
+
+/**
+ * Returns the machine code for a compiled expression, making it if this is
+ * the first call or the variables have moved since it was made.
+ *
+ * @param code The expression's compiled form, see tier.h.
+ * @param generation The current variable generation.
+ * @return The code, or NULL to run the stack machine.
+ */
+native_expression_t jit_expression(code_t *code, long generation);
+
+/**
+ * Returns the machine code for the body of a FOR on a single line,
+ * making it if needed, as for jit_expression.
+ *
+ * @param statement The FOR, which has to have been promoted.
+ * @param head The list item holding the FOR.
+ * @param tail The last statement on its line.
+ * @param generation The current variable generation.
+ * @return The code, or NULL if the line has anything but SETs on it.
+ */
+native_loop_t jit_loop(statement_t *statement, list_t *head, list_t *tail, long generation);
+
+#endif /* __JIT_H__ */
@@ -0,0 +1,272 @@
+/* program loader (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include <sys/stat.h>
+
+#include "loader.h"
+#include "retrofocal.h"
+#include "program.h"
+#include "memstat.h"
+#include "cache.h"
+#include "write.h"
+
+#if !defined(WIN32) && !defined(_WIN32)
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/* a program that was loaded, and the file it came from */
+typedef struct {
+  char *path;               // NULL if the slot is free
+  time_t modified;          // the file when it was read, any change to
+  off_t size;               // these means it has been written since
+  ino_t inode;
+  memory_arena_t *arena;    // its parse tree
+  int line_count;
+  int *line_numbers;        // the lines in use, in xx.yy * 100 format ...
+  list_t **heads;           // ... and their statements, which stay chained
+  long generation;          // program_generation when it was loaded
+  unsigned long used;       // when it was loaded, to find the least recently used
+} loaded_program_t;
+
+static loaded_program_t programs[LOADER_PROGRAMS];
+static unsigned long load_clock = 0;
+
+/* the program in the lines now, NULL if it didn't come from library_load,
+   and the arena its tree, and anything typed into it, comes from */
+static loaded_program_t *current = NULL;
+static memory_arena_t *current_arena = NULL;
+
+/* a program that was replaced and couldn't be kept, freed at the next load */
+static memory_arena_t *retired_arena = NULL;
+static list_t *retired_lines = NULL;
+
+/* the head of the program in the lines now, the rest is chained to it */
+static list_t *first_head(void)
+{
+  int first = program_next_line(0);
+  return first < MAXLINE ? interpreter_state.lines[first] : NULL;
+} /* first_head */
+
+static void free_program(memory_arena_t *arena, list_t *lines)
+{
+  memory_arena_free(arena);
+  lst_free(lines);
+} /* free_program */
+
+/* empties a slot, freeing the program in it unless it is being retired */
+static void clear_slot(loaded_program_t *program, bool free_it)
+{
+  if (free_it)
+    free_program(program->arena, program->line_count > 0 ? program->heads[0] : NULL);
+  free(program->path);
+  free(program->line_numbers);
+  free(program->heads);
+  memset(program, 0, sizeof(*program));
+} /* clear_slot */
+
+/* puts the current program aside, in the cache if it can be used again */
+static void leave_program(bool keep)
+{
+  if (current == NULL || !keep || current->generation != program_generation) {
+    free_program(retired_arena, retired_lines);
+    retired_arena = current_arena;
+    retired_lines = first_head();
+    if (current != NULL)
+      clear_slot(current, false);
+  }
+  current = NULL;
+  current_arena = NULL;
+  memory_use_arena(NULL);
+} /* leave_program */
+
+static loaded_program_t *find_program(const char *filename)
+{
+  for (int i = 0; i < LOADER_PROGRAMS; i++)
+    if (programs[i].path != NULL && strcmp(programs[i].path, filename) == 0)
+      return &programs[i];
+  return NULL;
+} /* find_program */
+
+/* a free slot, or the least recently used one emptied. the program
+   running was loaded last, so it is never the one pushed out */
+static loaded_program_t *free_slot(void)
+{
+  loaded_program_t *oldest = &programs[0];
+  for (int i = 0; i < LOADER_PROGRAMS; i++) {
+    if (programs[i].path == NULL)
+      return &programs[i];
+    if (programs[i].used < oldest->used)
+      oldest = &programs[i];
+  }
+  clear_slot(oldest, true);
+  return oldest;
+} /* free_slot */
+
+/* notes the lines of the program just parsed, to put them back later */
+static void keep_lines(loaded_program_t *program)
+{
+  program->line_count = 0;
+  for (int i = program_next_line(0); i < MAXLINE; i = program_next_line(i))
+    program->line_count++;
+  program->line_numbers = malloc((program->line_count + 1) * sizeof(int));
+  program->heads = malloc((program->line_count + 1) * sizeof(list_t *));
+  int count = 0;
+  for (int i = program_next_line(0); i < MAXLINE; i = program_next_line(i)) {
+    program->line_numbers[count] = i;
+    program->heads[count++] = interpreter_state.lines[i];
+  }
+} /* keep_lines */
+
+/* parses an open file, mapped if it's an ordinary file, otherwise read */
+static void parse_file(FILE *fp)
+{
+  for (int i = 0; i < MAXLINE; i++)
+    interpreter_state.lines[i] = NULL;
+
+#if !defined(WIN32) && !defined(_WIN32)
+  int fd = fileno(fp);
+  struct stat info;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    size_t size = (size_t)info.st_size;
+    void *text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text != MAP_FAILED) {
+      memory_charge(MEMORY_IO, size);
+      cache_parse(text, size);
+      memory_release(MEMORY_IO, size);
+      munmap(text, size);
+      return;
+    }
+  }
+#endif
+
+  size_t size = 0, capacity = 64 * 1024;
+  char *text = malloc(capacity);
+  size_t count;
+  while ((count = fread(text + size, 1, capacity - size, fp)) > 0) {
+    size += count;
+    if (size == capacity) {
+      capacity *= 2;
+      text = realloc(text, capacity);
+    }
+  }
+  memory_charge(MEMORY_IO, capacity);
+  cache_parse(text, size);
+  memory_release(MEMORY_IO, capacity);
+  free(text);
+} /* parse_file */
+
+/************************************************************************/
+
+bool read_program(const char *filename)
+{
+  FILE *fp = fopen(filename, "r");
+  if (fp == NULL)
+    return false;
+  parse_file(fp);
+  fclose(fp);
+  return true;
+} /* read_program */
+
+bool library_load(const char *filename)
+{
+  struct stat info;
+  FILE *fp = fopen(filename, "r");
+#if !defined(WIN32) && !defined(_WIN32)
+  if (fp == NULL || fstat(fileno(fp), &info) != 0) {
+#else
+  if (fp == NULL || stat(filename, &info) != 0) {
+#endif
+    if (fp != NULL)
+      fclose(fp);
+    fprintf(stderr, "Cannot open library file: %s\n", filename);
+    return false;
+  }
+
+  // a copy of a file that has changed since is no use, even the one running
+  loaded_program_t *program = find_program(filename);
+  bool changed = program != NULL && (program->modified != info.st_mtime || program->size != info.st_size || program->inode != info.st_ino);
+  leave_program(!(changed && program == current));
+  if (changed && program->path != NULL)
+    clear_slot(program, true);
+  // and leave_program drops an edited one
+  if (program != NULL && program->path == NULL)
+    program = NULL;
+  clear_stack();
+
+  if (program != NULL) {
+    // it's still chained together, so it only needs its lines back
+    fclose(fp);
+    for (int i = 0; i < MAXLINE; i++)
+      interpreter_state.lines[i] = NULL;
+    for (int i = 0; i < program->line_count; i++)
+      interpreter_state.lines[program->line_numbers[i]] = program->heads[i];
+    program_link();
+    interpreter_state.current_statement = interpreter_state.lines[interpreter_state.first_line_index];
+  } else {
+    program = free_slot();
+    program->arena = memory_arena_new();
+    memory_use_arena(program->arena);
+    parse_file(fp);
+    fclose(fp);
+    interpreter_post_parse();
+    program->path = str_new((char *)filename);
+    program->modified = info.st_mtime;
+    program->size = info.st_size;
+    program->inode = info.st_ino;
+    keep_lines(program);
+  }
+
+  memory_use_arena(program->arena);
+  current = program;
+  current_arena = program->arena;
+  program->generation = program_generation;
+  program->used = ++load_clock;
+  return true;
+} /* library_load */
+
+bool library_save(const char *filename)
+{
+  // the listing goes to a temporary name and is renamed into place, so a
+  // save that fails part way never leaves half a program where one was
+  char *temporary = malloc(strlen(filename) + 32);
+  sprintf(temporary, "%s.%ld.tmp", filename, (long)getpid());
+  FILE *fp = fopen(temporary, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "Cannot open file for writing: %s\n", filename);
+    free(temporary);
+    return false;
+  }
+  write_listing(fp, 1, MAXLINE);
+  bool ok = !ferror(fp);
+  ok = (fclose(fp) == 0) && ok;
+#if defined(WIN32) || defined(_WIN32)
+  // rename won't replace an existing file on Windows
+  if (ok)
+    remove(filename);
+#endif
+  ok = ok && rename(temporary, filename) == 0;
+  if (!ok) {
+    fprintf(stderr, "Error writing file: %s\n", filename);
+    remove(temporary);
+  }
+  free(temporary);
+  return ok;
+} /* library_save */
@@ -0,0 +1,85 @@
+/* program loader (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __LOADER_H__
+#define __LOADER_H__
+
+#include "stdhdr.h"
+
+/**
+ * @file loader.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief Reading and writing program files, and the LIBRARY statements.
+ *
+ * Source files are mapped into memory rather than copied, and parsed from
+ * there, or fetched from the cache of parsed trees on disk, see cache.h.
+ *
+ * A program that swaps itself for others with LIBRARY RUN, an overlay,
+ * may do it thousands of times, so the loader also keeps the last
+ * LOADER_PROGRAMS programs it loaded, parsed and ready. Going back to one
+ * of them only puts its lines back, as long as the file has the same
+ * modification time, size and inode as when it was read, and the program
+ * wasn't edited at the CLI while it was loaded. Edited programs are dropped
+ * from the cache, the file is read again the next time.
+ *
+ * Each program's parse tree is allocated from its own arena, see
+ * memstat.h, so the loader can free a program in one go when it falls out
+ * of the cache, or when it is replaced and can't be kept. That is put off
+ * until the next load, as the statement that did the LIBRARY may still be
+ * running. The strings from the scanner are not in the arena, a string
+ * variable can still point at a literal from a program long gone.
+ */
+
+/* programs kept parsed in memory */
+#define LOADER_PROGRAMS 8
+
+/**
+ * Reads a program file, replacing the lines of the current one, ready for
+ * interpreter_post_parse. This is how the program named on the command
+ * line is read.
+ *
+ * @param filename The program file.
+ * @return false if the file could not be read, with errno set.
+ */
+bool read_program(const char *filename);
+
+/**
+ * Replaces the program with the one in a file for LIBRARY CALL and
+ * LIBRARY RUN, and readies it to run from its first line. Anything left on
+ * the DO and FOR stack belonged to the old program, so it is dropped.
+ *
+ * @param filename The program file.
+ * @return false if the file could not be read, with a message printed,
+ * and the current program left as it was.
+ */
+bool library_load(const char *filename);
+
+/**
+ * Writes the program to a file for LIBRARY SAVE. The listing is written
+ * under a temporary name beside it and renamed over the file once it is
+ * complete, so the old file is only replaced by a whole new one.
+ *
+ * @param filename The program file.
+ * @return false if it could not be written, with a message printed.
+ */
+bool library_save(const char *filename);
+
+#endif /* __LOADER_H__ */
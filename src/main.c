@@ -32,8 +32,25 @@ Boston, MA 02111-1307, USA.  */
 #include "statistics.h"
 #include "parse.h"
 #include "io.h"
+#include "image.h"
+#include "cache.h"
+#include "record.h"
+#include "memstat.h"
+#include "optimize.h"
+#include "tier.h"
+#include "emit.h"
+#include "jit.h"
+#include "fmath.h"
+#include "common.h"
+#include "plugin.h"
+#include "plot.h"
+#include "cli.h"
+#include "loader.h"
+#include "rng.h"
 
-extern void interpreter_cli(void);
+
+/* checkpoint to resume from, if any */
+static char *resume_file = NULL;
 
 /* signal handler for SIGINT - does not exit in interactive mode */
 static void sigint_handler(int sig)
@@ -49,6 +66,35 @@ static void print_version()
   puts(VERSION_STRING);
 }
 
+/* returns a malloced copy of filename with its extension replaced, or added */
+static char *replace_extension(const char *filename, const char *extension)
+{
+  char *name = malloc(strlen(filename) + strlen(extension) + 1);
+  strcpy(name, filename);
+  char *dot = strrchr(name, '.');
+  if (dot != NULL && strchr(dot, '/') == NULL)
+    *dot = '\0';
+  strcat(name, extension);
+  return name;
+}
+
+/* a number of bytes, with K, M or G after it for kilo, mega or giga, or -1
+   if it isn't one */
+static long long parse_size(const char *text)
+{
+  char *end;
+  long long size = strtoll(text, &end, 10);
+  int shift = 0;
+  switch (toupper(*end)) {
+    case 'K': shift = 10; break;
+    case 'M': shift = 20; break;
+    case 'G': shift = 30; break;
+  }
+  if (end == text || size < 0 || size > (LLONG_MAX >> shift))
+    return -1;
+  return size << shift;
+}
+
 /* usage short form, just a list of the switches */
 static void print_usage(char *argv[])
 {
@@ -58,7 +104,7 @@ static void print_usage(char *argv[])
 /* full usage notes, both for the user and for documenting the code below */
 static void print_help(char *argv[])
 {
-  printf("Usage: retrofocal [-hvnu] [-t spaces] [-r seed] [-p | -w stats_file] [-o output_file] [-i input_file] [--prompt PROMPT] [source_file]\n");
+  printf("Usage: retrofocal [-hvnu] [-t spaces] [-r seed] [-p | -w stats_file] [-o output_file] [-i input_file] [--prompt PROMPT] [--cli-cache-size N] [--compile] [--cache] [--cache-dir DIR] [--cache-size BYTES] [--cache-purge] [--checkpoint-every N] [--checkpoint-file FILE] [--resume FILE] [--record FILE | --replay FILE] [--max-statements N] [--max-time SECONDS] [--max-stack-depth N] [--max-memory BYTES] [--no-optimize] [--verify-optimizer] [--tier-threshold N] [--no-jit] [--math fast|exact] [--common FILE] [--common-size N] [--common-lock] [--plugin FILE] [--plot-file FILE] [--adc-file FILE] [--emit-c] [source_file]\n");
   puts("\nOptions:");
   puts("  -h, --help: print this description");
   puts("  -v, --version: print version info");
@@ -70,6 +116,33 @@ static void print_help(char *argv[])
   puts("  -o, --output-file: redirect TYPE to the named file");
   puts("  -i, --input-file: redirect ASK from the named file");
   puts("  --prompt: set the interactive prompt string (default is *)");
+  puts("  --cli-cache-size: keep this many immediate commands parsed in interactive mode, 0 for none (default 32)");
+  puts("  --compile: write a precompiled .fcb image (named with -o) instead of running");
+  puts("  --cache: keep parsed programs in an on-disk cache keyed by their text");
+  puts("  --cache-dir: use the named cache directory, implies --cache");
+  puts("  --cache-size: limit the cache to this many bytes, K, M or G suffix allowed");
+  puts("  --cache-purge: empty the cache before starting");
+  puts("  --checkpoint-every: save the complete run state every N statements");
+  puts("  --checkpoint-file: name the checkpoint file, default is the source with .fcs");
+  puts("  --resume: continue a run from a checkpoint file");
+  puts("  --record: log ASK, FIN, FRAN and clock inputs to a file");
+  puts("  --replay: feed the program the inputs from a --record log");
+  puts("  --max-statements: stop the program after N statements");
+  puts("  --max-time: stop the program after this many seconds");
+  puts("  --max-stack-depth: stop the program if DO and FOR nest deeper than N");
+  puts("  --max-memory: stop the program if it uses more than this many bytes, K, M or G suffix allowed");
+  puts("  --no-optimize: evaluate expressions exactly as written, without folding constants");
+  puts("  --verify-optimizer: evaluate expressions both ways and report any difference");
+  puts("  --tier-threshold: compile a line after it has run N times, 0 for never (default 100)");
+  puts("  --no-jit: run compiled lines on the stack machine instead of as machine code");
+  puts("  --math: fast for six-digit approximations of FSIN, FEXP and the like, exact for the C library (default)");
+  puts("  --common: share FCOM with other programs through this file");
+  puts("  --common-size: elements in a new common area (default 4096)");
+  puts("  --common-lock: keep the common area to this program until it ends");
+  puts("  --plugin: load a library of functions for FNEW, can be given more than once");
+  puts("  --plot-file: draw FDIS and FDXS points in this file, SVG if it ends in .svg, otherwise PPM");
+  puts("  --adc-file: read FADC samples from this file, one line of channels per sample");
+  puts("  --emit-c: write the program as C (to -o or standard output) instead of running it");
 }
 
 static struct option program_options[] =
@@ -84,6 +157,33 @@ static struct option program_options[] =
   {"write-stats", required_argument, NULL, 'w'},
   {"no-run", no_argument, NULL, 'n'},
   {"prompt", required_argument, NULL, 501},
+  {"compile", no_argument, NULL, 502},
+  {"cache", no_argument, NULL, 503},
+  {"cache-dir", required_argument, NULL, 504},
+  {"cache-size", required_argument, NULL, 505},
+  {"cache-purge", no_argument, NULL, 506},
+  {"checkpoint-every", required_argument, NULL, 507},
+  {"checkpoint-file", required_argument, NULL, 508},
+  {"resume", required_argument, NULL, 509},
+  {"record", required_argument, NULL, 510},
+  {"replay", required_argument, NULL, 511},
+  {"max-statements", required_argument, NULL, 512},
+  {"max-time", required_argument, NULL, 513},
+  {"max-stack-depth", required_argument, NULL, 514},
+  {"max-memory", required_argument, NULL, 515},
+  {"no-optimize", no_argument, NULL, 516},
+  {"verify-optimizer", no_argument, NULL, 517},
+  {"tier-threshold", required_argument, NULL, 518},
+  {"emit-c", no_argument, NULL, 519},
+  {"no-jit", no_argument, NULL, 520},
+  {"math", required_argument, NULL, 521},
+  {"common", required_argument, NULL, 522},
+  {"common-size", required_argument, NULL, 523},
+  {"common-lock", no_argument, NULL, 524},
+  {"plugin", required_argument, NULL, 525},
+  {"plot-file", required_argument, NULL, 526},
+  {"adc-file", required_argument, NULL, 527},
+  {"cli-cache-size", required_argument, NULL, 528},
   {0, 0, 0, 0}
 };
 
@@ -91,6 +191,7 @@ void parse_options(int argc, char *argv[])
 {
   int option_index = 0;
   int printed_help = false;
+  bool purge_cache = false;
   
   // used to test whether an optional parameter is actually a number or not,
   // if not, we back up one input - see -r
@@ -149,6 +250,161 @@ void parse_options(int argc, char *argv[])
           cli_prompt = optarg;
         break;
         
+      case 502:
+        compile_program = true;
+        break;
+        
+      case 503:
+        use_cache = true;
+        break;
+        
+      case 504:
+        use_cache = true;
+        cache_dir = optarg;
+        break;
+        
+      case 505:
+      {
+        long long size = parse_size(optarg);
+        if (size < 0 || size > LONG_MAX) {
+          fprintf(stderr, "Invalid cache size: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        cache_size_limit = (long)size;
+        break;
+      }
+        
+      case 506:
+        purge_cache = true;
+        break;
+        
+      case 507:
+        checkpoint_interval = strtol(optarg, &test, 10);
+        if (test == optarg || checkpoint_interval < 0) {
+          fprintf(stderr, "Invalid checkpoint interval: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+        
+      case 508:
+        checkpoint_file = optarg;
+        break;
+        
+      case 509:
+        resume_file = optarg;
+        break;
+        
+      case 510:
+        record_file = optarg;
+        break;
+        
+      case 511:
+        replay_file = optarg;
+        break;
+        
+      case 512:
+        max_statements = strtol(optarg, &test, 10);
+        if (test == optarg || max_statements < 0) {
+          fprintf(stderr, "Invalid statement limit: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+        
+      case 513:
+        max_time = strtod(optarg, &test);
+        if (test == optarg || max_time < 0) {
+          fprintf(stderr, "Invalid time limit: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+        
+      case 514:
+        max_stack_depth = (int)strtol(optarg, &test, 10);
+        if (test == optarg || max_stack_depth < 0) {
+          fprintf(stderr, "Invalid stack depth limit: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+        
+      case 515:
+        max_memory = parse_size(optarg);
+        if (max_memory < 0) {
+          fprintf(stderr, "Invalid memory limit: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+        
+      case 516:
+        use_optimizer = false;
+        break;
+        
+      case 517:
+        verify_optimizer = true;
+        break;
+        
+      case 518:
+        tier_threshold = strtol(optarg, &test, 10);
+        if (test == optarg || tier_threshold < 0) {
+          fprintf(stderr, "Invalid tier threshold: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+        
+      case 519:
+        emit_c = true;
+        break;
+        
+      case 520:
+        use_jit = false;
+        break;
+        
+      case 521:
+        if (strcmp(optarg, "fast") == 0)
+          math_mode = MATH_FAST;
+        else if (strcmp(optarg, "exact") == 0)
+          math_mode = MATH_EXACT;
+        else {
+          fprintf(stderr, "Invalid math mode: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+        
+      case 522:
+        common_file = optarg;
+        break;
+        
+      case 523:
+        common_size = strtol(optarg, &test, 10);
+        if (test == optarg || common_size <= 0) {
+          fprintf(stderr, "Invalid common area size: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+        
+      case 524:
+        common_lock = true;
+        break;
+        
+      case 525:
+        plugin_add(optarg);
+        break;
+        
+      case 526:
+        plot_file = optarg;
+        break;
+        
+      case 527:
+        adc_file = optarg;
+        break;
+        
+      case 528:
+        cli_cache_size = (int)strtol(optarg, &test, 10);
+        if (test == optarg || cli_cache_size < 0) {
+          fprintf(stderr, "Invalid CLI cache size: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+        
       case 'r':
         test = optarg;
         random_seed = (int)strtol(optarg, &test, 10);
@@ -177,13 +433,23 @@ void parse_options(int argc, char *argv[])
   // if help or version was printed, exit
   if (printed_help)
     exit(EXIT_SUCCESS);
+
+  // a log covers a whole run, and a checkpoint starts part way through one
+  if (resume_file != NULL && (record_file != NULL || replay_file != NULL)) {
+    fprintf(stderr, "--resume can't be used with --record or --replay.\n");
+    exit(EXIT_FAILURE);
+  }
+  
+  // purging happens up front, and is all we do if there's no program
+  if (purge_cache) {
+    cache_purge();
+    if (strlen(source_file) == 0)
+      exit(EXIT_SUCCESS);
+  }
 }
 
 int main(int argc, char *argv[])
 {
-  extern int yyparse(void);
-  extern FILE *yyin;
-  
   // turn this on to add verbose debugging
 #if YYDEBUG
   yydebug = 1;
@@ -197,20 +463,45 @@ int main(int argc, char *argv[])
 
   // seed the random with the provided number or randomize it
   if (random_seed > -1)
-    srand(random_seed);
+    rng_seed((uint32_t)random_seed);
   else
-    srand((unsigned int)time(NULL));
-  
-  // now call rand to prime the pump, see:
-  // https://stackoverflow.com/questions/76367489/srand-rand-slowly-changing-starting-value/76367884#76367884
-  (void)rand();
-  (void)rand();
+    rng_seed((uint32_t)time(NULL));
+
+  // -i takes the place of the keyboard for ASK and FIN
+  if (strlen(input_file) > 0 && freopen(input_file, "r", stdin) == NULL) {
+    fprintf(stderr, "Cannot open input file: %s\n", input_file);
+    terminate_retrofocal(EXIT_FAILURE);
+  }
 
+  // open the record or replay log
+  if (!record_start())
+    terminate_retrofocal(EXIT_FAILURE);
+  
+  // and map the area FCOM shares with other programs
+  if (!common_start())
+    terminate_retrofocal(EXIT_FAILURE);
+  
+  // and load the functions FNEW calls
+  if (!plugin_start())
+    terminate_retrofocal(EXIT_FAILURE);
+  
+  // and set up the display and A/D converter
+  if (!plot_start())
+    terminate_retrofocal(EXIT_FAILURE);
+  
   // install signal handler for Ctrl-C
   signal(SIGINT, sigint_handler);
 
+  // checkpoints go next to the source unless named, or replace the one we resumed from
+  if (checkpoint_interval > 0 && checkpoint_file == NULL)
+    checkpoint_file = strlen(source_file) > 0 ? replace_extension(source_file, ".fcs") : resume_file;
+  if (checkpoint_interval > 0 && checkpoint_file == NULL) {
+    fprintf(stderr, "--checkpoint-every needs a program or --checkpoint-file.\n");
+    terminate_retrofocal(EXIT_FAILURE);
+  }
+  
   // enter interactive mode if no source file was provided
-  if (strlen(source_file) == 0) {
+  if (strlen(source_file) == 0 && resume_file == NULL) {
     interpreter_state.interactive_mode = true;
     setup_terminal_for_input();
     interpreter_cli();
@@ -219,8 +510,19 @@ int main(int argc, char *argv[])
   else {
     // batch mode: load and run the file
     interpreter_state.interactive_mode = false;
-    yyin = fopen(source_file, "r");
-    if (yyin == NULL) {
+    
+    // a checkpoint holds the program and where it was, so it's ready to run
+    if (resume_file != NULL) {
+      if (!load_snapshot(resume_file))
+        terminate_retrofocal(EXIT_FAILURE);
+    }
+    // precompiled images skip the parser entirely
+    else if (is_image_file(source_file)) {
+      if (!load_image(source_file))
+        terminate_retrofocal(EXIT_FAILURE);
+    }
+    // otherwise parse it, or fetch the parsed tree from the cache
+    else if (!read_program(source_file)) {
       if (errno == ENOENT) {
         fprintf(stderr, "File not found or invalid filename provided.\n");
         terminate_retrofocal(EXIT_FAILURE);
@@ -229,14 +531,36 @@ int main(int argc, char *argv[])
         terminate_retrofocal(EXIT_FAILURE);
       }
     }
-    // if we were able to open the file, parse it
-    yyparse();
     
-    // prepare the code for running
-    interpreter_post_parse();
+    // when compiling, write the image and stop, -o names it or we swap the extension
+    if (compile_program) {
+      char *image_name = print_file;
+      if (strlen(image_name) == 0)
+        image_name = replace_extension(source_file, ".fcb");
+      terminate_retrofocal(save_image(image_name) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
     
-    // set terminal to raw mode for the run so ESC can be detected
-    setup_terminal_for_input();
+    // prepare the code for running, a checkpoint has already done this
+    if (resume_file == NULL)
+      interpreter_post_parse();
+    
+    // when translating, write the C and stop, -o names the file or it goes to stdout
+    if (emit_c) {
+      FILE *c_file = stdout;
+      if (strlen(print_file) > 0 && (c_file = fopen(print_file, "w")) == NULL) {
+        fprintf(stderr, "Cannot open file for writing: %s\n", print_file);
+        terminate_retrofocal(EXIT_FAILURE);
+      }
+      bool translated = emit_program(c_file, strlen(source_file) > 0 ? source_file : resume_file);
+      if (c_file != stdout)
+        fclose(c_file);
+      terminate_retrofocal(translated ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    
+    // set terminal to raw mode for the run so ESC can be detected,
+    // unless we're replaying and won't be reading from it at all
+    if (replay_file == NULL)
+      setup_terminal_for_input();
     if (run_program)
       interpreter_run();
     restore_terminal();
@@ -246,6 +570,6 @@ int main(int argc, char *argv[])
   if (print_stats || write_stats)
     print_statistics();
   
-  // and exit
-  terminate_retrofocal(EXIT_SUCCESS);
+  // and exit, a program stopped by a limit gets its own status
+  terminate_retrofocal(limit_reached != NULL ? LIMIT_EXIT_STATUS : EXIT_SUCCESS);
 }
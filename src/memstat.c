@@ -0,0 +1,166 @@
+/* memory accounting (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include "memstat.h"
+#include "retrofocal.h"
+#include "io.h"
+
+/* command line settings */
+long long max_memory = 0;
+bool memory_exceeded = false;
+
+/* the tallies, the extra slot at the end is the total */
+static long long current[MEMORY_CATEGORIES + 1];
+static long long peak[MEMORY_CATEGORIES + 1];
+
+static const char *category_names[MEMORY_CATEGORIES + 1] = {
+  "tree", "symbols", "arrays", "stack", "i/o", "total"
+};
+
+/* arenas are carved out of blocks this size, larger objects get their own */
+#define ARENA_BLOCK (64 * 1024)
+
+/* one block of an arena, the objects follow it */
+typedef struct arena_block_s {
+  struct arena_block_s *next;
+  size_t size;              // bytes after the header
+  size_t used;
+} arena_block_t;
+
+struct memory_arena_s {
+  arena_block_t *blocks;    // the one being filled is first
+  size_t charged;           // bytes charged to MEMORY_AST
+};
+
+/* where MEMORY_AST objects come from, NULL for calloc */
+static memory_arena_t *arena_in_use = NULL;
+
+/* the header is rounded up so the objects after it stay aligned */
+#define BLOCK_HEADER ((sizeof(arena_block_t) + 15) & ~(size_t)15)
+
+static void *arena_alloc(memory_arena_t *arena, size_t bytes)
+{
+  bytes = (bytes + 15) & ~(size_t)15;
+  arena_block_t *block = arena->blocks;
+  if (block == NULL || block->size - block->used < bytes) {
+    size_t size = bytes > ARENA_BLOCK / 4 ? bytes : ARENA_BLOCK;
+    block = calloc(1, BLOCK_HEADER + size);
+    if (block == NULL)
+      return NULL;
+    block->size = size;
+    // a block for one large object goes behind the one being filled
+    if (size != ARENA_BLOCK && arena->blocks != NULL) {
+      block->next = arena->blocks->next;
+      arena->blocks->next = block;
+    } else {
+      block->next = arena->blocks;
+      arena->blocks = block;
+    }
+  }
+  void *memory = (char *)block + BLOCK_HEADER + block->used;
+  block->used += bytes;
+  return memory;
+} /* arena_alloc */
+
+void memory_charge(memory_category_t category, size_t bytes)
+{
+  current[category] += bytes;
+  if (current[category] > peak[category])
+    peak[category] = current[category];
+  current[MEMORY_CATEGORIES] += bytes;
+  if (current[MEMORY_CATEGORIES] > peak[MEMORY_CATEGORIES])
+    peak[MEMORY_CATEGORIES] = current[MEMORY_CATEGORIES];
+
+  if (max_memory == 0 || memory_exceeded || current[MEMORY_CATEGORIES] <= max_memory)
+    return;
+  memory_exceeded = true;
+
+  // a running program is stopped cleanly between statements, but if we're
+  // still loading it there's nothing to stop, so just give up
+  if (interpreter_state.running_state == 1)
+    interrupt_run();
+  else {
+    fprintf(stderr, "Program needs more than the %lld bytes allowed by --max-memory\n", max_memory);
+    terminate_retrofocal(LIMIT_EXIT_STATUS);
+  }
+} /* memory_charge */
+
+void memory_release(memory_category_t category, size_t bytes)
+{
+  current[category] -= bytes;
+  current[MEMORY_CATEGORIES] -= bytes;
+} /* memory_release */
+
+void *memory_calloc(memory_category_t category, size_t bytes)
+{
+  void *memory;
+  if (category == MEMORY_AST && arena_in_use != NULL) {
+    memory = arena_alloc(arena_in_use, bytes);
+    arena_in_use->charged += bytes;
+  } else
+    memory = calloc(1, bytes);
+  if (memory == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    terminate_retrofocal(EXIT_FAILURE);
+  }
+  memory_charge(category, bytes);
+  return memory;
+} /* memory_calloc */
+
+memory_arena_t *memory_arena_new(void)
+{
+  return calloc(1, sizeof(memory_arena_t));
+} /* memory_arena_new */
+
+memory_arena_t *memory_use_arena(memory_arena_t *arena)
+{
+  memory_arena_t *previous = arena_in_use;
+  arena_in_use = arena;
+  return previous;
+} /* memory_use_arena */
+
+void memory_arena_free(memory_arena_t *arena)
+{
+  if (arena == NULL)
+    return;
+  if (arena == arena_in_use)
+    arena_in_use = NULL;
+  for (arena_block_t *block = arena->blocks, *next; block != NULL; block = next) {
+    next = block->next;
+    free(block);
+  }
+  memory_release(MEMORY_AST, arena->charged);
+  free(arena);
+} /* memory_arena_free */
+
+long long memory_current(memory_category_t category)
+{
+  return current[category];
+}
+
+long long memory_peak(memory_category_t category)
+{
+  return peak[category];
+}
+
+const char *memory_category_name(memory_category_t category)
+{
+  return category_names[category];
+}
@@ -0,0 +1,108 @@
+/* memory accounting (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __MEMSTAT_H__
+#define __MEMSTAT_H__
+
+#include "stdhdr.h"
+
+/**
+ * @file memstat.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief Accounting of the memory used by a program.
+ *
+ * The interpreter's larger allocations are charged to one of a few
+ * categories when they are made and released when they are freed, giving
+ * the current and peak use of each for the statistics. With --max-memory
+ * the total is capped: going over it while parsing stops with an error,
+ * and going over it while running stops the program at the end of the
+ * current statement, the same way the other limits do.
+ *
+ * The tallies cover the structures the program itself causes to exist,
+ * not every byte the process uses, so list nodes and the C library's own
+ * overhead are not included.
+ *
+ * The parse tree is never freed a piece at a time, so while an arena is in
+ * use the MEMORY_AST objects are carved out of it instead, and the whole
+ * tree of a program goes in one call when the loader replaces it, see
+ * loader.h.
+ */
+
+typedef enum {
+  MEMORY_AST,       // statements, expressions and the rest of the parse tree
+  MEMORY_SYMBOLS,   // the variable table entries and their names
+  MEMORY_ARRAYS,    // variable values, scalar and subscripted
+  MEMORY_STACK,     // DO and FOR entries
+  MEMORY_IO,        // source text and image buffers
+  MEMORY_CATEGORIES
+} memory_category_t;
+
+extern long long max_memory;    // --max-memory, 0 for no limit
+extern bool memory_exceeded;    // set once the limit has been passed
+
+/**
+ * Records an allocation.
+ *
+ * @param category What the memory is used for.
+ * @param bytes The size of the allocation.
+ */
+void memory_charge(memory_category_t category, size_t bytes);
+
+/**
+ * Records that an allocation has been freed.
+ *
+ * @param category What the memory was used for.
+ * @param bytes The size of the allocation.
+ */
+void memory_release(memory_category_t category, size_t bytes);
+
+/**
+ * A calloc for a single object that also charges it to @p category.
+ */
+void *memory_calloc(memory_category_t category, size_t bytes);
+
+/* a group of MEMORY_AST objects that are freed together */
+typedef struct memory_arena_s memory_arena_t;
+
+/** A new, empty arena. */
+memory_arena_t *memory_arena_new(void);
+
+/**
+ * Makes memory_calloc take MEMORY_AST objects from @p arena, or from calloc
+ * if it is NULL.
+ *
+ * @return The arena that was in use before.
+ */
+memory_arena_t *memory_use_arena(memory_arena_t *arena);
+
+/** Frees everything allocated from @p arena, and the arena itself. */
+void memory_arena_free(memory_arena_t *arena);
+
+/** Current bytes charged to @p category, or to all of them with MEMORY_CATEGORIES. */
+long long memory_current(memory_category_t category);
+
+/** The most that was ever charged to @p category, or to all of them with MEMORY_CATEGORIES. */
+long long memory_peak(memory_category_t category);
+
+/** The name of @p category for the statistics. */
+const char *memory_category_name(memory_category_t category);
+
+#endif /* __MEMSTAT_H__ */
@@ -0,0 +1,150 @@
+/* number input (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include "number.h"
+
+/* every power of ten up to here is exact in a double, and the compiler
+   rounds the negative ones the same way pow does */
+#define TABLE_POWERS 22
+
+static const double positive_powers[TABLE_POWERS + 1] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const double negative_powers[TABLE_POWERS + 1] = {
+  1e-0, 1e-1, 1e-2, 1e-3, 1e-4, 1e-5, 1e-6, 1e-7, 1e-8, 1e-9, 1e-10, 1e-11,
+  1e-12, 1e-13, 1e-14, 1e-15, 1e-16, 1e-17, 1e-18, 1e-19, 1e-20, 1e-21, 1e-22
+};
+
+/* past this another digit could overflow a long long, and a double only
+   holds seventeen of them anyway */
+#define MOST_DIGITS 100000000000000000LL
+
+/* and an exponent past this is zero or infinity whatever comes after */
+#define MOST_EXPONENT 10000
+
+/** Returns 10 to the given power, from the tables if it's in them. */
+static double power_of_ten(int exponent)
+{
+  if (exponent >= 0 && exponent <= TABLE_POWERS)
+    return positive_powers[exponent];
+  if (exponent < 0 && exponent >= -TABLE_POWERS)
+    return negative_powers[-exponent];
+  return pow(10, exponent);
+} /* power_of_ten */
+
+int char_code_for_character(const char one_char)
+{
+	switch (one_char) {
+		case '@' ... 'Z' : return ((int)one_char - '@'); break;
+		case '0' ... '9' : return ((int)one_char - '0'); break;
+		case ':' ... '?' : return ((int)one_char + 22); break;
+		case '[' ... '_' : return ((int)one_char - 58); break;
+		case ' ' ... '/' : return ((int)one_char + 8); break;
+		default: return 0;
+	}
+} /* char_code_for_character */
+
+bool is_input_separator(char c)
+{
+  return c == ',' || isspace((unsigned char)c);
+} /* is_input_separator */
+
+double string_to_number(const char *text, size_t length, const char **error)
+{
+  // which part of the number we're in
+  enum { INTEGER, FRACTION, EXPONENT } part = INTEGER;
+  long long integer = 0;
+  long long fraction = 0;
+  int fraction_digits = 0;
+  int extra_digits = 0;
+  int exponent = 0;
+  int mantissa_sign = 1;
+  int exponent_sign = 1;
+
+  for (size_t i = 0; i < length; i++) {
+    char c = text[i];
+    int val = 0;
+
+    // the period and E switch parts, and can only appear once each
+    if (c == 'E' || c == 'e') {
+      if (part == EXPONENT) {
+        *error = "More than one E in string value";
+        return 0;
+      }
+      part = EXPONENT;
+      continue;
+    }
+    if (c == '.' && part == INTEGER) {
+      part = FRACTION;
+      continue;
+    }
+    if (c == '.' && part == FRACTION) {
+      *error = "More than one decimal/period in string value";
+      return 0;
+    }
+
+    // everything else is a digit or letter, or a sign outside the fraction
+    if (isalpha((unsigned char)c))
+      val = char_code_for_character(c);
+    else if (isdigit((unsigned char)c))
+      val = c - '0';
+    else if (c == '-' && part == INTEGER)
+      mantissa_sign = -mantissa_sign;
+    else if (c == '+' && part == INTEGER)
+      mantissa_sign = 1;
+    else if (c == '-' && part == EXPONENT)
+      exponent_sign = -exponent_sign;
+    else if (c == '+' && part == EXPONENT)
+      exponent_sign = 1;
+    else {
+      *error = "Invalid character in string value";
+      return 0;
+    }
+
+    // signs take up a place, the same as a zero would, and once there are
+    // enough digits the rest of the integer only moves the exponent along
+    // and the rest of the fraction is dropped
+    switch (part) {
+      case INTEGER:
+        if (integer < MOST_DIGITS)
+          integer = integer * 10 + val;
+        else
+          extra_digits++;
+        break;
+      case FRACTION:
+        if (extra_digits == 0 && fraction < MOST_DIGITS) {
+          fraction = fraction * 10 + val;
+          fraction_digits++;
+        }
+        break;
+      case EXPONENT:
+        if (exponent < MOST_EXPONENT)
+          exponent = exponent * 10 + val;
+        break;
+    }
+  }
+
+  // and construct the final number, signing the integers so that "-" and
+  // "-0" come out as zero rather than negative zero
+  double mantissa = (integer * mantissa_sign) + ((fraction * mantissa_sign) / power_of_ten(fraction_digits));
+  return mantissa * power_of_ten(exponent * exponent_sign + extra_digits);
+} /* string_to_number */
@@ -0,0 +1,67 @@
+/* number input (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __NUMBER_H__
+#define __NUMBER_H__
+
+#include "stdhdr.h"
+
+/**
+ * @file number.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief Converts typed input into FOCAL numbers.
+ *
+ * FOCAL was built on a machine with no inherent string support, and the
+ * language does not have any internal string handling. However, the need
+ * to input short strings for things like "yes" or 'no" remained, so the
+ * solution was to use the 6-bit teletype codes where A=1 and Z=26 and then
+ * just string them together so that "A" produces 1, "A1" produces 11 and
+ * "Z1" produces 261. The weird part is that if the number is two digits,
+ * the digits will overlap, so "AZ" produces 126, but "ZZ" produces 286.
+ *
+ * See section 3.4.8: http://bitsavers.trailing-edge.com/pdf/dec/pdp8/focal/DEC-08-AJBB-DL_Advanced_FOCAL_Technical_Specification_Apr69.pdf
+ */
+
+/**
+ * Returns the 6-bit code for a character, A=1, Z=26 and so on.
+ */
+int char_code_for_character(char one_char);
+
+/**
+ * Returns true for the characters that end one value typed at ASK and
+ * start the next, which are commas and white space.
+ */
+bool is_input_separator(char c);
+
+/**
+ * Converts a string to a number using the 6-bit codes for any letters.
+ * The value has an integer part, an optional fraction after a period and
+ * an optional exponent after an E, and is read in a single pass.
+ *
+ * @param text The string to convert, which need not be terminated.
+ * @param length The number of characters in @p text.
+ * @paramout error Set to a message if the text is malformed, in which
+ * case the result is zero. Left alone otherwise.
+ * @return A numeric representation of the string.
+ */
+double string_to_number(const char *text, size_t length, const char **error);
+
+#endif /* __NUMBER_H__ */
@@ -0,0 +1,574 @@
+/* optimizer (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include "optimize.h"
+#include "retrofocal.h"
+#include "memstat.h"
+#include "number.h"
+#include "parse.h"
+
+/* command line settings */
+bool use_optimizer = true;
+bool verify_optimizer = false;
+
+/* statistics */
+int constants_folded = 0;
+int identities_removed = 0;
+int invariants_hoisted = 0;
+int statements_fused = 0;
+
+static void optimize_root(expression_t *expression);
+
+/** Returns true for the operators and functions whose result depends only
+ * on their parameters, which are the ones that can be folded.
+ */
+static bool is_pure(int opcode, int arity)
+{
+  if (arity == 2)
+    return opcode == '+' || opcode == '-' || opcode == '*' || opcode == '/' || opcode == '^' || opcode == '=';
+  if (arity == 1) {
+    switch (opcode) {
+      case '-':
+      case FABS:
+      case FATN:
+      case FCOS:
+      case FEXP:
+      case FITR:
+      case FLOG:
+      case FSGN:
+      case FSIN:
+      case FSQT:
+        return true;
+    }
+  }
+  return false;
+} /* is_pure */
+
+static bool is_constant(const expression_t *expression, double value)
+{
+  // the sign counts, x-0 is always x, but x-(-0) is not when x is -0
+  return expression->type == number && expression->parms.number == value && signbit(expression->parms.number) == signbit(value);
+}
+
+static expression_t *new_number(double value)
+{
+  expression_t *expression = memory_calloc(MEMORY_AST, sizeof(*expression));
+  expression->type = number;
+  expression->parms.number = value;
+  return expression;
+}
+
+static expression_t *new_operator(const expression_t *original, expression_t **parameters)
+{
+  expression_t *expression = memory_calloc(MEMORY_AST, sizeof(*expression));
+  expression->type = op;
+  expression->parms.op.arity = original->parms.op.arity;
+  expression->parms.op.opcode = original->parms.op.opcode;
+  for (int i = 0; i < original->parms.op.arity; i++)
+    expression->parms.op.p[i] = parameters[i];
+  return expression;
+}
+
+/* the subscripts of a variable are evaluated on their own, so they're roots */
+static void optimize_variable(variable_t *variable)
+{
+  if (variable == NULL)
+    return;
+  for (list_t *subscript = variable->subscripts; subscript != NULL; subscript = lst_next(subscript))
+    optimize_root(subscript->data);
+}
+
+/** Returns a simpler expression that gives the same result, which is the
+ * expression itself if nothing could be done. New nodes are made for any
+ * part that changes, the original is never modified.
+ */
+static expression_t *simplify(expression_t *expression)
+{
+  switch (expression->type) {
+    case numstr:
+    {
+      // these are converted every time they're evaluated, so do it now,
+      // unless it's malformed and the error has to be reported at run time
+      const char *error = NULL;
+      double value = string_to_number(expression->parms.string, strlen(expression->parms.string), &error);
+      if (error != NULL)
+        return expression;
+      constants_folded++;
+      return new_number(value);
+    }
+    case variable:
+      optimize_variable(expression->parms.variable);
+      return expression;
+    case op:
+      break;
+    default:
+      return expression;
+  }
+
+  int arity = expression->parms.op.arity;
+  int opcode = expression->parms.op.opcode;
+  expression_t *p[3] = { NULL, NULL, NULL };
+  bool changed = false;
+  bool constant = arity > 0;
+  for (int i = 0; i < arity; i++) {
+    p[i] = simplify(expression->parms.op.p[i]);
+    changed = changed || p[i] != expression->parms.op.p[i];
+    constant = constant && p[i]->type == number;
+  }
+
+  // fold constants by evaluating them, leaving division by zero to report its error
+  if (constant && is_pure(opcode, arity) && !(opcode == '/' && p[1]->parms.number == 0)) {
+    expression_t folded = *expression;
+    folded.optimized = NULL;
+    for (int i = 0; i < arity; i++)
+      folded.parms.op.p[i] = p[i];
+    constants_folded++;
+    return new_number(expression_value(&folded));
+  }
+
+  // -(-x) is x
+  if (arity == 1 && opcode == '-' && p[0]->type == op && p[0]->parms.op.arity == 1 && p[0]->parms.op.opcode == '-') {
+    identities_removed++;
+    return p[0]->parms.op.p[0];
+  }
+
+  if (arity == 2) {
+    // x*1, x/1 and x^1 are all x, as are 1*x and x-0
+    if ((opcode == '*' || opcode == '/' || opcode == '^') && is_constant(p[1], 1)) {
+      identities_removed++;
+      return p[0];
+    }
+    if ((opcode == '*' && is_constant(p[0], 1)) || (opcode == '-' && is_constant(p[1], 0))) {
+      identities_removed++;
+      return opcode == '*' ? p[1] : p[0];
+    }
+    // x^2 is x*x, which is what the interpreter computes anyway, but without
+    // the test. only for variables, anything else would be evaluated twice
+    if (opcode == '^' && is_constant(p[1], 2) && p[0]->type == variable) {
+      expression_t *square = new_operator(expression, p);
+      square->parms.op.opcode = '*';
+      square->parms.op.p[1] = p[0];
+      identities_removed++;
+      return square;
+    }
+  }
+
+  return changed ? new_operator(expression, p) : expression;
+} /* simplify */
+
+/* optimizes an expression that is evaluated on its own, from a statement
+   or a subscript, unless it has already been done */
+static void optimize_root(expression_t *expression)
+{
+  if (expression == NULL || expression->optimized != NULL)
+    return;
+  expression->optimized = simplify(expression);
+}
+
+static void optimize_list(list_t *items)
+{
+  for (list_t *item = items; item != NULL; item = lst_next(item)) {
+    printitem_t *printitem = item->data;
+    if (printitem->expression == NULL)
+      continue;
+    // ASK stores into variables, so only their subscripts can be touched
+    if (printitem->expression->type == variable)
+      optimize_variable(printitem->expression->parms.variable);
+    else
+      optimize_root(printitem->expression);
+  }
+}
+
+bool expression_is_pure(const expression_t *expression)
+{
+  if (expression == NULL)
+    return true;
+  switch (expression->type) {
+    case variable:
+      for (list_t *subscript = expression->parms.variable->subscripts; subscript != NULL; subscript = lst_next(subscript))
+        if (!expression_is_pure(subscript->data))
+          return false;
+      return true;
+    case op:
+      if (!is_pure(expression->parms.op.opcode, expression->parms.op.arity))
+        return false;
+      for (int i = 0; i < expression->parms.op.arity; i++)
+        if (!expression_is_pure(expression->parms.op.p[i]))
+          return false;
+      return true;
+    default:
+      return true;
+  }
+} /* expression_is_pure */
+
+static void optimize_statement(statement_t *statement)
+{
+  switch (statement->type) {
+    case SET:
+      optimize_variable(statement->parms.set.variable);
+      optimize_root(statement->parms.set.expression);
+      break;
+    case FOR:
+      optimize_variable(statement->parms._for.variable);
+      optimize_root(statement->parms._for.begin);
+      optimize_root(statement->parms._for.end);
+      optimize_root(statement->parms._for.step);
+      break;
+    case IF:
+      optimize_root(statement->parms._if.condition);
+      break;
+    case ASK:
+      optimize_list(statement->parms.input);
+      break;
+    case TYPE:
+      optimize_list(statement->parms.print);
+      break;
+    default:
+      break;
+  }
+} /* optimize_statement */
+
+/* the names of the variables that are set inside a loop, all elements of
+   an array count as the array, and A is the same as A(0) */
+static bool is_assigned(list_t *assigned, const char *name)
+{
+  for (list_t *item = assigned; item != NULL; item = lst_next(item))
+    if (strcmp(item->data, name) == 0)
+      return true;
+  return false;
+}
+
+/* returns true if the expression gives the same result every time around
+   a loop that sets the variables in assigned */
+static bool is_invariant(const expression_t *expression, list_t *assigned)
+{
+  switch (expression->type) {
+    case number:
+    case string:
+    case invariant:
+      return true;
+    case variable:
+      if (is_assigned(assigned, expression->parms.variable->name))
+        return false;
+      for (list_t *subscript = expression->parms.variable->subscripts; subscript != NULL; subscript = lst_next(subscript)) {
+        const expression_t *root = subscript->data;
+        if (!is_invariant(root->optimized != NULL ? root->optimized : root, assigned))
+          return false;
+      }
+      return true;
+    case op:
+      if (!is_pure(expression->parms.op.opcode, expression->parms.op.arity))
+        return false;
+      for (int i = 0; i < expression->parms.op.arity; i++)
+        if (!is_invariant(expression->parms.op.p[i], assigned))
+          return false;
+      return true;
+    default:
+      // a malformed numstr reports its error every time it is evaluated
+      return false;
+  }
+} /* is_invariant */
+
+/* only worth doing if there is a variable in there somewhere, anything
+   else is a constant that could not be folded, like 1/0 */
+static bool reads_variable(const expression_t *expression)
+{
+  if (expression->type == variable || expression->type == invariant)
+    return true;
+  if (expression->type != op)
+    return false;
+  for (int i = 0; i < expression->parms.op.arity; i++)
+    if (reads_variable(expression->parms.op.p[i]))
+      return true;
+  return false;
+}
+
+static void hoist_root(expression_t *expression, statement_t *loop, list_t *assigned);
+
+/** Returns the expression with its largest invariant parts replaced by
+ * invariant nodes, which are added to the loop's list so they can be reset
+ * when it is entered. As in simplify, the expression is never modified.
+ */
+static expression_t *hoist(expression_t *expression, statement_t *loop, list_t *assigned)
+{
+  if (expression->type == variable) {
+    for (list_t *subscript = expression->parms.variable->subscripts; subscript != NULL; subscript = lst_next(subscript))
+      hoist_root(subscript->data, loop, assigned);
+    return expression;
+  }
+  if (expression->type != op)
+    return expression;
+
+  if (reads_variable(expression) && is_invariant(expression, assigned)) {
+    // a root that simplify left alone is about to point at the new node,
+    // so the node needs a copy of it or it would evaluate itself
+    if (expression->optimized != NULL) {
+      expression_t *copy = memory_calloc(MEMORY_AST, sizeof(*copy));
+      *copy = *expression;
+      copy->optimized = NULL;
+      expression = copy;
+    }
+    expression_t *hoisted = memory_calloc(MEMORY_AST, sizeof(*hoisted));
+    hoisted->type = invariant;
+    hoisted->parms.invariant.expression = expression;
+    loop->parms._for.invariants = lst_append(loop->parms._for.invariants, hoisted);
+    invariants_hoisted++;
+    return hoisted;
+  }
+
+  expression_t *p[3] = { NULL, NULL, NULL };
+  bool changed = false;
+  for (int i = 0; i < expression->parms.op.arity; i++) {
+    p[i] = hoist(expression->parms.op.p[i], loop, assigned);
+    changed = changed || p[i] != expression->parms.op.p[i];
+  }
+  return changed ? new_operator(expression, p) : expression;
+} /* hoist */
+
+static void hoist_root(expression_t *expression, statement_t *loop, list_t *assigned)
+{
+  if (expression == NULL)
+    return;
+  expression->optimized = hoist(expression->optimized != NULL ? expression->optimized : expression, loop, assigned);
+}
+
+static void hoist_variable(variable_t *variable, statement_t *loop, list_t *assigned)
+{
+  if (variable == NULL)
+    return;
+  for (list_t *subscript = variable->subscripts; subscript != NULL; subscript = lst_next(subscript))
+    hoist_root(subscript->data, loop, assigned);
+}
+
+void foreach_root(statement_t *statement, void (*function)(expression_t *root, void *user_data), void *user_data)
+{
+  list_t *items = NULL;
+  variable_t *variable = NULL;
+  switch (statement->type) {
+    case SET:
+      variable = statement->parms.set.variable;
+      function(statement->parms.set.expression, user_data);
+      break;
+    case FOR:
+      variable = statement->parms._for.variable;
+      function(statement->parms._for.begin, user_data);
+      function(statement->parms._for.end, user_data);
+      function(statement->parms._for.step, user_data);
+      break;
+    case IF:
+      function(statement->parms._if.condition, user_data);
+      break;
+    case ASK:
+      items = statement->parms.input;
+      break;
+    case TYPE:
+      items = statement->parms.print;
+      break;
+  }
+  if (variable != NULL)
+    for (list_t *subscript = variable->subscripts; subscript != NULL; subscript = lst_next(subscript))
+      function(subscript->data, user_data);
+  for (list_t *item = items; item != NULL; item = lst_next(item)) {
+    printitem_t *printitem = item->data;
+    if (printitem->expression != NULL)
+      function(printitem->expression, user_data);
+  }
+} /* foreach_root */
+
+/* clears the flag if a root has a call with a side effect */
+static void check_root(expression_t *root, void *user_data)
+{
+  if (root != NULL && !expression_is_pure(root))
+    *(bool *)user_data = false;
+}
+
+typedef struct {
+  statement_t *loop;
+  list_t *assigned;
+  bool storing;     // in an ASK, where a variable is a place to store
+} hoisting_t;
+
+static void hoist_statement_root(expression_t *root, void *user_data)
+{
+  hoisting_t *hoisting = user_data;
+  if (root == NULL)
+    return;
+  // an ASK stores into its variables, only their subscripts can be touched
+  if (hoisting->storing && root->type == variable)
+    hoist_variable(root->parms.variable, hoisting->loop, hoisting->assigned);
+  else
+    hoist_root(root, hoisting->loop, hoisting->assigned);
+}
+
+/** Looks for invariant expressions in the body of a FOR, which in FOCAL is
+ * always the rest of the line it is on. The loop is skipped if anything
+ * in the body could change a variable or leave the line, so only SET,
+ * ASK, TYPE and comments are allowed, and nothing with a side effect
+ * like FRAN or FOUT may be called.
+ *
+ * @param loop The FOR statement.
+ * @param body The statement after it.
+ * @param end The first statement on the next line.
+ */
+static void hoist_loop(statement_t *loop, list_t *body, list_t *end)
+{
+  list_t *assigned = lst_append(NULL, loop->parms._for.variable->name);
+  bool clean = true;
+
+  for (list_t *node = body; node != end && clean; node = lst_next(node)) {
+    statement_t *statement = node->data;
+    // an empty statement, from a doubled or trailing semicolon, does nothing,
+    // but at the end of the line it doesn't go back to the FOR either, so
+    // the body carries on into the lines after it
+    if (statement == NULL) {
+      if (lst_next(node) == end)
+        clean = false;
+      continue;
+    }
+    switch (statement->type) {
+      case SET:
+        assigned = lst_append(assigned, statement->parms.set.variable->name);
+        break;
+      case ASK:
+        for (list_t *item = statement->parms.input; item != NULL; item = lst_next(item)) {
+          printitem_t *printitem = item->data;
+          if (printitem->expression != NULL && printitem->expression->type == variable)
+            assigned = lst_append(assigned, printitem->expression->parms.variable->name);
+        }
+        break;
+      case TYPE:
+      case COMMENT:
+        break;
+      default:
+        // that includes another FOR, when it finishes the run carries on
+        // into the next line and comes back here from the end of that one
+        clean = false;
+        break;
+    }
+    foreach_root(statement, check_root, &clean);
+  }
+
+  if (clean) {
+    hoisting_t hoisting = { loop, assigned, false };
+    for (list_t *node = body; node != end; node = lst_next(node)) {
+      statement_t *statement = node->data;
+      if (statement == NULL)
+        continue;
+      hoisting.storing = statement->type == ASK;
+      foreach_root(statement, hoist_statement_root, &hoisting);
+    }
+  }
+  lst_free(assigned);
+} /* hoist_loop */
+
+/* a variable without subscripts, or a constant */
+static bool is_operand(const expression_t *expression)
+{
+  return expression->type == number || (expression->type == variable && expression->parms.variable->subscripts == NULL);
+}
+
+/* true for T e,! and T e!, with any number of commas, which print nothing */
+static bool is_type_line(list_t *items)
+{
+  printitem_t *first = items != NULL ? items->data : NULL;
+  if (first == NULL || first->expression == NULL)
+    return false;
+  for (list_t *item = lst_next(items); item != NULL; item = lst_next(item)) {
+    printitem_t *printitem = item->data;
+    if (printitem->expression != NULL || printitem->format != NULL)
+      return false;
+    if (printitem->separator == '!')
+      return lst_next(item) == NULL;
+    if (printitem->separator != ',')
+      return false;
+  }
+  return false;
+} /* is_type_line */
+
+/** Picks the fused form of a statement, if it has one. This looks at the
+ * optimized trees, so it has to come after folding and hoisting.
+ */
+static void fuse_statement(statement_t *statement)
+{
+  switch (statement->type) {
+    case SET:
+    {
+      variable_t *target = statement->parms.set.variable;
+      expression_t *value = statement->parms.set.expression->optimized;
+      if (target->subscripts == NULL && value->type == op && value->parms.op.arity == 2 &&
+          (value->parms.op.opcode == '+' || value->parms.op.opcode == '-') &&
+          value->parms.op.p[0]->type == variable && value->parms.op.p[0]->parms.variable->subscripts == NULL &&
+          strcmp(value->parms.op.p[0]->parms.variable->name, target->name) == 0 &&
+          value->parms.op.p[1]->type == number)
+        statement->fused = FUSED_INCREMENT;
+      else if (target->subscripts != NULL && lst_next(target->subscripts) == NULL)
+        statement->fused = FUSED_SET_ELEMENT;
+      break;
+    }
+    case IF:
+    {
+      expression_t *condition = statement->parms._if.condition->optimized;
+      if (condition->type == op && condition->parms.op.arity == 2 && condition->parms.op.opcode == '-' &&
+          is_operand(condition->parms.op.p[0]) && is_operand(condition->parms.op.p[1]))
+        statement->fused = FUSED_IF_DIFFERENCE;
+      break;
+    }
+    case TYPE:
+      if (is_type_line(statement->parms.print))
+        statement->fused = FUSED_TYPE_LINE;
+      break;
+    default:
+      break;
+  }
+  if (statement->fused != FUSED_NONE)
+    statements_fused++;
+} /* fuse_statement */
+
+void optimize_line(int line_index)
+{
+  list_t *head = interpreter_state.lines[line_index];
+  if (head == NULL)
+    return;
+  list_t *end = next_line_head(line_index);
+  // empty statements are left in the list with no data, so skip them
+  for (list_t *node = head; node != end; node = lst_next(node))
+    if (node->data != NULL)
+      optimize_statement(node->data);
+
+  for (list_t *node = head; node != end; node = lst_next(node)) {
+    statement_t *statement = node->data;
+    if (statement == NULL || statement->type != FOR || statement->parms._for.hoisted)
+      continue;
+    statement->parms._for.hoisted = true;
+    hoist_loop(statement, lst_next(node), end);
+  }
+
+  for (list_t *node = head; node != end; node = lst_next(node)) {
+    statement_t *statement = node->data;
+    if (statement != NULL && statement->fused == FUSED_NONE)
+      fuse_statement(statement);
+  }
+} /* optimize_line */
+
+void optimize_program(void)
+{
+  for (int i = interpreter_state.first_line_index; i < MAXLINE; i++)
+    optimize_line(i);
+} /* optimize_program */
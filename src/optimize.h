@@ -0,0 +1,118 @@
+/* optimizer (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __OPTIMIZE_H__
+#define __OPTIMIZE_H__
+
+#include "stdhdr.h"
+#include "retrofocal.h"
+
+/**
+ * @file optimize.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief Simplifies the expressions in a program before it runs.
+ *
+ * After parsing, each expression in the program is rewritten into a
+ * simpler one that gives the same result, and the new tree is hung off
+ * the original's optimized field where evaluate_expression will find it.
+ * The original is left alone, so WRITE and LIBRARY SAVE still print the
+ * program as it was typed, and program images still store the source.
+ *
+ * Subtrees made only of constants and the pure functions, FABS, FATN,
+ * FCOS, FEXP, FITR, FLOG, FSGN, FSIN and FSQT, are folded into a single
+ * constant, using the interpreter itself to do the arithmetic so the value
+ * is exactly what the run would have computed. FRAN, FIN, FOUT, FADC and
+ * the other functions that read or change something are never folded.
+ *
+ * A few identities are also removed: x*1, 1*x, x/1, x-0, x^1 and -(-x)
+ * become x, and x^2 becomes x*x when x is a variable. x+0 is not, because
+ * -0 plus 0 is +0.
+ *
+ * Last, the body of a FOR, which is always the rest of its line, is
+ * searched for parts that come out the same every time around the loop.
+ * Each is replaced by an invariant node that is evaluated the first time
+ * it is reached after the FOR is entered and then remembered. Nothing is
+ * reordered, so in S A(I)=A(I)*K/FSQT(M) only FSQT(M) is kept, since
+ * computing K/FSQT(M) first could round differently. A part is only
+ * invariant if it reads no variable that is set in the body, and a loop
+ * is left alone if its body has a DO, GOTO, IF, another FOR or a call
+ * with a side effect. A result that reported an error is not remembered,
+ * so the error is reported each time around, as it would have been.
+ *
+ * Finally, a few common statements are marked with a fused form that the
+ * interpreter runs directly, without walking the expression tree:
+ *
+ *   S X=X+c and S X=X-c, for a constant c, add or subtract in place
+ *   S A(I)=e stores straight into the element
+ *   I (X-Y) subtracts two variables or constants without a tree
+ *   T e,! prints a single value and ends the line
+ *
+ * These compute exactly what the statements would have, in the same order.
+ *
+--verify-optimizer evaluates every side-effect-free expression both
+ * ways, and reports an error if the results differ in any bit.
+ */
+
+extern bool use_optimizer;      // cleared by --no-optimize
+extern bool verify_optimizer;   // set by --verify-optimizer
+
+/* counts reported by -p and -w */
+extern int constants_folded;
+extern int identities_removed;
+extern int invariants_hoisted;
+extern int statements_fused;
+
+/* the fused forms, kept in a statement's fused field */
+typedef enum {
+  FUSED_NONE,
+  FUSED_INCREMENT,      // S X=X+c or S X=X-c
+  FUSED_SET_ELEMENT,    // S A(I)=e, with one subscript
+  FUSED_IF_DIFFERENCE,  // I (X-Y), with variables or constants either side
+  FUSED_TYPE_LINE       // T e,!
+} fused_t;
+
+/**
+ * Returns true if evaluating the expression has no effect other than
+ * producing its value, so that it can be evaluated twice.
+ */
+bool expression_is_pure(const expression_t *expression);
+
+/**
+ * Calls a function on each expression in a SET, FOR, IF, ASK or TYPE that is
+ * evaluated on its own, including the subscripts of the variable being
+ * set. For an ASK, that includes the variables being asked for.
+ */
+void foreach_root(statement_t *statement, void (*function)(expression_t *root, void *user_data), void *user_data);
+
+/**
+ * Optimizes the expressions on one line, as optimize_program does for all
+ * of them. Used when a line is typed in at the CLI.
+ */
+void optimize_line(int line_index);
+
+/**
+ * Optimizes every expression in the program. Expressions that have
+ * already been done are skipped, so it is cheap to call again after the
+ * program has been edited.
+ */
+void optimize_program(void);
+
+#endif /* __OPTIMIZE_H__ */
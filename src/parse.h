@@ -82,7 +82,12 @@
      FNEW = 298,
      FIN = 299,
      FOUT = 300,
-     VARLIST = 301
+     VARLIST = 301,
+     OPEN = 302,
+     INPUT = 303,
+     OUTPUT = 304,
+     RESTORE = 305,
+     CLOSE = 306
    };
 #endif
 /* Tokens.  */
@@ -130,6 +135,11 @@
 #define FIN 299
 #define FOUT 300
 #define VARLIST 301
+#define OPEN 302
+#define INPUT 303
+#define OUTPUT 304
+#define RESTORE 305
+#define CLOSE 306
 
 
 
@@ -27,6 +27,8 @@ Boston, MA 02111-1307, USA.  */
 
 #include "retrofocal.h"
 #include "statistics.h"
+#include "memstat.h"
+#include "program.h"
 
  /* used to track the line number being processed so
     that errors can report it */
@@ -50,7 +52,7 @@ int yylex(void);
 
 static statement_t *make_statement(int t)
 {
-  statement_t *new = malloc(sizeof(*new));
+  statement_t *new = memory_calloc(MEMORY_AST, sizeof(*new));
   new->type = t;
   new->abbreviated = true;  /* default to abbreviated (single character) */
   return new;
@@ -58,15 +60,24 @@ static statement_t *make_statement(int t)
 
 static statement_t *make_statement_with_abbrev(int t, bool abbrev)
 {
-  statement_t *new = malloc(sizeof(*new));
+  statement_t *new = memory_calloc(MEMORY_AST, sizeof(*new));
   new->type = t;
   new->abbreviated = abbrev;
   return new;
 }
 
+/* O INPUT "file" is short for O INPUT 1,"file" */
+static void set_open_channel(statement_t *new, expression_t *channel)
+{
+  if (channel != NULL && channel->type == string)
+    new->parms.open.filename = channel;
+  else
+    new->parms.open.channel = channel;
+}
+
 static expression_t *make_expression(expression_type_t t)
 {
-  expression_t *new = malloc(sizeof(*new));
+  expression_t *new = memory_calloc(MEMORY_AST, sizeof(*new));
   new->type = t;
   return new;
 }
@@ -101,8 +112,8 @@ static expression_t *make_operator(int arity, int o)
 
 %type <l> program line statements
 %type <l> printlist exprlist
-%type <i> printsep e2op term unary_op fn_0 fn_1
-%type <expression> expression expression2 expression3 expression4 function factor
+%type <i> printsep e2op term unary_op fn_0 fn_1 fn_display
+%type <expression> expression expression2 expression3 expression4 function factor fnew_args
 %type <statement> statement
 %type <variable> variable
 
@@ -168,6 +179,13 @@ static expression_t *make_operator(int arity, int o)
  // used internally
 %token VARLIST
 
+// FOCAL-71 file channels
+%token OPEN
+%token INPUT
+%token OUTPUT
+%token RESTORE
+%token CLOSE
+
 %%
 
 /* Grammar rules */
@@ -189,8 +207,12 @@ line:
     // even though it ends up mostly empty. to convert the X.Y format, we
     // simply multiply by 100 to shift the decimal so that 3.10 is line 310
     // however, due to decimal conversion, 5.10 might end up as 5.099999...
-    // and that would trunced to 5.09, so we have to round the result
-	  interpreter_state.lines[(int)round($1 * 100)] = $3;
+    // and that would trunced to 5.09, so we have to round the result.
+    // a line typed at the CLI goes straight into the running program
+    if (parse_in_cli_mode)
+      program_store_line((int)round($1 * 100), $3);
+    else
+	    interpreter_state.lines[(int)round($1 * 100)] = $3;
 	}       
 	;
 
@@ -442,6 +464,61 @@ statement:
     new->parms.library.action = 2;
     $$ = new;
   }
+  |  OPEN INPUT expression
+  {
+    statement_t *new = make_statement_with_abbrev(OPEN, last_keyword_abbreviated);
+    new->parms.open.action = 0;
+    set_open_channel(new, $3);
+    $$ = new;
+  }
+  |  OPEN INPUT expression ',' expression
+  {
+    statement_t *new = make_statement_with_abbrev(OPEN, last_keyword_abbreviated);
+    new->parms.open.action = 0;
+    new->parms.open.channel = $3;
+    new->parms.open.filename = $5;
+    $$ = new;
+  }
+  |  OPEN OUTPUT expression
+  {
+    statement_t *new = make_statement_with_abbrev(OPEN, last_keyword_abbreviated);
+    new->parms.open.action = 1;
+    set_open_channel(new, $3);
+    $$ = new;
+  }
+  |  OPEN OUTPUT expression ',' expression
+  {
+    statement_t *new = make_statement_with_abbrev(OPEN, last_keyword_abbreviated);
+    new->parms.open.action = 1;
+    new->parms.open.channel = $3;
+    new->parms.open.filename = $5;
+    $$ = new;
+  }
+  |  OPEN RESTORE INPUT
+  {
+    statement_t *new = make_statement_with_abbrev(OPEN, last_keyword_abbreviated);
+    new->parms.open.action = 2;
+    $$ = new;
+  }
+  |  OPEN RESTORE OUTPUT
+  {
+    statement_t *new = make_statement_with_abbrev(OPEN, last_keyword_abbreviated);
+    new->parms.open.action = 3;
+    $$ = new;
+  }
+  |  OPEN CLOSE
+  {
+    statement_t *new = make_statement_with_abbrev(OPEN, last_keyword_abbreviated);
+    new->parms.open.action = 4;
+    $$ = new;
+  }
+  |  OPEN CLOSE expression
+  {
+    statement_t *new = make_statement_with_abbrev(OPEN, last_keyword_abbreviated);
+    new->parms.open.action = 4;
+    set_open_channel(new, $3);
+    $$ = new;
+  }
   |  QUIT
   {
     statement_t *new = make_statement_with_abbrev(QUIT, last_keyword_abbreviated);
@@ -657,7 +734,134 @@ function:
 	  new->parms.op.p[0] = $3;
 	  $$ = new;
 	}
+  |
+  /* FDIS and FDXS plot a point at X,Y, or at Y with X sweeping across, see plot.h */
+  fn_display '(' expression ')'
+  {
+    expression_t *new = make_operator(1, $1);
+    new->parms.op.p[0] = $3;
+    $$ = new;
+  }
+  |
+  fn_display '[' expression ']'
+  {
+    expression_t *new = make_operator(1, $1);
+    new->parms.op.p[0] = $3;
+    $$ = new;
+  }
+  |
+  fn_display '<' expression '>'
+  {
+    expression_t *new = make_operator(1, $1);
+    new->parms.op.p[0] = $3;
+    $$ = new;
+  }
+  |
+  fn_display '(' expression ',' expression ')'
+  {
+    expression_t *new = make_operator(2, $1);
+    new->parms.op.p[0] = $3;
+    new->parms.op.p[1] = $5;
+    $$ = new;
+  }
+  |
+  fn_display '[' expression ',' expression ']'
+  {
+    expression_t *new = make_operator(2, $1);
+    new->parms.op.p[0] = $3;
+    new->parms.op.p[1] = $5;
+    $$ = new;
+  }
+  |
+  fn_display '<' expression ',' expression '>'
+  {
+    expression_t *new = make_operator(2, $1);
+    new->parms.op.p[0] = $3;
+    new->parms.op.p[1] = $5;
+    $$ = new;
+  }
+  |
+  /* FCOM reads the common area with one parameter and stores with two */
+  FCOM '(' expression ')'
+  {
+    expression_t *new = make_operator(1, FCOM);
+    new->parms.op.p[0] = $3;
+    $$ = new;
+  }
+  |
+  FCOM '[' expression ']'
+  {
+    expression_t *new = make_operator(1, FCOM);
+    new->parms.op.p[0] = $3;
+    $$ = new;
+  }
+  |
+  FCOM '<' expression '>'
+  {
+    expression_t *new = make_operator(1, FCOM);
+    new->parms.op.p[0] = $3;
+    $$ = new;
+  }
+  |
+  FCOM '(' expression ',' expression ')'
+  {
+    expression_t *new = make_operator(2, FCOM);
+    new->parms.op.p[0] = $3;
+    new->parms.op.p[1] = $5;
+    $$ = new;
+  }
+  |
+  FCOM '[' expression ',' expression ']'
+  {
+    expression_t *new = make_operator(2, FCOM);
+    new->parms.op.p[0] = $3;
+    new->parms.op.p[1] = $5;
+    $$ = new;
+  }
+  |
+  FCOM '<' expression ',' expression '>'
+  {
+    expression_t *new = make_operator(2, FCOM);
+    new->parms.op.p[0] = $3;
+    new->parms.op.p[1] = $5;
+    $$ = new;
+  }
+  |
+  /* FNEW calls a plugin function with any number of parameters, see plugin.h */
+  FNEW '(' fnew_args ')'
+  {
+    expression_t *new = make_operator(1, FNEW);
+    new->parms.op.p[0] = $3;
+    $$ = new;
+  }
+  |
+  FNEW '[' fnew_args ']'
+  {
+    expression_t *new = make_operator(1, FNEW);
+    new->parms.op.p[0] = $3;
+    $$ = new;
+  }
+  |
+  FNEW '<' fnew_args '>'
+  {
+    expression_t *new = make_operator(1, FNEW);
+    new->parms.op.p[0] = $3;
+    $$ = new;
+  }
 	;
+
+ /* the parameters of FNEW, chained together with ',' operators */
+fnew_args:
+  expression
+  |
+  expression ',' fnew_args
+  {
+    expression_t *new = make_operator(2, ',');
+    new->parms.op.p[0] = $1;
+    new->parms.op.p[1] = $3;
+    $$ = new;
+  }
+  ;
   
  /* arity-0 functions */
 fn_0:
@@ -670,19 +874,21 @@ fn_1:
   FABS { $$ = FABS; } |
   FADC { $$ = FADC; } |
   FATN { $$ = FATN; } |
-  FCOM { $$ = FCOM; } |
 	FCOS { $$ = FCOS; } |
   FEXP { $$ = FEXP; } |
-  FDIS { $$ = FDIS; } |
-  FDXS { $$ = FDXS; } |
   FITR { $$ = FITR; } |
   FLOG { $$ = FLOG; } |
-  FNEW { $$ = FNEW; } |
   FSQT { $$ = FSQT; } |
   FSGN { $$ = FSGN; } |
   FSIN { $$ = FSIN; } |
   FOUT { $$ = FOUT; }
   ;
+
+ /* the display functions, which take X and Y, or just Y */
+fn_display:
+  FDIS { $$ = FDIS; } |
+  FDXS { $$ = FDXS; }
+  ;
   
  /* ultimately all expressions end up here in factor, which is either a
     constant value, a variable value, or a parened expression. in
@@ -766,7 +972,7 @@ factor:
 variable:
   VARIABLE_NAME
   {
-	  variable_t *new = malloc(sizeof(*new));
+	  variable_t *new = memory_calloc(MEMORY_AST, sizeof(*new));
 	  new->name = $1;
 	  new->subscripts = NULL;
     $$ = new;
@@ -777,7 +983,7 @@ variable:
 	|
   VARIABLE_NAME '(' exprlist ')' // this assumes only () is allowed for subscripts, not <> or [], and only one-d arrays
   {
-    variable_t *new = malloc(sizeof(*new));
+    variable_t *new = memory_calloc(MEMORY_AST, sizeof(*new));
     new->name = $1;
     new->subscripts = $3;
     $$ = new;
@@ -788,7 +994,7 @@ variable:
 printlist:
   expression
   {
-    printitem_t *new = malloc(sizeof(*new));
+    printitem_t *new = memory_calloc(MEMORY_AST, sizeof(*new));
     new->expression = $1;
     new->separator = 0;
     $$ = lst_prepend(NULL, new);
@@ -796,7 +1002,7 @@ printlist:
   |
   printlist expression
   {
-    printitem_t *new = malloc(sizeof(*new));
+    printitem_t *new = memory_calloc(MEMORY_AST, sizeof(*new));
     new->expression = $2;
     new->separator = 0;
     $$ = lst_append($1, new);
@@ -805,7 +1011,7 @@ printlist:
   |
   printsep
   {
-    printitem_t *new = malloc(sizeof(*new));
+    printitem_t *new = memory_calloc(MEMORY_AST, sizeof(*new));
     new->expression = NULL;
     new->separator = $1;
     $$ = lst_prepend(NULL, new);
@@ -813,7 +1019,7 @@ printlist:
   |
   printlist printsep
   {
-    printitem_t *new = malloc(sizeof(*new));
+    printitem_t *new = memory_calloc(MEMORY_AST, sizeof(*new));
     new->expression = NULL;
     new->separator = $2;
     $$ = lst_append($1, new);
@@ -827,7 +1033,7 @@ printlist:
   |
   FMTSTR
   {
-    printitem_t *new = malloc(sizeof(*new));
+    printitem_t *new = memory_calloc(MEMORY_AST, sizeof(*new));
     new->expression = NULL;
     new->format = $1;
     $$ = lst_append(NULL, new);
@@ -835,7 +1041,7 @@ printlist:
   |
   printlist FMTSTR
   {
-    printitem_t *new = malloc(sizeof(*new));
+    printitem_t *new = memory_calloc(MEMORY_AST, sizeof(*new));
     new->expression = NULL;
     new->format = $2;
     $$ = lst_append($1, new);
@@ -844,7 +1050,7 @@ printlist:
   |
   '%'
   {
-    printitem_t *new = malloc(sizeof(*new));
+    printitem_t *new = memory_calloc(MEMORY_AST, sizeof(*new));
     new->expression = NULL;
     new->format = "-1";
     $$ = lst_prepend(NULL, new);
@@ -852,7 +1058,7 @@ printlist:
   |
   printlist '%'
   {
-    printitem_t *new = malloc(sizeof(*new));
+    printitem_t *new = memory_calloc(MEMORY_AST, sizeof(*new));
     new->expression = NULL;
     new->format = "-1";
     $$ = lst_prepend($1, new);
@@ -0,0 +1,292 @@
+/* display and A/D converter (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include "plot.h"
+#include "retrofocal.h"
+
+/* command line settings */
+char *plot_file = NULL;
+char *adc_file = NULL;
+
+/* bytes buffered for the plot file */
+#define PLOT_BUFFER (1024 * 1024)
+
+/* the colour of the phosphor */
+static const unsigned char phosphor[3] = { 0x44, 0xff, 0x44 };
+
+/* one entry in the display list */
+typedef struct {
+  double x, y;
+  bool line;
+} plot_entry_t;
+
+static FILE *plot = NULL;
+static char *plot_buffer = NULL;
+static bool vector = false;          // SVG rather than PPM
+static plot_entry_t *display = NULL;
+static int displayed = 0;            // entries in the display list
+static unsigned char *screen = NULL; // a byte for each point, for PPM
+static double pen_x = 0, pen_y = 0;  // the last point drawn
+static int sweep = 0;
+
+static double *samples = NULL;       // the values on every line, one after another
+static long *sample_start = NULL;    // where each line starts in samples, and one past the end
+static long sample_count = 0;        // lines
+static long next_sample[ADC_CHANNELS];
+
+/************************************************************************/
+
+/* cuts a line down to the part on the screen, false if there isn't one */
+static bool clip_line(double *x0, double *y0, double *x1, double *y1)
+{
+  double dx = *x1 - *x0, dy = *y1 - *y0;
+  double p[4] = { -dx, dx, -dy, dy };
+  double q[4] = { *x0, PLOT_SIZE - 1 - *x0, *y0, PLOT_SIZE - 1 - *y0 };
+  double t0 = 0, t1 = 1;
+  for (int i = 0; i < 4; i++) {
+    if (p[i] == 0) {
+      if (q[i] < 0)
+        return false;
+      continue;
+    }
+    double t = q[i] / p[i];
+    if (p[i] < 0) {
+      if (t > t1)
+        return false;
+      if (t > t0)
+        t0 = t;
+    } else {
+      if (t < t0)
+        return false;
+      if (t < t1)
+        t1 = t;
+    }
+  }
+  *x1 = *x0 + t1 * dx;
+  *y1 = *y0 + t1 * dy;
+  *x0 = *x0 + t0 * dx;
+  *y0 = *y0 + t0 * dy;
+  return true;
+} /* clip_line */
+
+static void light(long x, long y)
+{
+  if (x >= 0 && x < PLOT_SIZE && y >= 0 && y < PLOT_SIZE)
+    screen[(PLOT_SIZE - 1 - y) * PLOT_SIZE + x] = 1;
+} /* light */
+
+/* Bresenham's line, both ends included */
+static void draw_line(double from_x, double from_y, double to_x, double to_y)
+{
+  if (!clip_line(&from_x, &from_y, &to_x, &to_y))
+    return;
+  long x = lround(from_x), y = lround(from_y);
+  long x1 = lround(to_x), y1 = lround(to_y);
+  long dx = labs(x1 - x), dy = -labs(y1 - y);
+  int sx = x < x1 ? 1 : -1, sy = y < y1 ? 1 : -1;
+  long error = dx + dy;
+  for (;;) {
+    light(x, y);
+    if (x == x1 && y == y1)
+      break;
+    long twice = 2 * error;
+    if (twice >= dy) {
+      error += dy;
+      x += sx;
+    }
+    if (twice <= dx) {
+      error += dx;
+      y += sy;
+    }
+  }
+} /* draw_line */
+
+/* draws the display list and empties it */
+static void flush_display(void)
+{
+  if (displayed == 0)
+    return;
+  if (vector) {
+    // the whole batch is one path, a point is a line of no length, and a
+    // line only needs a move to the pen at the start of the path
+    fputs("<path d=\"", plot);
+    for (int i = 0; i < displayed; i++) {
+      plot_entry_t *entry = &display[i];
+      if (entry->line && i > 0)
+        fprintf(plot, "L%.6g %.6g", entry->x, PLOT_SIZE - 1 - entry->y);
+      else if (entry->line)
+        fprintf(plot, "M%.6g %.6gL%.6g %.6g", pen_x, PLOT_SIZE - 1 - pen_y, entry->x, PLOT_SIZE - 1 - entry->y);
+      else
+        fprintf(plot, "M%.6g %.6gh0", entry->x, PLOT_SIZE - 1 - entry->y);
+      pen_x = entry->x;
+      pen_y = entry->y;
+    }
+    fputs("\"/>\n", plot);
+  } else {
+    for (int i = 0; i < displayed; i++) {
+      plot_entry_t *entry = &display[i];
+      if (entry->line)
+        draw_line(pen_x, pen_y, entry->x, entry->y);
+      else
+        light(lround(entry->x), lround(entry->y));
+      pen_x = entry->x;
+      pen_y = entry->y;
+    }
+  }
+  displayed = 0;
+} /* flush_display */
+
+/* draws what's left and finishes the file */
+static void close_plot(void)
+{
+  flush_display();
+  if (vector)
+    fputs("</g>\n</svg>\n", plot);
+  else {
+    fprintf(plot, "P6\n%i %i\n255\n", PLOT_SIZE, PLOT_SIZE);
+    unsigned char row[PLOT_SIZE * 3];
+    for (int y = 0; y < PLOT_SIZE; y++) {
+      for (int x = 0; x < PLOT_SIZE; x++)
+        memcpy(&row[x * 3], screen[y * PLOT_SIZE + x] ? phosphor : (const unsigned char[3]){ 0, 0, 0 }, 3);
+      fwrite(row, 1, sizeof(row), plot);
+    }
+  }
+  if (fclose(plot) != 0)
+    fprintf(stderr, "Cannot write plot file: %s\n", plot_file);
+  plot = NULL;
+  free(plot_buffer);
+  free(display);
+  free(screen);
+} /* close_plot */
+
+static bool open_plot(void)
+{
+  plot = fopen(plot_file, "wb");
+  if (plot == NULL) {
+    fprintf(stderr, "Cannot open plot file: %s\n", plot_file);
+    return false;
+  }
+  plot_buffer = malloc(PLOT_BUFFER);
+  setvbuf(plot, plot_buffer, _IOFBF, PLOT_BUFFER);
+  display = malloc(PLOT_BATCH * sizeof(*display));
+
+  size_t length = strlen(plot_file);
+  vector = length >= 4 && strcasecmp(plot_file + length - 4, ".svg") == 0;
+  if (vector) {
+    fprintf(plot, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%i\" height=\"%i\" viewBox=\"0 0 %i %i\">\n", PLOT_SIZE, PLOT_SIZE, PLOT_SIZE, PLOT_SIZE);
+    fputs("<rect width=\"100%\" height=\"100%\" fill=\"black\"/>\n", plot);
+    fprintf(plot, "<g fill=\"none\" stroke=\"#%02x%02x%02x\" stroke-width=\"1\" stroke-linecap=\"square\">\n", phosphor[0], phosphor[1], phosphor[2]);
+  } else
+    screen = calloc(PLOT_SIZE * PLOT_SIZE, 1);
+
+  // terminate_retrofocal always goes through exit
+  atexit(close_plot);
+  return true;
+} /* open_plot */
+
+/* reads the whole sample file into memory */
+static bool read_samples(void)
+{
+  FILE *file = fopen(adc_file, "r");
+  if (file == NULL) {
+    fprintf(stderr, "Cannot open A/D sample file: %s\n", adc_file);
+    return false;
+  }
+  long allocated_lines = 0, allocated_values = 0, values = 0;
+  char line[ADC_CHANNELS * 64];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (sample_count + 1 >= allocated_lines) {
+      allocated_lines = allocated_lines == 0 ? 1024 : allocated_lines * 2;
+      sample_start = realloc(sample_start, allocated_lines * sizeof(long));
+    }
+    sample_start[sample_count] = values;
+    char *text = line;
+    for (int channel = 0; channel < ADC_CHANNELS; channel++) {
+      while (*text == ' ' || *text == '\t' || *text == ',')
+        text++;
+      char *end;
+      double value = strtod(text, &end);
+      if (end == text)
+        break;
+      text = end;
+      if (values == allocated_values) {
+        allocated_values = allocated_values == 0 ? 4096 : allocated_values * 2;
+        samples = realloc(samples, allocated_values * sizeof(double));
+      }
+      samples[values++] = value;
+    }
+    sample_count++;
+    sample_start[sample_count] = values;
+  }
+  fclose(file);
+  if (sample_count == 0) {
+    fprintf(stderr, "No samples in A/D sample file: %s\n", adc_file);
+    return false;
+  }
+  return true;
+} /* read_samples */
+
+/************************************************************************/
+
+bool plot_start(void)
+{
+  if (adc_file != NULL && !read_samples())
+    return false;
+  if (plot_file != NULL && !open_plot())
+    return false;
+  return true;
+} /* plot_start */
+
+double plot_point(double x, double y, bool line)
+{
+  if (plot == NULL || !isfinite(x) || !isfinite(y))
+    return 0;
+  if (displayed == PLOT_BATCH)
+    flush_display();
+  display[displayed].x = x;
+  display[displayed].y = y;
+  display[displayed].line = line;
+  displayed++;
+  return 0;
+} /* plot_point */
+
+double plot_sweep(double y, bool line)
+{
+  // like the beam, it doesn't draw on the way back to the left
+  double x = sweep;
+  sweep = (sweep + 1) % PLOT_SIZE;
+  return plot_point(x, y, line && x > 0);
+} /* plot_sweep */
+
+double adc_read(double channel)
+{
+  if (sample_start == NULL)
+    return 0;
+  if (!(channel >= 0 && channel < ADC_CHANNELS) || channel != floor(channel)) {
+    focal_error("Bad A/D channel");
+    return 0;
+  }
+  int number = (int)channel;
+  long line = next_sample[number];
+  next_sample[number] = (line + 1) % sample_count;
+  if (sample_start[line] + number >= sample_start[line + 1])
+    return 0;
+  return samples[sample_start[line] + number];
+} /* adc_read */
@@ -0,0 +1,103 @@
+/* display and A/D converter (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __PLOT_H__
+#define __PLOT_H__
+
+#include "stdhdr.h"
+
+/**
+ * @file plot.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief FDIS, FDXS and FADC, the display and the A/D converter.
+ *
+ * On a PDP-8 with a point-plotting scope and an A/D converter, FDIS and
+ * FDXS put points on the screen and FADC read a voltage. Here the screen
+ * is a file named with --plot-file, and the voltages come from a file of
+ * samples named with --adc-file.
+ *
+ * The screen is PLOT_SIZE points square, with 0,0 at the bottom left.
+ * FDIS(X,Y) plots a point at X,Y and FDXS(X,Y) draws a line to it from the
+ * last point plotted. With just one parameter, FDIS(Y) and FDXS(Y) use the
+ * sweep for X, which moves one point to the right each time and starts
+ * again at the left edge when it reaches the right. Points off the screen
+ * are not shown, lines that leave it are cut off at the edge. Both return
+ * zero.
+ *
+ * Programs that plot do it a point at a time, often millions of them, so
+ * the points are kept in a display list and only drawn PLOT_BATCH at a
+ * time, and when the program ends. A file ending in .svg gets a vector
+ * drawing, one path for each batch, written through a large buffer. Any
+ * other name gets a binary PPM image, drawn in memory and written once at
+ * the end.
+ *
+ * The sample file has one line for each sample, with the value for each
+ * A/D channel in turn, separated by spaces or commas. FADC(N) returns the
+ * next value for channel N, and each channel goes through the samples at
+ * its own pace, starting over after the last one. A channel with no value
+ * on a line reads zero there. The file is read when the program starts,
+ * so it can be the output of another program, like "<(gen)".
+ *
+ * Without the options the functions do nothing and return zero, as they
+ * always have, and so do programs translated with --emit-c.
+ */
+
+/* points across and up the screen */
+#define PLOT_SIZE 1024
+
+/* points kept in the display list before they're drawn */
+#define PLOT_BATCH 65536
+
+/* A/D channels FADC can read */
+#define ADC_CHANNELS 64
+
+/* command line settings */
+extern char *plot_file;       // --plot-file, where the screen is written
+extern char *adc_file;        // --adc-file, the samples FADC reads
+
+/**
+ * Opens the plot file and reads the samples. Call once after the options
+ * are parsed.
+ *
+ * @return false if either file could not be used, with a message printed.
+ */
+bool plot_start(void);
+
+/**
+ * Plots a point for FDIS(X,Y) and FDXS(X,Y).
+ *
+ * @param line True to draw a line to it from the last point, for FDXS.
+ * @return Zero.
+ */
+double plot_point(double x, double y, bool line);
+
+/**
+ * Plots a point at the sweep for FDIS(Y) and FDXS(Y), and moves the sweep
+ * on.
+ */
+double plot_sweep(double y, bool line);
+
+/**
+ * Reads the next sample on a channel, for FADC.
+ */
+double adc_read(double channel);
+
+#endif /* __PLOT_H__ */
@@ -0,0 +1,246 @@
+/* FNEW plugins (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include "plugin.h"
+#include "focalplugin.h"
+#include "array.h"
+#include "parse.h"
+
+#if !defined(WIN32) && !defined(_WIN32)
+#include <dlfcn.h>
+#endif
+
+/* command line settings */
+static list_t *plugin_files = NULL;
+
+/* a function registered by a plugin */
+typedef struct {
+  int selector;
+  const char *name;
+  const char *file;         // the plugin it came from, for messages
+  focal_function_t function;
+} plugin_function_t;
+
+static plugin_function_t *functions = NULL;
+static int function_count = 0;
+static const char *loading = NULL;   // the plugin being started
+
+/* a run of elements handed to a function, and what they were before it */
+typedef struct window_s {
+  variable_storage_t *storage;
+  int first, count;
+  double *values;
+  double *original;
+  struct window_s *next;
+} window_t;
+
+/* the call in progress, for the host functions to find their way back */
+typedef struct {
+  const focal_arg_t *argv;
+  variable_storage_t **storage;
+  int argc;
+  window_t *windows;
+} call_t;
+
+static call_t *current = NULL;
+
+/************************************************************************/
+
+/* the host side of focalplugin.h */
+
+static int host_define(int selector, const char *name, focal_function_t function)
+{
+  for (int i = 0; i < function_count; i++)
+    if (functions[i].selector == selector) {
+      fprintf(stderr, "FNEW %i is already %s from %s, %s from %s was not added.\n", selector, functions[i].name, functions[i].file, name, loading);
+      return 0;
+    }
+  functions = realloc(functions, (function_count + 1) * sizeof(*functions));
+  functions[function_count].selector = selector;
+  functions[function_count].name = name;
+  functions[function_count].file = loading;
+  functions[function_count].function = function;
+  function_count++;
+  return 1;
+} /* host_define */
+
+static double *host_elements(const focal_arg_t *arg, int count)
+{
+  if (current == NULL || arg < current->argv || arg >= current->argv + current->argc)
+    return NULL;
+  variable_storage_t *storage = current->storage[arg - current->argv];
+  if (storage == NULL || count < 1 || count > ARRAY_LAST - arg->subscript + 1)
+    return NULL;
+
+  window_t *window = malloc(sizeof(*window));
+  window->storage = storage;
+  window->first = arg->subscript;
+  window->count = count;
+  window->values = malloc(count * sizeof(double));
+  window->original = malloc(count * sizeof(double));
+  array_read_run(storage->array, window->first, count, window->values);
+  // element 0 is the variable itself, which the array doesn't hold
+  if (window->first <= 0 && window->first + count > 0)
+    window->values[-window->first] = storage->value->number;
+  memcpy(window->original, window->values, count * sizeof(double));
+  window->next = current->windows;
+  current->windows = window;
+  return window->values;
+} /* host_elements */
+
+static void host_error(const char *message)
+{
+  focal_error(message);
+} /* host_error */
+
+static const focal_host_t host = {
+  FOCAL_PLUGIN_VERSION,
+  host_define,
+  host_elements,
+  host_error
+};
+
+/* stores the elements the function changed and frees the windows. only
+   the ones that changed, so a sparse array isn't filled in with zeros,
+   and the oldest window last, so when two overlap the first one asked
+   for wins */
+static void close_windows(window_t *window)
+{
+  while (window != NULL) {
+    window_t *next = window->next;
+    for (int i = 0; i < window->count; i++)
+      if (memcmp(&window->values[i], &window->original[i], sizeof(double)) != 0)
+        element_slot(window->storage, window->first + i, true)->number = window->values[i];
+    free(window->values);
+    free(window->original);
+    free(window);
+    window = next;
+  }
+} /* close_windows */
+
+/************************************************************************/
+
+void plugin_add(char *file)
+{
+  plugin_files = lst_append(plugin_files, file);
+} /* plugin_add */
+
+#if !defined(WIN32) && !defined(_WIN32)
+bool plugin_start(void)
+{
+  for (list_t *item = plugin_files; item != NULL; item = lst_next(item)) {
+    loading = item->data;
+    // the libraries stay loaded until the program exits
+    void *library = dlopen(loading, RTLD_NOW | RTLD_LOCAL);
+    if (library == NULL) {
+      fprintf(stderr, "Cannot load plugin: %s\n", dlerror());
+      return false;
+    }
+    focal_plugin_init_t init = (focal_plugin_init_t)dlsym(library, FOCAL_PLUGIN_INIT);
+    if (init == NULL) {
+      fprintf(stderr, "Not a RetroFOCAL plugin: %s\n", loading);
+      return false;
+    }
+    if (!init(&host)) {
+      fprintf(stderr, "Plugin %s could not start.\n", loading);
+      return false;
+    }
+  }
+  loading = NULL;
+  return true;
+} /* plugin_start */
+#else
+bool plugin_start(void)
+{
+  if (plugin_files == NULL)
+    return true;
+  fprintf(stderr, "--plugin is not supported on this platform.\n");
+  return false;
+} /* plugin_start */
+#endif
+
+/* the number of arguments in the chain */
+static int argument_count(const expression_t *arguments)
+{
+  int count = 1;
+  while (arguments->type == op && arguments->parms.op.arity == 2 && arguments->parms.op.opcode == ',') {
+    arguments = arguments->parms.op.p[1];
+    count++;
+  }
+  return count;
+} /* argument_count */
+
+/* evaluates one argument, noting where it is if it's an element */
+static void evaluate_argument(expression_t *argument, focal_arg_t *arg, variable_storage_t **storage)
+{
+  arg->array = NULL;
+  arg->subscript = 0;
+  *storage = NULL;
+
+  // anything but a single subscript is evaluated the usual way
+  if (argument->type != variable || argument->parms.variable->subscripts == NULL || lst_next(argument->parms.variable->subscripts) != NULL) {
+    arg->value = expression_value(argument);
+    return;
+  }
+
+  // the same steps as variable_slot, keeping the subscript
+  variable_t *variable = argument->parms.variable;
+  double subscript = expression_value(variable->subscripts->data);
+  *storage = variable_storage(variable);
+  arg->value = element_slot(*storage, subscript, false)->number;
+  arg->array = variable->name;
+  // element_slot has reported a bad subscript and used element 0
+  arg->subscript = subscript < ARRAY_FIRST || subscript > ARRAY_LAST ? 0 : (int)subscript;
+} /* evaluate_argument */
+
+double plugin_call(expression_t *arguments)
+{
+  // the selector and arguments are all evaluated, even if nothing is called
+  int argc = argument_count(arguments) - 1;
+  double selector = expression_value(argc > 0 ? arguments->parms.op.p[0] : arguments);
+  focal_arg_t argv[argc > 0 ? argc : 1];
+  variable_storage_t *storage[argc > 0 ? argc : 1];
+  expression_t *rest = arguments;
+  for (int i = 0; i < argc; i++) {
+    rest = rest->parms.op.p[1];
+    bool last = i == argc - 1;
+    evaluate_argument(last ? rest : rest->parms.op.p[0], &argv[i], &storage[i]);
+  }
+
+  if (function_count == 0)
+    return 0;
+  plugin_function_t *function = NULL;
+  for (int i = 0; i < function_count; i++)
+    if (functions[i].selector == (int)selector)
+      function = &functions[i];
+  if (function == NULL) {
+    focal_error("Unknown FNEW function");
+    return 0;
+  }
+
+  // the arguments can call FNEW too, but are all done by the time we get here
+  call_t call = { argv, storage, argc, NULL };
+  call_t *caller = current;
+  current = &call;
+  double result = function->function(&host, argc, argv);
+  current = caller;
+  close_windows(call.windows);
+  return result;
+} /* plugin_call */
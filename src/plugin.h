@@ -0,0 +1,70 @@
+/* FNEW plugins (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __PLUGIN_H__
+#define __PLUGIN_H__
+
+#include "stdhdr.h"
+#include "retrofocal.h"
+
+/**
+ * @file plugin.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief FNEW, calling native functions in shared libraries.
+ *
+ * Each --plugin names a shared library that registers functions under
+ * numbers, and FNEW(S,X,Y...) calls the one registered as S. The
+ * interface the libraries see is in plugins/focalplugin.h, this is the
+ * interpreter's side of it.
+ *
+ * The parser keeps FNEW's arguments as a chain of ',' operators, so
+ * FNEW(S,X,Y) has one parameter, S ',' (X ',' Y). The chain is only ever
+ * evaluated here, one argument at a time from left to right, and the
+ * optimizer and compiler leave FNEW to the tree walker because the
+ * function can store into arrays.
+ *
+ * Without any plugins FNEW returns zero, as it always has. With them, a
+ * selector nobody registered is an error.
+ */
+
+/**
+ * Adds a library to be loaded by plugin_start, for --plugin.
+ */
+void plugin_add(char *file);
+
+/**
+ * Loads the libraries from --plugin, in the order given. Call once after
+ * the options are parsed.
+ *
+ * @return false if one could not be loaded or refused to start, with a
+ *         message printed.
+ */
+bool plugin_start(void);
+
+/**
+ * Evaluates FNEW's arguments and calls the function for its selector.
+ *
+ * @param arguments FNEW's parameter, the chain of arguments.
+ * @return The function's result, or zero.
+ */
+double plugin_call(expression_t *arguments);
+
+#endif /* __PLUGIN_H__ */
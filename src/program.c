@@ -0,0 +1,242 @@
+/* program line store (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include <stdint.h>
+
+#include "program.h"
+#include "retrofocal.h"
+#include "optimize.h"
+
+/* a bit for each line in use, and a bit for each word of those that
+   isn't zero, so finding a neighbour looks at a few words at most */
+#define LINE_WORDS ((MAXLINE + 63) / 64)
+#define SUMMARY_WORDS ((LINE_WORDS + 63) / 64)
+
+long program_generation = 0;
+
+static uint64_t lines_used[LINE_WORDS];
+static uint64_t words_used[SUMMARY_WORDS];
+
+#if defined(__GNUC__)
+#define lowest_bit(bits) __builtin_ctzll(bits)
+#define highest_bit(bits) (63 - __builtin_clzll(bits))
+#else
+static int lowest_bit(uint64_t bits)
+{
+  int bit = 0;
+  while (!(bits & 1)) {
+    bits >>= 1;
+    bit++;
+  }
+  return bit;
+} /* lowest_bit */
+
+static int highest_bit(uint64_t bits)
+{
+  int bit = 63;
+  while (!(bits & ((uint64_t)1 << 63))) {
+    bits <<= 1;
+    bit--;
+  }
+  return bit;
+} /* highest_bit */
+#endif
+
+static void mark_line(int line_index, bool used)
+{
+  int word = line_index / 64;
+  uint64_t bit = (uint64_t)1 << (line_index % 64);
+  if (used)
+    lines_used[word] |= bit;
+  else
+    lines_used[word] &= ~bit;
+  bit = (uint64_t)1 << (word % 64);
+  if (lines_used[word] != 0)
+    words_used[word / 64] |= bit;
+  else
+    words_used[word / 64] &= ~bit;
+} /* mark_line */
+
+/* the last statement of a line, which is followed by end or nothing */
+static list_t *line_end(list_t *head, list_t *end)
+{
+  list_t *node = head;
+  while (node->next != NULL && node->next != end)
+    node = node->next;
+  return node;
+} /* line_end */
+
+/* the first line in use, or MAXLINE - 1 if there are none, as always */
+static void set_first_line(void)
+{
+  int first_line = program_next_line(-1);
+  interpreter_state.first_line_index = first_line < MAXLINE ? first_line : MAXLINE - 1;
+} /* set_first_line */
+
+/************************************************************************/
+
+int program_next_line(int line_index)
+{
+  int start = line_index + 1;
+  if (start >= MAXLINE)
+    return MAXLINE;
+  int word = start / 64;
+  uint64_t bits = lines_used[word] & (~(uint64_t)0 << (start % 64));
+  if (bits != 0)
+    return word * 64 + lowest_bit(bits);
+
+  // no more in this word, so find the next word with any
+  for (word++; word < LINE_WORDS; word = (word | 63) + 1) {
+    bits = words_used[word / 64] & (~(uint64_t)0 << (word % 64));
+    if (bits != 0) {
+      word = (word / 64) * 64 + lowest_bit(bits);
+      return word * 64 + lowest_bit(lines_used[word]);
+    }
+  }
+  return MAXLINE;
+} /* program_next_line */
+
+int program_previous_line(int line_index)
+{
+  int end = (line_index > MAXLINE ? MAXLINE : line_index) - 1;
+  if (end < 0)
+    return -1;
+  int word = end / 64;
+  uint64_t bits = lines_used[word] & (~(uint64_t)0 >> (63 - end % 64));
+  if (bits != 0)
+    return word * 64 + highest_bit(bits);
+
+  for (word--; word >= 0; word = (word & ~63) - 1) {
+    bits = words_used[word / 64] & (~(uint64_t)0 >> (63 - word % 64));
+    if (bits != 0) {
+      word = (word / 64) * 64 + highest_bit(bits);
+      return word * 64 + highest_bit(lines_used[word]);
+    }
+  }
+  return -1;
+} /* program_previous_line */
+
+void program_link(void)
+{
+  list_t **lines = interpreter_state.lines;
+  memset(lines_used, 0, sizeof(lines_used));
+  memset(words_used, 0, sizeof(words_used));
+  for (int i = 0; i < MAXLINE; i++)
+    if (lines[i] != NULL)
+      mark_line(i, true);
+
+  // point the end of each line at the start of the next
+  list_t *tail = NULL;
+  for (int i = program_next_line(-1), next; i < MAXLINE; i = next) {
+    next = program_next_line(i);
+    list_t *end = line_end(lines[i], next < MAXLINE ? lines[next] : NULL);
+    for (list_t *node = lines[i]; ; node = node->next) {
+      if (node->data != NULL)
+        ((statement_t *)node->data)->line = i;
+      if (node == end)
+        break;
+    }
+    lines[i]->prev = tail;
+    if (tail != NULL)
+      tail->next = lines[i];
+    tail = end;
+  }
+  if (tail != NULL)
+    tail->next = NULL;
+  set_first_line();
+  program_generation++;
+} /* program_link */
+
+void program_store_line(int line_index, list_t *statements)
+{
+  list_t **lines = interpreter_state.lines;
+
+  // the CLI's immediate line runs on its own, it isn't part of the program
+  if (line_index == 0) {
+    for (list_t *node = statements; node != NULL; node = node->next)
+      if (node->data != NULL)
+        ((statement_t *)node->data)->line = 0;
+    lines[0] = statements;
+    interpreter_state.current_statement = lines[interpreter_state.first_line_index];
+    return;
+  }
+
+  int previous = program_previous_line(line_index);
+  int next = program_next_line(line_index);
+  list_t *after = next < MAXLINE ? lines[next] : NULL;
+  list_t *before = previous >= 0 ? line_end(lines[previous], lines[line_index] != NULL ? lines[line_index] : after) : NULL;
+
+  // cut the old line loose
+  if (lines[line_index] != NULL) {
+    line_end(lines[line_index], after)->next = NULL;
+    lines[line_index]->prev = NULL;
+  }
+
+  // and put the new one, or nothing, between its neighbours
+  list_t *head = after, *tail = before;
+  if (statements != NULL) {
+    head = statements;
+    for (tail = statements; ; tail = tail->next) {
+      if (tail->data != NULL)
+        ((statement_t *)tail->data)->line = line_index;
+      if (tail->next == NULL)
+        break;
+    }
+    head->prev = before;
+    tail->next = after;
+  }
+  if (before != NULL)
+    before->next = head;
+  if (after != NULL)
+    after->prev = tail;
+  lines[line_index] = statements;
+  mark_line(line_index, statements != NULL);
+  program_generation++;
+
+  set_first_line();
+  interpreter_state.current_statement = lines[interpreter_state.first_line_index];
+  if (use_optimizer && statements != NULL)
+    optimize_line(line_index);
+} /* program_store_line */
+
+int program_line_of(const list_t *node)
+{
+  // back up to the nearest statement that knows its line
+  const list_t *start = node;
+  while (start->data == NULL && start->prev != NULL)
+    start = start->prev;
+  int line;
+  if (start->data != NULL) {
+    line = ((const statement_t *)start->data)->line;
+    start = start->next;
+  }
+  else
+    line = start == interpreter_state.lines[0] ? 0 : -1;
+
+  // and come forward again, moving on a line each time one starts
+  for (const list_t *step = start; ; step = step->next) {
+    int next = program_next_line(line);
+    if (next < MAXLINE && step == interpreter_state.lines[next])
+      line = next;
+    if (step == node)
+      break;
+  }
+  return line;
+} /* program_line_of */
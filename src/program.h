@@ -0,0 +1,97 @@
+/* program line store (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __PROGRAM_H__
+#define __PROGRAM_H__
+
+#include "stdhdr.h"
+#include "list.h"
+
+/**
+ * @file program.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief Linking the lines of the program together, and editing them.
+ *
+ * The program is kept in interpreter_state.lines, one statement list for
+ * each line number, and the lists are chained into one so the run loop
+ * can step from the end of a line to the start of the next. Each
+ * statement also knows which line it is on, which is how the run loop
+ * tells where a line or group ends and how errors report the line.
+ *
+ * program_link chains a program that has just been read in, in one pass.
+ * After that, lines typed at the CLI, deleted or erased go through
+ * program_store_line, which only unhooks the line from its neighbours and
+ * hooks in the new one. The line before and after are found with a bitmap
+ * of the lines in use, a word at a time, so an edit costs the same in a
+ * program of ten lines or two thousand, and nothing has to be done to the
+ * rest of the program before it runs again.
+ */
+
+/* counts changes to the program, for anything that keeps work which
+   depends on it, like the CLI's parsed commands */
+extern long program_generation;
+
+/**
+ * Chains the lines of a program that has just been parsed or loaded, and
+ * sets the first line. Lines that are already chained are left as they
+ * are.
+ */
+void program_link(void);
+
+/**
+ * Puts a line in the program, replacing any line with the same number, or
+ * removes it if @p statements is NULL. The line is optimized if the
+ * optimizer is on.
+ *
+ * Line 0 is the CLI's immediate line, which is stored but not chained to
+ * the program, so it runs on its own.
+ *
+ * The old line is unhooked but not freed, something like a DO stopped by
+ * an error may still point into it. The caller can free it if it knows
+ * better, as the CLI does with its immediate line.
+ *
+ * @param line_index The line, in xx.yy * 100 format.
+ * @param statements The new statements, not chained to anything.
+ */
+void program_store_line(int line_index, list_t *statements);
+
+/**
+ * Returns the next line in use after @p line_index, or MAXLINE if there
+ * isn't one. Pass -1 to get the first line.
+ */
+int program_next_line(int line_index);
+
+/**
+ * Returns the last line in use before @p line_index, or -1 if there isn't
+ * one.
+ */
+int program_previous_line(int line_index);
+
+/**
+ * Returns the line a statement is on, or -1 if it can't be found. Most
+ * statements know their line, this is for the empty ones left by a
+ * doubled or trailing semicolon, which have no statement_t to keep it in.
+ *
+ * @param node The statement's node in the program.
+ */
+int program_line_of(const list_t *node);
+
+#endif /* __PROGRAM_H__ */
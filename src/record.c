@@ -0,0 +1,229 @@
+/* record and replay (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include <stdint.h>
+
+#include "record.h"
+#include "retrofocal.h"
+#include "io.h"
+#include "rng.h"
+
+/* command line settings */
+char *record_file = NULL;
+char *replay_file = NULL;
+
+#define RECORD_VERSION 1
+static const unsigned char record_magic[4] = { 'F', 'C', 'R', 0x1A };
+
+/* entry tags */
+#define TAG_ASK     'A'
+#define TAG_FIN     'F'
+#define TAG_FRAN    'R'
+#define TAG_JIFFIES 'J'
+#define TAG_COMMON  'C'
+
+static FILE *log_file = NULL;
+static bool replaying = false;
+
+static void close_log(void)
+{
+  if (log_file != NULL)
+    fclose(log_file);
+  log_file = NULL;
+}
+
+/* the log is little-endian, the same as program images */
+static void put_u32(uint32_t value)
+{
+  for (int i = 0; i < 4; i++)
+    fputc((value >> (i * 8)) & 0xFF, log_file);
+}
+
+static uint32_t get_u32(void)
+{
+  uint32_t value = 0;
+  for (int i = 0; i < 4; i++) {
+    int c = fgetc(log_file);
+    if (c == EOF)
+      return 0;
+    value |= (uint32_t)c << (i * 8);
+  }
+  return value;
+}
+
+/** Reads the next tag and makes sure it's the one the program is asking
+ * for. Any difference means the program or its flags changed since the
+ * log was recorded, and nothing after that point can be trusted.
+ */
+static void expect(int tag)
+{
+  int found = fgetc(log_file);
+  if (found == tag)
+    return;
+  if (found == EOF)
+    fprintf(stderr, "\nReplay log %s ended before the program did.\n", replay_file);
+  else
+    fprintf(stderr, "\nReplay log %s does not match the program, expected '%c' but found '%c'.\n", replay_file, tag, found);
+  terminate_retrofocal(EXIT_FAILURE);
+}
+
+bool record_start(void)
+{
+  unsigned char header[6];
+
+  if (replay_file != NULL) {
+    log_file = fopen(replay_file, "rb");
+    if (log_file == NULL) {
+      fprintf(stderr, "Cannot open replay log: %s\n", replay_file);
+      return false;
+    }
+    if (fread(header, 1, sizeof(header), log_file) != sizeof(header) || memcmp(header, record_magic, 4) != 0) {
+      fprintf(stderr, "Not a RetroFOCAL replay log: %s\n", replay_file);
+      return false;
+    }
+    if ((header[4] | (header[5] << 8)) != RECORD_VERSION) {
+      fprintf(stderr, "Replay log %s is version %i, this version of RetroFOCAL reads %i.\n", replay_file, header[4] | (header[5] << 8), RECORD_VERSION);
+      return false;
+    }
+    replaying = true;
+  }
+  else if (record_file != NULL) {
+    log_file = fopen(record_file, "wb");
+    if (log_file == NULL) {
+      fprintf(stderr, "Cannot open file for writing: %s\n", record_file);
+      return false;
+    }
+    memcpy(header, record_magic, 4);
+    header[4] = RECORD_VERSION & 0xFF;
+    header[5] = (RECORD_VERSION >> 8) & 0xFF;
+    fwrite(header, 1, sizeof(header), log_file);
+  }
+  else
+    return true;
+
+  // terminate_retrofocal always goes through exit, so this catches every way out
+  atexit(close_log);
+  return true;
+} /* record_start */
+
+int record_input_line(char *buffer, size_t size)
+{
+  // an ASK entry is the result code, then the length and text of the line
+  if (replaying) {
+    expect(TAG_ASK);
+    int result = (signed char)fgetc(log_file);
+    uint32_t length = get_u32();
+    if (length >= size)
+      length = size - 1;
+    if (fread(buffer, 1, length, log_file) != length) {
+      fprintf(stderr, "\nReplay log %s is truncated.\n", replay_file);
+      terminate_retrofocal(EXIT_FAILURE);
+    }
+    buffer[length] = '\0';
+    return result;
+  }
+
+  int result = raw_mode_input_line(buffer, size);
+  if (log_file != NULL) {
+    uint32_t length = result == 1 ? (uint32_t)strlen(buffer) : 0;
+    fputc(TAG_ASK, log_file);
+    fputc((unsigned char)(signed char)result, log_file);
+    put_u32(length);
+    fwrite(buffer, 1, length, log_file);
+    // the user may be about to kill us, so don't lose what they typed
+    fflush(log_file);
+  }
+  return result;
+} /* record_input_line */
+
+int record_input_char(void)
+{
+  if (replaying) {
+    expect(TAG_FIN);
+    return (int)get_u32();
+  }
+
+  int c = getchar();
+  if (log_file != NULL) {
+    fputc(TAG_FIN, log_file);
+    put_u32((uint32_t)c);
+  }
+  return c;
+} /* record_input_char */
+
+double record_random(void)
+{
+  uint64_t bits = 0;
+  double value;
+
+  // the generator moves on even when replaying, so a checkpoint taken
+  // during the replay holds the state a recorded run would have had
+  value = rng_next();
+
+  // the exact bits are kept so the replayed value is identical
+  if (replaying) {
+    expect(TAG_FRAN);
+    bits = get_u32();
+    bits |= (uint64_t)get_u32() << 32;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  if (log_file != NULL) {
+    memcpy(&bits, &value, sizeof(bits));
+    fputc(TAG_FRAN, log_file);
+    put_u32((uint32_t)(bits & 0xFFFFFFFF));
+    put_u32((uint32_t)(bits >> 32));
+  }
+  return value;
+} /* record_random */
+
+int record_jiffies(int jiffies)
+{
+  if (replaying) {
+    expect(TAG_JIFFIES);
+    return (int)get_u32();
+  }
+  if (log_file != NULL) {
+    fputc(TAG_JIFFIES, log_file);
+    put_u32((uint32_t)jiffies);
+  }
+  return jiffies;
+} /* record_jiffies */
+
+double record_common(double value)
+{
+  uint64_t bits = 0;
+
+  if (replaying) {
+    expect(TAG_COMMON);
+    bits = get_u32();
+    bits |= (uint64_t)get_u32() << 32;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+  if (log_file != NULL) {
+    memcpy(&bits, &value, sizeof(bits));
+    fputc(TAG_COMMON, log_file);
+    put_u32((uint32_t)(bits & 0xFFFFFFFF));
+    put_u32((uint32_t)(bits >> 32));
+  }
+  return value;
+} /* record_common */
@@ -0,0 +1,89 @@
+/* record and replay (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __RECORD_H__
+#define __RECORD_H__
+
+#include "stdhdr.h"
+
+/**
+ * @file record.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief Deterministic record and replay of a program's inputs.
+ *
+ * Everything a running program can see that isn't in its source passes
+ * through here: lines typed at ASK, characters read by FIN, the results
+ * of FRAN, readings of the clock and numbers read from FCOM. With
+ * --record each one is appended to a compact binary log as it happens,
+ * and with --replay they are read back from the log instead, so the run
+ * behaves identically without a terminal, a keyboard, the C library's
+ * random number generator or the other programs sharing the common area.
+ *
+ * The log is a four byte magic number and a version, followed by one
+ * tagged entry per input in the order the program consumed them.
+ */
+
+extern char *record_file;     // --record, log the inputs to this file
+extern char *replay_file;     // --replay, read the inputs from this file
+
+/**
+ * Opens the record or replay log, if either was requested. Call once
+ * after the options are parsed.
+ *
+ * @return false if the log could not be opened.
+ */
+bool record_start(void);
+
+/**
+ * Reads a line for ASK. Takes the same parameters and returns the same
+ * results as raw_mode_input_line.
+ */
+int record_input_line(char *buffer, size_t size);
+
+/**
+ * Reads a single character for FIN.
+ *
+ * @return The character, or EOF.
+ */
+int record_input_char(void);
+
+/**
+ * Returns the next random number for FRAN, between 0 and 1.
+ */
+double record_random(void);
+
+/**
+ * Passes a clock reading through the log.
+ *
+ * @param jiffies The time just read.
+ * @return @p jiffies, or the recorded reading when replaying.
+ */
+int record_jiffies(int jiffies);
+
+/**
+ * Passes a number read from the common area through the log.
+ *
+ * @param value The number just read.
+ * @return @p value, or the recorded number when replaying.
+ */
+double record_common(double value);
+
+#endif /* __RECORD_H__ */
@@ -30,6 +30,22 @@ Boston, MA 02111-1307, USA.  */
 #include "parse.h"
 #include "io.h"
 #include "write.h"
+#include "loader.h"
+#include "image.h"
+#include "record.h"
+#include "memstat.h"
+#include "array.h"
+#include "number.h"
+#include "optimize.h"
+#include "tier.h"
+#include "jit.h"
+#include "vector.h"
+#include "fmath.h"
+#include "common.h"
+#include "plugin.h"
+#include "channel.h"
+#include "plot.h"
+#include "program.h"
 
 /* Portable timersub macro for Windows/MinGW compatibility */
 #ifndef timersub
@@ -57,6 +73,16 @@ bool type_equals = false;								// print the = in TYPEs
 bool type_space = true;								  // print a leading space in TYPE
 bool upper_case = true;          				// force ASK input to upper case, which is generally the case for DEC
 int random_seed = -1;              		  // reset with RANDOMIZE, if -1 then auto-seeds
+bool compile_program = false;           // write a program image instead of running
+long checkpoint_interval = 0;           // statements between checkpoints, 0 for none
+char *checkpoint_file = NULL;           // where checkpoints are written
+bool resumed_run = false;               // the run state came from a checkpoint, don't reset it
+long max_statements = 0;                // stop after this many statements, 0 for no limit
+double max_time = 0;                    // ... or this many seconds
+int max_stack_depth = 0;                // ... or when DO and FOR nest this deep
+const char *limit_reached = NULL;       // which of those stopped the run, if any
+long long statements_run = 0;           // statements performed in the last run
+
 
 char *source_file = "";
 char *input_file = "";
@@ -83,13 +109,32 @@ typedef struct {
 
 /* forward declares */
 static value_t evaluate_expression(expression_t *e);
+static value_t verified_value(expression_t *expression);
 static double line_for_statement(const list_t *s);
 static double current_line(void);
+static void stop_at_limit(const char *limit);
 
 static void print_variables(void);
 void delete_variables(void);
 static void delete_lines(void);
 
+/* the run loop counts this down to zero between checks of the limits and
+   checkpoints, countdown_length is where it started */
+static long countdown, countdown_length;
+
+/* bumped whenever a variable's storage is freed, so pointers to it that
+   were kept by a FOR know they have to look it up again */
+static long variable_generation = 0;
+
+/* calls to focal_error, to see if an evaluation failed */
+static long errors_reported = 0;
+
+/* set by --verify-optimizer while it evaluates the source expressions */
+static bool evaluating_source = false;
+
+/* how often the clock is read when there's a time limit */
+#define TIME_CHECK_INTERVAL 10000
+
 /* defitions of variables used by the static analyzer */
 clock_t start_ticks = 0, end_ticks = 0;	// start and end ticks, for calculating CPU time
 struct timeval start_time, end_time;    // start and end clock, for total run time
@@ -102,115 +147,176 @@ struct timeval reset_time;     					// if the user resets the time with TIME$, t
  *
  * @param message The error message.
  */
-static void focal_error(const char *message)
+void focal_error(const char *message)
 {
+  errors_reported++;
   fprintf(stderr, "%s at line %2.2f\n", message, current_line());
 }
 
-/** Returns an either_t containing a string or a number for the underlying
- * variable, along with its type in the out-parameter 'type'. If the
- * variable has not been encountered before it will be created here.
+/** Finds the storage for a variable reference, creating it if the
+ * variable has not been encountered before. The storage doesn't move until
+ * a variable is freed, so once found it is kept in the reference.
  *
  * @param variable The variable reference to look up.
- * @paramout type The variable type as found in storage.
- * @returns An either_t containing a numeric result.
+ * @returns The variable's entry in the variable table.
  */
-either_t *variable_value(const variable_t *variable, int *type)
+variable_storage_t *variable_storage(variable_t *variable)
 {
   variable_storage_t *storage;
 	char *storage_name;
-	int index;
+  
+  if (variable->storage != NULL && variable->generation == variable_generation)
+    return variable->storage;
   
 	// in contrast to BASIC, in FOCAL all variables can be arrays, and A and A()
 	// refer to the same variable, so we don't have to munge on the "(" to make
-	// it into a separate variable
-	storage_name = str_new(variable->name);
-
-	// see if we can find the entry in the symbol list
-	storage = lst_data_with_key(interpreter_state.variable_values, storage_name);
+	// it into a separate variable, and we can look it up by the name as-is
+	storage = lst_data_with_key(interpreter_state.variable_values, variable->name);
   
   // if not, make a new variable slot in values and set it up
   if (storage == NULL) {
-    int slots;
+    // the table keeps its own copy of the name
+    storage_name = str_new(variable->name);
     
-    // calloc a single slot, if it's an array we'll use this slot as the template
-    storage = calloc(1, sizeof(*storage));
+    storage = memory_calloc(MEMORY_SYMBOLS, sizeof(*storage));
+    memory_charge(MEMORY_SYMBOLS, strlen(storage_name) + 1);
     storage->type = NUMBER;	// this is all we have in FOCAL, but leaving in the type for simplicity
-    		
-    // see if this reference includes subscripts
-    if (variable->subscripts != NULL) {
-			// in FOCAL, there is no equivalent of a DIM, and all arrays are -2048 to +2047.
-			// I suspect that they used the subscripts as pseudo-names, so A(100) becomes
-			// a separate variable A100. That would make it only create entries for those
-			// indexes that are acually stored.
-			//
-			// given the small amount of memory this represents on a modern machine, we'll
-			// just go ahead and dim all 4k slots for any variable we see with ()
-			slots = 4096;
-			storage->actual_dimensions = lst_append(NULL, INT_TO_POINTER(slots));;
-    }
-    // if it doesn't include subscripts, null them out and set the number of slots to 1
-    else {
-			// BUG: is it possible that we get a non-subscript ref after we set up the refs above?
-      storage->actual_dimensions = NULL;
-      slots = 1;
-    }
     
-    // now calloc the result and insert it into the values tree
-    storage->value = calloc(slots, sizeof(storage->value[0]));
+    // every variable has a single value, which is also element 0 if it is
+    // subscripted, so A and A(0) are the same
+    storage->value = calloc(1, sizeof(storage->value[0]));
+    memory_charge(MEMORY_ARRAYS, sizeof(storage->value[0]));
 		interpreter_state.variable_values = lst_insert_with_key_sorted(interpreter_state.variable_values, storage, storage_name);
   }
   
+  // in FOCAL, there is no equivalent of a DIM, and all arrays are -2048 to +2047.
+  // I suspect that they used the subscripts as pseudo-names, so A(100) becomes
+  // a separate variable A100. That would make it only create entries for those
+  // indexes that are acually stored, and that is what the array does, so we can
+  // set one up the first time we see the variable with subscripts, no matter
+  // how it was used before that
+  if (variable->subscripts != NULL && storage->array == NULL)
+    storage->array = array_new();
+  
+  variable->storage = storage;
+  variable->generation = variable_generation;
+  return storage;
+} /* variable_storage */
+
+/** Checks that a subscript is in range, and reports it if it isn't.
+ *
+ * @param subscript The element, 0 for the variable itself.
+ * @returns The subscript, or 0 if it was out of range.
+ */
+double checked_subscript(double subscript)
+{
+  if ((subscript < ARRAY_FIRST) || (subscript > ARRAY_LAST)) {
+    focal_error("Array subscript out of bounds");
+    return 0;
+  }
+  return subscript;
+} /* checked_subscript */
+
+/** Returns the slot for one element of a variable, after checking that
+ * the subscript is in range.
+ *
+ * @param storage The variable.
+ * @param subscript The element, 0 for the variable itself.
+ * @param writing True if the caller will store into the slot.
+ * @returns The element's value.
+ */
+either_t *element_slot(variable_storage_t *storage, double subscript, bool writing)
+{
+  int index = checked_subscript(subscript);
+  
+  if (index == 0)
+    return storage->value;
+  if (writing)
+    return array_write(storage->array, index);
+  // reads never allocate, so the cast is safe as long as nobody writes through it
+  return (either_t *)array_read(storage->array, index);
+} /* element_slot */
+
+/** Finds the storage for a variable reference and returns the slot for
+ * its value, along with its type in the out-parameter 'type'. If the
+ * variable has not been encountered before it will be created here.
+ *
+ * @param variable The variable reference to look up.
+ * @paramout type The variable type as found in storage.
+ * @param writing True if the caller will store into the slot.
+ * @returns An either_t containing a numeric result.
+ */
+static double variable_subscript(variable_t *variable);
+
+static either_t *variable_slot(variable_t *variable, int *type, bool writing)
+{
+  variable_storage_t *storage = variable_storage(variable);
+  
   // if we haven't started runnning yet, we were being called during parsing to
   // populate the variable table. In that case, we don't need the value, so...
   if (interpreter_state.running_state == 0)
     return NULL;
   
   // at this point we have either found or created the variable, so...
+  double index = variable_subscript(variable);
   
+  // returning the type, always a number in this case
+  *type = NUMBER;
+
+  // all done, return the value at that index
+  return element_slot(storage, index, writing);
+} /* variable_slot */
+
+/** Works out the subscript of a variable reference.
+ *
+ * @param variable The variable reference.
+ * @returns The subscript, or zero if there is none.
+ */
+static double variable_subscript(variable_t *variable)
+{
   // compute array index, or leave it at zero if there is none
-	index = 0;
+	double index = 0;
 	
-	// there is only ever one dimension in FOCAL, so this is pretty simple,
-	// the only crazy bit is that we have to map the input to negative values
+	// there is only ever one dimension in FOCAL, so this is pretty simple
 	list_t *variable_index;       	// list of indices in this variable reference, each is an expression, likely a constant
 	variable_index = lst_first_node(variable->subscripts);
 	
 	// if there are no subscripts, get the value at 0
-	if (lst_length(variable_index) == 0) {
+	if (variable_index == NULL) {
 		index = 0;
 	}
-	else if (lst_length(variable_index) > 1)
+	else if (lst_next(variable_index) != NULL)
 		focal_error("Array access has more than one subscript"); // should we exit at this point?
-	else
-		if (variable_index != NULL) {
-			// evaluate the variable reference's index for a given dimension
-			value_t this_index = evaluate_expression(variable_index->data);
-			
-			// make sure the index is within the originally DIMed bounds
-			// NOTE: should check against array_base, not 0, but this doesn't work in Dartmouth. see notes
-			if ((this_index.number < -2048) || (this_index.number > 2047)) {
-				focal_error("Array subscript out of bounds");
-				this_index.number = 0;
-			}
-		
-			index = this_index.number;
-		} else {
-			focal_error("Array subscript is empty");
-			index = 0;
-		}
-  
-  // returning the type, always a number in this case
-  *type = NUMBER;
+	else {
+		// evaluate the variable reference's index for a given dimension
+		index = evaluate_expression(variable_index->data).number;
+	}
+  return index;
+} /* variable_subscript */
 
-  // all done, return the value at that index
-  return &storage->value[index];
+/** Returns the value of a variable without subscripts or a constant,
+ * which is all the fused IF has to deal with.
+ */
+static double operand_value(expression_t *operand)
+{
+  if (operand->type == number)
+    return operand->parms.number;
+  return variable_storage(operand->parms.variable)->value->number;
+} /* operand_value */
+
+/** Returns the slot for a variable reference that is about to be assigned,
+ * creating it if needed. The pointer is only good until the next
+ * assignment to the same array.
+ */
+either_t *variable_value(variable_t *variable, int *type)
+{
+  return variable_slot(variable, type, true);
 } /* variable_value */
 
 /** Cover method for variable_value, allows it to be exported to the parser
  * without it having to know about either_t, which is private.
  */
-void insert_variable(const variable_t *variable)
+void insert_variable(variable_t *variable)
 {
   int ignore = 0;
   variable_value(variable, &ignore);
@@ -261,139 +367,21 @@ static char *number_to_string(const double d)
   return str;
 } /* number_to_string */
 
-/** Returns the DEC 6-bit character code for any given character.
- *
- * @param one_char The character to convert.
- * @return The DEC character code number.
- */
-static int char_code_for_character(const char one_char)
-{
-	switch (one_char) {
-		case '@' ... 'Z' : return ((int)one_char - '@'); break;
-		case '0' ... '9' : return ((int)one_char - '0'); break;
-		case ':' ... '?' : return ((int)one_char + 22); break;
-		case '[' ... '_' : return ((int)one_char - 58); break;
-		case ' ' ... '/' : return ((int)one_char + 8); break;
-		default: return 0;
-	}
-} /* char_code_for_character */
-
-/** Returns a number encoding a string using DEC's 6-bit codes. The value
- * is always an integer, but may have an exponent if the string has an E.
- *
- * FOCAL was built on a machine with no inherent string support, and the
- * language does not have any internal string handling. However, the need
- * to input short strings for things like "yes" or 'no" remained, so the
- * solution was to use the 6-bit teletype codes where A=1 and Z=26 and then
- * just string them together so that "A" produces 1, "A1" produces 11 and
- * "Z1" produces 261. The weird part is that if the number is two digits,
- * the digits will overlap, so "AZ" produces 126, but "ZZ" produces 286.
- *
- * To emulate this behaviour, this code loops backward through the string,
- * multiplying each character by its position*10.
- *
- * See section 3.4.8: http://bitsavers.trailing-edge.com/pdf/dec/pdp8/focal/DEC-08-AJBB-DL_Advanced_FOCAL_Technical_Specification_Apr69.pdf
+/** Converts a string to a number using DEC's 6-bit codes, see number.h,
+ * and reports any problem with the current line number.
  *
  * @param string The string to convert to a numeric representation.
+ * @param length The number of characters to convert.
  * @return A numeric representation of the string.
  */
-static double string_to_number(const char *string)
+static double text_to_number(const char *string, size_t length)
 {
-	int len = (int)strlen(string);
-
-	// empty/useless string?
-	if (len == 0)
-		return 0.0;
-
-	int e_location = -1;
-	int p_location = -1;
-	int integer = 0;
-	int fraction = 0;
-	int exponent = 0;
-	int mantissa_sign = 1;
-	int exponent_sign = 1;
-	
-	// look for Es and .s in the string
-	for (int i = 0; i < (int)len; i++) {
-		char c = string[i];
-		if (c == 'E' || c == 'e') {
-			if (e_location != -1) {
-				focal_error("More than one E in string value");
-				return 0;
-			}
-			e_location = i;
-		}
-		else if (c == '.') {
-			if (p_location != -1) {
-				focal_error("More than one decimal/period in string value");
-				return 0;
-			}
-			p_location = i;
-		}
-	}
-	// if there wasn't an E or period, move it to the end
-	if (e_location == -1)
-		e_location = len;
-	if (p_location == -1)
-		p_location = e_location;
-	
-	// process the integer part, everything to the left of the period and/or E
-	for (int i = 0; i < p_location; i++) {
-		char c = string[i];
-		int val = 0;
-		if (c == '-')
-			mantissa_sign = !mantissa_sign;
-		else if (c == '+')
-			mantissa_sign = 1;
-		else if (isalpha(c))
-			val = char_code_for_character(c);
-		else if (isdigit(c))
-			val = (c - '0');
-		else {
-			focal_error("Invalid character in string value");
-			return 0;
-		}
-		integer = integer * 10 + val;
-	}
-	
-	// and the fraction, if there is one
-	for (int i = p_location + 1; i < e_location; i++) {
-		char c = string[i];
-		int val = 0;
-		if (isalpha(c))
-			val = char_code_for_character(c);
-		else if (isdigit(c))
-			val = (c - '0');
-		else {
-			focal_error("Invalid character in string value");
-			return 0;
-		}
-		fraction = fraction * 10 + val;
-	}
-	
-	// and then for the exponent, if there is any
-	for (int i = e_location + 1; i < len; i++) {
-		char c = string[i];
-		int val = 0;
-		if (isalpha(c))
-			val = char_code_for_character(c);
-		else if (isdigit(c))
-			val = (c - '0');
-		else if (c == '-')
-			exponent_sign = !exponent_sign;
-		else if (c == '+')
-			exponent_sign = 1;
-		else {
-			focal_error("Invalid character in string value");
-			return 0;
-		}
-		exponent = exponent * 10 + val;
-	}
-	
-	// and construct the final number
-	double val = ((integer * mantissa_sign) + (fraction / pow(10, e_location - p_location - 1))) * pow(10, (exponent * exponent_sign));
-	return val;
-} /* string_to_number */
+  const char *error = NULL;
+  double value = string_to_number(string, length, &error);
+  if (error != NULL)
+    focal_error(error);
+  return value;
+} /* text_to_number */
 
 /** Extracts the decimal part of a string and returns an int value.
  * This is needed in order to account for trailing zeros in format
@@ -402,7 +390,7 @@ static double string_to_number(const char *string)
  * @param string The string to extract the decimal from.
  * @return The decimal part as an integer, or zero if there is no decimal.
  */
-static int format_decimals(char *string)
+int format_decimals(char *string)
 {
 	int len = (int)strlen(string);
 	if (len == 0)
@@ -451,9 +439,112 @@ static int elapsed_jiffies() {
 	// times this should never occur
 	jiffies %= 5183999;
 	
-	return (int)jiffies;
+	// the clock is an input like any other, so it's recorded and replayed
+	return record_jiffies((int)jiffies);
 } /* elapsed_jiffies */
 
+/** Returns the result of one of the functions that depend only on their
+ * parameter, for both the tree walker and compiled code.
+ *
+ * @param function The function's token, like FSQT.
+ * @param a The parameter.
+ */
+double pure_function(int function, double a)
+{
+  switch (function) {
+    case FABS:
+      return fabs(a);
+    case FATN:
+      return math_mode == MATH_FAST ? fast_atn(a) : atan(a);
+    case FCOS:
+      return math_mode == MATH_FAST ? fast_cos(a) : cos(a);
+    case FEXP:
+      return math_mode == MATH_FAST ? fast_exp(a) : exp(a);
+    case FITR:
+      return floor(a);
+    case FLOG:
+      return math_mode == MATH_FAST ? fast_log(a) : log(a);
+    case FSIN:
+      return math_mode == MATH_FAST ? fast_sin(a) : sin(a);
+    case FSGN:
+      // FOCAL-69 returns 1 when a=0, this implements the FOCAL-71 version where 0 returns 0
+      if (a < 0)
+        return -1;
+      else if (a == 0)
+        return 0;
+      else
+        return 1;
+    case FSQT:
+      return sqrt(a);
+    default:
+      focal_error("Unhandled arity-1 function");
+      return 0;
+  }
+} /* pure_function */
+
+/** Runs the instructions that an expression was compiled into when its
+ * line became hot. See tier.h.
+ *
+ * @param code The compiled expression.
+ * @return Its value, which is always a number.
+ */
+static double run_code(const code_t *code)
+{
+  double stack[CODE_STACK];
+  int top = -1;
+  
+  compiled_runs++;
+  for (const instruction_t *instruction = code->instructions; instruction < code->instructions + code->length; instruction++) {
+    switch (instruction->op) {
+      case CODE_NUMBER:
+        stack[++top] = instruction->operand.number;
+        break;
+      case CODE_VARIABLE:
+        stack[++top] = variable_storage(instruction->operand.variable)->value->number;
+        break;
+      case CODE_ELEMENT:
+        stack[top] = element_slot(variable_storage(instruction->operand.variable), stack[top], false)->number;
+        break;
+      case CODE_NEGATE:
+        stack[top] = -stack[top];
+        break;
+      case CODE_ADD:
+        top--;
+        stack[top] = stack[top] + stack[top + 1];
+        break;
+      case CODE_SUBTRACT:
+        top--;
+        stack[top] = stack[top] - stack[top + 1];
+        break;
+      case CODE_MULTIPLY:
+        top--;
+        stack[top] = stack[top] * stack[top + 1];
+        break;
+      case CODE_DIVIDE:
+        top--;
+        if (stack[top + 1] == 0)
+          focal_error("Division by zero");
+        stack[top] = stack[top] / stack[top + 1];
+        break;
+      case CODE_POWER:
+        top--;
+        stack[top] = stack[top + 1] == 2 ? stack[top] * stack[top] : pow(stack[top], stack[top + 1]);
+        break;
+      case CODE_EQUAL:
+        top--;
+        stack[top] = -(stack[top] == stack[top + 1]);
+        break;
+      case CODE_FUNCTION:
+        stack[top] = pure_function(instruction->operand.function, stack[top]);
+        break;
+      case CODE_TREE:
+        stack[++top] = evaluate_expression(instruction->operand.expression).number;
+        break;
+    }
+  }
+  return stack[0];
+} /* run_code */
+
 /** Recursively evaluates an expression and returns a value_t with the result.
  *
  * @param expression The expression to evaluate.
@@ -464,6 +555,22 @@ static value_t evaluate_expression(expression_t *expression)
   value_t result;
   value_t parameters[3];
   
+  // use the compiled or optimized version if there is one, they give the same results
+  if (!evaluating_source) {
+    if (verify_optimizer && (expression->compiled != NULL || (expression->optimized != NULL && expression->optimized != expression)))
+      return verified_value(expression);
+    if (expression->compiled != NULL) {
+      native_expression_t native = use_jit ? jit_expression(expression->compiled, variable_generation) : NULL;
+      if (native != NULL) {
+        compiled_runs++;
+        return double_to_value(native());
+      }
+      return double_to_value(run_code(expression->compiled));
+    }
+    if (expression->optimized != NULL)
+      expression = expression->optimized;
+  }
+  
   switch (expression->type) {
       // for number and string constants, simply copy the value and return it
     case number:
@@ -476,14 +583,14 @@ static value_t evaluate_expression(expression_t *expression)
       break;
 		case numstr:
 			result.type = NUMBER;
-			result.number = string_to_number(expression->parms.string);
+			result.number = text_to_number(expression->parms.string, strlen(expression->parms.string));
 			break;
 
       // variables are also easy, just copy over their value from storage
     case variable:
     {
       int type = 0;
-      either_t *p = variable_value(expression->parms.variable, &type);
+      either_t *p = variable_slot(expression->parms.variable, &type, false);
       result.type = type;
 			
 			// user functions will call this method while being set up and at that time the
@@ -503,8 +610,27 @@ static value_t evaluate_expression(expression_t *expression)
     }
       break;
       
+      // the parts of a FOR body that don't change are only worked out once
+      // per entry into the loop, unless they report an error
+    case invariant:
+      if (expression->parms.invariant.valid) {
+        result = double_to_value(expression->parms.invariant.value);
+      } else {
+        long errors = errors_reported;
+        result = evaluate_expression(expression->parms.invariant.expression);
+        expression->parms.invariant.value = result.number;
+        expression->parms.invariant.valid = errors_reported == errors;
+      }
+      break;
+      
       // and now for the fun bit, the operators list...
     case op:
+      // FNEW's parameter is a list of arguments, which the call works out itself
+      if (expression->parms.op.opcode == FNEW) {
+        result = double_to_value(plugin_call(expression->parms.op.p[0]));
+        break;
+      }
+
       // build a list of values for each of the parameters by recursing
       // on them until they return a value
       for (int i = 0; i < expression->parms.op.arity; i++)
@@ -521,12 +647,13 @@ static value_t evaluate_expression(expression_t *expression)
 						// that returns the DEC ASCII code
 					case FIN:
 					{
-						char c = getchar();
+						char c = record_input_char();
 						result.number = (int)c + 128;
 					}
+						break;
 
           case FRAN:
-            result.number = ((double)rand() / (double)RAND_MAX); // don't forget the cast!
+            result.number = record_random();
             break;
 
 					default:
@@ -545,17 +672,16 @@ static value_t evaluate_expression(expression_t *expression)
             result.number = -a;
             break;
           case FABS:
-            result.number = fabs(a);
-            break;
           case FATN:
-            result.number = atan(a);
-            break;
 					case FCOS:
-						result.number = cos(a);
+          case FEXP:
+					case FITR:
+          case FLOG:
+					case FSIN:
+					case FSGN:
+					case FSQT:
+						result.number = pure_function(expression->parms.op.opcode, a);
 						break;
-           case FEXP:
-            result.number = exp(a);
-            break;
 					case FIN:
 					{
 						// takes the value of the first char and converts it to DEC ASCII
@@ -563,53 +689,28 @@ static value_t evaluate_expression(expression_t *expression)
 						result.number = (int)c + 128;
 					}
 						break;
-					case FITR:
-						result.number = floor(a);
-						break;
           case FOUT:
 					{
 						// writes the char and returns its DEC ASCII value
-						putchar((int)a - 128);
+						putc((int)a - 128, CHANNEL_OUTPUT);
 						result.number = a;
 					}
             break;
-          case FLOG:
-						result.number = log(a);
-						break;
-					case FSIN:
-						result.number = sin(a);
-						break;
-					case FSGN:
-						// FOCAL-69 returns 1 when a=0, this implements the FOCAL-71 version where 0 returns 0
-						if (a < 0)
-							result.number = -1;
-						else if (a == 0)
-							result.number = 0;
-						else
-							result.number = 1;
-						break;
-					case FSQT:
-						result.number = sqrt(a);
-						break;
 						
-						// various plotting functions
+						// the A/D converter and the display, see plot.h
 					case FADC:
-						result.number = 0.0;
+						result.number = adc_read(a);
 						break;
 					case FDIS:
-						result.number = 0.0;
+						result.number = plot_sweep(a, false);
 						break;
 					case FDXS:
-						result.number = 0.0;
+						result.number = plot_sweep(a, true);
 						break;
 
-						// machine language call and common memory, return 0
-					case FNEW:
-						result.number = 0.0;
-						break;
 					case FCOM:
-						result.number = 0.0;
-						 break;
+						result.number = common_read(a);
+						break;
 
           default:
             focal_error("Unhandled arity-1 function");
@@ -643,7 +744,8 @@ static value_t evaluate_expression(expression_t *expression)
             result = double_to_value(a / b);
             break;
           case '^':
-            result = double_to_value(pow(a, b));
+            // squares are common and pow is slower and less exact than a multiply
+            result = double_to_value(b == 2 ? a * a : pow(a, b));
             break;
           case '=':
             if (parameters[0].type >= NUMBER)
@@ -654,6 +756,18 @@ static value_t evaluate_expression(expression_t *expression)
 						}
             break;
 
+          case FCOM:
+            result = double_to_value(common_write(a, b));
+            break;
+
+          case FDIS:
+            result = double_to_value(plot_point(a, b, false));
+            break;
+
+          case FDXS:
+            result = double_to_value(plot_point(a, b, true));
+            break;
+
           default:
             result.number = 0;
             focal_error("Unhandled arity-2 function");
@@ -669,6 +783,43 @@ static value_t evaluate_expression(expression_t *expression)
   return result;
 } /* evaluate_expression */
 
+/** Evaluates an expression from its compiled code or optimized tree and then from the
+ * source, as --no-optimize would, and reports an error if the two differ
+ * in any bit. Expressions with side effects are only evaluated once, and
+ * the source is skipped if the first evaluation reported an error.
+ *
+ * @param expression An expression with an optimized version.
+ * @return The result of the optimized version.
+ */
+static value_t verified_value(expression_t *expression)
+{
+  long errors = errors_reported;
+  bool pure = expression_is_pure(expression);
+  value_t optimized;
+  if (expression->compiled != NULL)
+    optimized = double_to_value(run_code(expression->compiled));
+  else
+    optimized = evaluate_expression(expression->optimized);
+  if (!pure || errors_reported != errors)
+    return optimized;
+
+  evaluating_source = true;
+  value_t source = evaluate_expression(expression);
+  evaluating_source = false;
+  if (optimized.type != source.type ||
+      (source.type == STRING ? strcmp(optimized.string, source.string) != 0 : memcmp(&optimized.number, &source.number, sizeof(double)) != 0))
+    focal_error("Optimized result differs from source");
+  return optimized;
+} /* verified_value */
+
+/** Evaluates an expression and returns its numeric value, so that the
+ * optimizer folds constants with exactly the same arithmetic as a run.
+ */
+double expression_value(expression_t *expression)
+{
+  return evaluate_expression(expression).number;
+} /* expression_value */
+
 /** Prints a single printitem_t, which may be an expression, a field
  * separator which includes ! for newlines, or a formatter. Updates
  * cursor_column as it goes, to allow next tab position to be determined.
@@ -688,16 +839,16 @@ static void print_item(printitem_t *item)
 		if (item->separator > 0) {
 			switch (item->separator) {
 				case '!':
-					printf("\n");
+					putc('\n', CHANNEL_OUTPUT);
 					interpreter_state.cursor_column = 0;
 					break;
 				case '#':
-					printf("\r");
+					putc('\r', CHANNEL_OUTPUT);
 					interpreter_state.cursor_column = 0;
 					break;
 				case ':':
 					while (interpreter_state.cursor_column % tab_columns != 0) {
-						printf(" ");
+						putc(' ', CHANNEL_OUTPUT);
 						interpreter_state.cursor_column++;
 					}
 					break;
@@ -729,26 +880,33 @@ static void print_item(printitem_t *item)
 		switch (v.type) {
 			case NUMBER:
 			{
-				// if it's a number, make a c-style formatter for the output
-				char fmtstr[MAXSTRING];
-				int width = atoi(interpreter_state.format);
-				int prec = format_decimals(interpreter_state.format);
-				
-				// FIXME: need to support "-1" here
-				
-				// this currently prints a leading space and a space for the sign
-				if (type_equals)
-					sprintf(fmtstr, "= %%%d.%df", width, prec);
-				else
-					sprintf(fmtstr, "  %%%d.%df", width, prec);
+				// if it's a number, make a c-style formatter for the output, which
+				// is kept until the format changes
+				static char fmtstr[MAXSTRING];
+				static char made_from[MAXSTRING];
+				static bool made_with_equals;
+				if (fmtstr[0] == '\0' || made_with_equals != type_equals || strcmp(made_from, interpreter_state.format) != 0) {
+					int width = atoi(interpreter_state.format);
+					int prec = format_decimals(interpreter_state.format);
+					
+					// FIXME: need to support "-1" here
+					
+					// this currently prints a leading space and a space for the sign
+					if (type_equals)
+						sprintf(fmtstr, "= %%%d.%df", width, prec);
+					else
+						sprintf(fmtstr, "  %%%d.%df", width, prec);
+					snprintf(made_from, sizeof(made_from), "%s", interpreter_state.format);
+					made_with_equals = type_equals;
+				}
 
-				interpreter_state.cursor_column += printf(fmtstr, v.number);
+				interpreter_state.cursor_column += fprintf(CHANNEL_OUTPUT, fmtstr, v.number);
 			}
 				break;
 				
 			case STRING:
 				// if it's a string, just print it out
-				interpreter_state.cursor_column += printf("%-s", v.string);
+				interpreter_state.cursor_column += fprintf(CHANNEL_OUTPUT, "%-s", v.string);
 				break;
 		}
 	} // e != NULL
@@ -756,40 +914,20 @@ static void print_item(printitem_t *item)
 
 /** Returns the line number for given a statement.
  *
- * NOTE: this is likely expensive, because is uses the index lookup
- *				methods in list_t, which loop. So only use it when required!
+ * Each statement is told its line when the program is linked or the
+ * line is typed in, see program.h, so this is cheap enough to call at
+ * the end of every statement.
  *
  * @param statement The statement you are looking for.
- * @return The line number as a double.
+ * @return The line number as a double, -1 if there is no statement.
  */
 static double line_for_statement(const list_t *statement)
 {
-  // get a pointer to the program from the first line
-  list_t *program = interpreter_state.lines[interpreter_state.first_line_index];
-  
-  // get the index of this statement in that list
-  int target_index = lst_index_of_data(program, statement->data);
-  
-  // loop forward through the program until we find a line who's
-  // first statement is higher than that index. That means we must
-  // be on the previous line
-  int this_index, previous_line = interpreter_state.first_line_index;
-  for (int i = interpreter_state.first_line_index; i < MAXLINE; i++) {
-    // skip empty lines
-    if (interpreter_state.lines[i] == NULL) continue;
-    
-    // get the index of the first statement on that line
-    this_index = lst_index_of_data(program, interpreter_state.lines[i]->data);
-    
-    // now see if we're in this line or the previous one
-    if (this_index == target_index) return (double)i / 100.0;
-    if (this_index > target_index) return (double)previous_line / 100.0;
-    
-    // otherwise keep looking
-    previous_line = i;
-  }
-  // didn't find it
-  return -1;
+  if (statement == NULL)
+    return -1;
+  if (statement->data == NULL)
+    return program_line_of(statement) / 100.0;
+  return ((const statement_t *)statement->data)->line / 100.0;
 } /* line_for_statement */
 
 /** Curries line_for_statement to return the current line.
@@ -851,18 +989,12 @@ static list_t *find_line(double linenumber)
 	}
 	// and here we look for the group
 	else {
-		// for the group lookup, we have to loop through it until we find an item with that value
+		// for the group lookup, the first line at or after the group's
+		// number has to be in the group
 		list_t *lv = NULL;
-		for(int i = (group * 100); i < MAXLINE - 1; i++) {
-			if (interpreter_state.lines[i] != NULL) {
-				// we found a non-empty line, is it the right group?
-				if (linenumber == trunc(i / 100)) {
-					// we found the first line in the group, so we can exit
-					lv = interpreter_state.lines[i];
-					break;
-				}
-			}
-		}
+		int i = program_next_line(group * 100 - 1);
+		if (i < MAXLINE && i / 100 == group)
+			lv = interpreter_state.lines[i];
 		if (lv != NULL) {
 			return lv;
 		}
@@ -879,6 +1011,192 @@ static list_t *find_line(double linenumber)
 	return NULL;
 } /*find_line */
 
+/** Frees a DO or FOR entry once it has been popped off the stack. */
+static void free_stack_entry(stackentry_t *entry)
+{
+  memory_release(MEMORY_STACK, sizeof(*entry));
+  free(entry);
+}
+
+/** Drops every DO and FOR still on the stack, for the CLI when a command
+ * is finished with.
+ */
+void clear_stack(void)
+{
+  for (list_t *node = interpreter_state.stack; node != NULL; node = node->next)
+    free_stack_entry(node->data);
+  lst_free(interpreter_state.stack);
+  interpreter_state.stack = NULL;
+} /* clear_stack */
+
+/** Runs a FOR whose line is nothing but SETs as machine code, see jit.h,
+ * when the index has been set for the next time round and the body is
+ * about to be performed. The machine code takes the statements it runs
+ * off the countdown, and stops early if a checkpoint or limit is due.
+ *
+ * @param se The FOR entry on the top of the stack.
+ */
+static void run_native_loop(stackentry_t *se)
+{
+  statement_t *statement = se->head->data;
+  
+  // tracing, the memory limit and the verifier all need to see each statement
+  if (!use_jit || verify_optimizer || trace_lines || max_memory > 0 || !statement->promoted)
+    return;
+  if (se->tail == NULL || se->index == NULL || se->generation != variable_generation)
+    return;
+  native_loop_t loop = jit_loop(statement, se->head, se->tail, variable_generation);
+  if (loop == NULL)
+    return;
+  
+  long iterations = loop(&se->index->number, se->end, se->step, &countdown);
+  bool finished = iterations < 0;
+  if (finished)
+    iterations = -iterations;
+  
+  // keep the counts as if the statements had been performed one by one
+  native_t *native = statement->parms._for.native;
+  for (list_t *node = lst_next(se->head); node != NULL; node = lst_next(node)) {
+    if (node->data != NULL)
+      ((statement_t *)node->data)->executions += iterations;
+    if (node == se->tail)
+      break;
+  }
+  compiled_runs += iterations * native->expressions;
+  native_iterations += iterations;
+  
+  if (finished) {
+    interpreter_state.next_statement = lst_next(se->tail);
+    interpreter_state.stack = lst_remove_node_with_data(interpreter_state.stack, se);
+    free_stack_entry(se);
+  }
+} /* run_native_loop */
+
+/** Runs the rest of a FOR over an array as a batch, see vector.h, at the
+ * same point as run_native_loop. Each time round is one statement off the
+ * countdown, and the loop is left alone if there isn't room for all of it.
+ *
+ * @param se The FOR entry on the top of the stack.
+ * @return True if the loop was finished and popped.
+ */
+static bool run_vector_loop(stackentry_t *se)
+{
+  statement_t *statement = se->head->data;
+  
+  if (!use_optimizer || verify_optimizer || trace_lines || max_memory > 0 || !statement->promoted)
+    return false;
+  if (se->tail == NULL || se->index == NULL || se->generation != variable_generation)
+    return false;
+  long iterations = vector_loop(statement, se->head, se->tail, &se->index->number, se->end, se->step, countdown - 1);
+  if (iterations == 0)
+    return false;
+  
+  statement_t *set = se->tail->data;
+  countdown -= iterations;
+  set->executions += iterations;
+  compiled_runs += iterations * ((set->parms.set.expression->compiled != NULL) + (((expression_t *)set->parms.set.variable->subscripts->data)->compiled != NULL));
+  
+  interpreter_state.next_statement = lst_next(se->tail);
+  interpreter_state.stack = lst_remove_node_with_data(interpreter_state.stack, se);
+  free_stack_entry(se);
+  return true;
+} /* run_vector_loop */
+
+/** Performs the NEXT at the end of a FOR's line: steps the index and
+ * either goes back to the statement after the FOR or, if the loop is
+ * done, pops it and carries on. The index is normally reached through the
+ * pointer kept in the entry, and the usual step of one has its own test.
+ *
+ * @param se The FOR entry on the top of the stack.
+ */
+static void next_iteration(stackentry_t *se)
+{
+  either_t *index = se->index;
+  if (index == NULL || se->generation != variable_generation) {
+    int type = 0;
+    index = variable_value(se->index_variable, &type);
+    if (se->index_variable->subscripts == NULL) {
+      se->index = index;
+      se->generation = variable_generation;
+    }
+  }
+  
+  bool again;
+  if (se->step == 1)
+    again = ++index->number <= se->end;
+  else {
+    index->number += se->step;
+    again = (se->step < 0 && index->number >= se->end) || (se->step > 0 && index->number <= se->end);
+  }
+  
+  if (again) {
+    // we're not done, go back to the head of the loop
+    interpreter_state.next_statement = lst_next(se->head);
+    if (!run_vector_loop(se))
+      run_native_loop(se);
+  } else {
+    // we are done, remove this entry from the stack and just keep going
+    interpreter_state.stack = lst_remove_node_with_data(interpreter_state.stack, se);
+    free_stack_entry(se);
+  }
+} /* next_iteration */
+
+/** Handles the end of a statement inside the innermost FOR without
+ * working out any line numbers, using the last statement on the FOR's
+ * line that was found when it was entered.
+ *
+ * @param list_item The statement that was just performed.
+ * @return True if it was on the FOR's line and has been dealt with.
+ */
+static bool loop_fast_path(list_t *list_item)
+{
+  if (interpreter_state.stack == NULL)
+    return false;
+  stackentry_t *se = lst_last_node(interpreter_state.stack)->data;
+  if (se->type != FOR || se->tail == NULL)
+    return false;
+  
+  if (list_item == se->tail) {
+    next_iteration(se);
+    return true;
+  }
+  // anywhere else on the line is not the end of it, so there's nothing to do
+  for (list_t *node = se->head; node != se->tail; node = lst_next(node))
+    if (node == list_item)
+      return true;
+  return false;
+} /* loop_fast_path */
+
+/** Returns the last statement on the line that starts at or before
+ * @p statement, or NULL if it can't be found, as in immediate mode.
+ */
+static list_t *line_tail(list_t *statement, double line)
+{
+  list_t *end = next_line_head((int)round(line * 100));
+  for (list_t *node = statement; node != NULL; node = lst_next(node))
+    if (lst_next(node) == end)
+      return node;
+  return NULL;
+} /* line_tail */
+
+/** Compiles the line a hot statement is on and, if it is a DO, the line
+ * or group that it calls.
+ *
+ * @param list_item The statement that has reached the threshold.
+ */
+static void promote_statement(list_t *list_item)
+{
+  statement_t *statement = list_item->data;
+  promote_line((int)round(line_for_statement(list_item) * 100));
+  if (statement->type == DO) {
+    double target = statement->parms._do;
+    if (target == trunc(target))
+      promote_group((int)target);
+    else
+      promote_line((int)round(target * 100));
+  }
+} /* promote_statement */
+
 /** Runs a single statement, like ASK or TYPE
  *
  * @param L A pointer to the list item in the program to perform.
@@ -887,6 +1205,10 @@ static void perform_statement(list_t *list_item)
 {
 	statement_t *statement = list_item->data;
 	if (statement) {
+		// once a statement has run often enough, compile its line, see tier.h
+		if (++statement->executions == tier_threshold && use_optimizer)
+			promote_statement(list_item);
+		
 		switch (statement->type) {
 			case COMMENT:
 				break;
@@ -898,6 +1220,13 @@ static void perform_statement(list_t *list_item)
 				// but does so for every input, not just the first
 				//
 				// one difference with BASIC: entering nothing will return zero
+				//
+				// several values can be typed on one line, separated by spaces or commas,
+				// and they are handed out to the variables in turn. a line is only read
+				// when the last one has been used up, and anything left over when the
+				// statement ends is thrown away
+				char line[256];
+				char *next = NULL;    // the rest of the last line typed
 				
 				// loop over the items in the variable/prompt list
 				for (list_t *I = statement->parms.input; I != NULL; I = lst_next(I)) {
@@ -911,49 +1240,67 @@ static void perform_statement(list_t *list_item)
 					}
 					// if it is a variable, get the input
 					else {
-						char line[80];
 						either_t *value;
 						int type = 0;
 						
-						// print the colon prompt for ASK input
-						printf(":");
-						
-						// see if we can get some data using raw mode line input
-						fflush(stdout);
-						int input_result = raw_mode_input_line(line, sizeof(line));
+						// skip to the next value on the line, if there is one
+						while (next != NULL && is_input_separator(*next))
+							next++;
 						
-						// Handle break (ESC) or EOF
-						if (input_result == -1) {
-							// BREAK detected
-							interpreter_state.running_state = 0;  // stop execution
-							return;
-						}
-						if (input_result == 0) {
-							// EOF detected
-							exit(EXIT_FAILURE);
-						}
-						
-						// optionally (almost always) convert to upper case
-						if (upper_case) {
-							char *c = line;
-							while (*c) {
-								*c = toupper((unsigned char) *c);
-								c++;
+						if (next == NULL || *next == '\0') {
+							// a line from an OPEN INPUT file doesn't need a prompt
+							char *text = channel_read_line();
+							if (text == NULL) {
+								// print the colon prompt for ASK input
+								putc(':', CHANNEL_OUTPUT);
+								
+								// see if we can get some data using raw mode line input, there's
+								// no one to see the prompt if the input is coming from a file
+								if (strlen(input_file) == 0)
+									fflush(stdout);
+								int input_result = record_input_line(line, sizeof(line));
+								
+								// Handle break (ESC) or EOF
+								if (input_result == -1) {
+									// BREAK detected
+									interpreter_state.running_state = 0;  // stop execution
+									return;
+								}
+								if (input_result == 0) {
+									// EOF detected
+									exit(EXIT_FAILURE);
+								}
+								text = line;
 							}
+							
+							// optionally (almost always) convert to upper case
+							if (upper_case) {
+								char *c = text;
+								while (*c) {
+									*c = toupper((unsigned char) *c);
+									c++;
+								}
+							}
+							
+							// trim any leading spaces
+							next = text;
+							while (is_input_separator(*next))
+								next++;
 						}
 						
-						// trim any leading spaces
-						char *trim = line;
-						while(isspace(trim[0]))
-							trim++;
-
+						// the value runs up to the next separator, an empty line is zero
+						char *end = next;
+						while (*end != '\0' && !is_input_separator(*end))
+							end++;
+						
 						// find the storage for this variable
 						value = variable_value(ppi->expression->parms.variable, &type);
 						
 						// FOCAL only has numeric variables, but it does have the ability to
 						// type in strings at prompts, so we have to hand-convert the string
 						// into a value, we can't simply sscanf it
-						value->number = string_to_number(trim);
+						value->number = text_to_number(next, end - next);
+						next = end;
 					}
 				} // loop over list of items
 			} // ASK
@@ -962,7 +1309,11 @@ static void perform_statement(list_t *list_item)
 			case DO:
 			{
 				// DO is a GOSUB which may call a line or a group
-				stackentry_t *new_do = calloc(1, sizeof(*new_do));
+				if (max_stack_depth > 0 && lst_length(interpreter_state.stack) >= max_stack_depth) {
+					stop_at_limit("stack depth");
+					return;
+				}
+				stackentry_t *new_do = memory_calloc(MEMORY_STACK, sizeof(*new_do));
 				
 				new_do->type = DO;
 				new_do->original_line = current_line();
@@ -1000,19 +1351,19 @@ static void perform_statement(list_t *list_item)
 				}
 
 				const char *prompt = (cli_prompt && cli_prompt[0]) ? cli_prompt : "*";
-				printf("%s ", prompt);
+				fprintf(CHANNEL_OUTPUT, "%s ", prompt);
 
-				char *output = write_program(index, index);
-				if (output) {
-					printf("%s", output);
-					free(output);
-				}
+				write_listing(CHANNEL_OUTPUT, index, index);
 			}
 				break;
 				
 			case FOR:
 			{
-				stackentry_t *new_for = calloc(1, sizeof(*new_for));
+				if (max_stack_depth > 0 && lst_length(interpreter_state.stack) >= max_stack_depth) {
+					stop_at_limit("stack depth");
+					return;
+				}
+				stackentry_t *new_for = memory_calloc(MEMORY_STACK, sizeof(*new_for));
 				either_t *loop_value;
 				int type = 0;
 				
@@ -1027,10 +1378,24 @@ static void perform_statement(list_t *list_item)
 					new_for->step = 1;
 				}
 				new_for->head = list_item;
+				new_for->tail = line_tail(list_item, new_for->original_line);
+				
+				// anything remembered from the last time round is out of date
+				for (list_t *node = statement->parms._for.invariants; node != NULL; node = lst_next(node))
+					((expression_t *)node->data)->parms.invariant.valid = false;
+				
 				loop_value = variable_value(new_for->index_variable, &type);
 				loop_value->number = new_for->begin;
+				if (new_for->index_variable->subscripts == NULL) {
+					new_for->index = loop_value;
+					new_for->generation = variable_generation;
+				}
 				
 				interpreter_state.stack = lst_append(interpreter_state.stack, new_for);
+				// a line that could run as a batch once its invariants are known
+				// goes round once in the interpreter to work them out
+				if (!run_vector_loop(new_for) && statement->parms._for.vector != VECTOR_SHAPED)
+					run_native_loop(new_for);
 			}
 				break;
 				
@@ -1055,7 +1420,12 @@ static void perform_statement(list_t *list_item)
 				
 			case IF:
 			{
-				value_t cond = evaluate_expression(statement->parms._if.condition);
+				value_t cond;
+				if (statement->fused == FUSED_IF_DIFFERENCE && !verify_optimizer) {
+					expression_t *difference = statement->parms._if.condition->optimized;
+					cond = double_to_value(operand_value(difference->parms.op.p[0]) - operand_value(difference->parms.op.p[1]));
+				} else
+					cond = evaluate_expression(statement->parms._if.condition);
 				/* in contrast to BASIC, FOCAL uses the FORTRAN-like model where all comparisons are
 				 mathematical and the branch is based on whether the result of the comparison is
 				 -ve, 0 or +ve. The 0 and +ve branches are optional. If either is missing, that case
@@ -1088,11 +1458,38 @@ static void perform_statement(list_t *list_item)
 				int type = 0;
 				value_t exp_val;
 				
-				// get/make the storage entry for this variable
-				stored_val = variable_value(statement->parms.set.variable, &type);
+				// the fused forms do the same things in the same order, just faster,
+				// the verifier needs the expressions to go through evaluate_expression
+				if (statement->fused == FUSED_INCREMENT && !verify_optimizer) {
+					expression_t *sum = statement->parms.set.expression->optimized;
+					double constant = sum->parms.op.p[1]->parms.number;
+					stored_val = variable_storage(statement->parms.set.variable)->value;
+					if (sum->parms.op.opcode == '+')
+						stored_val->number = stored_val->number + constant;
+					else
+						stored_val->number = stored_val->number - constant;
+					break;
+				}
+				if (statement->fused == FUSED_SET_ELEMENT && !verify_optimizer) {
+					variable_t *target = statement->parms.set.variable;
+					variable_storage_t *storage = variable_storage(target);
+					double index = checked_subscript(evaluate_expression(target->subscripts->data).number);
+					double value = evaluate_expression(statement->parms.set.expression).number;
+					element_slot(storage, index, true)->number = value;
+					break;
+				}
+				
+				// get/make the storage entry for this variable, and check the
+				// subscript, but only find the slot once the value is known, as
+				// FNEW can store into the array and move its elements
+				variable_t *target = statement->parms.set.variable;
+				variable_storage_t *storage = variable_storage(target);
+				double index = checked_subscript(variable_subscript(target));
 				
 				// evaluate the expression
 				exp_val = evaluate_expression(statement->parms.set.expression);
+				stored_val = element_slot(storage, index, true);
+				type = NUMBER;
 				
 				// make sure we got the right type, and assign it if we did
 				if (exp_val.type == type) {
@@ -1109,6 +1506,14 @@ static void perform_statement(list_t *list_item)
 								
 			case TYPE:
 			{
+				// a single value and a new line, the commas between don't print anything
+				if (statement->fused == FUSED_TYPE_LINE && !verify_optimizer) {
+					print_item(statement->parms.print->data);
+					putc('\n', CHANNEL_OUTPUT);
+					interpreter_state.cursor_column = 0;
+					break;
+				}
+				
 				// loop over the items in the print list and print them out
 				for (list_t *item = statement->parms.print; item != NULL; item = lst_next(item)) {
 					print_item(item->data);
@@ -1151,11 +1556,7 @@ static void perform_statement(list_t *list_item)
 					}
 				}
 				
-				char *output = write_program(start_line, end_line);
-				if (output) {
-					printf("%s", output);
-					free(output);
-				}
+				write_listing(CHANNEL_OUTPUT, start_line, end_line);
 			}
 				break;
 				
@@ -1164,81 +1565,53 @@ static void perform_statement(list_t *list_item)
 				// LIBRARY CALL loads a program file and parses it
                 // LIBRARY SAVE writes the current program to a file
                 // LIBRARY RUN loads a program file and immediately begins execution
-                if (statement->parms.library.action == 1) {
-                    // LIBRARY CALL: load and parse a file
-                    FILE *lib_file = fopen(statement->parms.library.filename, "r");
-                    if (lib_file == NULL) {
-                        fprintf(stderr, "Cannot open library file: %s\n", statement->parms.library.filename);
-                        break;
-                    }
-                    
-                    // Clear the current program
-                    for (int i = 0; i < MAXLINE; i++) {
-                        interpreter_state.lines[i] = NULL;
-                    }
-                    
-                    // Reset interpreter state and load the new program
-                    extern int yyparse(void);
-                    extern void yyrestart(FILE *input_file);
-                    extern FILE *yyin;
-                    
-                    FILE *old_yyin = yyin;
-                    yyin = lib_file;
-                    yyrestart(lib_file);
-                    yyparse();
-                    fclose(lib_file);
-                    yyin = old_yyin;
-                    
-                    // Prepare the new program for execution
-                    interpreter_post_parse();
-                } else if (statement->parms.library.action == 0) {
+                if (statement->parms.library.action == 0) {
                     // LIBRARY SAVE: write the current program to a file (excluding line 0, reserved for temporary CLI statements)
-                    char *output = write_program(1, MAXLINE);
-                    if (output) {
-                        FILE *save_file = fopen(statement->parms.library.filename, "w");
-                        if (save_file == NULL) {
-                            fprintf(stderr, "Cannot open file for writing: %s\n", statement->parms.library.filename);
-                            free(output);
-                            break;
-                        }
-                        
-                        fprintf(save_file, "%s", output);
-                        fclose(save_file);
-                        free(output);
-                    }
+                    library_save(statement->parms.library.filename);
                 } else {
-                    // LIBRARY RUN: load a program file and immediately execute it
-                    FILE *lib_file = fopen(statement->parms.library.filename, "r");
-                    if (lib_file == NULL) {
-                        fprintf(stderr, "Cannot open library file: %s\n", statement->parms.library.filename);
+                    // LIBRARY CALL or RUN: replace the program with the file, the
+                    // old one is gone so nothing after this statement can be run
+                    if (!library_load(statement->parms.library.filename))
                         break;
-                    }
-                    
-                    // Clear the current program
-                    for (int i = 0; i < MAXLINE; i++) {
-                        interpreter_state.lines[i] = NULL;
-                    }
-                    
-                    extern int yyparse(void);
-                    extern void yyrestart(FILE *input_file);
-                    extern FILE *yyin;
-                    
-                    FILE *old_yyin = yyin;
-                    yyin = lib_file;
-                    yyrestart(lib_file);
-                    yyparse();
-                    fclose(lib_file);
-                    yyin = old_yyin;
                     
-                    interpreter_post_parse();
-                    
-                    /* Start execution at the first line of the loaded program */
-                    interpreter_state.next_statement = find_line(interpreter_state.first_line_index);
+                    // RUN starts the new program at its first line, CALL stops
+                    interpreter_state.next_statement = statement->parms.library.action == 2 ? interpreter_state.current_statement : NULL;
                     return;
                 }
             }
                 break;
 
+			case OPEN:
+			{
+				// OPEN INPUT and OUTPUT switch ASK and TYPE between the terminal and files
+				bool output = statement->parms.open.action == 1 || statement->parms.open.action == 3;
+				double channel = 1;
+				if (statement->parms.open.channel != NULL)
+					channel = evaluate_expression(statement->parms.open.channel).number;
+				
+				switch (statement->parms.open.action) {
+					case 0:
+					case 1:
+						if (statement->parms.open.filename != NULL) {
+							value_t file = evaluate_expression(statement->parms.open.filename);
+							if (file.type != STRING)
+								focal_error("OPEN needs a file name");
+							else
+								channel_open(channel, file.string, output);
+						} else
+							channel_select(channel, output);
+						break;
+					case 2:
+					case 3:
+						channel_select(0, output);
+						break;
+					default:
+						channel_close(statement->parms.open.channel != NULL ? channel : -1);
+						break;
+				}
+			}
+				break;
+				
             case RETURN:
             {
 				stackentry_t *se;
@@ -1250,6 +1623,7 @@ static void perform_statement(list_t *list_item)
 				se = lst_last_node(interpreter_state.stack)->data;
 				interpreter_state.next_statement = se->returnpoint;
 				interpreter_state.stack = lst_remove_node_with_data(interpreter_state.stack, se);
+				free_stack_entry(se);
 			}
 				break;
 				
@@ -1262,6 +1636,10 @@ static void perform_statement(list_t *list_item)
 				exit(0);
 		} //end switch
 		
+		// the common case of a statement inside a loop is handled on its own
+		if (loop_fast_path(list_item))
+			return;
+		
 		// because of the way that FOCAL handles FOR loops and DO calls,
 		// we have to test whether or not we are the last statement on the line,
 		// or at the last statement of a group. if so, we need to determine where
@@ -1292,20 +1670,7 @@ static void perform_statement(list_t *list_item)
 				
 				// if it's a FOR, we perform a next if we are at the end of any line
 				if (se->type == FOR) {
-					int type = 0;
-					either_t *lv = variable_value(se->index_variable, &type);
-					lv->number += se->step;
-					
-					// and see if we need to go back to the FOR or we're done and we continue on
-					if (((se->step < 0) && (lv->number >= se->end)) ||
-							((se->step > 0) && (lv->number <= se->end))) {
-						// we're not done, go back to the head of the loop
-						interpreter_state.next_statement = lst_next(se->head);
-					} else {
-						// we are done, remove this entry from the stack and just keep going
-						interpreter_state.stack = lst_remove_node_with_data(interpreter_state.stack, se);
-						free(se);
-					}
+					next_iteration(se);
 				}
 				// or it might be a DO, in which case we have to check the original
 				// target to see if it was a group or single line
@@ -1317,11 +1682,13 @@ static void perform_statement(list_t *list_item)
 					if (target_step == 0 && this_group == target_group && this_group != next_group) {
 						interpreter_state.next_statement = se->returnpoint;
 						interpreter_state.stack = lst_remove_node_with_data(interpreter_state.stack, se);
+						free_stack_entry(se);
 					}
 					// if it had a group and step, then only return if both changed
 					else if (target_step != 0 && this_group == target_group && this_step == target_step) {
 						interpreter_state.next_statement = se->returnpoint;
 						interpreter_state.stack = lst_remove_node_with_data(interpreter_state.stack, se);
+						free_stack_entry(se);
 					}
 				} // is a FOR or DO
 
@@ -1359,11 +1726,40 @@ static void print_variables() {
 	lst_foreach(interpreter_state.variable_values, print_symbol, NULL);
   printf("\n\n");
 }
+/* frees a variable table entry along with its values */
+static void free_variable(char *name, variable_storage_t *storage)
+{
+  variable_generation++;
+  memory_release(MEMORY_ARRAYS, sizeof(storage->value[0]));
+  memory_release(MEMORY_SYMBOLS, sizeof(*storage) + strlen(name) + 1);
+  free(storage->value);
+  array_free(storage->array);
+  free(storage);
+  free(name);
+}
 /* used for CLEAR, NEW and similar instructions. */
 void delete_variables() {
-	lst_free_everything(interpreter_state.variable_values);
+  for (list_t *node = lst_first_node(interpreter_state.variable_values); node != NULL; node = node->next)
+    free_variable(node->key, node->data);
+	lst_free(interpreter_state.variable_values);
 	interpreter_state.variable_values = NULL;
 }
+/** Adopts the entries of a separately built variable table into the
+ * current one. Names that already exist keep their current storage, the
+ * same as if the parser had seen them again, and the duplicates are freed.
+ *
+ * @param variables A variable table, which is consumed.
+ */
+void merge_variables(list_t *variables)
+{
+  for (list_t *node = lst_first_node(variables); node != NULL; node = node->next) {
+    if (lst_data_with_key(interpreter_state.variable_values, node->key) == NULL) {
+      interpreter_state.variable_values = lst_insert_with_key_sorted(interpreter_state.variable_values, node->data, node->key);
+    } else
+      free_variable(node->key, node->data);
+  }
+  lst_free(variables);
+} /* merge_variables */
 static void delete_lines() {
   for(int i = MAXLINE - 1; i >= 0; i--) {
     if (interpreter_state.lines[i] != NULL) {
@@ -1372,48 +1768,121 @@ static void delete_lines() {
   }
 }
 
+/** Returns the first statement of the next non-empty line after
+ * @p line_index. Once the lines have been chained together by
+ * interpreter_post_parse, this is also where the statements belonging
+ * to @p line_index stop, so it is used to walk a single line.
+ *
+ * @param line_index The line to start from, in xx.yy * 100 format.
+ * @return The head of the following line, or NULL if this is the last.
+ */
+list_t *next_line_head(int line_index)
+{
+  int next = program_next_line(line_index);
+  return next < MAXLINE ? interpreter_state.lines[next] : NULL;
+} /* next_line_head */
+
 /** After yacc has done it's magic, we form a program by pointing
  * the ->next for each line to the head of the next non-empty line.
  * that way we don't have to search through the line array for the
  * next non-null entry during the run loop, we just keep stepping
  * through the ->next until we fall off the end. this is how most
- * interpreters handled it anyway.
+ * interpreters handled it anyway. Lines edited later are linked one
+ * at a time by program_store_line.
  */
 void interpreter_post_parse(void)
 {
-  // look for the first entry in the lines array with a non-empty statement list
-  int first_line = 0;
-  while ((first_line < MAXLINE - 1) && (interpreter_state.lines[first_line] == NULL))
-    first_line++;
+  // chain the lines together, and keep track of the first for posterity
+  program_link();
   
-  // that statement is going to be the head of the list when we're done
-  list_t *first_statement = interpreter_state.lines[first_line];
+  // a program runs from the first line, so...
+  interpreter_state.current_statement = interpreter_state.lines[interpreter_state.first_line_index];
   
-  // now find the next non-null line and concat it to the first one, and repeat
-  for (int i = first_line + 1; i < MAXLINE; i++) {
-    if (interpreter_state.lines[i])
-      first_statement = lst_concat(first_statement, interpreter_state.lines[i]);
-  }
+  // and simplify the expressions now that the whole program is here
+  if (use_optimizer)
+    optimize_program();
+} /* interpreter_post_parse */
+
+/** Stops the run because a limit was reached.
+ *
+ * @param limit The name of the limit, reported in the statistics.
+ */
+static void stop_at_limit(const char *limit)
+{
+  limit_reached = limit;
+  fprintf(stderr, "\n%s limit reached at line %2.2f\n", limit, current_line());
+  interpreter_state.next_statement = NULL;
+  interpreter_state.current_statement = NULL;
+}
+
+/** Returns the number of statements until periodic_work next has
+ * something to do. With no checkpoints or limits it is effectively never.
+ */
+static long next_countdown(void)
+{
+  long count = LONG_MAX;
+  if (checkpoint_interval > 0)
+    count = checkpoint_interval - (long)(statements_run % checkpoint_interval);
+  if (max_statements > 0 && max_statements - statements_run < count)
+    count = (long)(max_statements - statements_run);
+  if (max_time > 0 && TIME_CHECK_INTERVAL < count)
+    count = TIME_CHECK_INTERVAL;
+  return count > 0 ? count : 1;
+} /* next_countdown */
+
+/** Makes the run loop call periodic_work as soon as the current statement
+ * is finished, used to stop a program from outside the loop.
+ */
+void interrupt_run(void)
+{
+  // keep the count of statements run correct
+  countdown_length -= countdown - 1;
+  countdown = 1;
+} /* interrupt_run */
+
+/** Called from the run loop each time the countdown runs out. Doing
+ * this work here rather than on every statement means the loop only
+ * pays for a decrement and a test.
+ */
+static void periodic_work(void)
+{
+  statements_run += countdown_length;
   
-  // and set the resulting list back into the first line
-  // NOTE: do we need to do this? isn't this already there?
-  interpreter_state.lines[first_line] = first_statement;
-  // and keep track of this for posterity
-  interpreter_state.first_line_index = first_line;
+  if (interpreter_state.current_statement != NULL) {
+    if (checkpoint_interval > 0 && statements_run % checkpoint_interval == 0)
+      save_snapshot(checkpoint_file);
+    
+    if (memory_exceeded) {
+      // cleared so that another run in the CLI is caught again
+      memory_exceeded = false;
+      stop_at_limit("memory");
+    }
+    else if (max_statements > 0 && statements_run >= max_statements)
+      stop_at_limit("statement");
+    else if (max_time > 0) {
+      struct timeval now, elapsed;
+      gettimeofday(&now, NULL);
+      timersub(&now, &start_time, &elapsed);
+      if (elapsed.tv_sec + elapsed.tv_usec / 1000000.0 >= max_time)
+        stop_at_limit("time");
+    }
+  }
   
-  // a program runs from the first line, so...
-  interpreter_state.current_statement = first_statement;          // the first statement
-} /* interpreter_post_parse */
+  countdown_length = countdown = next_countdown();
+} /* periodic_work */
 
 /** The main loop for the program.
  */
 void interpreter_run(void)
 {
-  // the cursor starts in col 0
-  interpreter_state.cursor_column = 0;
-	
-	// the normal format is similar
-	interpreter_state.format = "5.4";
+  // a resumed run picks up where the checkpoint left off, otherwise
+  // the cursor starts in col 0 and the format is the default
+  if (resumed_run)
+    resumed_run = false;
+  else {
+    interpreter_state.cursor_column = 0;
+    interpreter_state.format = "5.4";
+  }
 
   // start the clock and mark us as running
   start_ticks = clock();
@@ -1428,6 +1897,11 @@ void interpreter_run(void)
   if (trace_lines)
     printf("[%i]\n", last_line);
   
+  // checkpoints and limits share a single countdown, see periodic_work
+  statements_run = 0;
+  limit_reached = NULL;
+  countdown_length = countdown = next_countdown();
+  
   // very simple - perform_statement returns the next statement so we just keep
 	// looping over perform_statement until it returns a NULL
   while (interpreter_state.current_statement) {
@@ -1439,6 +1913,11 @@ void interpreter_run(void)
     // and move to the next statement, which might have changed inside perform
     interpreter_state.current_statement = interpreter_state.next_statement;
     
+    // between statements the state is consistent, so this is where we
+    // checkpoint and check the limits, but only every so often
+    if (--countdown == 0)
+      periodic_work();
+    
     // trace, only on line changes
     if (trace_lines && last_line != current_line()) {
       last_line = current_line();
@@ -1450,4 +1929,5 @@ void interpreter_run(void)
   end_ticks = clock();
   gettimeofday(&end_time, NULL);
   interpreter_state.running_state = 0;
+  statements_run += countdown_length - countdown;
 } /* interpreter_run */
@@ -46,6 +46,9 @@ Boston, MA 02111-1307, USA.  */
 #define MAXLINE 9999          // 1.01 through 99.99
 #define VERSION_STRING "2.0.0"
 
+/* exit status when a run is stopped by --max-statements and friends */
+#define LIMIT_EXIT_STATUS 3
+
 /* internal state variables used for I/O and other tasks */
 extern bool run_program;      // default to running the program, not just parsing it
 extern bool print_stats;      // when the program finishes running, should we print statistics?
@@ -56,6 +59,15 @@ extern bool trace_lines;
 extern bool type_equals;      // print an equals before each TYPE output?
 extern bool upper_case;       // force ASK inputs to upper case
 extern int random_seed;       // reset with RANDOMIZE, if -1 then auto-seeds
+extern bool compile_program;  // write a program image (.fcb) instead of running
+extern long checkpoint_interval;  // statements between checkpoints, 0 for none
+extern char *checkpoint_file; // where checkpoints are written
+extern bool resumed_run;      // the run state came from a checkpoint
+extern long max_statements;   // stop after this many statements, 0 for no limit
+extern double max_time;       // ... or this many seconds
+extern int max_stack_depth;   // ... or when DO and FOR nest this deep
+extern const char *limit_reached; // which limit stopped the run, NULL if none
+extern long long statements_run;  // statements performed in the last run
 
 extern char *source_file;
 extern char *input_file;
@@ -73,9 +85,13 @@ extern bool parse_in_cli_mode;
    The current value is held in a separate variable_storage_t
    in the variable_values list of the interpreter_state.
  */
+typedef struct variable_storage_s variable_storage_t;
+
 typedef struct {
   char *name;
   list_t *subscripts;      // subscripts, list of expressions
+  variable_storage_t *storage; // where it was last found, if generation is still current
+  long generation;
 } variable_t;
 
 /* either_t is used within variable_value_t for the actual data */
@@ -84,16 +100,25 @@ typedef union {
   double number;
 } either_t;
 
+/* subscripted values, see array.h */
+typedef struct array_s array_t;
+
 /* variable_storage_t holds the *value* of a variable in memory, it is a variable_t */
-typedef struct {
+struct variable_storage_s {
   int type;             /* NUMBER, STRING */
-  list_t *actual_dimensions;    // actual dimensions, even if auto-DIMmed
-  either_t *value;      // actual value(s), malloced
-} variable_storage_t;
+  array_t *array;       // the other elements if it is ever subscripted, otherwise NULL
+  either_t *value;      // the value, which is also element 0, malloced
+};
+
+/* compiled expressions, see tier.h */
+typedef struct code_s code_t;
+
+/* ... and the machine code made from them, see jit.h */
+typedef struct native_s native_t;
 
 /* expressions */
 typedef enum {
-  number, string, numstr, variable, op
+  number, string, numstr, variable, op, invariant
 } expression_type_t;
 
 typedef struct expression_struct {
@@ -107,7 +132,14 @@ typedef struct expression_struct {
       int opcode;
       struct expression_struct *p[3]; // arity can be up to 3 in BASIC
     } op;
+    struct {
+      struct expression_struct *expression; // the part that does not change inside a FOR
+      bool valid;         // false until it has been evaluated since the FOR was entered
+      double value;       // the result when it was
+    } invariant;          // only ever found in optimized trees, see optimize.h
   } parms;
+  struct expression_struct *optimized;  // what is evaluated in its place, see optimize.h
+  code_t *compiled;       // ... or run in its place, once its line is hot
 } expression_t;
 
 /* printlists */
@@ -128,10 +160,18 @@ typedef struct {
 typedef struct statement_struct {
   int type;
   bool abbreviated;  /* indicates whether keyword was abbreviated (e.g., 'S' vs 'SET') */
+  int fused;         /* a faster form picked by the optimizer, see optimize.h */
+  long executions;   /* times it has been performed, see tier.h */
+  bool promoted;     /* its expressions have been compiled */
+  int line;          /* the line it is on, in xx.yy * 100 format, see program.h */
   union {
     struct {
       variable_t *variable;
       expression_t *begin, *end, *step;
+      list_t *invariants;  // invariant expressions in the rest of the line, reset on entry
+      bool hoisted;        // the optimizer has looked for them
+      native_t *native;    // the rest of the line as a loop of machine code, see jit.h
+      int vector;          // whether the line can be run as a batch, see vector.h
     } _for;
     double _do;
     double go;
@@ -158,6 +198,11 @@ typedef struct statement_struct {
       char *filename;
       int action;  /* 0 = LIBRARY SAVE, 1 = LIBRARY CALL, 2 = LIBRARY RUN */
     } library;
+    struct {
+      int action;  /* 0 = INPUT, 1 = OUTPUT, 2 = RESTORE INPUT, 3 = RESTORE OUTPUT, 4 = CLOSE */
+      expression_t *channel;   /* NULL for channel 1, or for all of them with CLOSE */
+      expression_t *filename;  /* NULL to select a channel that's already open */
+    } open;
   } parms;
 } statement_t;
 
@@ -182,6 +227,9 @@ typedef struct {
   list_t *returnpoint;
   variable_t *index_variable;
   double begin, end, step;
+  either_t *index;      // in a FOR, the index variable's storage, or NULL to look it up
+  long generation;      // ... which is only good while no variables have been freed
+  list_t *tail;         // in a FOR, the last statement on its line, NULL if unknown
 } stackentry_t;
 
 /* this is the main state for the interpreter, largely consisting of the lines of
@@ -205,7 +253,33 @@ typedef struct {
 extern interpreterstate_t interpreter_state;
 
 /* the only piece of the interpreter the parser needs to know about is the variable table */
-void insert_variable(const variable_t *variable);
+void insert_variable(variable_t *variable);
+
+/* moves the entries of another variable table into the current one */
+void merge_variables(list_t *variables);
+
+/* returns the head of the line following line_index, used to find where a line ends */
+list_t *next_line_head(int line_index);
+
+/* drops anything left on the DO and FOR stack */
+void clear_stack(void);
+
+/* stops the run loop after the current statement to check the limits */
+void interrupt_run(void);
+
+/* evaluates an expression for its numeric value, used to fold constants */
+double expression_value(expression_t *expression);
+
+/* the pieces of the interpreter that machine code calls or finds its
+   addresses with, see jit.h */
+variable_storage_t *variable_storage(variable_t *variable);
+either_t *element_slot(variable_storage_t *storage, double subscript, bool writing);
+double checked_subscript(double subscript);
+double pure_function(int function, double a);
+void focal_error(const char *message);
+
+/* the number of decimals in a % format, also used to translate it to C */
+int format_decimals(char *string);
 
 /* perform post-parse setup */
 void interpreter_post_parse(void);
@@ -0,0 +1,58 @@
+/* random number generator (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __RNG_H__
+#define __RNG_H__
+
+#include <stdint.h>
+
+#include "stdhdr.h"
+
+/**
+ * @file rng.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief The random number generator behind FRAN.
+ *
+ * FRAN used to call rand, but the C library gives no way to save its
+ * state, so a checkpoint had to store the seed and the number of draws
+ * and call rand that many times again on resume, and the numbers changed
+ * from one C library to the next. This is xorshift64*, which keeps all of
+ * its state in one 64-bit word that is saved and put back as it is, and
+ * gives the same numbers everywhere.
+ *
+ * Nothing here depends on the interpreter, so translated programs, see
+ * emit.h, can link it too and draw the same numbers for the same seed.
+ */
+
+/* the whole state, never zero once seeded */
+extern uint64_t rng_state;
+
+/**
+ * Starts the generator from @p seed, any value, zero included.
+ */
+void rng_seed(uint32_t seed);
+
+/**
+ * Returns the next number, from 0 up to but not including 1.
+ */
+double rng_next(void);
+
+#endif /* __RNG_H__ */
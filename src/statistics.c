@@ -27,6 +27,12 @@ Boston, MA 02111-1307, USA.  */
 #include "statistics.h"
 
 #include "parse.h"
+#include "cache.h"
+#include "memstat.h"
+#include "optimize.h"
+#include "tier.h"
+#include "jit.h"
+#include "vector.h"
 
 /* declarations of the externs from the header */
 int variables_total = 0;
@@ -56,6 +62,29 @@ int assign_zero = 0;
 int assign_one = 0;
 int assign_other = 0;
 
+/* the number of lines listed by -p, busiest first */
+#define TIER_HOTTEST 5
+
+/* finds the busiest lines, filling the rest with -1 if there are fewer */
+static void hottest_lines(int hottest[TIER_HOTTEST])
+{
+  for (int i = 0; i < TIER_HOTTEST; i++)
+    hottest[i] = -1;
+  for (int line = 0; line < MAXLINE; line++) {
+    long count = line_executions(line);
+    if (count == 0)
+      continue;
+    // insert it into the list in order
+    for (int i = 0; i < TIER_HOTTEST; i++) {
+      if (hottest[i] < 0 || count > line_executions(hottest[i])) {
+        memmove(&hottest[i + 1], &hottest[i], (TIER_HOTTEST - i - 1) * sizeof(hottest[0]));
+        hottest[i] = line;
+        break;
+      }
+    }
+  }
+} /* hottest_lines */
+
 /* prints out various statistics from the static code,
  or if the write_stats flag is on, writes them to a file */
 void print_statistics()
@@ -165,6 +194,53 @@ void print_statistics()
     printf(" step 1: %i\n",for_loops_step_1);
     printf("   incs: %i\n",increments);
     printf("   decs: %i\n",decrements);
+    
+    if (max_statements > 0 || max_time > 0 || max_stack_depth > 0 || max_memory > 0) {
+      printf("\nLIMITS\n\n");
+      printf("    ran: %lld\n",statements_run);
+      printf("  fired: %s\n",limit_reached ? limit_reached : "none");
+    }
+    
+    if (use_cache) {
+      printf("\nPARSE CACHE\n\n");
+      printf("   hits: %i\n",cache_hits);
+      printf(" misses: %i\n",cache_misses);
+      printf(" stores: %i\n",cache_stores);
+      printf(" evicts: %i\n",cache_evictions);
+    }
+    
+    if (use_optimizer) {
+      printf("\nOPTIMIZER\n\n");
+      printf(" folded: %i\n",constants_folded);
+      printf("removed: %i\n",identities_removed);
+      printf("hoisted: %i\n",invariants_hoisted);
+      printf("  fused: %i\n",statements_fused);
+    }
+    
+    if (use_optimizer && tier_threshold > 0) {
+      int hottest[TIER_HOTTEST];
+      hottest_lines(hottest);
+      printf("\nTIERS\n\n");
+      printf("  after: %li\n",tier_threshold);
+      printf("  lines: %i\n",lines_promoted);
+      printf(" groups: %i\n",groups_promoted);
+      printf("  exprs: %i\n",expressions_compiled);
+      printf("   runs: %lld\n",compiled_runs);
+      printf(" vector: %i\n",loops_vectorized);
+      printf("  lanes: %lld\n",elements_vectorized);
+      if (use_jit) {
+        printf(" native: %i\n",expressions_native);
+        printf("  loops: %i\n",loops_native);
+        printf("  times: %lld\n",native_iterations);
+        printf("  bytes: %li\n",jit_code_size);
+      }
+      for (int i = 0; i < TIER_HOTTEST && hottest[i] >= 0; i++)
+        printf("%7.2f: %li\n",hottest[i] / 100.0,line_executions(hottest[i]));
+    }
+    
+    printf("\nMEMORY       current     peak\n\n");
+    for (int i = 0; i <= MEMORY_CATEGORIES; i++)
+      printf("%7s: %10lld %10lld\n",memory_category_name(i),memory_current(i),memory_peak(i));
   }
   /* and/or the file if selected */
   if (write_stats) {
@@ -212,6 +288,47 @@ void print_statistics()
     fprintf(fp, "OTHER,incs: %i\n",increments);
     fprintf(fp, "OTHER,decs: %i\n",decrements);
     
+    if (max_statements > 0 || max_time > 0 || max_stack_depth > 0 || max_memory > 0) {
+      fprintf(fp, "LIMITS,statements run,%lld\n",statements_run);
+      fprintf(fp, "LIMITS,fired,%s\n",limit_reached ? limit_reached : "none");
+    }
+    
+    if (use_cache) {
+      fprintf(fp, "PARSE CACHE,hits,%i\n",cache_hits);
+      fprintf(fp, "PARSE CACHE,misses,%i\n",cache_misses);
+      fprintf(fp, "PARSE CACHE,stores,%i\n",cache_stores);
+      fprintf(fp, "PARSE CACHE,evictions,%i\n",cache_evictions);
+    }
+    
+    if (use_optimizer) {
+      fprintf(fp, "OPTIMIZER,constants folded,%i\n",constants_folded);
+      fprintf(fp, "OPTIMIZER,identities removed,%i\n",identities_removed);
+      fprintf(fp, "OPTIMIZER,invariants hoisted,%i\n",invariants_hoisted);
+      fprintf(fp, "OPTIMIZER,statements fused,%i\n",statements_fused);
+    }
+    
+    if (use_optimizer && tier_threshold > 0) {
+      fprintf(fp, "TIERS,threshold,%li\n",tier_threshold);
+      fprintf(fp, "TIERS,lines promoted,%i\n",lines_promoted);
+      fprintf(fp, "TIERS,groups promoted,%i\n",groups_promoted);
+      fprintf(fp, "TIERS,expressions compiled,%i\n",expressions_compiled);
+      fprintf(fp, "TIERS,compiled runs,%lld\n",compiled_runs);
+      fprintf(fp, "TIERS,vectorized loops,%i\n",loops_vectorized);
+      fprintf(fp, "TIERS,vectorized elements,%lld\n",elements_vectorized);
+      if (use_jit) {
+        fprintf(fp, "TIERS,native expressions,%i\n",expressions_native);
+        fprintf(fp, "TIERS,native loops,%i\n",loops_native);
+        fprintf(fp, "TIERS,native loop iterations,%lld\n",native_iterations);
+        fprintf(fp, "TIERS,machine code bytes,%li\n",jit_code_size);
+      }
+      for (int i = 0; i < MAXLINE; i++)
+        if (interpreter_state.lines[i] != NULL && line_executions(i) > 0)
+          fprintf(fp, "EXECUTIONS,%.2f,%li\n",i / 100.0,line_executions(i));
+    }
+    
+    for (int i = 0; i <= MEMORY_CATEGORIES; i++)
+      fprintf(fp, "MEMORY,%s,%lld,%lld\n",memory_category_name(i),memory_current(i),memory_peak(i));
+    
     fclose(fp);
   }
 }
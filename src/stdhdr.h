@@ -66,6 +66,10 @@ Boston, MA 02111-1307, USA.  */
   #ifndef fileno
   #define fileno _fileno
   #endif
+  #include <process.h>
+  #ifndef getpid
+  #define getpid _getpid
+  #endif
   #if !defined(_IO_H_)
     int _isatty(int _FileHandle);
     int _fileno(FILE *_File);
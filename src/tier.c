@@ -0,0 +1,244 @@
+/* tiered execution (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include "tier.h"
+#include "memstat.h"
+#include "optimize.h"
+#include "parse.h"
+
+/* command line settings */
+long tier_threshold = 100;
+
+/* statistics */
+int lines_promoted = 0;
+int groups_promoted = 0;
+int expressions_compiled = 0;
+long long compiled_runs = 0;
+
+/* the instructions for one expression as they are being compiled */
+typedef struct {
+  instruction_t *instructions;
+  int length, capacity;
+  int depth, max_depth;       // the stack, as it will be when this runs
+} builder_t;
+
+static void emit(builder_t *code, code_op_t op, int pushes)
+{
+  if (code->length == code->capacity) {
+    code->capacity = code->capacity ? code->capacity * 2 : 8;
+    code->instructions = realloc(code->instructions, code->capacity * sizeof(code->instructions[0]));
+  }
+  code->instructions[code->length].op = op;
+  code->length++;
+  code->depth += pushes;
+  if (code->depth > code->max_depth)
+    code->max_depth = code->depth;
+}
+
+/* the operand of the instruction that was just emitted */
+#define LAST_OPERAND(code) ((code)->instructions[(code)->length - 1].operand)
+
+/* true if there's a string anywhere in the expression, which would mean
+   the stack of numbers could not hold its values */
+static bool has_string(const expression_t *expression)
+{
+  switch (expression->type) {
+    case string:
+      return true;
+    case variable:
+      for (list_t *subscript = expression->parms.variable->subscripts; subscript != NULL; subscript = lst_next(subscript))
+        if (has_string(subscript->data))
+          return true;
+      return false;
+    case op:
+      for (int i = 0; i < expression->parms.op.arity; i++)
+        if (has_string(expression->parms.op.p[i]))
+          return true;
+      return false;
+    default:
+      return false;
+  }
+} /* has_string */
+
+/* returns the instruction for an operator, or CODE_TREE if it isn't one
+   the stack machine does */
+static code_op_t operator_code(int opcode, int arity)
+{
+  if (arity == 2) {
+    switch (opcode) {
+      case '+': return CODE_ADD;
+      case '-': return CODE_SUBTRACT;
+      case '*': return CODE_MULTIPLY;
+      case '/': return CODE_DIVIDE;
+      case '^': return CODE_POWER;
+      case '=': return CODE_EQUAL;
+    }
+  }
+  if (arity == 1) {
+    switch (opcode) {
+      case '-':
+        return CODE_NEGATE;
+      case FABS:
+      case FATN:
+      case FCOS:
+      case FEXP:
+      case FITR:
+      case FLOG:
+      case FSGN:
+      case FSIN:
+      case FSQT:
+        return CODE_FUNCTION;
+    }
+  }
+  return CODE_TREE;
+} /* operator_code */
+
+/* emits the code for an expression, in postfix order so that the values are
+   worked out in the same order as evaluate_expression does it */
+static void compile_node(builder_t *code, expression_t *expression)
+{
+  code_op_t code_op;
+  
+  switch (expression->type) {
+    case number:
+      emit(code, CODE_NUMBER, 1);
+      LAST_OPERAND(code).number = expression->parms.number;
+      return;
+      
+    case variable:
+    {
+      variable_t *variable = expression->parms.variable;
+      if (variable->subscripts == NULL) {
+        emit(code, CODE_VARIABLE, 1);
+        LAST_OPERAND(code).variable = variable;
+        return;
+      }
+      // only one subscript is allowed, anything else gets the error from the tree
+      expression_t *subscript = variable->subscripts->data;
+      if (lst_next(variable->subscripts) == NULL && !has_string(subscript)) {
+        compile_node(code, subscript->optimized != NULL ? subscript->optimized : subscript);
+        emit(code, CODE_ELEMENT, 0);
+        LAST_OPERAND(code).variable = variable;
+        return;
+      }
+      break;
+    }
+      
+    case op:
+      code_op = operator_code(expression->parms.op.opcode, expression->parms.op.arity);
+      if (code_op == CODE_TREE || has_string(expression))
+        break;
+      for (int i = 0; i < expression->parms.op.arity; i++)
+        compile_node(code, expression->parms.op.p[i]);
+      emit(code, code_op, 1 - expression->parms.op.arity);
+      if (code_op == CODE_FUNCTION)
+        LAST_OPERAND(code).function = expression->parms.op.opcode;
+      return;
+      
+    default:
+      // numstr, strings and loop invariants, which know how to cache themselves
+      break;
+  }
+  
+  emit(code, CODE_TREE, 1);
+  LAST_OPERAND(code).expression = expression;
+} /* compile_node */
+
+/* compiles a root expression into its compiled field */
+static void compile_root(expression_t *root, void *user_data)
+{
+  (void)user_data;
+  if (root == NULL || root->compiled != NULL)
+    return;
+  
+  // constants are as fast as they're going to get
+  expression_t *tree = root->optimized != NULL ? root->optimized : root;
+  if (tree->type != op && tree->type != variable)
+    return;
+  
+  builder_t code = { NULL, 0, 0, 0, 0 };
+  compile_node(&code, tree);
+  
+  // if the whole thing went back to the tree there's no point, and it would
+  // end up calling itself
+  if ((code.length > 1 || code.instructions[0].op != CODE_TREE) && code.max_depth <= CODE_STACK) {
+    code_t *compiled = memory_calloc(MEMORY_AST, sizeof(*compiled) + code.length * sizeof(code.instructions[0]));
+    compiled->length = code.length;
+    memcpy(compiled->instructions, code.instructions, code.length * sizeof(code.instructions[0]));
+    root->compiled = compiled;
+    expressions_compiled++;
+  }
+  free(code.instructions);
+} /* compile_root */
+
+/* compiles the statements from head up to end, returns true if any were new */
+static bool promote_statements(list_t *head, list_t *end)
+{
+  bool promoted = false;
+  for (list_t *node = head; node != NULL && node != end; node = lst_next(node)) {
+    statement_t *statement = node->data;
+    // empty statements, from a doubled or trailing semicolon, have nothing to compile
+    if (statement == NULL || statement->promoted)
+      continue;
+    statement->promoted = true;
+    promoted = true;
+    // an ASK stores into its variables rather than evaluating them
+    if (statement->type != ASK)
+      foreach_root(statement, compile_root, NULL);
+  }
+  return promoted;
+} /* promote_statements */
+
+void promote_line(int line_index)
+{
+  if (line_index < 0 || line_index >= MAXLINE || interpreter_state.lines[line_index] == NULL)
+    return;
+  if (promote_statements(interpreter_state.lines[line_index], next_line_head(line_index)))
+    lines_promoted++;
+} /* promote_line */
+
+void promote_group(int group)
+{
+  bool promoted = false;
+  for (int i = group * 100; i < (group + 1) * 100 && i < MAXLINE; i++) {
+    if (interpreter_state.lines[i] == NULL)
+      continue;
+    if (promote_statements(interpreter_state.lines[i], next_line_head(i))) {
+      lines_promoted++;
+      promoted = true;
+    }
+  }
+  if (promoted)
+    groups_promoted++;
+} /* promote_group */
+
+long line_executions(int line_index)
+{
+  long most = 0;
+  if (line_index < 0 || line_index >= MAXLINE || interpreter_state.lines[line_index] == NULL)
+    return 0;
+  list_t *end = next_line_head(line_index);
+  for (list_t *node = interpreter_state.lines[line_index]; node != NULL && node != end; node = lst_next(node)) {
+    statement_t *statement = node->data;
+    if (statement != NULL && statement->executions > most)
+      most = statement->executions;
+  }
+  return most;
+} /* line_executions */
@@ -0,0 +1,117 @@
+/* tiered execution (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __TIER_H__
+#define __TIER_H__
+
+#include "stdhdr.h"
+#include "retrofocal.h"
+
+/**
+ * @file tier.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief Compiles the lines a program spends its time in.
+ *
+ * Every statement counts how many times it has been performed. When one
+ * reaches the threshold, the line it is on is promoted: the expressions
+ * in each of its statements are compiled into a short list of
+ * instructions for a stack machine, which the interpreter runs in place of
+ * walking the tree. When the statement is a DO, the line or group it
+ * calls is promoted as well, so the body of a hot subroutine is compiled
+ * before its own counts catch up.
+ *
+ * The instructions perform the same operations in the same order as the
+ * tree, so the results are identical. Anything that is not plain
+ * arithmetic on numbers, like strings, FRAN or a malformed constant, is
+ * left as a call back into the tree walker, and an expression that would
+ * be nothing but that is not compiled at all.
+ *
+ * Cold lines are never compiled, so short runs start as quickly as they
+ * always have.
+ */
+
+/* the most values a compiled expression can stack up at once */
+#define CODE_STACK 32
+
+typedef enum {
+  CODE_NUMBER,      // push a constant
+  CODE_VARIABLE,    // push a variable without subscripts
+  CODE_ELEMENT,     // replace the subscript on the top with that element
+  CODE_NEGATE,
+  CODE_ADD,
+  CODE_SUBTRACT,
+  CODE_MULTIPLY,
+  CODE_DIVIDE,
+  CODE_POWER,
+  CODE_EQUAL,
+  CODE_FUNCTION,    // apply a pure function like FSQT to the top
+  CODE_TREE         // push the value of an expression from the tree walker
+} code_op_t;
+
+typedef struct {
+  code_op_t op;
+  union {
+    double number;
+    variable_t *variable;
+    int function;               // the token, like FSQT
+    expression_t *expression;
+  } operand;
+} instruction_t;
+
+struct code_s {
+  native_t *native;             // the same as machine code, see jit.h
+  int length;
+  instruction_t instructions[];
+};
+
+/* command line settings */
+extern long tier_threshold;     // performances before a line is compiled, 0 for never
+
+/* statistics */
+extern int lines_promoted;
+extern int groups_promoted;
+extern int expressions_compiled;
+extern long long compiled_runs;
+
+/**
+ * Compiles the expressions in every statement on a line, unless it has
+ * already been done.
+ *
+ * @param line_index The line, in xx.yy * 100 format.
+ */
+void promote_line(int line_index);
+
+/**
+ * Compiles every line in a group, as for promote_line.
+ *
+ * @param group The group number.
+ */
+void promote_group(int group);
+
+/**
+ * Returns the number of times the statements on a line have been
+ * performed, which is the count of the busiest of them.
+ *
+ * @param line_index The line, in xx.yy * 100 format.
+ */
+long line_executions(int line_index);
+
+#endif /* __TIER_H__ */
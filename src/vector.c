@@ -0,0 +1,375 @@
+/* array loops run as batches (implementation) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#include <math.h>
+
+#include "vector.h"
+#include "tier.h"
+#include "array.h"
+#include "parse.h"
+#include "fmath.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define VECTOR_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* statistics */
+int loops_vectorized = 0;
+long long elements_vectorized = 0;
+
+/* the operations done a block at a time */
+typedef enum {
+  BLOCK_ADD,
+  BLOCK_SUBTRACT,
+  BLOCK_MULTIPLY,
+  BLOCK_DIVIDE,
+  BLOCK_EQUAL,
+  BLOCK_NEGATE,
+  BLOCK_ABS,
+  BLOCK_SQRT
+} block_op_t;
+
+/* the whole range of subscripts, which is the most times round a batch can go */
+#define ELEMENTS (ARRAY_LAST - ARRAY_FIRST + 1)
+
+/* the stack of the stack machine, a block for each entry */
+static double stack[CODE_STACK][VECTOR_BLOCK];
+
+/* the index each time round, and the values to store */
+static double indices[ELEMENTS];
+static double results[ELEMENTS];
+
+#ifdef VECTOR_AVX2
+/* four lanes at a time, returning how many were done */
+__attribute__((target("avx2")))
+static int block_avx2(block_op_t op, double *a, const double *b, int lanes)
+{
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  const __m256d minus_one = _mm256_set1_pd(-1.0);
+  int i;
+  for (i = 0; i + 4 <= lanes; i += 4) {
+    __m256d x = _mm256_loadu_pd(a + i);
+    switch (op) {
+      case BLOCK_ADD: x = _mm256_add_pd(x, _mm256_loadu_pd(b + i)); break;
+      case BLOCK_SUBTRACT: x = _mm256_sub_pd(x, _mm256_loadu_pd(b + i)); break;
+      case BLOCK_MULTIPLY: x = _mm256_mul_pd(x, _mm256_loadu_pd(b + i)); break;
+      case BLOCK_DIVIDE: x = _mm256_div_pd(x, _mm256_loadu_pd(b + i)); break;
+      case BLOCK_EQUAL: x = _mm256_and_pd(_mm256_cmp_pd(x, _mm256_loadu_pd(b + i), _CMP_EQ_OQ), minus_one); break;
+      case BLOCK_NEGATE: x = _mm256_xor_pd(x, sign); break;
+      case BLOCK_ABS: x = _mm256_andnot_pd(sign, x); break;
+      case BLOCK_SQRT: x = _mm256_sqrt_pd(x); break;
+    }
+    _mm256_storeu_pd(a + i, x);
+  }
+  return i;
+} /* block_avx2 */
+
+static bool has_avx2(void)
+{
+  static int supported = -1;
+  if (supported < 0)
+    supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+  return supported;
+} /* has_avx2 */
+#endif
+
+#ifdef __SSE2__
+/* two lanes at a time, which every x86-64 can do */
+static int block_sse2(block_op_t op, double *a, const double *b, int lanes)
+{
+  const __m128d sign = _mm_set1_pd(-0.0);
+  const __m128d minus_one = _mm_set1_pd(-1.0);
+  int i;
+  for (i = 0; i + 2 <= lanes; i += 2) {
+    __m128d x = _mm_loadu_pd(a + i);
+    switch (op) {
+      case BLOCK_ADD: x = _mm_add_pd(x, _mm_loadu_pd(b + i)); break;
+      case BLOCK_SUBTRACT: x = _mm_sub_pd(x, _mm_loadu_pd(b + i)); break;
+      case BLOCK_MULTIPLY: x = _mm_mul_pd(x, _mm_loadu_pd(b + i)); break;
+      case BLOCK_DIVIDE: x = _mm_div_pd(x, _mm_loadu_pd(b + i)); break;
+      case BLOCK_EQUAL: x = _mm_and_pd(_mm_cmpeq_pd(x, _mm_loadu_pd(b + i)), minus_one); break;
+      case BLOCK_NEGATE: x = _mm_xor_pd(x, sign); break;
+      case BLOCK_ABS: x = _mm_andnot_pd(sign, x); break;
+      case BLOCK_SQRT: x = _mm_sqrt_pd(x); break;
+    }
+    _mm_storeu_pd(a + i, x);
+  }
+  return i;
+} /* block_sse2 */
+#endif
+
+/* one lane at a time, for what's left over and for everything elsewhere,
+   done exactly as run_code does it */
+static void block_scalar(block_op_t op, double *a, const double *b, int from, int lanes)
+{
+  for (int i = from; i < lanes; i++) {
+    switch (op) {
+      case BLOCK_ADD: a[i] = a[i] + b[i]; break;
+      case BLOCK_SUBTRACT: a[i] = a[i] - b[i]; break;
+      case BLOCK_MULTIPLY: a[i] = a[i] * b[i]; break;
+      case BLOCK_DIVIDE: a[i] = a[i] / b[i]; break;
+      case BLOCK_EQUAL: a[i] = -(a[i] == b[i]); break;
+      case BLOCK_NEGATE: a[i] = -a[i]; break;
+      case BLOCK_ABS: a[i] = fabs(a[i]); break;
+      case BLOCK_SQRT: a[i] = sqrt(a[i]); break;
+    }
+  }
+} /* block_scalar */
+
+/* a = a op b, or a = op a when there is no b, over a block */
+static void block(block_op_t op, double *a, const double *b, int lanes)
+{
+  int done = 0;
+#ifdef VECTOR_AVX2
+  if (has_avx2())
+    done = block_avx2(op, a, b, lanes);
+#endif
+#ifdef __SSE2__
+  done += block_sse2(op, a + done, b != NULL ? b + done : NULL, lanes - done);
+#endif
+  block_scalar(op, a, b, done, lanes);
+} /* block */
+
+static void fill(double *a, double value, int lanes)
+{
+  for (int i = 0; i < lanes; i++)
+    a[i] = value;
+} /* fill */
+
+/* true if an expression is nothing but a reference to the index */
+static bool is_index(expression_t *expression, const variable_t *index)
+{
+  expression_t *tree = expression->optimized != NULL ? expression->optimized : expression;
+  return tree->type == variable && tree->parms.variable->subscripts == NULL && strcmp(tree->parms.variable->name, index->name) == 0;
+} /* is_index */
+
+/* true if the compiled expression only reads things that the stores can't
+   change, other than the element being stored */
+static bool code_is_independent(const code_t *code, const variable_t *index, const variable_t *target)
+{
+  for (int i = 0; i < code->length; i++) {
+    const instruction_t *instruction = &code->instructions[i];
+    switch (instruction->op) {
+      case CODE_VARIABLE:
+        // the target alone is its element 0, which might be stored into
+        if (strcmp(instruction->operand.variable->name, target->name) == 0)
+          return false;
+        break;
+      case CODE_ELEMENT:
+      {
+        const char *name = instruction->operand.variable->name;
+        // the index changes each time round, and so does its element 0
+        if (strcmp(name, index->name) == 0)
+          return false;
+        // the target may only be read at the element being stored
+        if (strcmp(name, target->name) == 0) {
+          const instruction_t *subscript = instruction - 1;
+          if (i == 0 || subscript->op != CODE_VARIABLE || strcmp(subscript->operand.variable->name, index->name) != 0)
+            return false;
+        }
+        break;
+      }
+      case CODE_TREE:
+        // the only trees it can do are invariants, which are checked when run
+        if (instruction->operand.expression->type != invariant)
+          return false;
+        break;
+      default:
+        break;
+    }
+  }
+  return true;
+} /* code_is_independent */
+
+/* looks at the line once to see if it has the right shape */
+static vector_shape_t loop_shape(statement_t *statement, list_t *head, list_t *tail)
+{
+  statement_t *set = tail->data;
+  variable_t *index = statement->parms._for.variable;
+  if (lst_next(head) != tail || set == NULL || set->type != SET || index->subscripts != NULL)
+    return VECTOR_NEVER;
+
+  variable_t *target = set->parms.set.variable;
+  if (target->subscripts == NULL || lst_next(target->subscripts) != NULL)
+    return VECTOR_NEVER;
+  if (strcmp(target->name, index->name) == 0 || !is_index(target->subscripts->data, index))
+    return VECTOR_NEVER;
+
+  expression_t *root = set->parms.set.expression;
+  expression_t *tree = root->optimized != NULL ? root->optimized : root;
+  if (root->compiled == NULL)
+    return tree->type == number ? VECTOR_SHAPED : VECTOR_NEVER;
+  return code_is_independent(root->compiled, index, target) ? VECTOR_SHAPED : VECTOR_NEVER;
+} /* loop_shape */
+
+/* replaces a block of subscripts with the elements they pick out, or
+   returns false if any is out of bounds and would print an error */
+static bool gather(variable_storage_t *storage, double *subscripts, int lanes)
+{
+  bool run = subscripts[0] == floor(subscripts[0]);
+  for (int i = 0; i < lanes; i++) {
+    if (!(subscripts[i] >= ARRAY_FIRST && subscripts[i] <= ARRAY_LAST))
+      return false;
+    run = run && subscripts[i] == subscripts[0] + i;
+  }
+
+  // consecutive elements can be copied out a page at a time, except
+  // element 0, which is the variable itself
+  if (run) {
+    int first = (int)subscripts[0];
+    array_read_run(storage->array, first, lanes, subscripts);
+    if (first <= 0 && first + lanes > 0)
+      subscripts[-first] = storage->value->number;
+    return true;
+  }
+  for (int i = 0; i < lanes; i++)
+    subscripts[i] = element_slot(storage, subscripts[i], false)->number;
+  return true;
+} /* gather */
+
+/* runs a compiled expression over a block of the loop, the same way run_code
+   runs it once, and returns false if the block can't be done as a batch */
+static bool run_block(const code_t *code, const variable_t *index, const double *index_values, int lanes, double *values)
+{
+  int top = -1;
+
+  for (const instruction_t *instruction = code->instructions; instruction < code->instructions + code->length; instruction++) {
+    switch (instruction->op) {
+      case CODE_NUMBER:
+        fill(stack[++top], instruction->operand.number, lanes);
+        break;
+      case CODE_VARIABLE:
+        if (strcmp(instruction->operand.variable->name, index->name) == 0)
+          memcpy(stack[++top], index_values, lanes * sizeof(double));
+        else
+          fill(stack[++top], variable_storage(instruction->operand.variable)->value->number, lanes);
+        break;
+      case CODE_ELEMENT:
+        if (!gather(variable_storage(instruction->operand.variable), stack[top], lanes))
+          return false;
+        break;
+      case CODE_NEGATE:
+        block(BLOCK_NEGATE, stack[top], NULL, lanes);
+        break;
+      case CODE_ADD:
+        top--;
+        block(BLOCK_ADD, stack[top], stack[top + 1], lanes);
+        break;
+      case CODE_SUBTRACT:
+        top--;
+        block(BLOCK_SUBTRACT, stack[top], stack[top + 1], lanes);
+        break;
+      case CODE_MULTIPLY:
+        top--;
+        block(BLOCK_MULTIPLY, stack[top], stack[top + 1], lanes);
+        break;
+      case CODE_DIVIDE:
+        top--;
+        // a zero would print an error, which has to come out in order
+        for (int i = 0; i < lanes; i++)
+          if (stack[top + 1][i] == 0)
+            return false;
+        block(BLOCK_DIVIDE, stack[top], stack[top + 1], lanes);
+        break;
+      case CODE_POWER:
+        top--;
+        for (int i = 0; i < lanes; i++)
+          stack[top][i] = stack[top + 1][i] == 2 ? stack[top][i] * stack[top][i] : pow(stack[top][i], stack[top + 1][i]);
+        break;
+      case CODE_EQUAL:
+        top--;
+        block(BLOCK_EQUAL, stack[top], stack[top + 1], lanes);
+        break;
+      case CODE_FUNCTION:
+        // the instructions for these are exact, the rest come from fmath.h
+        switch (instruction->operand.function) {
+          case FABS: block(BLOCK_ABS, stack[top], NULL, lanes); break;
+          case FSQT: block(BLOCK_SQRT, stack[top], NULL, lanes); break;
+          case FATN: batch_atn(stack[top], lanes); break;
+          case FCOS: batch_cos(stack[top], lanes); break;
+          case FEXP: batch_exp(stack[top], lanes); break;
+          case FLOG: batch_log(stack[top], lanes); break;
+          case FSIN: batch_sin(stack[top], lanes); break;
+          default:
+            for (int i = 0; i < lanes; i++)
+              stack[top][i] = pure_function(instruction->operand.function, stack[top][i]);
+            break;
+        }
+        break;
+      case CODE_TREE:
+      {
+        // an invariant that hasn't been worked out yet will be on the first time round
+        expression_t *expression = instruction->operand.expression;
+        if (!expression->parms.invariant.valid)
+          return false;
+        fill(stack[++top], expression->parms.invariant.value, lanes);
+        break;
+      }
+    }
+  }
+  memcpy(values, stack[0], lanes * sizeof(double));
+  return true;
+} /* run_block */
+
+long vector_loop(statement_t *statement, list_t *head, list_t *tail, double *index, double end, double step, long most)
+{
+  if (statement->parms._for.vector == VECTOR_UNKNOWN)
+    statement->parms._for.vector = loop_shape(statement, head, tail);
+  if (statement->parms._for.vector == VECTOR_NEVER || step != 1)
+    return 0;
+
+  // the values the index takes, stepped the way next_iteration does it, all
+  // of which have to be elements that can be stored
+  double value = *index;
+  long count = 0;
+  if (value != floor(value))
+    return 0;
+  do {
+    if (value < ARRAY_FIRST || value > ARRAY_LAST || count == most)
+      return 0;
+    indices[count++] = value;
+  } while (++value <= end);
+
+  // work everything out before anything is stored, so giving up leaves no trace
+  statement_t *set = tail->data;
+  expression_t *root = set->parms.set.expression;
+  variable_t *variable = statement->parms._for.variable;
+  for (long start = 0; start < count; start += VECTOR_BLOCK) {
+    int lanes = count - start < VECTOR_BLOCK ? (int)(count - start) : VECTOR_BLOCK;
+    if (root->compiled == NULL) {
+      expression_t *tree = root->optimized != NULL ? root->optimized : root;
+      fill(results + start, tree->parms.number, lanes);
+    }
+    else if (!run_block(root->compiled, variable, indices + start, lanes, results + start))
+      return 0;
+  }
+
+  variable_storage_t *storage = variable_storage(set->parms.set.variable);
+  for (long i = 0; i < count; i++)
+    element_slot(storage, indices[i], true)->number = results[i];
+  *index = value;
+
+  loops_vectorized++;
+  elements_vectorized += count;
+  return count;
+} /* vector_loop */
@@ -0,0 +1,88 @@
+/* array loops run as batches (header) for RetroFOCAL
+ Copyright (C) 2026 Maury Markowitz
+
+ This file is part of RetroFOCAL.
+
+ RetroFOCAL is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2, or (at your option)
+ any later version.
+
+ RetroFOCAL is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with RetroFOCAL; see the file COPYING.  If not, write to
+ the Free Software Foundation, 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.  */
+
+#ifndef __VECTOR_H__
+#define __VECTOR_H__
+
+#include "stdhdr.h"
+#include "retrofocal.h"
+
+/**
+ * @file vector.h
+ * @author Maury Markowitz
+ * @date 18 October 2026
+ * @brief Runs loops over whole arrays a block of elements at a time.
+ *
+ * Numeric programs are full of lines like
+ *
+ *     F I=-100,100; S B(I)=A(I)*K+C
+ *
+ * where each time round stores one element of an array and reads nothing
+ * that an earlier time round wrote. Once such a line is hot, the rest of
+ * the loop is run as a batch: the compiled expression from tier.h is run
+ * once per instruction over VECTOR_BLOCK elements at a time, using AVX2
+ * or SSE2 where the processor has them, and the results are stored in
+ * order once every one of them has been worked out.
+ *
+ * A loop qualifies when its line is the FOR and a single SET into an
+ * element of an array subscripted by the index, the step is 1, the index
+ * is a whole number, and every element it will store is within bounds.
+ * The expression can read the index, any variable other than the target
+ * or the index, the element being stored, other arrays with any
+ * subscript, and invariants that have already been worked out.
+ *
+ * Anything that could make the batch differ from running it one element
+ * at a time, like reading another element of the target, a division by
+ * zero or a subscript out of bounds, which would print an error, leaves
+ * the loop to the interpreter with nothing changed. FSIN, FEXP and the
+ * other functions are run through the batch forms in fmath.h, so the
+ * results are the same to the last bit in either --math mode.
+ */
+
+/* the elements worked on at once */
+#define VECTOR_BLOCK 256
+
+/* what is known about a FOR, kept in the statement */
+typedef enum {
+  VECTOR_UNKNOWN,     // not looked at yet
+  VECTOR_NEVER,       // the line doesn't have the right shape
+  VECTOR_SHAPED       // it does, so it is worth trying each time
+} vector_shape_t;
+
+/* statistics */
+extern int loops_vectorized;
+extern long long elements_vectorized;
+
+/**
+ * Runs the rest of a FOR loop as a batch, if it qualifies.
+ *
+ * @param statement The FOR, whose line must have been promoted.
+ * @param head The list item holding the FOR.
+ * @param tail The last statement on its line.
+ * @param index The index, set for the next time round.
+ * @param end The last value of the index.
+ * @param step The step, which has to be 1.
+ * @param most The most times round there is room for before a checkpoint or limit.
+ * @return The times round that were run, with the index left as the
+ *         NEXT that ended the loop leaves it, or 0 if nothing was done.
+ */
+long vector_loop(statement_t *statement, list_t *head, list_t *tail, double *index, double end, double step, long most);
+
+#endif /* __VECTOR_H__ */
@@ -26,70 +26,71 @@
 #include "write.h"
 #include "retrofocal.h"
 #include "parse.h"
+#include "program.h"
 
+/* where the listing goes, straight to a file, or into a string that grows */
 typedef struct {
+  FILE *file;           // NULL for the string
   char *data;
   size_t length;
   size_t capacity;
-} string_builder_t;
+} sink_t;
 
-static void sb_init(string_builder_t *sb)
+static void reserve(sink_t *sink, size_t extra)
 {
-  sb->capacity = 256;
-  sb->length = 0;
-  sb->data = malloc(sb->capacity);
-  if (sb->data == NULL) {
-    fprintf(stderr, "Malloc failed in write_output\n");
-    exit(EXIT_FAILURE);
-  }
-  sb->data[0] = '\0';
-}
-
-static void sb_reserve(string_builder_t *sb, size_t extra)
-{
-  if (sb->length + extra + 1 > sb->capacity) {
-    size_t need = sb->length + extra + 1;
-    size_t new_capacity = sb->capacity * 2;
+  if (sink->length + extra + 1 > sink->capacity) {
+    size_t need = sink->length + extra + 1;
+    size_t new_capacity = sink->capacity * 2;
     while (new_capacity < need)
       new_capacity *= 2;
-    sb->data = realloc(sb->data, new_capacity);
-    if (sb->data == NULL) {
+    sink->data = realloc(sink->data, new_capacity);
+    if (sink->data == NULL) {
       fprintf(stderr, "Realloc failed in write_output\n");
       exit(EXIT_FAILURE);
     }
-    sb->capacity = new_capacity;
+    sink->capacity = new_capacity;
   }
 }
 
-static void sb_append(string_builder_t *sb, const char *text)
+static void put(sink_t *sink, const char *text)
 {
   if (text == NULL)
     return;
+  if (sink->file != NULL) {
+    fputs(text, sink->file);
+    return;
+  }
 
   size_t added = strlen(text);
-  sb_reserve(sb, added);
-  memcpy(sb->data + sb->length, text, added);
-  sb->length += added;
-  sb->data[sb->length] = '\0';
+  reserve(sink, added);
+  memcpy(sink->data + sink->length, text, added);
+  sink->length += added;
+  sink->data[sink->length] = '\0';
 }
 
-static void sb_append_fmt(string_builder_t *sb, const char *fmt, ...)
+static void put_fmt(sink_t *sink, const char *fmt, ...)
 {
   va_list ap;
   va_start(ap, fmt);
-  va_list ap_copy;
-  va_copy(ap_copy, ap);
-  int needed = vsnprintf(NULL, 0, fmt, ap_copy);
-  va_end(ap_copy);
-  if (needed < 0) {
+  if (sink->file != NULL) {
+    vfprintf(sink->file, fmt, ap);
     va_end(ap);
     return;
   }
 
-  sb_reserve(sb, (size_t)needed);
-  vsnprintf(sb->data + sb->length, sb->capacity - sb->length, fmt, ap);
-  sb->length += (size_t)needed;
-  sb->data[sb->length] = '\0';
+  // the pieces are numbers and formats, so they nearly always fit here
+  char buffer[64];
+  va_list ap_copy;
+  va_copy(ap_copy, ap);
+  int needed = vsnprintf(buffer, sizeof(buffer), fmt, ap_copy);
+  va_end(ap_copy);
+  if (needed >= 0 && (size_t)needed < sizeof(buffer))
+    put(sink, buffer);
+  else if (needed >= 0) {
+    reserve(sink, (size_t)needed);
+    vsnprintf(sink->data + sink->length, sink->capacity - sink->length, fmt, ap);
+    sink->length += (size_t)needed;
+  }
   va_end(ap);
 }
 
@@ -97,43 +98,43 @@ static void sb_append_fmt(string_builder_t *sb, const char *fmt, ...)
  * Reconstruct an expression as canonical FOCAL source code.
  *
  * @param e The expression to reconstruct.
- * @param sb String builder to append result to.
+ * @param sink Where to write it.
  */
-static void expression_to_string(expression_t *e, string_builder_t *sb)
+static void expression_to_string(expression_t *e, sink_t *sink)
 {
   if (e == NULL)
     return;
     
   switch (e->type) {
     case number:
-      sb_append_fmt(sb, "%g", e->parms.number);
+      put_fmt(sink, "%g", e->parms.number);
       break;
       
     case string:
-      sb_append(sb, "\"");
-      sb_append(sb, e->parms.string);
-      sb_append(sb, "\"");
+      put(sink, "\"");
+      put(sink, e->parms.string);
+      put(sink, "\"");
       break;
       
     case numstr:
-      sb_append(sb, e->parms.string);
+      put(sink, e->parms.string);
       break;
       
     case variable:
       if (e->parms.variable && e->parms.variable->name) {
-        sb_append(sb, e->parms.variable->name);
+        put(sink, e->parms.variable->name);
         
         // Add subscripts if present
         if (e->parms.variable->subscripts != NULL) {
-          sb_append(sb, "(");
+          put(sink, "(");
           bool first = true;
           for (list_t *node = e->parms.variable->subscripts; node != NULL; node = node->next) {
             if (!first)
-              sb_append(sb, ",");
-            expression_to_string((expression_t *)node->data, sb);
+              put(sink, ",");
+            expression_to_string((expression_t *)node->data, sink);
             first = false;
           }
-          sb_append(sb, ")");
+          put(sink, ")");
         }
       }
       break;
@@ -143,104 +144,143 @@ static void expression_to_string(expression_t *e, string_builder_t *sb)
       if (e->parms.op.arity == 1) {
         switch (e->parms.op.opcode) {
           case '-':
-            sb_append(sb, "-");
+            put(sink, "-");
             break;
           case FABS:
-            sb_append(sb, "FABS(");
-            expression_to_string(e->parms.op.p[0], sb);
-            sb_append(sb, ")");
+            put(sink, "FABS(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
             return;
           case FATN:
-            sb_append(sb, "FATN(");
-            expression_to_string(e->parms.op.p[0], sb);
-            sb_append(sb, ")");
+            put(sink, "FATN(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
             return;
           case FCOS:
-            sb_append(sb, "FCOS(");
-            expression_to_string(e->parms.op.p[0], sb);
-            sb_append(sb, ")");
+            put(sink, "FCOS(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
             return;
           case FEXP:
-            sb_append(sb, "FEXP(");
-            expression_to_string(e->parms.op.p[0], sb);
-            sb_append(sb, ")");
+            put(sink, "FEXP(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
             return;
           case FITR:
-            sb_append(sb, "FITR(");
-            expression_to_string(e->parms.op.p[0], sb);
-            sb_append(sb, ")");
+            put(sink, "FITR(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
             return;
           case FLOG:
-            sb_append(sb, "FLOG(");
-            expression_to_string(e->parms.op.p[0], sb);
-            sb_append(sb, ")");
+            put(sink, "FLOG(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
             return;
           case FSIN:
-            sb_append(sb, "FSIN(");
-            expression_to_string(e->parms.op.p[0], sb);
-            sb_append(sb, ")");
+            put(sink, "FSIN(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
             return;
           case FSGN:
-            sb_append(sb, "FSGN(");
-            expression_to_string(e->parms.op.p[0], sb);
-            sb_append(sb, ")");
+            put(sink, "FSGN(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
             return;
           case FSQT:
-            sb_append(sb, "FSQT(");
-            expression_to_string(e->parms.op.p[0], sb);
-            sb_append(sb, ")");
+            put(sink, "FSQT(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
             return;
           case FIN:
-            sb_append(sb, "FIN(");
-            expression_to_string(e->parms.op.p[0], sb);
-            sb_append(sb, ")");
+            put(sink, "FIN(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
             return;
           case FOUT:
-            sb_append(sb, "FOUT(");
-            expression_to_string(e->parms.op.p[0], sb);
-            sb_append(sb, ")");
+            put(sink, "FOUT(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
+            return;
+          case FCOM:
+            put(sink, "FCOM(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
+            return;
+          case FADC:
+            put(sink, "FADC(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
+            return;
+          case FDIS:
+            put(sink, "FDIS(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
+            return;
+          case FDXS:
+            put(sink, "FDXS(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
+            return;
+          case FNEW:
+            put(sink, "FNEW(");
+            expression_to_string(e->parms.op.p[0], sink);
+            put(sink, ")");
             return;
           default:
             // Unknown unary operator
-            sb_append(sb, "?");
+            put(sink, "?");
         }
-        expression_to_string(e->parms.op.p[0], sb);
+        expression_to_string(e->parms.op.p[0], sink);
+      }
+      // FCOM with a value to store, and FDIS and FDXS with X and Y, have two parameters
+      else if (e->parms.op.arity == 2 && (e->parms.op.opcode == FCOM || e->parms.op.opcode == FDIS || e->parms.op.opcode == FDXS)) {
+        put(sink, e->parms.op.opcode == FCOM ? "FCOM(" : e->parms.op.opcode == FDIS ? "FDIS(" : "FDXS(");
+        expression_to_string(e->parms.op.p[0], sink);
+        put(sink, ",");
+        expression_to_string(e->parms.op.p[1], sink);
+        put(sink, ")");
+      }
+      // the arguments to FNEW are chained together with commas
+      else if (e->parms.op.arity == 2 && e->parms.op.opcode == ',') {
+        expression_to_string(e->parms.op.p[0], sink);
+        put(sink, ",");
+        expression_to_string(e->parms.op.p[1], sink);
       }
       // Binary operators
       else if (e->parms.op.arity == 2) {
-        sb_append(sb, "(");
-        expression_to_string(e->parms.op.p[0], sb);
+        put(sink, "(");
+        expression_to_string(e->parms.op.p[0], sink);
         
         switch (e->parms.op.opcode) {
           case '+':
-            sb_append(sb, "+");
+            put(sink, "+");
             break;
           case '-':
-            sb_append(sb, "-");
+            put(sink, "-");
             break;
           case '*':
-            sb_append(sb, "*");
+            put(sink, "*");
             break;
           case '/':
-            sb_append(sb, "/");
+            put(sink, "/");
             break;
           case '^':
-            sb_append(sb, "^");
+            put(sink, "^");
             break;
           case '=':
-            sb_append(sb, "=");
+            put(sink, "=");
             break;
           default:
-            sb_append(sb, "?");
+            put(sink, "?");
         }
         
-        expression_to_string(e->parms.op.p[1], sb);
-        sb_append(sb, ")");
+        expression_to_string(e->parms.op.p[1], sink);
+        put(sink, ")");
       }
       break;
       
     default:
-      sb_append(sb, "?");
+      put(sink, "?");
   }
 }
 
@@ -248,92 +288,92 @@ static void expression_to_string(expression_t *e, string_builder_t *sb)
  * Reconstruct a single statement as canonical FOCAL source code.
  *
  * @param stmt The statement to reconstruct.
- * @param sb String builder to append result to.
+ * @param sink Where to write it.
  */
-static void statement_to_string(statement_t *stmt, string_builder_t *sb)
+static void statement_to_string(statement_t *stmt, sink_t *sink)
 {
   if (stmt == NULL)
     return;
     
   switch (stmt->type) {
     case COMMENT:
-      sb_append(sb, stmt->abbreviated ? "C" : "COMMENT");
+      put(sink, stmt->abbreviated ? "C" : "COMMENT");
       if (stmt->parms.rem)
-        sb_append(sb, stmt->parms.rem);
+        put(sink, stmt->parms.rem);
       break;
       
     case SET:
-      sb_append(sb, stmt->abbreviated ? "S " : "SET ");
+      put(sink, stmt->abbreviated ? "S " : "SET ");
       if (stmt->parms.set.variable && stmt->parms.set.variable->name)
-        sb_append(sb, stmt->parms.set.variable->name);
-      sb_append(sb, "=");
-      expression_to_string(stmt->parms.set.expression, sb);
+        put(sink, stmt->parms.set.variable->name);
+      put(sink, "=");
+      expression_to_string(stmt->parms.set.expression, sink);
       break;
       
     case DO:
       if (stmt->abbreviated)
-        sb_append_fmt(sb, "D %2.2f", stmt->parms._do);
+        put_fmt(sink, "D %2.2f", stmt->parms._do);
       else
-        sb_append_fmt(sb, "DO %2.2f", stmt->parms._do);
+        put_fmt(sink, "DO %2.2f", stmt->parms._do);
       break;
       
     case GOTO:
       if (stmt->abbreviated)
-        sb_append_fmt(sb, "G %2.2f", stmt->parms.go);
+        put_fmt(sink, "G %2.2f", stmt->parms.go);
       else
-        sb_append_fmt(sb, "GOTO %2.2f", stmt->parms.go);
+        put_fmt(sink, "GOTO %2.2f", stmt->parms.go);
       break;
       
     case FOR:
-      sb_append(sb, stmt->abbreviated ? "F " : "FOR ");
+      put(sink, stmt->abbreviated ? "F " : "FOR ");
       if (stmt->parms._for.variable && stmt->parms._for.variable->name)
-        sb_append(sb, stmt->parms._for.variable->name);
-      sb_append(sb, "=");
-      expression_to_string(stmt->parms._for.begin, sb);
-      sb_append(sb, ",");
-      expression_to_string(stmt->parms._for.step, sb);
-      sb_append(sb, ",");
-      expression_to_string(stmt->parms._for.end, sb);
+        put(sink, stmt->parms._for.variable->name);
+      put(sink, "=");
+      expression_to_string(stmt->parms._for.begin, sink);
+      put(sink, ",");
+      expression_to_string(stmt->parms._for.step, sink);
+      put(sink, ",");
+      expression_to_string(stmt->parms._for.end, sink);
       break;
       
     case IF:
     {
-      sb_append(sb, stmt->abbreviated ? "I (" : "IF (");
-      expression_to_string(stmt->parms._if.condition, sb);
-      sb_append(sb, ")");
+      put(sink, stmt->abbreviated ? "I (" : "IF (");
+      expression_to_string(stmt->parms._if.condition, sink);
+      put(sink, ")");
       
       int need_first = 1;
       if (stmt->parms._if.less_line > 0) {
-        sb_append_fmt(sb, "%2.2f", stmt->parms._if.less_line);
+        put_fmt(sink, "%2.2f", stmt->parms._if.less_line);
         need_first = 0;
       }
       
       if (stmt->parms._if.zero_line > 0) {
         if (!need_first)
-          sb_append(sb, ",");
-        sb_append_fmt(sb, "%2.2f", stmt->parms._if.zero_line);
+          put(sink, ",");
+        put_fmt(sink, "%2.2f", stmt->parms._if.zero_line);
         need_first = 0;
       }
       
       if (stmt->parms._if.more_line > 0) {
         if (!need_first)
-          sb_append(sb, ",");
-        sb_append_fmt(sb, "%2.2f", stmt->parms._if.more_line);
+          put(sink, ",");
+        put_fmt(sink, "%2.2f", stmt->parms._if.more_line);
       }
       break;
     }
       
     case ASK:
     {
-      sb_append(sb, stmt->abbreviated ? "A " : "ASK ");
+      put(sink, stmt->abbreviated ? "A " : "ASK ");
       bool first = true;
       for (list_t *node = stmt->parms.input; node != NULL; node = node->next) {
         if (!first)
-          sb_append(sb, ",");
+          put(sink, ",");
         if (node->data) {
           variable_t *var = (variable_t *)node->data;
           if (var->name)
-            sb_append(sb, var->name);
+            put(sink, var->name);
         }
         first = false;
       }
@@ -342,27 +382,27 @@ static void statement_to_string(statement_t *stmt, string_builder_t *sb)
       
     case TYPE:
     {
-      sb_append(sb, stmt->abbreviated ? "T " : "TYPE ");
+      put(sink, stmt->abbreviated ? "T " : "TYPE ");
       bool first = true;
       for (list_t *node = stmt->parms.print; node != NULL; node = node->next) {
         if (!first)
-          sb_append(sb, ",");
+          put(sink, ",");
         if (node->data) {
           printitem_t *item = (printitem_t *)node->data;
           if (item->expression) {
-            expression_to_string(item->expression, sb);
+            expression_to_string(item->expression, sink);
           } else if (item->format) {
-            sb_append_fmt(sb, "%%%s", item->format);
+            put_fmt(sink, "%%%s", item->format);
           } else if (item->separator) {
             switch (item->separator) {
               case '!':
-                sb_append(sb, "!");
+                put(sink, "!");
                 break;
               case '#':
-                sb_append(sb, "#");
+                put(sink, "#");
                 break;
               case ':':
-                sb_append(sb, ":");
+                put(sink, ":");
                 break;
             }
           }
@@ -373,52 +413,73 @@ static void statement_to_string(statement_t *stmt, string_builder_t *sb)
     }
       
     case RETURN:
-      sb_append(sb, stmt->abbreviated ? "R" : "RETURN");
+      put(sink, stmt->abbreviated ? "R" : "RETURN");
       break;
       
     case QUIT:
-      sb_append(sb, stmt->abbreviated ? "Q" : "QUIT");
+      put(sink, stmt->abbreviated ? "Q" : "QUIT");
       break;
       
     case ERASE:
-      sb_append(sb, stmt->abbreviated ? "E" : "ERASE");
+      put(sink, stmt->abbreviated ? "E" : "ERASE");
       break;
       
     case LIBRARY:
-      sb_append(sb, stmt->abbreviated ? "L " : "LIBRARY ");
+      put(sink, stmt->abbreviated ? "L " : "LIBRARY ");
       switch (stmt->parms.library.action) {
         case 0:
-          sb_append(sb, "SAVE ");
+          put(sink, "SAVE ");
           break;
         case 1:
-          sb_append(sb, "CALL ");
+          put(sink, "CALL ");
           break;
         case 2:
-          sb_append(sb, "RUN ");
+          put(sink, "RUN ");
           break;
         default:
-          sb_append(sb, "UNKNOWN ");
+          put(sink, "UNKNOWN ");
           break;
       }
       if (stmt->parms.library.filename)
-        sb_append(sb, stmt->parms.library.filename);
+        put(sink, stmt->parms.library.filename);
+      break;
+      
+    case OPEN:
+      put(sink, stmt->abbreviated ? "O " : "OPEN ");
+      switch (stmt->parms.open.action) {
+        case 0:
+          put(sink, "INPUT ");
+          break;
+        case 1:
+          put(sink, "OUTPUT ");
+          break;
+        case 2:
+          put(sink, "RESTORE INPUT");
+          break;
+        case 3:
+          put(sink, "RESTORE OUTPUT");
+          break;
+        default:
+          put(sink, "CLOSE ");
+          break;
+      }
+      expression_to_string(stmt->parms.open.channel, sink);
+      if (stmt->parms.open.channel && stmt->parms.open.filename)
+        put(sink, ",");
+      expression_to_string(stmt->parms.open.filename, sink);
       break;
       
     default:
-      sb_append(sb, "; unknown statement");
+      put(sink, "; unknown statement");
   }
 }
 
-/**
- * Generate a canonical listing of the current program.
- */
-char *write_program(int start_line, int end_line)
+/* writes the lines from start_line up to end_line, one at a time */
+static void write_lines(sink_t *sink, int start_line, int end_line)
 {
-  string_builder_t sb;
-  sb_init(&sb);
-  
-  // Iterate through the program lines
-  for (int i = start_line; i < end_line && i < MAXLINE; i++) {
+  // the first is looked at even if it's line 0, after that only the
+  // lines in the program
+  for (int i = start_line; i < end_line && i < MAXLINE; i = program_next_line(i)) {
     if (interpreter_state.lines[i] == NULL)
       continue;
       
@@ -427,22 +488,46 @@ char *write_program(int start_line, int end_line)
     int step = i % 100;
     
     // Append line number
-    sb_append_fmt(&sb, "%d.%02d ", group, step);
+    put_fmt(sink, "%d.%02d ", group, step);
     
-    // Append each statement on the line
+    // Append each statement on the line, stopping at the next line as
+    // they are all chained together once the program has been post-parsed
+    list_t *stop = next_line_head(i);
     bool first_stmt = true;
-    for (list_t *node = interpreter_state.lines[i]; node != NULL; node = node->next) {
+    for (list_t *node = interpreter_state.lines[i]; node != NULL && node != stop; node = node->next) {
       if (node->data) {
         if (!first_stmt)
-          sb_append(&sb, ";");
-        statement_to_string((statement_t *)node->data, &sb);
+          put(sink, ";");
+        statement_to_string((statement_t *)node->data, sink);
         first_stmt = false;
       }
     }
     
     // End the line
-    sb_append(&sb, "\n");
+    put(sink, "\n");
+  }
+}
+
+/**
+ * Generate a canonical listing of the current program.
+ */
+char *write_program(int start_line, int end_line)
+{
+  sink_t sink = { NULL, malloc(256), 0, 256 };
+  if (sink.data == NULL) {
+    fprintf(stderr, "Malloc failed in write_output\n");
+    exit(EXIT_FAILURE);
   }
-  
-  return sb.data;
+  sink.data[0] = '\0';
+  write_lines(&sink, start_line, end_line);
+  return sink.data;
+}
+
+/**
+ * Write a canonical listing of the current program to a file.
+ */
+void write_listing(FILE *file, int start_line, int end_line)
+{
+  sink_t sink = { file, NULL, 0, 0 };
+  write_lines(&sink, start_line, end_line);
 }
@@ -21,6 +21,8 @@
 #ifndef __WRITE_H__
 #define __WRITE_H__
 
+#include <stdio.h>
+
 /**
  * @file write.h
  * @author Maury Markowitz
@@ -29,6 +31,10 @@
  *
  * Reconstructs the tokenized program as canonical FOCAL source code.
  * Used by WRITE command and LIBRARY SAVE.
+ *
+ * WRITE and LIBRARY SAVE send the listing straight to the file a line at
+ * a time, through its buffer, so a large program is never held as one
+ * string. write_program builds the string for anything that needs one.
  */
 
 /**
@@ -40,4 +46,13 @@
  */
 char *write_program(int start_line, int end_line);
 
+/**
+ * Write a canonical listing of the current program to a file.
+ *
+ * @param file Where the listing goes, with any errors left for ferror.
+ * @param start_line The first line number to include (in FOCAL xx.yy format, *100).
+ * @param end_line The last line number to include (in FOCAL xx.yy format, *100).
+ */
+void write_listing(FILE *file, int start_line, int end_line);
+
 #endif /* __WRITE_H__ */